@@ -76,6 +76,10 @@ struct agent_options {
   unsigned long def_cache_ttl; /* Default. */
   unsigned long max_cache_ttl; /* Default. */
 
+  /* Maximum lifetime of an unprotected key in the key cache; 0
+     disables that cache.  */
+  unsigned long key_cache_ttl;
+
   /* Flag disallowing bypassing of the warning.  */
   int enforce_passphrase_constraints;
 
@@ -99,6 +103,10 @@ struct agent_options {
   /* If set the extended key format is used for new keys.  */
   int enable_extended_key_format;
 
+  /* If set new keys are protected using scrypt instead of the
+     iterated and salted S2K.  */
+  int enable_scrypt_protection;
+
   int running_detached; /* We are running detached from the tty. */
 
   /* If this global option is true, the passphrase cache is ignored
@@ -232,6 +240,14 @@ typedef enum {
 /* The type of a function to lookup a TTL by a keygrip.  */
 typedef int (*lookup_ttl_t)(const char *hexgrip);
 
+/* Identifies the version of a key file a cached unprotected key was
+   made from; a cache entry is only used while the file is unchanged.  */
+struct key_file_stamp_s {
+  time_t mtime;
+  unsigned long long size;
+  unsigned long long ino;
+};
+
 /* Used to translate agent strings for connections.  */
 #define L_(a) (a)
 
@@ -251,7 +267,7 @@ gpg_error_t agent_write_status(ctrl_t ctrl, const char *keyword, ...)
     GPGRT_ATTR_SENTINEL(0);
 gpg_error_t agent_print_status(ctrl_t ctrl, const char *keyword,
                                const char *format, ...) GPGRT_ATTR_PRINTF(3, 4);
-void start_command_handler(ctrl_t);
+void start_command_handler(ctrl_t, gnupg_fd_t);
 gpg_error_t pinentry_loopback(ctrl_t, const char *keyword,
                               unsigned char **buffer, size_t *size,
                               size_t max_length);
@@ -323,10 +339,18 @@ int agent_clear_passphrase(ctrl_t ctrl, const char *keyinfo,
 void initialize_module_cache(void);
 void deinitialize_module_cache(void);
 void agent_flush_cache(void);
+void agent_cache_housekeeping(void);
 int agent_put_cache(const char *key, cache_mode_t cache_mode, const char *data,
                     int ttl);
 char *agent_get_cache(const char *key, cache_mode_t cache_mode);
 void agent_store_cache_hit(const char *key);
+gpg_error_t agent_put_key_cache(const char *hexgrip,
+                                const struct key_file_stamp_s *stamp,
+                                const unsigned char *key, size_t keylen);
+unsigned char *agent_get_key_cache(const char *hexgrip,
+                                   const struct key_file_stamp_s *stamp,
+                                   size_t *r_keylen);
+void agent_forget_key_cache(const char *hexgrip);
 
 /*-- pksign.c --*/
 int agent_pksign_do(ctrl_t ctrl, const char *cache_nonce, const char *desc_text,
@@ -20,6 +20,8 @@
 #include <config.h>
 
 #include <mutex>
+#include <string>
+#include <unordered_map>
 
 #include <assert.h>
 #include <stdio.h>
@@ -51,23 +53,56 @@ struct secret_data_s {
   char data[1]; /* A string.  */
 };
 
+/* A cached passphrase.  All items with the same key are chained
+   using NEXT, most recently inserted first.  Each item is also linked
+   into the slot of the timer wheel for its DUE time.  */
 typedef struct cache_item_s *ITEM;
 struct cache_item_s {
   ITEM next;
+  ITEM wheel_next;
+  ITEM *wheel_prevp;
   time_t created;
   time_t accessed;
-  int ttl; /* max. lifetime given in seconds, -1 one means infinite */
+  time_t due; /* When the timer wheel looks at this item again.  */
+  int ttl;    /* max. lifetime given in seconds, -1 one means infinite */
   struct secret_data_s *pw;
   cache_mode_t cache_mode;
   char key[1];
 };
 
-/* The cache himself.  */
-static ITEM thecache;
+/* The cache himself, mapping a key to the chain of its items.  There
+   is usually only one item per key, but a GET_PASSPHRASE entry may
+   share its key with one of another mode.  */
+static std::unordered_map<std::string, ITEM> thecache;
+
+/* The timer wheel used to expire the items.  An item is put into the
+   slot for its expiration time modulo the number of slots.  Each
+   second the current slot is checked; items which are not yet due
+   because they were accessed meanwhile or belong to a later round of
+   the wheel are put back into the wheel.  */
+#define WHEEL_SLOTS 512
+static ITEM timer_wheel[WHEEL_SLOTS];
+
+/* The last time the wheel was advanced to.  */
+static time_t wheel_time;
 
 /* NULL or the last cache key stored by agent_store_cache_hit.  */
 static char *last_stored_cache_key;
 
+/* An unprotected private key in canonical S-expression format.  The
+   key is wrapped with the same key as the passphrases and padded to a
+   multiple of 8 bytes; KEYLEN is the length of the actual key.  */
+struct key_cache_item_s {
+  time_t created;
+  struct key_file_stamp_s stamp;
+  size_t keylen;
+  Botan::secure_vector<uint8_t> wrapped;
+};
+
+/* The unprotected keys indexed by their hex encoded keygrip.  Also
+   protected by CACHE_LOCK.  */
+static std::unordered_map<std::string, key_cache_item_s> key_cache;
+
 void deinitialize_module_cache(void) {
   delete encryption_handle;
   encryption_handle = NULL;
@@ -144,75 +179,125 @@ static gpg_error_t new_data(const char *string, struct secret_data_s **r_data) {
   return 0;
 }
 
-/* Check whether there are items to expire.  */
-static void housekeeping(void) {
-  ITEM r, rprev;
-  time_t current = gnupg_get_time();
+/* Return the last second in which item R is still valid.  */
+static time_t item_expiry(ITEM r) {
+  time_t expiry = r->created + opt.max_cache_ttl;
 
-  /* First expire the actual data */
-  for (r = thecache; r; r = r->next) {
-    if (r->pw && r->ttl >= 0 && r->accessed + r->ttl < current) {
-      if (DBG_CACHE)
-        log_debug("  expired '%s' (%ds after last access)\n", r->key, r->ttl);
-      release_data(r->pw);
-      r->pw = NULL;
-      r->accessed = current;
-    }
-  }
+  if (r->ttl >= 0 && r->accessed + r->ttl < expiry)
+    expiry = r->accessed + r->ttl;
+  return expiry;
+}
 
-  /* Second, make sure that we also remove them based on the created stamp so
-     that the user has to enter it from time to time. */
-  for (r = thecache; r; r = r->next) {
-    unsigned long maxttl;
+/* Put item R into the slot of the timer wheel for its expiration.  */
+static void wheel_insert(ITEM r) {
+  ITEM *slot;
 
-    maxttl = opt.max_cache_ttl;
-    if (r->pw && r->created + maxttl < current) {
-      if (DBG_CACHE)
-        log_debug("  expired '%s' (%lus after creation)\n", r->key,
-                  opt.max_cache_ttl);
-      release_data(r->pw);
-      r->pw = NULL;
-      r->accessed = current;
-    }
+  r->due = item_expiry(r) + 1;
+  slot = &timer_wheel[r->due % WHEEL_SLOTS];
+  r->wheel_next = *slot;
+  if (r->wheel_next) r->wheel_next->wheel_prevp = &r->wheel_next;
+  r->wheel_prevp = slot;
+  *slot = r;
+}
+
+static void wheel_remove(ITEM r) {
+  if (!r->wheel_prevp) return;
+  *r->wheel_prevp = r->wheel_next;
+  if (r->wheel_next) r->wheel_next->wheel_prevp = r->wheel_prevp;
+  r->wheel_next = NULL;
+  r->wheel_prevp = NULL;
+}
+
+/* Remove item R from the cache and release it.  */
+static void remove_item(ITEM r) {
+  auto head = thecache.find(r->key);
+  ITEM *rp;
+
+  wheel_remove(r);
+  if (head != thecache.end()) {
+    for (rp = &head->second; *rp; rp = &(*rp)->next)
+      if (*rp == r) {
+        *rp = r->next;
+        break;
+      }
+    if (!head->second) thecache.erase(head);
   }
+  release_data(r->pw);
+  xfree(r);
+}
 
-  /* Third, make sure that we don't have too many items in the list.
-     Expire old and unused entries after 30 minutes */
-  for (rprev = NULL, r = thecache; r;) {
-    if (!r->pw && r->ttl >= 0 && r->accessed + 60 * 30 < current) {
-      ITEM r2 = r->next;
-      if (DBG_CACHE)
-        log_debug("  removed '%s' (mode %d) (slot not used for 30m)\n", r->key,
-                  r->cache_mode);
-      xfree(r);
-      if (!rprev)
-        thecache = r2;
-      else
-        rprev->next = r2;
-      r = r2;
-    } else {
-      rprev = r;
-      r = r->next;
+/* Check the slot of the timer wheel for the second T and expire the
+   items which are due.  */
+static void expire_slot(time_t t, time_t current) {
+  ITEM r, rnext;
+
+  r = timer_wheel[t % WHEEL_SLOTS];
+  timer_wheel[t % WHEEL_SLOTS] = NULL;
+  for (; r; r = rnext) {
+    rnext = r->wheel_next;
+    r->wheel_next = NULL;
+    r->wheel_prevp = NULL;
+
+    /* Items of a later round of the wheel and items which have been
+       accessed since they were scheduled go back into the wheel.  */
+    if (item_expiry(r) >= current) {
+      wheel_insert(r);
+      continue;
     }
+    if (DBG_CACHE)
+      log_debug("  expired '%s' (mode %d)\n", r->key, r->cache_mode);
+    key_cache.erase(r->key);
+    remove_item(r);
   }
 }
 
-void agent_flush_cache(void) {
-  ITEM r;
-  int res;
+/* Check whether there are items to expire.  This advances the timer
+   wheel to the current time; the cost depends on the number of items
+   due, not on the size of the cache.  The few unprotected keys are
+   all looked at, once per second.  */
+static void housekeeping(void) {
+  time_t current = gnupg_get_time();
+  time_t t;
+
+  if (current == wheel_time) return;
+
+  /* After a long pause or a backward clock jump look at all slots.  */
+  if (!wheel_time || current < wheel_time ||
+      current - wheel_time > WHEEL_SLOTS)
+    wheel_time = current - WHEEL_SLOTS;
+  for (t = wheel_time + 1; t <= current; t++) expire_slot(t, current);
+  wheel_time = current;
+
+  for (auto it = key_cache.begin(); it != key_cache.end();) {
+    if (it->second.created + (time_t)opt.key_cache_ttl < current) {
+      if (DBG_CACHE) log_debug("  expired key '%s'\n", it->first.c_str());
+      it = key_cache.erase(it);
+    } else
+      ++it;
+  }
+}
+
+/* Expire the passphrases and unprotected keys which are due.  This
+   is called by the connection loop about once a second, so that they
+   do not stay in memory while the cache is not used.  */
+void agent_cache_housekeeping(void) {
+  std::lock_guard<std::mutex> lock(cache_lock);
 
+  housekeeping();
+}
+
+void agent_flush_cache(void) {
   if (DBG_CACHE) log_debug("agent_flush_cache\n");
 
   std::lock_guard<std::mutex> lock(cache_lock);
 
-  for (r = thecache; r; r = r->next) {
-    if (r->pw) {
-      if (DBG_CACHE) log_debug("  flushing '%s'\n", r->key);
-      release_data(r->pw);
-      r->pw = NULL;
-      r->accessed = 0;
-    }
+  while (!thecache.empty()) {
+    ITEM r = thecache.begin()->second;
+
+    if (DBG_CACHE) log_debug("  flushing '%s'\n", r->key);
+    remove_item(r);
   }
+  key_cache.clear();
 }
 
 /* Compare two cache modes.  */
@@ -222,6 +307,21 @@ static int cache_mode_equal(cache_mode_t a, cache_mode_t b) {
           (b == CACHE_MODE_ANY && a != CACHE_MODE_IGNORE) || a == b);
 }
 
+/* Return the item for KEY and CACHE_MODE or NULL.  Except for
+   CACHE_MODE_USER and CACHE_MODE_NONCE, the mode of the item does
+   not matter.  */
+static ITEM find_item(const char *key, cache_mode_t cache_mode) {
+  auto head = thecache.find(key);
+  ITEM r;
+
+  if (head == thecache.end()) return NULL;
+  for (r = head->second; r; r = r->next)
+    if ((cache_mode != CACHE_MODE_USER && cache_mode != CACHE_MODE_NONCE) ||
+        cache_mode_equal(r->cache_mode, cache_mode))
+      return r;
+  return NULL;
+}
+
 /* Store the string DATA in the cache under KEY and mark it with a
    maximum lifetime of TTL seconds.  If there is already data under
    this key, it will be replaced.  Using a DATA of NULL deletes the
@@ -232,7 +332,6 @@ int agent_put_cache(const char *key, cache_mode_t cache_mode, const char *data,
                     int ttl) {
   gpg_error_t err = 0;
   ITEM r;
-  int res;
 
   std::lock_guard<std::mutex> lock(cache_lock);
 
@@ -241,27 +340,32 @@ int agent_put_cache(const char *key, cache_mode_t cache_mode, const char *data,
               cache_mode, ttl);
   housekeeping();
 
+  /* A new or cleared passphrase invalidates a key unprotected with
+     the old one.  */
+  key_cache.erase(key);
+
   if (!ttl) ttl = opt.def_cache_ttl;
   if ((!ttl && data) || cache_mode == CACHE_MODE_IGNORE) goto out;
 
-  for (r = thecache; r; r = r->next) {
-    if (((cache_mode != CACHE_MODE_USER && cache_mode != CACHE_MODE_NONCE) ||
-         cache_mode_equal(r->cache_mode, cache_mode)) &&
-        !strcmp(r->key, key))
-      break;
-  }
+  r = find_item(key, cache_mode);
   if (r) /* Replace.  */
   {
-    if (r->pw) {
-      release_data(r->pw);
-      r->pw = NULL;
-    }
+    struct secret_data_s *pw = NULL;
+
     if (data) {
+      err = new_data(data, &pw);
+      if (err) log_error("error replacing cache item: %s\n", gpg_strerror(err));
+    }
+    if (!pw)
+      remove_item(r);
+    else {
+      release_data(r->pw);
+      r->pw = pw;
       r->created = r->accessed = gnupg_get_time();
       r->ttl = ttl;
       r->cache_mode = cache_mode;
-      err = new_data(data, &r->pw);
-      if (err) log_error("error replacing cache item: %s\n", gpg_strerror(err));
+      wheel_remove(r);
+      wheel_insert(r);
     }
   } else if (data) /* Insert.  */
   {
@@ -277,8 +381,11 @@ int agent_put_cache(const char *key, cache_mode_t cache_mode, const char *data,
       if (err)
         xfree(r);
       else {
-        r->next = thecache;
-        thecache = r;
+        ITEM &head = thecache[key];
+
+        r->next = head;
+        head = r;
+        wheel_insert(r);
       }
     }
     if (err) log_error("error inserting cache item: %s\n", gpg_strerror(err));
@@ -295,7 +402,6 @@ char *agent_get_cache(const char *key, cache_mode_t cache_mode) {
   gpg_error_t err;
   ITEM r;
   char *value = NULL;
-  int res;
   int last_stored = 0;
 
   if (cache_mode == CACHE_MODE_IGNORE) return NULL;
@@ -313,36 +419,41 @@ char *agent_get_cache(const char *key, cache_mode_t cache_mode) {
               last_stored ? " (stored cache key)" : "");
   housekeeping();
 
-  for (r = thecache; r; r = r->next) {
-    if (r->pw &&
-        ((cache_mode != CACHE_MODE_USER && cache_mode != CACHE_MODE_NONCE) ||
-         cache_mode_equal(r->cache_mode, cache_mode)) &&
-        !strcmp(r->key, key)) {
-      /* Note: To avoid races KEY may not be accessed anymore below.  */
-      r->accessed = gnupg_get_time();
-      if (DBG_CACHE) log_debug("... hit\n");
-      if (r->pw->totallen < 32)
-        err = GPG_ERR_INV_LENGTH;
-      else if ((err = init_encryption()))
-        ;
-      else if (!(value = (char *)xtrymalloc_secure(r->pw->totallen - 8)))
-        err = gpg_error_from_syserror();
-      else {
-        const Botan::secure_vector<uint8_t> pw_data(r->pw->totallen);
-        memcpy((void *)(pw_data.data()), r->pw->data, r->pw->totallen);
-        Botan::secure_vector<uint8_t> val =
-            Botan::rfc3394_keyunwrap(pw_data, *encryption_handle);
-        assert(val.size() == r->pw->totallen - 8);
-        memcpy(value, val.data(), val.size());
-        err = 0;
-      }
-      if (err) {
-        xfree(value);
-        value = NULL;
-        log_error("retrieving cache entry '%s' failed: %s\n", key,
-                  gpg_strerror(err));
-      }
-      break;
+  r = find_item(key, cache_mode);
+  if (r && item_expiry(r) < gnupg_get_time()) {
+    /* Due but its slot has not been checked yet.  */
+    if (DBG_CACHE)
+      log_debug("  expired '%s' (mode %d)\n", r->key, r->cache_mode);
+    key_cache.erase(r->key);
+    remove_item(r);
+    r = NULL;
+  }
+  if (r) {
+    /* Note: To avoid races KEY may not be accessed anymore below.
+       The timer wheel picks up the new access time when the item's
+       slot comes round.  */
+    r->accessed = gnupg_get_time();
+    if (DBG_CACHE) log_debug("... hit\n");
+    if (r->pw->totallen < 32)
+      err = GPG_ERR_INV_LENGTH;
+    else if ((err = init_encryption()))
+      ;
+    else if (!(value = (char *)xtrymalloc_secure(r->pw->totallen - 8)))
+      err = gpg_error_from_syserror();
+    else {
+      const Botan::secure_vector<uint8_t> pw_data(r->pw->totallen);
+      memcpy((void *)(pw_data.data()), r->pw->data, r->pw->totallen);
+      Botan::secure_vector<uint8_t> val =
+          Botan::rfc3394_keyunwrap(pw_data, *encryption_handle);
+      assert(val.size() == r->pw->totallen - 8);
+      memcpy(value, val.data(), val.size());
+      err = 0;
+    }
+    if (err) {
+      xfree(value);
+      value = NULL;
+      log_error("retrieving cache entry '%s' failed: %s\n", r->key,
+                gpg_strerror(err));
     }
   }
   if (DBG_CACHE && value == NULL) log_debug("... miss\n");
@@ -381,3 +492,77 @@ void agent_store_cache_hit(const char *key) {
 
   xfree(old);
 }
+
+/* Store the unprotected private key KEY of length KEYLEN under the
+   hex encoded keygrip HEXGRIP.  STAMP describes the key file the key
+   was read from.  The entry is kept for at most opt.key_cache_ttl
+   seconds; nothing is stored if that option is 0.  */
+gpg_error_t agent_put_key_cache(const char *hexgrip,
+                                const struct key_file_stamp_s *stamp,
+                                const unsigned char *key, size_t keylen) {
+  gpg_error_t err;
+
+  if (!opt.key_cache_ttl) return 0;
+
+  std::lock_guard<std::mutex> lock(cache_lock);
+
+  err = init_encryption();
+  if (err) return err;
+
+  if (DBG_CACHE) log_debug("agent_put_key_cache '%s'\n", hexgrip);
+
+  /* AESWRAP needs at least two blocks of 8 bytes.  */
+  Botan::secure_vector<uint8_t> data(keylen < 16 ? 16 : (keylen + 7) & ~7);
+  memcpy(data.data(), key, keylen);
+
+  key_cache_item_s &item = key_cache[hexgrip];
+  item.created = gnupg_get_time();
+  item.stamp = *stamp;
+  item.keylen = keylen;
+  item.wrapped = Botan::rfc3394_keywrap(data, *encryption_handle);
+  return 0;
+}
+
+/* Return a copy of the unprotected key stored under HEXGRIP in secure
+   memory and its length at R_KEYLEN.  NULL is returned if there is no
+   such key, it is too old, or if STAMP shows that the key file has
+   changed since the key was stored.  */
+unsigned char *agent_get_key_cache(const char *hexgrip,
+                                   const struct key_file_stamp_s *stamp,
+                                   size_t *r_keylen) {
+  unsigned char *value;
+
+  *r_keylen = 0;
+  if (!opt.key_cache_ttl) return NULL;
+
+  std::lock_guard<std::mutex> lock(cache_lock);
+
+  auto it = key_cache.find(hexgrip);
+  if (it == key_cache.end()) return NULL;
+
+  key_cache_item_s &item = it->second;
+  if (item.created + (time_t)opt.key_cache_ttl < gnupg_get_time() ||
+      item.stamp.mtime != stamp->mtime || item.stamp.size != stamp->size ||
+      item.stamp.ino != stamp->ino) {
+    if (DBG_CACHE) log_debug("agent_get_key_cache '%s' ... stale\n", hexgrip);
+    key_cache.erase(it);
+    return NULL;
+  }
+
+  value = (unsigned char *)xtrymalloc_secure(item.keylen);
+  if (!value) return NULL;
+
+  Botan::secure_vector<uint8_t> data =
+      Botan::rfc3394_keyunwrap(item.wrapped, *encryption_handle);
+  memcpy(value, data.data(), item.keylen);
+  *r_keylen = item.keylen;
+  if (DBG_CACHE) log_debug("agent_get_key_cache '%s' ... hit\n", hexgrip);
+  return value;
+}
+
+/* Remove the unprotected key stored under HEXGRIP.  */
+void agent_forget_key_cache(const char *hexgrip) {
+  std::lock_guard<std::mutex> lock(cache_lock);
+
+  key_cache.erase(hexgrip);
+}
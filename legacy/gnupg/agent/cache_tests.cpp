@@ -0,0 +1,77 @@
+/* Tests for the agent cache
+   Copyright 2017 The NeoPG developers
+
+   NeoPG is released under the Simplified BSD License (see license.txt)
+*/
+
+#include <config.h>
+
+#include <string.h>
+
+#include "gtest/gtest.h"
+
+#include "agent.h"
+
+/* Normally defined in gpg-agent.cpp.  */
+struct agent_options opt;
+
+namespace {
+
+const time_t T0 = 1500000000;
+
+class AgentCacheTest : public ::testing::Test {
+ protected:
+  static void SetUpTestCase() {
+    gcry_control(GCRYCTL_INITIALIZATION_FINISHED, 0);
+  }
+
+  void SetUp() override {
+    opt.def_cache_ttl = 10;
+    opt.max_cache_ttl = 100;
+    opt.key_cache_ttl = 5;
+    gnupg_set_time(T0, 1);
+  }
+
+  void TearDown() override {
+    agent_flush_cache();
+    gnupg_set_time((time_t)-1, 0);
+  }
+};
+
+}  // namespace
+
+/* Entries must go away when they are due, even if the cache is not
+   used.  Afterwards the clock is set back to a time at which the
+   entries were still valid: a lookup then only misses them if the
+   housekeeping dropped them.  */
+TEST_F(AgentCacheTest, housekeeping_expires_unused_entries) {
+  static const unsigned char key[20] = {1, 2, 3};
+  struct key_file_stamp_s stamp = {T0, sizeof key, 1};
+  size_t keylen;
+  unsigned char *value;
+  char *pw;
+
+  ASSERT_EQ(agent_put_cache("short", CACHE_MODE_NORMAL, "secret", 10), 0);
+  ASSERT_EQ(agent_put_cache("long", CACHE_MODE_NORMAL, "secret", 20), 0);
+  ASSERT_EQ(agent_put_key_cache("old", &stamp, key, sizeof key), 0);
+  gnupg_set_time(T0 + 8, 1);
+  ASSERT_EQ(agent_put_key_cache("new", &stamp, key, sizeof key), 0);
+
+  gnupg_set_time(T0 + 11, 1);
+  agent_cache_housekeeping();
+
+  gnupg_set_time(T0 + 1, 1);
+  EXPECT_EQ(agent_get_cache("short", CACHE_MODE_NORMAL), nullptr);
+  EXPECT_EQ(agent_get_key_cache("old", &stamp, &keylen), nullptr);
+
+  pw = agent_get_cache("long", CACHE_MODE_NORMAL);
+  ASSERT_NE(pw, nullptr);
+  EXPECT_STREQ(pw, "secret");
+  xfree(pw);
+
+  value = agent_get_key_cache("new", &stamp, &keylen);
+  ASSERT_NE(value, nullptr);
+  ASSERT_EQ(keylen, sizeof key);
+  EXPECT_EQ(memcmp(value, key, sizeof key), 0);
+  xfree(value);
+}
@@ -24,6 +24,8 @@
 
 #include <config.h>
 
+#include <mutex>
+
 #include <assert.h>
 #include <ctype.h>
 #include <dirent.h>
@@ -1087,17 +1089,24 @@ static gpg_error_t cmd_get_passphrase(assuan_context_t ctx, char *line) {
 
 static const char hlp_clear_passphrase[] =
     "CLEAR_PASSPHRASE [--mode=normal] <cache_id>\n"
+    "CLEAR_PASSPHRASE --all\n"
     "\n"
     "may be used to invalidate the cache entry for a passphrase.  The\n"
     "function returns with OK even when there is no cached passphrase.\n"
     "The --mode=normal option is used to clear an entry for a cacheid\n"
-    "added by the agent.\n";
+    "added by the agent.  With --all all cached passphrases and all\n"
+    "cached unprotected keys are flushed.\n";
 static gpg_error_t cmd_clear_passphrase(assuan_context_t ctx, char *line) {
   ctrl_t ctrl = (ctrl_t)assuan_get_pointer(ctx);
   char *cacheid = NULL;
   char *p;
   int opt_normal;
 
+  if (has_option(line, "--all")) {
+    agent_flush_cache();
+    return 0;
+  }
+
   opt_normal = has_option(line, "--mode=normal");
   line = skip_options(line);
 
@@ -1786,45 +1795,68 @@ static int command_has_option(const char *cmd, const char *cmdopt) {
   return 0;
 }
 
+/* The commands known to the server.  */
+static const struct {
+  const char *name;
+  assuan_handler_t handler;
+  const char *const help;
+} command_table[] = {
+    {"ISTRUSTED", cmd_istrusted, hlp_istrusted},
+    {"HAVEKEY", cmd_havekey, hlp_havekey},
+    {"KEYINFO", cmd_keyinfo, hlp_keyinfo},
+    {"SIGKEY", cmd_sigkey, hlp_sigkey},
+    {"SETKEY", cmd_sigkey, hlp_sigkey},
+    {"SETKEYDESC", cmd_setkeydesc, hlp_setkeydesc},
+    {"SETHASH", cmd_sethash, hlp_sethash},
+    {"PKSIGN", cmd_pksign, hlp_pksign},
+    {"PKDECRYPT", cmd_pkdecrypt, hlp_pkdecrypt},
+    {"GENKEY", cmd_genkey, hlp_genkey},
+    {"READKEY", cmd_readkey, hlp_readkey},
+    {"GET_PASSPHRASE", cmd_get_passphrase, hlp_get_passphrase},
+    {"CLEAR_PASSPHRASE", cmd_clear_passphrase, hlp_clear_passphrase},
+    {"GET_CONFIRMATION", cmd_get_confirmation, hlp_get_confirmation},
+    {"LISTTRUSTED", cmd_listtrusted, hlp_listtrusted},
+    {"MARKTRUSTED", cmd_marktrusted, hlp_martrusted},
+    {"LEARN", cmd_learn, hlp_learn},
+    {"PASSWD", cmd_passwd, hlp_passwd},
+    {"INPUT", NULL, NULL},
+    {"OUTPUT", NULL, NULL},
+    {"SCD", cmd_scd, hlp_scd},
+    {"IMPORT_KEY", cmd_import_key, hlp_import_key},
+    {"EXPORT_KEY", cmd_export_key, hlp_export_key},
+    {"DELETE_KEY", cmd_delete_key, hlp_delete_key},
+    {"GETINFO", cmd_getinfo, hlp_getinfo},
+    {"KEYTOCARD", cmd_keytocard, hlp_keytocard},
+    {NULL, NULL, NULL}};
+
+/* Serializes the commands of all connections.  They share the
+   pinentry, the scdaemon connection and the key files, which are not
+   thread safe.  */
+static std::mutex command_lock;
+
+/* Run the handler of the current command under COMMAND_LOCK.  */
+static gpg_error_t locked_command(assuan_context_t ctx, char *line) {
+  const char *name = assuan_get_command_name(ctx);
+  int i;
+
+  for (i = 0; command_table[i].name; i++)
+    if (!strcmp(command_table[i].name, name)) break;
+  if (!command_table[i].name) return GPG_ERR_ASS_UNKNOWN_CMD;
+
+  std::lock_guard<std::mutex> lock(command_lock);
+  return command_table[i].handler(ctx, line);
+}
+
 /* Tell Libassuan about our commands.  Also register the other Assuan
    handlers. */
 static int register_commands(assuan_context_t ctx) {
-  static struct {
-    const char *name;
-    assuan_handler_t handler;
-    const char *const help;
-  } table[] = {{"ISTRUSTED", cmd_istrusted, hlp_istrusted},
-               {"HAVEKEY", cmd_havekey, hlp_havekey},
-               {"KEYINFO", cmd_keyinfo, hlp_keyinfo},
-               {"SIGKEY", cmd_sigkey, hlp_sigkey},
-               {"SETKEY", cmd_sigkey, hlp_sigkey},
-               {"SETKEYDESC", cmd_setkeydesc, hlp_setkeydesc},
-               {"SETHASH", cmd_sethash, hlp_sethash},
-               {"PKSIGN", cmd_pksign, hlp_pksign},
-               {"PKDECRYPT", cmd_pkdecrypt, hlp_pkdecrypt},
-               {"GENKEY", cmd_genkey, hlp_genkey},
-               {"READKEY", cmd_readkey, hlp_readkey},
-               {"GET_PASSPHRASE", cmd_get_passphrase, hlp_get_passphrase},
-               {"CLEAR_PASSPHRASE", cmd_clear_passphrase, hlp_clear_passphrase},
-               {"GET_CONFIRMATION", cmd_get_confirmation, hlp_get_confirmation},
-               {"LISTTRUSTED", cmd_listtrusted, hlp_listtrusted},
-               {"MARKTRUSTED", cmd_marktrusted, hlp_martrusted},
-               {"LEARN", cmd_learn, hlp_learn},
-               {"PASSWD", cmd_passwd, hlp_passwd},
-               {"INPUT", NULL, NULL},
-               {"OUTPUT", NULL, NULL},
-               {"SCD", cmd_scd, hlp_scd},
-               {"IMPORT_KEY", cmd_import_key, hlp_import_key},
-               {"EXPORT_KEY", cmd_export_key, hlp_export_key},
-               {"DELETE_KEY", cmd_delete_key, hlp_delete_key},
-               {"GETINFO", cmd_getinfo, hlp_getinfo},
-               {"KEYTOCARD", cmd_keytocard, hlp_keytocard},
-               {NULL, NULL, NULL}};
   int i, rc;
 
-  for (i = 0; table[i].name; i++) {
-    rc = assuan_register_command(ctx, table[i].name, table[i].handler,
-                                 table[i].help);
+  for (i = 0; command_table[i].name; i++) {
+    rc = assuan_register_command(
+        ctx, command_table[i].name,
+        command_table[i].handler ? locked_command : NULL,
+        command_table[i].help);
     if (rc) return rc;
   }
   assuan_register_reset_notify(ctx, reset_notify);
@@ -1833,8 +1865,11 @@ static int register_commands(assuan_context_t ctx) {
 }
 
 /* Startup the server.  CTRL is the control structure for this
-   connection; it has only the basic initialization. */
-void start_command_handler(ctrl_t ctrl) {
+   connection; it has only the basic initialization.  With FD =
+   ASSUAN_INVALID_FD use stdin/stdout, otherwise serve the connected
+   socket FD of the daemon, which is closed on return; errors then
+   only end this connection.  */
+void start_command_handler(ctrl_t ctrl, gnupg_fd_t fd) {
   int rc;
   assuan_context_t ctx = NULL;
   assuan_fd_t filedes[2];
@@ -1842,21 +1877,33 @@ void start_command_handler(ctrl_t ctrl) {
   rc = assuan_new(&ctx);
   if (rc) {
     log_error("failed to allocate assuan context: %s\n", gpg_strerror(rc));
-    agent_exit(2);
+    if (fd == ASSUAN_INVALID_FD) agent_exit(2);
+    close(fd);
+    return;
   }
 
-  filedes[0] = assuan_fdopen(0);
-  filedes[1] = assuan_fdopen(1);
+  if (fd == ASSUAN_INVALID_FD) {
+    filedes[0] = assuan_fdopen(0);
+    filedes[1] = assuan_fdopen(1);
+  } else {
+    filedes[0] = fd;
+    filedes[1] = fd;
+  }
   rc = assuan_init_pipe_server(ctx, filedes);
   if (rc) {
     log_error("failed to initialize the server: %s\n", gpg_strerror(rc));
-    agent_exit(2);
+    if (fd == ASSUAN_INVALID_FD) agent_exit(2);
+    assuan_release(ctx);
+    close(fd); /* Not yet owned by CTX.  */
+    return;
   }
   rc = register_commands(ctx);
   if (rc) {
     log_error("failed to register commands with Assuan: %s\n",
               gpg_strerror(rc));
-    agent_exit(2);
+    if (fd == ASSUAN_INVALID_FD) agent_exit(2);
+    assuan_release(ctx);
+    return;
   }
 
   assuan_set_pointer(ctx, ctrl);
@@ -1882,14 +1929,18 @@ void start_command_handler(ctrl_t ctrl) {
     }
   }
 
-  /* Reset the nonce caches.  */
-  clear_nonce_cache(ctrl);
+  {
+    std::lock_guard<std::mutex> lock(command_lock);
 
-  /* Reset the SCD if needed. */
-  agent_reset_scd(ctrl);
+    /* Reset the nonce caches.  */
+    clear_nonce_cache(ctrl);
 
-  /* Reset the pinentry (in case of popup messages). */
-  agent_reset_query(ctrl);
+    /* Reset the SCD if needed. */
+    agent_reset_scd(ctrl);
+
+    /* Reset the pinentry (in case of popup messages). */
+    agent_reset_query(ctrl);
+  }
 
   /* Cleanup.  */
   assuan_release(ctx);
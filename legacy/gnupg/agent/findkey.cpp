@@ -124,6 +124,7 @@ int agent_write_private_key(const unsigned char *grip, const void *buffer,
   char hexgrip[40 + 4 + 1];
 
   bin2hex(grip, 20, hexgrip);
+  agent_forget_key_cache(hexgrip);
   strcpy(hexgrip + 40, ".key");
 
   fname = make_filename(gnupg_homedir(), GNUPG_PRIVATE_KEYS_DIR, hexgrip, NULL);
@@ -529,6 +530,30 @@ static int unprotect(ctrl_t ctrl, const char *cache_nonce,
   return rc;
 }
 
+/* Store the modification time, size and inode of the key file for
+   GRIP at STAMP.  These tell whether a cached unprotected key still
+   matches the file.  */
+static gpg_error_t stat_key_file(const unsigned char *grip,
+                                 struct key_file_stamp_s *stamp) {
+  gpg_error_t err = 0;
+  char *fname;
+  struct stat st;
+  char hexgrip[40 + 4 + 1];
+
+  bin2hex(grip, 20, hexgrip);
+  strcpy(hexgrip + 40, ".key");
+  fname = make_filename(gnupg_homedir(), GNUPG_PRIVATE_KEYS_DIR, hexgrip, NULL);
+  if (stat(fname, &st))
+    err = gpg_error_from_syserror();
+  else {
+    stamp->mtime = st.st_mtime;
+    stamp->size = st.st_size;
+    stamp->ino = st.st_ino;
+  }
+  xfree(fname);
+  return err;
+}
+
 /* Read the key identified by GRIP from the private key directory and
    return it as an gcrypt S-expression object in RESULT.  On failure
    returns an error code and stores NULL at RESULT. */
@@ -650,6 +675,7 @@ static gpg_error_t remove_key_file(const unsigned char *grip) {
   char hexgrip[40 + 4 + 1];
 
   bin2hex(grip, 20, hexgrip);
+  agent_forget_key_cache(hexgrip);
   strcpy(hexgrip + 40, ".key");
   fname = make_filename(gnupg_homedir(), GNUPG_PRIVATE_KEYS_DIR, hexgrip, NULL);
   if (gnupg_remove(fname)) err = gpg_error_from_syserror();
@@ -671,7 +697,9 @@ static gpg_error_t remove_key_file(const unsigned char *grip) {
    R_PASSPHRASE is not NULL, the function succeeded and the key was
    protected the used passphrase (entered or from the cache) is stored
    there; if not NULL will be stored.  The caller needs to free the
-   returned passphrase.   */
+   returned passphrase.  If enabled, unprotected keys are kept in the
+   key cache and reused as long as the passphrase is cached and the
+   key file did not change.  */
 gpg_error_t agent_key_from_file(ctrl_t ctrl, const char *cache_nonce,
                                 const char *desc_text,
                                 const unsigned char *grip,
@@ -683,11 +711,38 @@ gpg_error_t agent_key_from_file(ctrl_t ctrl, const char *cache_nonce,
   unsigned char *buf;
   size_t len, buflen, erroff;
   gcry_sexp_t s_skey;
+  char hexgrip[40 + 1];
+  struct key_file_stamp_s stamp;
+  int have_stamp = 0;
 
   *result = NULL;
   if (shadow_info) *shadow_info = NULL;
   if (r_passphrase) *r_passphrase = NULL;
 
+  bin2hex(grip, 20, hexgrip);
+
+  /* The cached key is only used while its passphrase is in the cache
+     so that the passphrase TTLs and CLEAR_PASSPHRASE still apply.  */
+  if (opt.key_cache_ttl && cache_mode != CACHE_MODE_IGNORE &&
+      !stat_key_file(grip, &stamp)) {
+    char *pw;
+
+    have_stamp = 1;
+    pw = agent_get_cache(hexgrip, cache_mode);
+    if (pw) {
+      buf = agent_get_key_cache(hexgrip, &stamp, &len);
+      if (buf) {
+        if (cache_mode == CACHE_MODE_NORMAL) agent_store_cache_hit(hexgrip);
+        if (r_passphrase)
+          *r_passphrase = pw;
+        else
+          xfree(pw);
+        goto build_sexp;
+      }
+      xfree(pw);
+    }
+  }
+
   rc = read_key_file(grip, &s_skey);
   if (rc) {
     if (rc == GPG_ERR_ENOENT) rc = GPG_ERR_NO_SECKEY;
@@ -743,6 +798,9 @@ gpg_error_t agent_key_from_file(ctrl_t ctrl, const char *cache_nonce,
         if (rc)
           log_error("failed to unprotect the secret key: %s\n",
                     gpg_strerror(rc));
+        else if (have_stamp)
+          agent_put_key_cache(hexgrip, &stamp, buf,
+                              gcry_sexp_canon_len(buf, 0, NULL, NULL));
       }
 
       xfree(desc_text_final);
@@ -784,6 +842,7 @@ gpg_error_t agent_key_from_file(ctrl_t ctrl, const char *cache_nonce,
     return rc;
   }
 
+build_sexp:
   buflen = gcry_sexp_canon_len(buf, 0, NULL, NULL);
   rc = gcry_sexp_sscan(&s_skey, &erroff, (char *)buf, buflen);
   wipememory(buf, buflen);
@@ -20,9 +20,16 @@
 
 #include <config.h>
 
+#include <condition_variable>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -68,6 +75,7 @@ enum cmd_and_opt_values {
   oNoDetach,
   oLogFile,
   oServer,
+  oDaemon,
   oBatch,
 
   oLCctype,
@@ -75,7 +83,9 @@ enum cmd_and_opt_values {
   oScdaemonProgram,
   oDefCacheTTL,
   oMaxCacheTTL,
+  oKeyCacheTTL,
   oEnableExtendedKeyFormat,
+  oEnableScryptProtection,
   oFakedSystemTime,
 
   oIgnoreCacheForSigning,
@@ -95,6 +105,7 @@ static ARGPARSE_OPTS opts[] = {
     ARGPARSE_group(301, N_("@Options:\n ")),
 
     ARGPARSE_s_n(oServer, "server", N_("run in server mode (foreground)")),
+    ARGPARSE_s_n(oDaemon, "daemon", N_("run in daemon mode (background)")),
     ARGPARSE_s_n(oVerbose, "verbose", N_("verbose")),
     ARGPARSE_s_n(oQuiet, "quiet", N_("be somewhat more quiet")),
     ARGPARSE_s_s(oOptions, "options", N_("|FILE|read options from FILE")),
@@ -119,6 +130,8 @@ static ARGPARSE_OPTS opts[] = {
     ARGPARSE_s_u(oDefCacheTTL, "default-cache-ttl",
                  N_("|N|expire cached PINs after N seconds")),
     ARGPARSE_s_u(oMaxCacheTTL, "max-cache-ttl", "@"),
+    ARGPARSE_s_u(oKeyCacheTTL, "key-cache-ttl",
+                 N_("|N|keep unprotected keys for up to N seconds")),
 
     ARGPARSE_s_n(oIgnoreCacheForSigning, "ignore-cache-for-signing",
                  /* */ N_("do not use the PIN cache when signing")),
@@ -128,6 +141,8 @@ static ARGPARSE_OPTS opts[] = {
                  /* */ N_("disallow clients to mark keys as \"trusted\"")),
     ARGPARSE_s_n(oAllowMarkTrusted, "allow-mark-trusted", "@"),
     ARGPARSE_s_n(oEnableExtendedKeyFormat, "enable-extended-key-format", "@"),
+    ARGPARSE_s_n(oEnableScryptProtection, "enable-scrypt-protection",
+                 /* */ N_("protect new keys using scrypt")),
 
     /* Dummy options for backward compatibility.  */
     ARGPARSE_o_s(oWriteEnvFile, "write-env-file", "@"),
@@ -167,6 +182,18 @@ static const char *debug_level;
    the log file after a SIGHUP if it didn't changed. Malloced. */
 static char *current_logfile;
 
+/* The name of the socket in daemon mode.  Malloced.  */
+static char *socket_name;
+
+/* Set by the signal handler to stop accepting new connections.  */
+static volatile sig_atomic_t shutdown_pending;
+
+/* The number of connections being served in daemon mode, and the
+   lock and condition used to wait for them on shutdown.  */
+static int active_connections;
+static std::mutex active_connections_lock;
+static std::condition_variable active_connections_cond;
+
 /*
    Local prototypes.
  */
@@ -175,6 +202,7 @@ static void create_directories(void);
 
 static void agent_init_default_ctrl(ctrl_t ctrl);
 static void agent_deinit_default_ctrl(ctrl_t ctrl);
+static void handle_connections(int listen_fd);
 
 /* Return strings describing this program.  The case values are
    described in common/argparse.c:strusage.  The values here override
@@ -264,6 +292,11 @@ static void cleanup(void) {
   if (done) return;
   done = 1;
   deinitialize_module_cache();
+  if (socket_name) {
+    gnupg_remove(socket_name);
+    xfree(socket_name);
+    socket_name = NULL;
+  }
 }
 
 /* Handle options which are allowed to be reset after program start.
@@ -280,6 +313,7 @@ static int parse_rereadable_options(ARGPARSE_ARGS *pargs, int reread) {
     opt.debug_pinentry = 0;
     opt.def_cache_ttl = DEFAULT_CACHE_TTL;
     opt.max_cache_ttl = MAX_CACHE_TTL;
+    opt.key_cache_ttl = 0;
     opt.enforce_passphrase_constraints = 0;
     opt.min_passphrase_len = MIN_PASSPHRASE_LEN;
     opt.min_passphrase_nonalpha = MIN_PASSPHRASE_NONALPHA;
@@ -287,6 +321,7 @@ static int parse_rereadable_options(ARGPARSE_ARGS *pargs, int reread) {
     opt.max_passphrase_days = MAX_PASSPHRASE_DAYS;
     opt.enable_passphrase_history = 0;
     opt.enable_extended_key_format = 0;
+    opt.enable_scrypt_protection = 0;
     opt.ignore_cache_for_signing = 0;
     opt.allow_mark_trusted = 1;
     opt.allow_external_cache = 1;
@@ -332,10 +367,16 @@ static int parse_rereadable_options(ARGPARSE_ARGS *pargs, int reread) {
     case oMaxCacheTTL:
       opt.max_cache_ttl = pargs->r.ret_ulong;
       break;
+    case oKeyCacheTTL:
+      opt.key_cache_ttl = pargs->r.ret_ulong;
+      break;
 
     case oEnableExtendedKeyFormat:
       opt.enable_extended_key_format = 1;
       break;
+    case oEnableScryptProtection:
+      opt.enable_scrypt_protection = 1;
+      break;
 
     case oIgnoreCacheForSigning:
       opt.ignore_cache_for_signing = 1;
@@ -374,6 +415,8 @@ int agent_main(int argc, char **argv) {
   int parse_debug = 0;
   int default_config = 1;
   int pipe_server = 0;
+  int is_daemon = 0;
+  int socket_fd = -1;
   int nodetach = 0;
   int csh_style = 0;
   char *logfile = NULL;
@@ -505,6 +548,9 @@ next_pass:
       case oServer:
         pipe_server = 1;
         break;
+      case oDaemon:
+        is_daemon = 1;
+        break;
 
       case oLCctype:
         default_lc_ctype = xstrdup(pargs.r.ret_str);
@@ -556,7 +602,7 @@ next_pass:
         log_info(_("Note: '%s' is not considered an option\n"), argv[i]);
   }
 
-  if (!pipe_server) {
+  if (!pipe_server && !is_daemon) {
     /* We have been called without any command and thus we merely
        check whether an agent is already running.  We do this right
        here so that we don't clobber a logfile with this check but
@@ -577,6 +623,22 @@ next_pass:
   /* Try to create missing directories. */
   create_directories();
 
+  if (is_daemon && !pipe_server) {
+    socket_name = make_filename(gnupg_homedir(), GPG_AGENT_SOCK_NAME, NULL);
+    socket_fd = create_server_socket(socket_name, opt.verbose);
+    if (socket_fd == -1) {
+      /* Don't remove the socket of an agent which is already running.  */
+      xfree(socket_name);
+      socket_name = NULL;
+      agent_exit(2);
+    }
+
+    if (!nodetach) {
+      if (detach_server(!!logfile)) agent_exit(1);
+      opt.running_detached = 1;
+    }
+  }
+
   if (debug_wait && pipe_server) {
     log_debug("waiting for debugger - my pid is %u .....\n",
               (unsigned int)getpid());
@@ -603,15 +665,108 @@ next_pass:
       agent_exit(1);
     }
     agent_init_default_ctrl(ctrl);
-    start_command_handler(ctrl);
+    start_command_handler(ctrl, ASSUAN_INVALID_FD);
     agent_deinit_default_ctrl(ctrl);
     xfree(ctrl);
+  } else {
+    handle_connections(socket_fd);
+    agent_exit(0);
   }
   /* NOTREACHED */
 
   return 0;
 }
 
+/* Signal handler for the daemon: stop accepting connections.  */
+static void handle_signal(int signo) {
+  (void)signo;
+  shutdown_pending = 1;
+}
+
+/* The body of a connection thread in daemon mode: serve the
+   connection FD with the control structure CTRL and release both.  */
+static void connection_thread(ctrl_t ctrl, int fd) {
+  start_command_handler(ctrl, assuan_fdopen(fd));
+  agent_deinit_default_ctrl(ctrl);
+  xfree(ctrl);
+
+  std::lock_guard<std::mutex> lock(active_connections_lock);
+  active_connections--;
+  active_connections_cond.notify_all();
+}
+
+/* Accept connections on LISTEN_FD and serve each of them in a thread
+   of its own until SIGTERM or SIGINT is received, so that a client
+   keeping its connection open does not hold up the others.  The
+   commands themselves are serialized by start_command_handler.
+   Returns after all accepted connections have been served.  */
+static void handle_connections(int listen_fd) {
+  struct sigaction sa;
+  struct pollfd pfd;
+
+  memset(&sa, 0, sizeof sa);
+  sa.sa_handler = handle_signal;
+  sa.sa_flags = SA_RESTART; /* Don't disturb the active connections.  */
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGTERM, &sa, NULL);
+  sigaction(SIGINT, &sa, NULL);
+  /* A client going away must not kill the agent.  */
+  sa.sa_handler = SIG_IGN;
+  sigaction(SIGPIPE, &sa, NULL);
+
+  log_info("%s %s started\n", strusage(11), strusage(13));
+
+  pfd.fd = listen_fd;
+  pfd.events = POLLIN;
+  while (!shutdown_pending) {
+    ctrl_t ctrl;
+    int fd, n;
+
+    /* Wake up once a second to expire cache entries, also while the
+       agent is idle, and to check for a pending shutdown.  */
+    pfd.revents = 0;
+    n = poll(&pfd, 1, 1000);
+    agent_cache_housekeeping();
+    if (n <= 0) continue;
+
+    fd = accept(listen_fd, NULL, NULL);
+    if (fd == -1) {
+      if (errno != EINTR && errno != EAGAIN && errno != ECONNABORTED)
+        log_error("accept failed: %s\n", strerror(errno));
+      continue;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    ctrl = (ctrl_t)xtrycalloc(1, sizeof *ctrl);
+    if (!ctrl) {
+      log_error("error allocating connection control data: %s\n",
+                strerror(errno));
+      close(fd);
+      continue;
+    }
+    agent_init_default_ctrl(ctrl);
+
+    std::lock_guard<std::mutex> lock(active_connections_lock);
+    try {
+      std::thread(connection_thread, ctrl, fd).detach();
+      active_connections++;
+    } catch (const std::system_error &e) {
+      log_error("can't start connection thread: %s\n", e.what());
+      agent_deinit_default_ctrl(ctrl);
+      xfree(ctrl);
+      close(fd);
+    }
+  }
+
+  close(listen_fd);
+  std::unique_lock<std::mutex> lock(active_connections_lock);
+  if (active_connections)
+    log_info("shutdown pending, waiting for %d active connections\n",
+             active_connections);
+  active_connections_cond.wait(lock, [] { return !active_connections; });
+  log_info("%s %s stopped\n", strusage(11), strusage(13));
+}
+
 /* Exit entry point.  This function should be called instead of a
    plain exit.  */
 void agent_exit(int rc) {
@@ -36,6 +36,11 @@
 #include <sys/times.h>
 #endif
 
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include <botan/hash.h>
 
 #include "agent.h"
@@ -49,6 +54,20 @@
 #define PROT_CIPHER_STRING "aes"
 #define PROT_CIPHER_KEYLEN (128 / 8)
 
+/* The protection mode using scrypt instead of the iterated S2K.  Only
+   OCB is supported with it.  */
+#define PROT_SCRYPT_MODE "scrypt-ocb-aes"
+
+/* The limits for the scrypt parameters we accept in a key; this bounds
+   the memory an unprotect may take to SCRYPT_MAX_N KiB per CPU.  */
+#define SCRYPT_MIN_N 1024
+#define SCRYPT_MAX_N (1ul << 18)
+#define SCRYPT_MAX_P 16
+
+/* The name of the file in the home directory caching the calibration
+   results.  */
+#define S2K_CALIBRATION_FILE "s2k-calibration.txt"
+
 /* Decode an rfc4880 encoded S2K count.  */
 #define S2K_DECODE_COUNT(_val) ((16ul + ((_val)&15)) << (((_val) >> 4) + 6))
 
@@ -79,6 +98,9 @@ struct calibrate_time_s {
 static int hash_passphrase(const char *passphrase, int hashalgo, int s2kmode,
                            const unsigned char *s2ksalt, unsigned long s2kcount,
                            unsigned char *key, size_t keylen);
+static int derive_key(const char *passphrase, const unsigned char *salt,
+                      unsigned long count, unsigned long scrypt_p,
+                      unsigned char *key, size_t keylen);
 
 /* Get the process time and store it in DATA.  */
 static void calibrate_get_time(struct calibrate_time_s *data) {
@@ -159,14 +181,187 @@ static unsigned long calibrate_s2k_count(void) {
   return count;
 }
 
-/* Return the standard S2K count.  */
-unsigned long get_standard_s2k_count(void) {
-  static unsigned long count;
+/* Run a test scrypt derivation with cost N and P lanes and return
+   the wall clock time required in milliseconds.  Unlike the S2K, the
+   lanes run in parallel, so the process time is not meaningful.  */
+static unsigned long calibrate_scrypt_one(unsigned long n, unsigned long p) {
+  char keybuf[PROT_CIPHER_KEYLEN];
+  auto start = std::chrono::steady_clock::now();
+
+  if (gcry_kdf_derive("123456789abcdef0", 16, GCRY_KDF_SCRYPT, n, "saltsalt",
+                      8, p, sizeof keybuf, keybuf))
+    BUG();
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
 
-  if (!count) count = calibrate_s2k_count();
+/* Pick the scrypt parameters for new keys: one lane per CPU, up to 4,
+   and the largest power of two cost for which a derivation takes at
+   most about 100ms.  */
+static void calibrate_scrypt(unsigned long *r_n, unsigned long *r_p) {
+  unsigned long n, p;
+  unsigned long ms;
+
+  p = std::thread::hardware_concurrency();
+  if (!p) p = 1;
+  if (p > 4) p = 4;
+
+  for (n = SCRYPT_MIN_N; n < SCRYPT_MAX_N; n *= 2) {
+    ms = calibrate_scrypt_one(n * 2, p);
+    if (opt.verbose > 1)
+      log_info("scrypt calibration: N=%lu p=%lu -> %lums\n", n * 2, p, ms);
+    if (ms > 100) break;
+  }
+
+  if (opt.verbose) log_info("scrypt calibration: N=%lu p=%lu\n", n, p);
+  *r_n = n;
+  *r_p = p;
+}
+
+/* The calibration results for this machine.  A value of 0 means not
+   yet known.  */
+static struct {
+  int loaded;
+  unsigned long s2k_count;
+  unsigned long scrypt_n;
+  unsigned long scrypt_p;
+} calibration;
+
+/* Return a string identifying the CPU.  The calibration results are
+   only reused on the same kind of CPU because a home directory may be
+   shared between machines.  */
+static std::string cpu_model(void) {
+  std::string model;
+  estream_t fp;
+  char line[256];
+  char *p;
+
+  fp = es_fopen("/proc/cpuinfo", "r");
+  if (fp) {
+    while (es_fgets(line, DIM(line) - 1, fp)) {
+      if (strncmp(line, "model name", 10)) continue;
+      p = strchr(line, ':');
+      if (!p) continue;
+      for (p++; spacep(p); p++)
+        ;
+      trim_trailing_spaces(p);
+      model = p;
+      break;
+    }
+    es_fclose(fp);
+  }
+  if (model.empty()) model = "unknown";
+  model += " (" + std::to_string(std::thread::hardware_concurrency()) + ")";
+  return model;
+}
+
+/* Read the calibration results for this CPU from the calibration
+   file.  Each line of that file reads
+
+     S2K_COUNT SCRYPT_N SCRYPT_P CPU_MODEL
+
+   where a 0 stands for a value not yet calibrated.  If OTHERS is not
+   NULL, nothing is read but the lines for other CPUs are returned
+   there so that save_calibration can write them back.  */
+static void load_calibration(const std::string &model,
+                             std::vector<std::string> *others) {
+  char *fname;
+  estream_t fp;
+  char line[512];
+  unsigned long count, n, p;
+  int pos;
+
+  fname = make_filename(gnupg_homedir(), S2K_CALIBRATION_FILE, NULL);
+  fp = es_fopen(fname, "r");
+  xfree(fname);
+  if (!fp) return;
+
+  while (es_fgets(line, DIM(line) - 1, fp)) {
+    trim_trailing_spaces(line);
+    if (!*line || *line == '#') continue;
+    if (sscanf(line, "%lu %lu %lu %n", &count, &n, &p, &pos) != 3 ||
+        model != line + pos) {
+      if (others) others->push_back(line);
+      continue;
+    }
+    if (others) continue;
+    /* Ignore values we would not produce ourself.  */
+    if (count >= 65536) calibration.s2k_count = count;
+    if (n >= SCRYPT_MIN_N && n <= SCRYPT_MAX_N && !(n & (n - 1)) && p &&
+        p <= SCRYPT_MAX_P) {
+      calibration.scrypt_n = n;
+      calibration.scrypt_p = p;
+    }
+  }
+  es_fclose(fp);
+}
+
+/* Write the current calibration results to the calibration file.  */
+static void save_calibration(void) {
+  std::string model = cpu_model();
+  std::vector<std::string> others;
+  char *fname;
+  estream_t fp;
+
+  load_calibration(model, &others);
+
+  fname = make_filename(gnupg_homedir(), S2K_CALIBRATION_FILE, NULL);
+  fp = es_fopen(fname, "w,mode=-rw");
+  if (!fp) {
+    if (opt.verbose)
+      log_info("can't create '%s': %s\n", fname,
+               gpg_strerror(gpg_error_from_syserror()));
+    xfree(fname);
+    return;
+  }
+  es_fputs("# S2K calibration results of gpg-agent; "
+           "remove to recalibrate.\n", fp);
+  for (const auto &line : others) es_fprintf(fp, "%s\n", line.c_str());
+  es_fprintf(fp, "%lu %lu %lu %s\n", calibration.s2k_count,
+             calibration.scrypt_n, calibration.scrypt_p, model.c_str());
+  if (es_fclose(fp))
+    log_error("error writing '%s': %s\n", fname,
+              gpg_strerror(gpg_error_from_syserror()));
+  xfree(fname);
+}
+
+/* Load the persisted calibration results once.  */
+static void init_calibration(void) {
+  if (calibration.loaded) return;
+  calibration.loaded = 1;
+  load_calibration(cpu_model(), NULL);
+  if (opt.verbose && calibration.s2k_count)
+    log_info("S2K calibration: using stored count %lu\n",
+             calibration.s2k_count);
+}
+
+/* Return the standard S2K count.  The calibration is done only once
+   per CPU model and home directory; the result is kept in the
+   calibration file.  */
+unsigned long get_standard_s2k_count(void) {
+  init_calibration();
+  if (!calibration.s2k_count) {
+    calibration.s2k_count = calibrate_s2k_count();
+    save_calibration();
+  }
 
   /* Enforce a lower limit.  */
-  return count < 65536 ? 65536 : count;
+  return calibration.s2k_count < 65536 ? 65536 : calibration.s2k_count;
+}
+
+/* Return the scrypt cost and parallelization parameters for new keys
+   at R_N and R_P.  They are calibrated and persisted like the S2K
+   count.  */
+static void get_standard_scrypt_params(unsigned long *r_n,
+                                       unsigned long *r_p) {
+  init_calibration();
+  if (!calibration.scrypt_n) {
+    calibrate_scrypt(&calibration.scrypt_n, &calibration.scrypt_p);
+    save_calibration();
+  }
+  *r_n = calibration.scrypt_n;
+  *r_p = calibration.scrypt_p;
 }
 
 /* Same as get_standard_s2k_count but return the count in the encoding
@@ -267,7 +462,7 @@ static int do_encryption(const unsigned char *hashbegin, size_t hashlen,
                          const char *passphrase, const char *timestamp_exp,
                          size_t timestamp_exp_len, unsigned char **result,
                          size_t *resultlen, unsigned long s2k_count,
-                         int use_ocb) {
+                         int use_ocb, int use_scrypt) {
   gcry_cipher_hd_t hd;
   const char *modestr;
   unsigned char hashvalue[20];
@@ -279,15 +474,24 @@ static int do_encryption(const unsigned char *hashbegin, size_t hashlen,
   char *outbuf = NULL;
   char *p;
   int saltpos, ivpos, encpos;
+  unsigned long scrypt_p = 0;
 
   s2ksalt = iv; /* Silence compiler warning.  */
 
   *resultlen = 0;
   *result = NULL;
 
-  modestr = (use_ocb ? "openpgp-s2k3-ocb-aes"
-                     /*   */
-                     : "openpgp-s2k3-sha1-" PROT_CIPHER_STRING "-cbc");
+  if (use_scrypt) {
+    use_ocb = 1;
+    get_standard_scrypt_params(&s2k_count, &scrypt_p);
+  } else if (!s2k_count)
+    s2k_count = get_standard_s2k_count();
+
+  modestr = (use_scrypt ? PROT_SCRYPT_MODE
+                        : use_ocb ? "openpgp-s2k3-ocb-aes"
+                                  /*   */
+                                  : "openpgp-s2k3-sha1-" PROT_CIPHER_STRING
+                                    "-cbc");
 
   rc = gcry_cipher_open(&hd, PROT_CIPHER,
                         use_ocb ? GCRY_CIPHER_MODE_OCB : GCRY_CIPHER_MODE_CBC,
@@ -348,9 +552,7 @@ static int do_encryption(const unsigned char *hashbegin, size_t hashlen,
     if (!key)
       rc = gpg_error_from_syserror();
     else {
-      rc = hash_passphrase(passphrase, GCRY_MD_SHA1, 3, s2ksalt,
-                           s2k_count ? s2k_count : get_standard_s2k_count(),
-                           key, keylen);
+      rc = derive_key(passphrase, s2ksalt, s2k_count, scrypt_p, key, keylen);
       if (!rc) rc = gcry_cipher_setkey(hd, key, keylen);
       xfree(key);
     }
@@ -429,18 +631,33 @@ static int do_encryption(const unsigned char *hashbegin, size_t hashlen,
        ((sha1 salt no_of_iterations) 16byte_iv)
        encrypted_octet_string)
 
+     or with scrypt
+
+     (protected scrypt-ocb-aes
+       ((scrypt salt cost parallelization) 12byte_nonce)
+       encrypted_octet_string)
+
      in canoncical format of course.  We use asprintf and %n modifier
      and dummy values as placeholders.  */
   {
     char countbuf[35];
+    char parmbuf[40];
+
+    snprintf(countbuf, sizeof countbuf, "%lu", s2k_count);
+    parmbuf[0] = 0;
+    if (use_scrypt) {
+      char pbuf[20];
 
-    snprintf(countbuf, sizeof countbuf, "%lu",
-             s2k_count ? s2k_count : get_standard_s2k_count());
+      snprintf(pbuf, sizeof pbuf, "%lu", scrypt_p);
+      snprintf(parmbuf, sizeof parmbuf, "%u:%s", (unsigned int)strlen(pbuf),
+               pbuf);
+    }
     p = xtryasprintf(
-        "(9:protected%d:%s((4:sha18:%n_8bytes_%u:%s)%d:%n%*s)%d:%n%*s)",
-        (int)strlen(modestr), modestr, &saltpos, (unsigned int)strlen(countbuf),
-        countbuf, use_ocb ? 12 : blklen, &ivpos, use_ocb ? 12 : blklen, "",
-        enclen, &encpos, enclen, "");
+        "(9:protected%d:%s((%s8:%n_8bytes_%u:%s%s)%d:%n%*s)%d:%n%*s)",
+        (int)strlen(modestr), modestr, use_scrypt ? "6:scrypt" : "4:sha1",
+        &saltpos, (unsigned int)strlen(countbuf), countbuf, parmbuf,
+        use_ocb ? 12 : blklen, &ivpos, use_ocb ? 12 : blklen, "", enclen,
+        &encpos, enclen, "");
     if (!p) {
       gpg_error_t tmperr = gpg_error_from_syserror();
       xfree(iv);
@@ -466,8 +683,9 @@ leave:
 
 /* Protect the key encoded in canonical format in PLAINKEY.  We assume
    a valid S-Exp here.  With USE_UCB set to -1 the default scheme is
-   used (ie. either CBC or OCB), set to 0 the old CBC mode is used,
-   and set to 1 OCB is used. */
+   used (ie. either CBC or OCB, or scrypt with OCB if enabled and no
+   S2K_COUNT is requested), set to 0 the old CBC mode is used, and set
+   to 1 OCB is used. */
 int agent_protect(const unsigned char *plainkey, const char *passphrase,
                   unsigned char **result, size_t *resultlen,
                   unsigned long s2k_count, int use_ocb) {
@@ -485,8 +703,12 @@ int agent_protect(const unsigned char *plainkey, const char *passphrase,
   int depth = 0;
   unsigned char *p;
   int have_curve = 0;
+  int use_scrypt = 0;
 
-  if (use_ocb == -1) use_ocb = opt.enable_extended_key_format;
+  if (use_ocb == -1) {
+    use_ocb = opt.enable_extended_key_format;
+    use_scrypt = opt.enable_scrypt_protection && !s2k_count;
+  }
 
   /* Create an S-expression with the protected-at timestamp.  */
   memcpy(timestamp_exp, "(12:protected-at15:", 19);
@@ -571,7 +793,7 @@ int agent_protect(const unsigned char *plainkey, const char *passphrase,
   rc = do_encryption(hash_begin, hash_end - hash_begin + 1, prot_begin,
                      prot_end - prot_begin + 1, passphrase, timestamp_exp,
                      sizeof(timestamp_exp), &protecteder, &protectedlen,
-                     s2k_count, use_ocb);
+                     s2k_count, use_ocb, use_scrypt);
   if (rc) return rc;
 
   /* Now create the protected version of the key.  Note that the 10
@@ -609,9 +831,10 @@ static int do_decryption(const unsigned char *aad_begin, size_t aad_len,
                          const unsigned char *aadhole_begin, size_t aadhole_len,
                          const unsigned char *protecteder, size_t protectedlen,
                          const char *passphrase, const unsigned char *s2ksalt,
-                         unsigned long s2kcount, const unsigned char *iv,
-                         size_t ivlen, int prot_cipher, int prot_cipher_keylen,
-                         int is_ocb, unsigned char **result) {
+                         unsigned long s2kcount, unsigned long scrypt_p,
+                         const unsigned char *iv, size_t ivlen,
+                         int prot_cipher, int prot_cipher_keylen, int is_ocb,
+                         unsigned char **result) {
   int rc = 0;
   int blklen;
   gcry_cipher_hd_t hd;
@@ -646,8 +869,8 @@ static int do_decryption(const unsigned char *aad_begin, size_t aad_len,
     if (!key)
       rc = gpg_error_from_syserror();
     else {
-      rc = hash_passphrase(passphrase, GCRY_MD_SHA1, 3, s2ksalt, s2kcount, key,
-                           prot_cipher_keylen);
+      rc = derive_key(passphrase, s2ksalt, s2kcount, scrypt_p, key,
+                      prot_cipher_keylen);
       if (!rc) rc = gcry_cipher_setkey(hd, key, prot_cipher_keylen);
       xfree(key);
     }
@@ -844,10 +1067,12 @@ int agent_unprotect(ctrl_t ctrl, const unsigned char *protectedkey,
     int algo;         /* (A zero indicates the "openpgp-native" hack.)  */
     int keylen;       /* Used key length in bytes.  */
     unsigned int is_ocb : 1;
+    unsigned int is_scrypt : 1;
   } algotable[] = {
       {"openpgp-s2k3-sha1-aes-cbc", GCRY_CIPHER_AES128, (128 / 8)},
       {"openpgp-s2k3-sha1-aes256-cbc", GCRY_CIPHER_AES256, (256 / 8)},
       {"openpgp-s2k3-ocb-aes", GCRY_CIPHER_AES128, (128 / 8), 1},
+      {PROT_SCRYPT_MODE, GCRY_CIPHER_AES128, (128 / 8), 1, 1},
       {"openpgp-native", 0, 0}};
   int rc;
   const unsigned char *s;
@@ -857,9 +1082,10 @@ int agent_unprotect(ctrl_t ctrl, const unsigned char *protectedkey,
   unsigned char sha1hash[20], sha1hash2[20];
   const unsigned char *s2ksalt;
   unsigned long s2kcount;
+  unsigned long scrypt_p;
   const unsigned char *iv;
   int prot_cipher, prot_cipher_keylen;
-  int is_ocb;
+  int is_ocb, is_scrypt;
   const unsigned char *aad_begin, *aad_end, *aadhole_begin, *aadhole_end;
   const unsigned char *prot_begin;
   unsigned char *cleartext;
@@ -950,12 +1176,13 @@ int agent_unprotect(ctrl_t ctrl, const unsigned char *protectedkey,
   /* Lookup the protection algo.  */
   prot_cipher = 0;        /* (avoid gcc warning) */
   prot_cipher_keylen = 0; /* (avoid gcc warning) */
-  is_ocb = 0;
+  is_ocb = is_scrypt = 0;
   for (i = 0; i < DIM(algotable); i++)
     if (smatch(&s, n, algotable[i].name)) {
       prot_cipher = algotable[i].algo;
       prot_cipher_keylen = algotable[i].keylen;
       is_ocb = algotable[i].is_ocb;
+      is_scrypt = algotable[i].is_scrypt;
       break;
     }
   if (i == DIM(algotable)) return GPG_ERR_UNSUPPORTED_PROTECTION;
@@ -981,13 +1208,32 @@ int agent_unprotect(ctrl_t ctrl, const unsigned char *protectedkey,
   s += 2;
   n = snext(&s);
   if (!n) return GPG_ERR_INV_SEXP;
-  if (!smatch(&s, n, "sha1")) return GPG_ERR_UNSUPPORTED_PROTECTION;
+  if (!smatch(&s, n, is_scrypt ? "scrypt" : "sha1"))
+    return GPG_ERR_UNSUPPORTED_PROTECTION;
   n = snext(&s);
   if (n != 8) return GPG_ERR_CORRUPTED_PROTECTION;
   s2ksalt = s;
   s += n;
   n = snext(&s);
   if (!n) return GPG_ERR_CORRUPTED_PROTECTION;
+
+  if (is_scrypt) {
+    /* The cost N and the parallelization P.  Limit both so that a
+       crafted key can't make us allocate an arbitrary amount of
+       memory.  */
+    for (s2kcount = 0; n && digitp(s) && s2kcount <= SCRYPT_MAX_N; n--, s++)
+      s2kcount = s2kcount * 10 + atoi_1(s);
+    if (n) return GPG_ERR_CORRUPTED_PROTECTION;
+    n = snext(&s);
+    if (!n || s[n] != ')') return GPG_ERR_INV_SEXP;
+    scrypt_p = strtoul((const char *)s, NULL, 10);
+    if (s2kcount < SCRYPT_MIN_N || s2kcount > SCRYPT_MAX_N ||
+        (s2kcount & (s2kcount - 1)) || !scrypt_p || scrypt_p > SCRYPT_MAX_P)
+      return GPG_ERR_CORRUPTED_PROTECTION;
+    goto parms_done;
+  }
+  scrypt_p = 0;
+
   /* We expect a list close as next, so we can simply use strtoul()
      here.  We might want to check that we only have digits - but this
      is nothing we should worry about */
@@ -1007,6 +1253,7 @@ int agent_unprotect(ctrl_t ctrl, const unsigned char *protectedkey,
     s2kcount = (16ul + (s2kcount & 15)) << ((s2kcount >> 4) + 6);
   if (s2kcount < 65536) return GPG_ERR_CORRUPTED_PROTECTION;
 
+parms_done:
   s += n;
   s++; /* skip list end */
 
@@ -1028,7 +1275,7 @@ int agent_unprotect(ctrl_t ctrl, const unsigned char *protectedkey,
   cleartext = NULL; /* Avoid cc warning. */
   rc = do_decryption(aad_begin, aad_end - aad_begin, aadhole_begin,
                      aadhole_end - aadhole_begin, s, n, passphrase, s2ksalt,
-                     s2kcount, iv, is_ocb ? 12 : 16, prot_cipher,
+                     s2kcount, scrypt_p, iv, is_ocb ? 12 : 16, prot_cipher,
                      prot_cipher_keylen, is_ocb, &cleartext);
   if (rc) return rc;
 
@@ -1163,6 +1410,22 @@ static int hash_passphrase(const char *passphrase, int hashalgo, int s2kmode,
       hashalgo, s2ksalt, 8, s2kcount, keylen, key);
 }
 
+/* Derive the protection key of length KEYLEN from PASSPHRASE and the
+   8 byte SALT and store it at KEY.  With SCRYPT_P of 0 the iterated
+   and salted S2K with SHA-1 and COUNT iterations is used, otherwise
+   scrypt with cost COUNT and SCRYPT_P lanes.  */
+static int derive_key(const char *passphrase, const unsigned char *salt,
+                      unsigned long count, unsigned long scrypt_p,
+                      unsigned char *key, size_t keylen) {
+  if (!scrypt_p)
+    return hash_passphrase(passphrase, GCRY_MD_SHA1, 3, salt, count, key,
+                           keylen);
+
+  if (!passphrase || !*passphrase) return GPG_ERR_NO_PASSPHRASE;
+  return gcry_kdf_derive(passphrase, strlen(passphrase), GCRY_KDF_SCRYPT,
+                         count, salt, 8, scrypt_p, keylen, key);
+}
+
 gpg_error_t s2k_hash_passphrase(const char *passphrase, int hashalgo,
                                 int s2kmode, const unsigned char *s2ksalt,
                                 unsigned int s2kcount, unsigned char *key,
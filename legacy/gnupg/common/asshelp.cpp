@@ -29,9 +29,13 @@
 
 #include <config.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <unistd.h>
 #ifdef HAVE_LOCALE_H
 #include <locale.h>
@@ -192,6 +196,21 @@ gpg_error_t send_pinentry_environment(assuan_context_t ctx,
 
 extern char *neopg_program;
 
+/* Try to connect CTX to a daemon listening on the socket SOCKNAME in
+   the home directory.  Returns 0 on success; on error CTX is left
+   unconnected and may be used for spawning a server.  */
+static gpg_error_t connect_daemon_socket(assuan_context_t ctx,
+                                         const char *sockname) {
+  gpg_error_t err;
+  char *fname;
+
+  fname = make_filename_try(gnupg_homedir(), sockname, NULL);
+  if (!fname) return gpg_error_from_syserror();
+  err = assuan_socket_connect(ctx, fname, 0, 0);
+  xfree(fname);
+  return err;
+}
+
 /* Handle the server's initial greeting.  Returns a new assuan context
    at R_CTX or an error code. */
 gpg_error_t start_new_gpg_agent(assuan_context_t *r_ctx,
@@ -210,7 +229,11 @@ gpg_error_t start_new_gpg_agent(assuan_context_t *r_ctx,
     return err;
   }
 
-  {
+  /* Prefer a running "agent --daemon", so that the passphrase cache
+     and the S2K calibration outlive this process.  */
+  if (!connect_daemon_socket(ctx, GPG_AGENT_SOCK_NAME)) {
+    if (debug) log_debug("connection to the agent daemon established\n");
+  } else {
     char *abs_homedir;
     int i;
 
@@ -247,9 +270,9 @@ gpg_error_t start_new_gpg_agent(assuan_context_t *r_ctx,
     }
 
     xfree(abs_homedir);
+    if (debug) log_debug("connection to agent established\n");
   }
 
-  if (debug) log_debug("connection to agent established\n");
 
   err = assuan_transact(ctx, "RESET", NULL, NULL, NULL, NULL, NULL, NULL);
   if (!err) {
@@ -272,6 +295,106 @@ gpg_error_t start_new_gpg_agent(assuan_context_t *r_ctx,
   return 0;
 }
 
+/* Create a listening Unix domain socket at NAME for a daemon.  A stale
+   socket from a crashed daemon is removed, but we refuse to start if
+   another daemon still answers on it.  Returns the socket or -1 on
+   error.  */
+int create_server_socket(const char *name, int verbose) {
+  struct sockaddr_un serv_addr;
+  socklen_t len;
+  mode_t old_umask;
+  int fd;
+  int rc;
+
+  if (strlen(name) + 1 >= sizeof serv_addr.sun_path) {
+    log_error(_("socket name '%s' is too long\n"), name);
+    return -1;
+  }
+  memset(&serv_addr, 0, sizeof serv_addr);
+  serv_addr.sun_family = AF_UNIX;
+  strcpy(serv_addr.sun_path, name);
+  len = SUN_LEN(&serv_addr);
+
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd == -1) {
+    log_error(_("can't create socket: %s\n"), strerror(errno));
+    return -1;
+  }
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+  /* Only the owner may connect.  Creating the socket with the right
+     mode avoids a window in which others could connect.  */
+  old_umask = umask(077);
+  rc = bind(fd, (struct sockaddr *)&serv_addr, len);
+  if (rc == -1 && errno == EADDRINUSE) {
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (probe != -1 && !connect(probe, (struct sockaddr *)&serv_addr, len)) {
+      close(probe);
+      umask(old_umask);
+      log_error(_("a server is already listening on '%s'\n"), name);
+      close(fd);
+      return -1;
+    }
+    if (probe != -1) close(probe);
+    gnupg_remove(name);
+    rc = bind(fd, (struct sockaddr *)&serv_addr, len);
+  }
+  umask(old_umask);
+  if (rc == -1) {
+    log_error(_("error binding socket to '%s': %s\n"), name, strerror(errno));
+    close(fd);
+    return -1;
+  }
+
+  if (listen(fd, SOMAXCONN) == -1) {
+    log_error(_("listen() failed: %s\n"), strerror(errno));
+    gnupg_remove(name);
+    close(fd);
+    return -1;
+  }
+
+  if (verbose) log_info(_("listening on socket '%s'\n"), name);
+  return fd;
+}
+
+/* Detach a daemon from its terminal: fork, let the parent exit right
+   away without running the atexit handlers, which would remove the
+   socket now owned by the child, and start a new session in the
+   child.  Stdin and stdout are redirected to /dev/null, and stderr
+   too if CLOSE_STDERR is set.  Returns 0 in the child or -1 on
+   error.  */
+int detach_server(int close_stderr) {
+  pid_t pid;
+  int nullfd;
+
+  fflush(NULL);
+  pid = fork();
+  if (pid == (pid_t)-1) {
+    log_error("fork failed: %s\n", strerror(errno));
+    return -1;
+  } else if (pid) /* We are the parent.  */
+    _exit(0);
+
+  /* This is the child.  */
+  if (setsid() == -1) {
+    log_error("setsid() failed: %s\n", strerror(errno));
+    return -1;
+  }
+  nullfd = open("/dev/null", O_RDWR);
+  if (nullfd != -1) {
+    dup2(nullfd, 0);
+    dup2(nullfd, 1);
+    if (close_stderr) dup2(nullfd, 2);
+    if (nullfd > 2) close(nullfd);
+  }
+  if (chdir("/")) {
+    log_error("chdir to / failed: %s\n", strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
 /* Returns a new assuan context at R_CTX or an error code. */
 gpg_error_t start_new_dirmngr(assuan_context_t *r_ctx, int verbose, int debug) {
   gpg_error_t err;
@@ -285,6 +408,14 @@ gpg_error_t start_new_dirmngr(assuan_context_t *r_ctx, int verbose, int debug) {
     return err;
   }
 
+  /* Prefer a running "dirmngr --daemon", which keeps its caches warm
+     across invocations and serves several clients at once.  */
+  if (!connect_daemon_socket(ctx, DIRMNGR_SOCK_NAME)) {
+    if (debug) log_debug("connection to the dirmngr daemon established\n");
+    *r_ctx = ctx;
+    return 0;
+  }
+
   {
     lock_spawn_t lock;
     const char *argv[6];
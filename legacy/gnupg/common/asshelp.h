@@ -58,6 +58,12 @@ gpg_error_t start_new_gpg_agent(assuan_context_t *r_ctx,
    the function is able starts a dirmngr process if needed.  */
 gpg_error_t start_new_dirmngr(assuan_context_t *r_ctx, int verbose, int debug);
 
+/* Create the listening socket NAME for a daemon.  */
+int create_server_socket(const char *name, int verbose);
+
+/* Detach a daemon from its terminal; returns 0 in the child.  */
+int detach_server(int close_stderr);
+
 /* Return the version of a server using "GETINFO version".  */
 gpg_error_t get_assuan_server_version(assuan_context_t ctx, int mode,
                                       char **r_version);
@@ -0,0 +1,136 @@
+/* cdb-bench.cpp - Benchmark serial number lookups in a CRL cache file
+   Copyright 2017 The NeoPG developers
+
+   NeoPG is released under the Simplified BSD License (see license.txt)
+*/
+
+/* Usage: cdb-bench [NRECORDS [NLOOKUPS]]
+
+   Builds a cdb file like the ones in the CRL cache, with NRECORDS
+   20 byte serial numbers mapping to a 16 byte revocation record, and
+   measures how many lookups per second the memory mapped reader used
+   by dirmngr does.  Half of the lookups are for listed and half for
+   unlisted serial numbers.  For comparison, the old file descriptor
+   based cdb_seek interface is measured as well.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <vector>
+
+#include "cdb.h"
+
+#define SNLEN 20
+
+/* A simple deterministic generator for the serial numbers.  */
+static unsigned long long rng_state = 0x9e3779b97f4a7c15ULL;
+
+static unsigned long long rng_next(void) {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return rng_state;
+}
+
+static void make_serial(unsigned char *sn) {
+  for (int i = 0; i < SNLEN; i += 8) {
+    unsigned long long r = rng_next();
+    for (int j = 0; j < 8 && i + j < SNLEN; j++) sn[i + j] = r >> (8 * j);
+  }
+}
+
+static double elapsed(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+int main(int argc, char **argv) {
+  unsigned long nrecords = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+  unsigned long nlookups = argc > 2 ? strtoul(argv[2], NULL, 10) : 2000000;
+  char fname[] = "/tmp/cdb-bench-XXXXXX";
+  std::vector<unsigned char> keys(nrecords * SNLEN);
+  std::vector<unsigned char> misses(nrecords * SNLEN);
+  unsigned char record[16];
+  struct cdb_make cdbm;
+  struct cdb cdb;
+  unsigned long found;
+  cdbi_t dlen;
+  int fd;
+
+  if (!nrecords || !nlookups) {
+    fprintf(stderr, "usage: cdb-bench [NRECORDS [NLOOKUPS]]\n");
+    return 1;
+  }
+
+  fd = mkstemp(fname);
+  if (fd == -1) {
+    perror("mkstemp");
+    return 1;
+  }
+  unlink(fname);
+
+  /* Build the file like crl_parse_insert does.  */
+  auto start = std::chrono::steady_clock::now();
+  memset(record, 0, sizeof record);
+  record[0] = 1;
+  memcpy(record + 1, "20171001T000000", 15);
+  cdb_make_start(&cdbm, fd);
+  for (unsigned long i = 0; i < nrecords; i++) {
+    make_serial(&keys[i * SNLEN]);
+    if (cdb_make_add(&cdbm, &keys[i * SNLEN], SNLEN, record, sizeof record)) {
+      perror("cdb_make_add");
+      return 1;
+    }
+  }
+  if (cdb_make_finish(&cdbm)) {
+    perror("cdb_make_finish");
+    return 1;
+  }
+  for (unsigned long i = 0; i < nrecords; i++) make_serial(&misses[i * SNLEN]);
+  printf("built cdb with %lu records in %.2fs\n", nrecords, elapsed(start));
+
+  if (cdb_init(&cdb, fd)) {
+    perror("cdb_init");
+    return 1;
+  }
+
+  /* The memory mapped reader.  */
+  found = 0;
+  start = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < nlookups; i++) {
+    const unsigned char *sn = (i & 1) ? &misses[(i / 2 % nrecords) * SNLEN]
+                                      : &keys[(i / 2 % nrecords) * SNLEN];
+    if (cdb_find(&cdb, sn, SNLEN) == 1 &&
+        !cdb_read(&cdb, record, sizeof record, cdb_datapos(&cdb)))
+      found++;
+  }
+  double secs = elapsed(start);
+  printf("mmap:     %10.0f lookups/s (%lu found)\n", nlookups / secs, found);
+
+  /* The file descriptor based reader.  */
+  found = 0;
+  nlookups = nlookups / 10 ? nlookups / 10 : 1;
+  start = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < nlookups; i++) {
+    const unsigned char *sn = (i & 1) ? &misses[(i / 2 % nrecords) * SNLEN]
+                                      : &keys[(i / 2 % nrecords) * SNLEN];
+    dlen = 0;
+    if (cdb_seek(fd, sn, SNLEN, &dlen) == 1 &&
+        !cdb_bread(fd, record, sizeof record))
+      found++;
+  }
+  secs = elapsed(start);
+  printf("fd/lseek: %10.0f lookups/s (%lu found)\n", nlookups / secs, found);
+
+  cdb_free(&cdb);
+  close(fd);
+  return 0;
+}
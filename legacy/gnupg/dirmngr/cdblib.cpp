@@ -104,7 +104,8 @@ static int make_write(struct cdb_make *cdbmp, const char *ptr, cdbi_t len);
    itself if needed and file open operation should be done by
    application.  File FD should be opened at least read-only, and
    should be seekable.  Routine returns 0 on success or negative value
-   on error. */
+   on error.  The file is memory mapped, thus FD may be closed after
+   this call; cdb_find and cdb_read work on the mapping only. */
 int cdb_init(struct cdb *cdbp, int fd) {
   struct stat st;
   unsigned char *mem;
@@ -140,17 +141,12 @@ int cdb_init(struct cdb *cdbp, int fd) {
   cdbp->cdb_fsize = st.st_size;
   cdbp->cdb_mem = mem;
 
-#if 0
-  /* XXX don't know well about madvise syscall -- is it legal
-     to set different options for parts of one mmap() region?
-     There is also posix_madvise() exist, with POSIX_MADV_RANDOM etc...
-  */
-#ifdef MADV_RANDOM
-  /* set madvise() parameters. Ignore errors for now if system
-     doesn't support it */
+#if !defined(_WIN32) && defined(MADV_RANDOM)
+  /* Lookups jump between the hash tables and the records, so
+     read-ahead would only pollute the page cache.  The toc is needed
+     by every lookup.  Errors are ignored; this is only a hint.  */
+  madvise(mem, fsize, MADV_RANDOM);
   madvise(mem, 2048, MADV_WILLNEED);
-  madvise(mem + 2048, cdbp->cdb_fsize - 2048, MADV_RANDOM);
-#endif
 #endif
 
   cdbp->cdb_vpos = cdbp->cdb_vlen = 0;
@@ -447,7 +443,7 @@ int cdb_seek(int fd, const void *key, unsigned klen, cdbi_t *dlenp) {
         /* read the key from file and compare with wanted */
         cdbi_t l = klen, c;
         const char *k = (const char *)key;
-        if (*dlenp) *dlenp = cdb_unpack(rbuf + 4); /* save value length */
+        if (dlenp) *dlenp = cdb_unpack(rbuf + 4); /* save value length */
         for (;;) {
           if (!l) /* the whole key read and matches, return */
             return 1;
@@ -463,7 +459,7 @@ int cdb_seek(int fd, const void *key, unsigned klen, cdbi_t *dlenp) {
     }
     if (!--httodo) return 0;
     if (++hti == htsize) {
-      hti = htstart;
+      hti = 0;
       needseek = 1;
     }
   }
@@ -19,7 +19,14 @@
 
 #include <config.h>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <mutex>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <assert.h>
 #include <dirent.h>
@@ -36,8 +43,6 @@
 #include "crlfetch.h"
 #include "misc.h"
 
-#define MAX_NONPERM_CACHED_CERTS 1000
-
 /* Constants used to classify search patterns.  */
 enum pattern_class {
   PATTERN_UNKNOWN = 0,
@@ -57,7 +62,9 @@ enum pattern_class {
 /* A certificate cache item.  This consists of a the KSBA cert object
    and some meta data for easier lookup.  We use a hash table to keep
    track of all items and use the (randomly distributed) first byte of
-   the fingerprint directly as the hash which makes it pretty easy. */
+   the fingerprint directly as the hash which makes it pretty easy.
+   Lookups by issuer and subject go through the secondary indexes
+   below. */
 struct cert_item_s {
   struct cert_item_s *next; /* Next item with the same hash value. */
   ksba_cert_t cert;         /* The KSBA cert object or NULL is this is
@@ -74,6 +81,11 @@ struct cert_item_s {
   /* If this field is set the certificate is trusted.  The actual
    * value is a (possible) combination of CERTTRUST_CLASS values.  */
   unsigned int trustclasses : 4;
+
+  /* The value of CACHE_TICK at the last use of this item.  This is
+   * updated by readers and used to evict the least recently used
+   * certificates.  */
+  std::atomic<unsigned long> last_use;
 };
 typedef struct cert_item_s *cert_item_t;
 
@@ -81,8 +93,72 @@ typedef struct cert_item_s *cert_item_t;
    the first byte of the fingerprint.  */
 static cert_item_t cert_cache[256];
 
+/* Secondary indexes over the valid items of CERT_CACHE.  The keys
+   are the issuer DN and the serial number (see issuer_sn_key), the
+   issuer DN and the subject DN.  */
+typedef std::unordered_multimap<std::string, cert_item_t> cert_index_t;
+static cert_index_t cert_by_issuer_sn;
+static cert_index_t cert_by_issuer;
+static cert_index_t cert_by_subject;
+
+/* Counter to track the use of cache items.  */
+static std::atomic<unsigned long> cache_tick;
+
+/* A reader/writer lock for the cache.  Lookups only need a shared
+   lock so that concurrent validations do not serialize; anything
+   which modifies the cache or the indexes needs the exclusive lock.
+   Writers are preferred to avoid starving them.  */
+class cache_rwlock {
+ public:
+  void lock() {
+    std::unique_lock<std::mutex> guard(mutex_);
+    writers_waiting_++;
+    cond_.wait(guard, [this] { return !writer_ && !readers_; });
+    writers_waiting_--;
+    writer_ = true;
+  }
+
+  void unlock() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    writer_ = false;
+    cond_.notify_all();
+  }
+
+  void lock_shared() {
+    std::unique_lock<std::mutex> guard(mutex_);
+    cond_.wait(guard, [this] { return !writer_ && !writers_waiting_; });
+    readers_++;
+  }
+
+  void unlock_shared() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (!--readers_) cond_.notify_all();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  unsigned int readers_{0};
+  unsigned int writers_waiting_{0};
+  bool writer_{false};
+};
+
+/* Scoped shared lock for a cache_rwlock.  */
+class cache_shared_lock {
+ public:
+  explicit cache_shared_lock(cache_rwlock &lock) : lock_(lock) {
+    lock_.lock_shared();
+  }
+  ~cache_shared_lock() { lock_.unlock_shared(); }
+  cache_shared_lock(const cache_shared_lock &) = delete;
+  cache_shared_lock &operator=(const cache_shared_lock &) = delete;
+
+ private:
+  cache_rwlock &lock_;
+};
+
 /* This is the global cache_lock variable.  */
-static std::mutex cache_lock;
+static cache_rwlock cache_lock;
 
 /* Flag to track whether the cache has been initialized.  */
 static int initialization_done;
@@ -108,6 +184,40 @@ static int compare_serialno(ksba_sexp_t serial1, ksba_sexp_t serial2) {
   return cmp_simple_canon_sexp(a, b);
 }
 
+/* Return the key for the CERT_BY_ISSUER_SN index.  This is ISSUER_DN
+   and the value of the canonical S-expression SERIALNO separated by
+   a Nul.  */
+static std::string issuer_sn_key(const char *issuer_dn,
+                                 ksba_const_sexp_t serialno) {
+  std::string key(issuer_dn);
+  const char *s = (const char *)serialno;
+  unsigned long n;
+  char *endp;
+
+  key.push_back('\0');
+  if (!s || *s != '(') return key;
+  n = strtoul(s + 1, &endp, 10);
+  if (*endp != ':') return key;
+  key.append(endp + 1, n);
+  return key;
+}
+
+/* Remove the item CI from the index IDX under KEY.  */
+static void index_remove(cert_index_t &idx, const std::string &key,
+                         cert_item_t ci) {
+  auto range = idx.equal_range(key);
+  for (auto it = range.first; it != range.second; ++it)
+    if (it->second == ci) {
+      idx.erase(it);
+      return;
+    }
+}
+
+/* Mark the item CI as used.  */
+static void touch_cache_item(cert_item_t ci) {
+  ci->last_use.store(++cache_tick, std::memory_order_relaxed);
+}
+
 /* Return a malloced canonical S-Expression with the serial number
  * converted from the hex string HEXSN.  Return NULL on memory
  * error.  */
@@ -154,6 +264,14 @@ static void clean_cache_slot(cert_item_t ci) {
 
   if (!ci->cert) return; /* Already cleaned.  */
 
+  if (ci->issuer_dn) {
+    if (ci->sn)
+      index_remove(cert_by_issuer_sn, issuer_sn_key(ci->issuer_dn, ci->sn),
+                   ci);
+    index_remove(cert_by_issuer, ci->issuer_dn, ci);
+  }
+  if (ci->subject_dn) index_remove(cert_by_subject, ci->subject_dn, ci);
+
   ksba_free(ci->sn);
   ci->sn = NULL;
   ksba_free(ci->issuer_dn);
@@ -190,53 +308,48 @@ static gpg_error_t put_cert(ksba_cert_t cert, int permanent,
   fpr = (unsigned char *)(fpr_buffer ? fpr_buffer : &help_fpr_buffer);
 
   /* If we already reached the caching limit, drop a couple of certs
-   * from the cache.  Our dropping strategy is simple: We keep a
-   * static index counter and use this to start looking for
-   * certificates, then we drop 5 percent of the oldest certificates
-   * starting at that index.  For a large cache this is a fair way of
-   * removing items.  An LRU strategy would be better of course.
-   * Because we append new entries to the head of the list and we want
-   * to remove old ones first, we need to do this from the tail.  The
-   * implementation is not very efficient but compared to the long
-   * time it takes to retrieve a certificate from an external resource
-   * it seems to be reasonable.  */
-  if (!permanent && total_nonperm_certificates >= MAX_NONPERM_CACHED_CERTS) {
-    static int idx;
-    cert_item_t ci_mark;
-    int i;
+   * from the cache.  We drop 5 percent of the certificates, namely
+   * those which have not been used for the longest time.  Finding
+   * them takes a linear scan but that is amortized over the
+   * insertions until the limit is reached again.  */
+  if (!permanent && total_nonperm_certificates >= opt.max_cached_certs) {
+    std::vector<cert_item_t> items;
     unsigned int drop_count;
+    int i;
 
-    drop_count = MAX_NONPERM_CACHED_CERTS / 20;
+    drop_count = opt.max_cached_certs / 20;
     if (drop_count < 2) drop_count = 2;
 
-    log_info(_("dropping %u certificates from the cache\n"), drop_count);
-    assert(idx < 256);
-    for (i = idx; drop_count; i = ((i + 1) % 256)) {
-      ci_mark = NULL;
+    items.reserve(total_nonperm_certificates);
+    for (i = 0; i < 256; i++)
       for (ci = cert_cache[i]; ci; ci = ci->next)
-        if (ci->cert && !ci->permanent) ci_mark = ci;
-      if (ci_mark) {
-        clean_cache_slot(ci_mark);
-        drop_count--;
-        total_nonperm_certificates--;
-      }
+        if (ci->cert && !ci->permanent) items.push_back(ci);
+    if (drop_count > items.size()) drop_count = items.size();
+
+    log_info(_("dropping %u certificates from the cache\n"), drop_count);
+    std::nth_element(items.begin(), items.begin() + drop_count, items.end(),
+                     [](cert_item_t a, cert_item_t b) {
+                       return a->last_use.load(std::memory_order_relaxed) <
+                              b->last_use.load(std::memory_order_relaxed);
+                     });
+    for (unsigned int n = 0; n < drop_count; n++) {
+      clean_cache_slot(items[n]);
+      total_nonperm_certificates--;
     }
-    if (i == idx)
-      idx++;
-    else
-      idx = i;
-    idx %= 256;
   }
 
   cert_compute_fpr(cert, fpr);
   for (ci = cert_cache[*fpr]; ci; ci = ci->next)
-    if (ci->cert && !memcmp(ci->fpr, fpr, 20)) return GPG_ERR_DUP_VALUE;
+    if (ci->cert && !memcmp(ci->fpr, fpr, 20)) {
+      touch_cache_item(ci);
+      return GPG_ERR_DUP_VALUE;
+    }
   /* Try to reuse an existing entry.  */
   for (ci = cert_cache[*fpr]; ci; ci = ci->next)
     if (!ci->cert) break;
   if (!ci) { /* No: Create a new entry.  */
-    ci = (cert_item_t)xtrycalloc(1, sizeof *ci);
-    if (!ci) return gpg_error_from_errno(errno);
+    ci = new (std::nothrow) cert_item_s();
+    if (!ci) return GPG_ERR_ENOMEM;
     ci->next = cert_cache[*fpr];
     cert_cache[*fpr] = ci;
   }
@@ -253,6 +366,11 @@ static gpg_error_t put_cert(ksba_cert_t cert, int permanent,
   ci->subject_dn = ksba_cert_get_subject(cert, 0);
   ci->permanent = !!permanent;
   ci->trustclasses = trustclass;
+  touch_cache_item(ci);
+
+  cert_by_issuer_sn.emplace(issuer_sn_key(ci->issuer_dn, ci->sn), ci);
+  cert_by_issuer.emplace(ci->issuer_dn, ci);
+  if (ci->subject_dn) cert_by_subject.emplace(ci->subject_dn, ci);
 
   if (!permanent) total_nonperm_certificates++;
 
@@ -557,7 +675,7 @@ void cert_cache_init(const std::vector<std::string> &hkp_cacerts) {
   if (initialization_done) return;
 
   {
-    std::lock_guard<std::mutex> lock(cache_lock);
+    std::lock_guard<cache_rwlock> lock(cache_lock);
     load_certs_from_system();
 
     fname = make_filename_try(gnupg_sysconfdir(), "trusted-certs", NULL);
@@ -590,7 +708,7 @@ void cert_cache_deinit(int full) {
 
   if (!initialization_done) return;
 
-  std::lock_guard<std::mutex> lock(cache_lock);
+  std::lock_guard<cache_rwlock> lock(cache_lock);
 
   for (i = 0; i < 256; i++)
     for (ci = cert_cache[i]; ci; ci = ci->next) clean_cache_slot(ci);
@@ -599,12 +717,15 @@ void cert_cache_deinit(int full) {
     for (i = 0; i < 256; i++) {
       for (ci = cert_cache[i]; ci; ci = ci2) {
         ci2 = ci->next;
-        xfree(ci);
+        delete ci;
       }
       cert_cache[i] = NULL;
     }
   }
 
+  cert_by_issuer_sn.clear();
+  cert_by_issuer.clear();
+  cert_by_subject.clear();
   total_nonperm_certificates = 0;
   initialization_done = 0;
 }
@@ -621,7 +742,7 @@ void cert_cache_print_stats(void) {
   unsigned int n_trustclass_hkp = 0;
   unsigned int n_trustclass_hkpspool = 0;
 
-  std::lock_guard<std::mutex> lock(cache_lock);
+  cache_shared_lock lock(cache_lock);
   for (idx = 0; idx < 256; idx++)
     for (ci = cert_cache[idx]; ci; ci = ci->next)
       if (ci->cert) {
@@ -652,7 +773,7 @@ void cert_cache_print_stats(void) {
 gpg_error_t cache_cert(ksba_cert_t cert) {
   gpg_error_t err;
 
-  std::lock_guard<std::mutex> lock(cache_lock);
+  std::lock_guard<cache_rwlock> lock(cache_lock);
   err = put_cert(cert, 0, 0, NULL);
   if (err == GPG_ERR_DUP_VALUE)
     log_info(_("certificate already cached\n"));
@@ -670,7 +791,7 @@ gpg_error_t cache_cert(ksba_cert_t cert) {
 gpg_error_t cache_cert_silent(ksba_cert_t cert, void *fpr_buffer) {
   gpg_error_t err;
 
-  std::lock_guard<std::mutex> lock(cache_lock);
+  std::lock_guard<cache_rwlock> lock(cache_lock);
   err = put_cert(cert, 0, 0, fpr_buffer);
   if (err == GPG_ERR_DUP_VALUE) err = 0;
   if (err) log_error(_("error caching certificate: %s\n"), gpg_strerror(err));
@@ -686,9 +807,10 @@ gpg_error_t cache_cert_silent(ksba_cert_t cert, void *fpr_buffer) {
 ksba_cert_t get_cert_byfpr(const unsigned char *fpr) {
   cert_item_t ci;
 
-  std::lock_guard<std::mutex> lock(cache_lock);
+  cache_shared_lock lock(cache_lock);
   for (ci = cert_cache[*fpr]; ci; ci = ci->next)
     if (ci->cert && !memcmp(ci->fpr, fpr, 20)) {
+      touch_cache_item(ci);
       ksba_cert_ref(ci->cert);
       return ci->cert;
     }
@@ -729,19 +851,26 @@ ksba_cert_t get_cert_byhexfpr(const char *string) {
 
 /* Return the certificate matching ISSUER_DN and SERIALNO.  */
 ksba_cert_t get_cert_bysn(const char *issuer_dn, ksba_sexp_t serialno) {
-  /* Simple and inefficient implementation.   fixme! */
-  cert_item_t ci;
-  int i;
+  cache_shared_lock lock(cache_lock);
+  auto it = cert_by_issuer_sn.find(issuer_sn_key(issuer_dn, serialno));
+  if (it == cert_by_issuer_sn.end()) return NULL;
 
-  std::lock_guard<std::mutex> lock(cache_lock);
-  for (i = 0; i < 256; i++) {
-    for (ci = cert_cache[i]; ci; ci = ci->next)
-      if (ci->cert && !strcmp(ci->issuer_dn, issuer_dn) &&
-          !compare_serialno(ci->sn, serialno)) {
-        ksba_cert_ref(ci->cert);
-        return ci->cert;
-      }
-  }
+  touch_cache_item(it->second);
+  ksba_cert_ref(it->second->cert);
+  return it->second->cert;
+}
+
+/* Return the SEQ-th item from the index IDX matching KEY.  */
+static ksba_cert_t get_cert_byindex(const cert_index_t &idx, const char *key,
+                                    unsigned int seq) {
+  cache_shared_lock lock(cache_lock);
+  auto range = idx.equal_range(key);
+  for (auto it = range.first; it != range.second; ++it)
+    if (!seq--) {
+      touch_cache_item(it->second);
+      ksba_cert_ref(it->second->cert);
+      return it->second->cert;
+    }
 
   return NULL;
 }
@@ -749,43 +878,15 @@ ksba_cert_t get_cert_bysn(const char *issuer_dn, ksba_sexp_t serialno) {
 /* Return the certificate matching ISSUER_DN.  SEQ should initially be
    set to 0 and bumped up to get the next issuer with that DN. */
 ksba_cert_t get_cert_byissuer(const char *issuer_dn, unsigned int seq) {
-  /* Simple and very inefficient implementation and API.  fixme! */
-  cert_item_t ci;
-  int i;
-
-  std::lock_guard<std::mutex> lock(cache_lock);
-  for (i = 0; i < 256; i++) {
-    for (ci = cert_cache[i]; ci; ci = ci->next)
-      if (ci->cert && !strcmp(ci->issuer_dn, issuer_dn))
-        if (!seq--) {
-          ksba_cert_ref(ci->cert);
-          return ci->cert;
-        }
-  }
-
-  return NULL;
+  return get_cert_byindex(cert_by_issuer, issuer_dn, seq);
 }
 
 /* Return the certificate matching SUBJECT_DN.  SEQ should initially be
    set to 0 and bumped up to get the next subject with that DN. */
 ksba_cert_t get_cert_bysubject(const char *subject_dn, unsigned int seq) {
-  /* Simple and very inefficient implementation and API.  fixme! */
-  cert_item_t ci;
-  int i;
-
   if (!subject_dn) return NULL;
 
-  std::lock_guard<std::mutex> lock(cache_lock);
-  for (i = 0; i < 256; i++) {
-    for (ci = cert_cache[i]; ci; ci = ci->next)
-      if (ci->cert && ci->subject_dn && !strcmp(ci->subject_dn, subject_dn))
-        if (!seq--) {
-          ksba_cert_ref(ci->cert);
-          return ci->cert;
-        }
-  }
-
-  return NULL;
+  return get_cert_byindex(cert_by_subject, subject_dn, seq);
 }
 
 /* Return a value describing the class of PATTERN.  The offset of
@@ -1156,20 +1257,18 @@ ksba_cert_t find_cert_bysubject(ctrl_t ctrl, const char *subject_dn,
    * for example required by Telesec certificates where a keyId is
    * used but the issuer certificate comes without a subject keyId! */
   if (ctrl->ocsp_certs && subject_dn) {
-    cert_item_t ci;
     cert_ref_t cr;
-    int i;
 
     /* For efficiency reasons we won't use get_cert_bysubject here. */
-    std::lock_guard<std::mutex> lock(cache_lock);
-    for (i = 0; i < 256; i++)
-      for (ci = cert_cache[i]; ci; ci = ci->next)
-        if (ci->cert && ci->subject_dn && !strcmp(ci->subject_dn, subject_dn))
-          for (cr = ctrl->ocsp_certs; cr; cr = cr->next)
-            if (!memcmp(ci->fpr, cr->fpr, 20)) {
-              ksba_cert_ref(ci->cert);
-              return ci->cert; /* We use this certificate. */
-            }
+    cache_shared_lock lock(cache_lock);
+    auto range = cert_by_subject.equal_range(subject_dn);
+    for (auto it = range.first; it != range.second; ++it)
+      for (cr = ctrl->ocsp_certs; cr; cr = cr->next)
+        if (!memcmp(it->second->fpr, cr->fpr, 20)) {
+          touch_cache_item(it->second);
+          ksba_cert_ref(it->second->cert);
+          return it->second->cert; /* We use this certificate. */
+        }
     if (DBG_LOOKUP)
       log_debug("find_cert_bysubject: certificate not in ocsp_certs\n");
   }
@@ -1290,7 +1389,7 @@ gpg_error_t is_trusted_cert(ksba_cert_t cert, unsigned int trustclasses) {
 
   cert_compute_fpr(cert, fpr);
 
-  std::lock_guard<std::mutex> lock(cache_lock);
+  cache_shared_lock lock(cache_lock);
   for (ci = cert_cache[*fpr]; ci; ci = ci->next)
     if (ci->cert && !memcmp(ci->fpr, fpr, 20)) {
       if ((ci->trustclasses & trustclasses)) {
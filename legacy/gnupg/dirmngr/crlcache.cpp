@@ -90,7 +90,10 @@
 #include <config.h>
 
 #include <boost/format.hpp>
+#include <map>
+#include <mutex>
 #include <ostream>
+#include <string>
 
 #include <assert.h>
 #include <dirent.h>
@@ -125,11 +128,13 @@
 #define DBDIRFILE "DIR.txt"
 #define DBDIRVERSION 1
 
-/* The number of DB files we may have open at one time.  We need to
+/* The number of DB files we may have mapped at one time.  We need to
    limit this because there is no guarantee that the number of issuers
-   has a upper limit.  We are currently using mmap, so it is a good
-   idea anyway to limit the number of opened cache files. */
-#define MAX_OPEN_DB_FILES 5
+   has a upper limit.  The file descriptor is closed right after
+   mapping, so this only limits address space; it is large enough to
+   keep the CRLs of all issuers in regular use mapped across
+   queries. */
+#define MAX_OPEN_DB_FILES 64
 
 static const char oidstr_crlNumber[] = "2.5.29.20";
 /* static const char oidstr_issuingDistributionPoint[] = "2.5.29.28"; */
@@ -179,6 +184,23 @@ static crl_cache_entry_t find_entry(crl_cache_entry_t first,
    right at startup.  */
 static crl_cache_t current_cache;
 
+/* Protects the entry list of CURRENT_CACHE, the use counts of the
+   mapped DB files and the DIR file.  Lookups in a mapped DB file are
+   done without holding it; the use count keeps the mapping alive.  */
+static std::mutex cache_lock;
+
+/* Fetching and inserting the CRL of an issuer is serialized per
+   issuer hash, so that concurrent requests for the same issuer wait
+   for one download instead of starting their own.  Requests for
+   different issuers do not block each other.  An entry is removed
+   when its last user releases it.  */
+struct fetch_lock_s {
+  std::mutex mutex;
+  unsigned int refcount{0};
+};
+static std::map<std::string, fetch_lock_s> fetch_locks;
+static std::mutex fetch_locks_lock;
+
 /* Return the current cache object or bail out if it is has not yet
    been initialized.  */
 static crl_cache_t get_current_cache(void) {
@@ -318,16 +340,17 @@ static char *next_line_from_file(estream_t fp, gpg_error_t *r_err) {
   return tmpbuf;
 }
 
+/* Unmap the cache file of ENTRY.  */
+static void close_db_file(crl_cache_entry_t entry) {
+  cdb_free(entry->cdb);
+  xfree(entry->cdb);
+  entry->cdb = NULL;
+}
+
 /* Release one cache entry.  */
 static void release_one_cache_entry(crl_cache_entry_t entry) {
   if (entry) {
-    if (entry->cdb) {
-      int fd = cdb_fileno(entry->cdb);
-      cdb_free(entry->cdb);
-      xfree(entry->cdb);
-      if (close(fd))
-        log_error(_("error closing cache file: %s\n"), strerror(errno));
-    }
+    if (entry->cdb) close_db_file(entry);
     xfree(entry->release_ptr);
     xfree(entry->check_trust_anchor);
     xfree(entry);
@@ -913,7 +936,8 @@ static int check_dbfile(const char *fname, const char *md5hexvalue) {
 
 /* Open the cache file for ENTRY.  This function implements a caching
    strategy and might close unused cache files. It is required to use
-   unlock_db_file after using the file. */
+   unlock_db_file after using the file.  Must be called with
+   CACHE_LOCK held.  */
 static struct cdb *lock_db_file(crl_cache_t cache, crl_cache_entry_t entry) {
   char *fname;
   int fd;
@@ -950,12 +974,7 @@ static struct cdb *lock_db_file(crl_cache_t cache, crl_cache_entry_t entry) {
 
     /*       log_debug ("CACHE: closing file at cdb=%p\n", last_e->cdb); */
 
-    fd = cdb_fileno(last_e->cdb);
-    cdb_free(last_e->cdb);
-    xfree(last_e->cdb);
-    last_e->cdb = NULL;
-    if (close(fd))
-      log_error(_("error closing cache file: %s\n"), strerror(errno));
+    close_db_file(last_e);
     open_count--;
   }
 
@@ -990,6 +1009,10 @@ static struct cdb *lock_db_file(crl_cache_t cache, crl_cache_entry_t entry) {
     xfree(fname);
     return NULL;
   }
+  /* Lookups only use the mapping, which stays valid after closing.  */
+  if (close(fd))
+    log_error(_("error closing cache file: %s\n"), strerror(errno));
+  entry->cdb->cdb_fd = -1;
   xfree(fname);
 
   entry->cdb_use_count = 1;
@@ -998,7 +1021,8 @@ static struct cdb *lock_db_file(crl_cache_t cache, crl_cache_entry_t entry) {
   return entry->cdb;
 }
 
-/* Unlock a cache file, so that it can be reused. */
+/* Unlock a cache file, so that it can be reused.  Must be called with
+   CACHE_LOCK held.  */
 static void unlock_db_file(crl_cache_t cache, crl_cache_entry_t entry) {
   if (!entry->cdb)
     log_error(_("calling unlock_db_file on a closed file\n"));
@@ -1010,20 +1034,16 @@ static void unlock_db_file(crl_cache_t cache, crl_cache_entry_t entry) {
   }
 
   /* If the entry was marked for deletion in the meantime do it now.
-     We do this for the sake of Pth thread safeness. */
+     Nobody else can reference it once the use count dropped to zero
+     because lookups take their reference under CACHE_LOCK.  */
   if (!entry->cdb_use_count && entry->deleted) {
-    crl_cache_entry_t eprev, enext;
+    crl_cache_entry_t *ep;
 
-    enext = entry->next;
-    for (eprev = cache->entries; eprev && eprev->next != entry;
-         eprev = eprev->next)
+    for (ep = &cache->entries; *ep && *ep != entry; ep = &(*ep)->next)
       ;
-    assert(eprev);
-    if (eprev == cache->entries)
-      cache->entries = enext;
-    else
-      eprev->next = enext;
-    /* FIXME: Do we leak ENTRY? */
+    assert(*ep);
+    *ep = entry->next;
+    release_one_cache_entry(entry);
   }
 }
 
@@ -1084,10 +1104,12 @@ static crl_cache_result_t cache_isvalid(ctrl_t ctrl, const char *issuer_hash,
   crl_cache_t cache = get_current_cache();
   crl_cache_result_t retval;
   struct cdb *cdb;
+  struct cdb lookup;
   int rc;
   crl_cache_entry_t entry;
   gnupg_isotime_t current_time;
   size_t n;
+  std::unique_lock<std::mutex> lock(cache_lock);
 
   (void)ctrl;
 
@@ -1138,6 +1160,14 @@ static crl_cache_result_t cache_isvalid(ctrl_t ctrl, const char *issuer_hash,
     return CRL_CACHE_DONTKNOW;
   }
 
+  /* The mapping is read-only and stays valid while we hold a use
+     count, but cdb_find stores its result in the handle.  Searching
+     in a private copy of the handle lets concurrent lookups in the
+     same file run without the lock.  */
+  lookup = *cdb;
+  cdb = &lookup;
+  lock.unlock();
+
   rc = cdb_find(cdb, sn, snlen);
   if (rc == 1) {
     n = cdb_datalen(cdb);
@@ -1184,6 +1214,7 @@ static crl_cache_result_t cache_isvalid(ctrl_t ctrl, const char *issuer_hash,
     }
   }
 
+  lock.lock();
   unlock_db_file(cache, entry);
 
   return retval;
@@ -1672,10 +1703,10 @@ gpg_error_t crl_cache_insert(ctrl_t ctrl, const char *url,
   const char *oid;
   int critical;
   char *trust_anchor = NULL;
+  std::unique_lock<std::mutex> lock(cache_lock, std::defer_lock);
 
-  /* FIXME: We should acquire a mutex for the URL, so that we don't
-     simultaneously enter the same CRL twice.  However this needs to be
-     interweaved with the checking function.*/
+  /* Concurrent fetches of the same CRL are serialized by
+     crl_cache_reload_crl; here we only need to protect the list.  */
 
   err2 = 0;
 
@@ -1845,7 +1876,9 @@ gpg_error_t crl_cache_insert(ctrl_t ctrl, const char *url,
 
   /* Check whether we already have an entry for this issuer and mark
      it as deleted. We better use a loop, just in case duplicates got
-     somehow into the list. */
+     somehow into the list.  Entries still in use by a lookup are
+     released by unlock_db_file.  */
+  lock.lock();
   for (e = cache->entries; (e = find_entry(e, entry->issuer_hash)); e = e->next)
     e->deleted = 1;
 
@@ -1862,12 +1895,7 @@ gpg_error_t crl_cache_insert(ctrl_t ctrl, const char *url,
       for (e = cache->entries; e; e = e->next)
         if (!e->cdb_use_count && e->cdb &&
             !strcmp(e->issuer_hash, entry->issuer_hash)) {
-          int fd = cdb_fileno(e->cdb);
-          cdb_free(e->cdb);
-          xfree(e->cdb);
-          e->cdb = NULL;
-          if (close(fd))
-            log_error(_("error closing cache file: %s\n"), strerror(errno));
+          close_db_file(e);
           any = 1;
           break;
         }
@@ -2032,6 +2060,7 @@ gpg_error_t crl_cache_list(std::ostream &out) {
   crl_cache_t cache = get_current_cache();
   crl_cache_entry_t entry;
   gpg_error_t err = 0;
+  std::lock_guard<std::mutex> lock(cache_lock);
 
   for (entry = cache->entries; entry && !entry->deleted && !err;
        entry = entry->next)
@@ -2064,7 +2093,7 @@ gpg_error_t crl_cache_load(ctrl_t ctrl, const char *filename) {
 
 /* Locate the corresponding CRL for the certificate CERT, read and
    verify the CRL and store it in the cache.  */
-gpg_error_t crl_cache_reload_crl(ctrl_t ctrl, ksba_cert_t cert) {
+static gpg_error_t reload_crl(ctrl_t ctrl, ksba_cert_t cert) {
   gpg_error_t err;
   ksba_reader_t reader = NULL;
   char *issuer = NULL;
@@ -2123,6 +2152,8 @@ gpg_error_t crl_cache_reload_crl(ctrl_t ctrl, ksba_cert_t cert) {
       if (err) {
         log_error(_("crl_cache_insert via DP failed: %s\n"), gpg_strerror(err));
         last_err = err;
+        crl_close_reader(reader);
+        reader = NULL;
         continue; /* with the next name. */
       }
       last_err = 0;
@@ -2187,3 +2218,72 @@ leave:
   ksba_free(issuer);
   return err;
 }
+
+/* Acquire the fetch lock for ISSUER_HASH.  */
+static fetch_lock_s *acquire_fetch_lock(const std::string &issuer_hash) {
+  fetch_lock_s *fl;
+
+  {
+    std::lock_guard<std::mutex> lock(fetch_locks_lock);
+    fl = &fetch_locks[issuer_hash];
+    fl->refcount++;
+  }
+  fl->mutex.lock();
+  return fl;
+}
+
+/* Release the fetch lock FL for ISSUER_HASH.  */
+static void release_fetch_lock(const std::string &issuer_hash,
+                               fetch_lock_s *fl) {
+  fl->mutex.unlock();
+
+  std::lock_guard<std::mutex> lock(fetch_locks_lock);
+  if (!--fl->refcount) fetch_locks.erase(issuer_hash);
+}
+
+/* Return true if the CRL for ISSUER_HASH has been loaded at or after
+   SINCE.  */
+static int crl_loaded_since(const std::string &issuer_hash,
+                            const gnupg_isotime_t since) {
+  crl_cache_t cache = get_current_cache();
+  crl_cache_entry_t entry;
+  std::lock_guard<std::mutex> lock(cache_lock);
+
+  entry = find_entry(cache->entries, issuer_hash.c_str());
+  return entry && !entry->invalid && *entry->last_refresh &&
+         strcmp(entry->last_refresh, since) >= 0;
+}
+
+/* Locate the corresponding CRL for the certificate CERT, read and
+   verify the CRL and store it in the cache.  If another connection
+   is already loading the CRL of the same issuer, wait for it and use
+   its result instead of fetching the CRL again.  */
+gpg_error_t crl_cache_reload_crl(ctrl_t ctrl, ksba_cert_t cert) {
+  gpg_error_t err;
+  gnupg_isotime_t started;
+  fetch_lock_s *fl;
+  char *tmp;
+
+  tmp = ksba_cert_get_issuer(cert, 0);
+  if (!tmp) {
+    log_error("oops: issuer missing in certificate\n");
+    return GPG_ERR_INV_CERT_OBJ;
+  }
+  std::unique_ptr<Botan::HashFunction> sha1 =
+      Botan::HashFunction::create_or_throw("SHA-1");
+  std::string issuer_hash = Botan::hex_encode(sha1->process(tmp));
+  ksba_free(tmp);
+
+  gnupg_get_isotime(started);
+  fl = acquire_fetch_lock(issuer_hash);
+  if (crl_loaded_since(issuer_hash, started)) {
+    if (opt.verbose)
+      log_info("CRL for issuer id %s has just been loaded\n",
+               issuer_hash.c_str());
+    err = 0;
+  } else
+    err = reload_crl(ctrl, cert);
+  release_fetch_lock(issuer_hash, fl);
+
+  return err;
+}
@@ -22,16 +22,188 @@
 
 #include <errno.h>
 #include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
 
 #include <neopg/http.h>
 
 #include "crlfetch.h"
+#include "misc.h"
+
+/* A CRL being downloaded in the background.  The HTTP transfer runs
+ * in its own thread and writes the body, after removing any PEM
+ * armor, into one end of a socket pair.  The ksba reader returned by
+ * crl_fetch reads from the other end.  Thus the CRL is parsed and
+ * inserted into the cache while it arrives and is never held in
+ * memory as a whole; the socket buffer bounds the amount of data in
+ * flight.  */
+struct crl_stream_s {
+  int fd;             /* Our end of the socket pair.  */
+  std::thread thread; /* The thread running the transfer.  */
+  std::string url;
+  std::string cache_dir; /* Where to keep the response for revalidation.  */
+
+  std::mutex lock;   /* Protects ERROR.  */
+  std::string error; /* Error message of a failed transfer.  */
+
+  std::string peek; /* Data already read by crl_fetch.  */
+  size_t peek_off;
+};
+typedef struct crl_stream_s *crl_stream_t;
+
+/* The streams associated with the readers returned by crl_fetch.  */
+static std::map<ksba_reader_t, crl_stream_t> crl_streams;
+static std::mutex crl_streams_lock;
+
+/* Write LEN bytes from DATA to FD.  Throws if the reader has gone
+   away, which aborts the transfer.  */
+static void crl_stream_write(int fd, const char *data, size_t len) {
+  while (len) {
+    ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+    if (n == -1 && errno == EINTR) continue;
+    if (n <= 0) throw std::runtime_error("reader closed");
+    data += n;
+    len -= n;
+  }
+}
+
+/* The thread function running the HTTP transfer for STREAM.  FD is
+   the writing end of the socket pair and is closed on return.  */
+static void crl_stream_run(crl_stream_t stream, int fd, long timeout) {
+  enum { FORMAT_UNKNOWN, FORMAT_DER, FORMAT_PEM } format = FORMAT_UNKNOWN;
+  gpgrt_b64state_t b64state = NULL;
+  std::string buffer;
+
+  try {
+    NeoPG::Http request;
+    request.set_url(stream->url).forbid_reuse().set_timeout(timeout).no_cache();
+    /* The size limit is meant to protect memory; we don't keep the
+       body in memory.  */
+    request.set_maxfilesize(0);
+    /* An unchanged CRL is then answered with 304 and taken from the
+       cache directory instead of being downloaded again.  */
+    request.set_cache_dir(stream->cache_dir);
+
+    if (opt.http_proxy)
+      request.set_proxy(opt.http_proxy);
+    else
+      request.default_proxy(opt.honor_http_proxy);
+
+    if (opt.disable_ipv6)
+      request.set_ipresolve(NeoPG::Http::Resolve::IPv4);
+    else if (opt.disable_ipv4)
+      request.set_ipresolve(NeoPG::Http::Resolve::IPv6);
+
+    request.fetch([&](const uint8_t *data, size_t len) {
+      size_t n;
+
+      if (format == FORMAT_UNKNOWN && len) {
+        /* Check for PEM, such as
+           http://grid.fzk.de/ca/gridka-crl.pem (2008-2017). */
+        uint8_t c = data[0];
+        if (((c & 0xc0) >> 6) == 0 /* class: universal */
+            && (c & 0x1f) == 16    /* sequence */
+            && (c & 0x20) /* is constructed */)
+          format = FORMAT_DER;
+        else {
+          format = FORMAT_PEM;
+          b64state = gpgrt_b64dec_start("");
+        }
+      }
+
+      if (format == FORMAT_DER)
+        crl_stream_write(fd, (const char *)data, len);
+      else if (format == FORMAT_PEM) {
+        /* The decoder works in place and keeps its state across
+           chunks.  */
+        buffer.assign((const char *)data, len);
+        gpgrt_b64dec_proc(b64state, &buffer[0], buffer.size(), &n);
+        crl_stream_write(fd, buffer.data(), n);
+      }
+    });
+  } catch (const std::exception &e) {
+    std::lock_guard<std::mutex> guard(stream->lock);
+    stream->error = e.what();
+  }
+
+  if (b64state) gpgrt_b64dec_finish(b64state);
+  close(fd);
+}
+
+/* Release STREAM.  Closing our end first makes a running transfer
+   fail, so that the thread terminates.  */
+static void crl_stream_release(crl_stream_t stream) {
+  if (!stream) return;
+
+  if (stream->fd != -1) {
+    shutdown(stream->fd, SHUT_RDWR);
+    close(stream->fd);
+  }
+  if (stream->thread.joinable()) stream->thread.join();
+  delete stream;
+}
+
+/* Return the error of a finished transfer or an empty string.  */
+static std::string crl_stream_error(crl_stream_t stream) {
+  std::lock_guard<std::mutex> guard(stream->lock);
+  return stream->error;
+}
+
+/* The ksba reader callback for a CRL stream.  Returns -1 on EOF.  */
+static int crl_stream_read_cb(void *cb_value, char *buffer, size_t count,
+                              size_t *r_nread) {
+  crl_stream_t stream = (crl_stream_t)cb_value;
+  ssize_t n;
+
+  *r_nread = 0;
+  if (!count) return 0;
+
+  if (stream->peek_off < stream->peek.size()) {
+    n = std::min(count, stream->peek.size() - stream->peek_off);
+    memcpy(buffer, stream->peek.data() + stream->peek_off, n);
+    stream->peek_off += n;
+    *r_nread = n;
+    return 0;
+  }
+
+  do
+    n = recv(stream->fd, buffer, count, 0);
+  while (n == -1 && errno == EINTR);
+  if (n > 0) {
+    *r_nread = n;
+    return 0;
+  }
+
+  if (n == -1)
+    log_error(_("error reading from '%s': %s\n"), stream->url.c_str(),
+              strerror(errno));
+  else {
+    std::string error = crl_stream_error(stream);
+    if (!error.empty())
+      log_error(_("error retrieving '%s': %s\n"), stream->url.c_str(),
+                error.c_str());
+  }
+  return -1;
+}
 
 /* Fetch CRL from URL and return the entire CRL using new ksba reader
-   object in READER. */
+   object in READER.  The CRL is read while it is downloaded; the
+   reader must be released with crl_close_reader.  */
 gpg_error_t crl_fetch(ctrl_t ctrl, const char *url, ksba_reader_t *reader) {
   gpg_error_t err;
-  std::string response;
+  crl_stream_t stream;
+  int fds[2];
+  char buffer[4096];
+  ssize_t n;
+
   *reader = NULL;
 
   if (!url) return GPG_ERR_INV_ARG;
@@ -53,55 +225,54 @@ gpg_error_t crl_fetch(ctrl_t ctrl, const char *url, ksba_reader_t *reader) {
     return GPG_ERR_NOT_SUPPORTED;
   }
 
-  NeoPG::Http request;
-  request.set_url(url).forbid_reuse().set_timeout(ctrl->timeout).no_cache();
-
-  if (opt.http_proxy)
-    request.set_proxy(opt.http_proxy);
-  else
-    request.default_proxy(opt.honor_http_proxy);
-
-  if (opt.disable_ipv6)
-    request.set_ipresolve(NeoPG::Http::Resolve::IPv4);
-  else if (opt.disable_ipv4)
-    request.set_ipresolve(NeoPG::Http::Resolve::IPv6);
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+    err = gpg_error_from_syserror();
+    log_error(_("error creating socket: %s\n"), gpg_strerror(err));
+    return err;
+  }
 
+  stream = new crl_stream_s();
+  stream->fd = fds[0];
+  stream->url = url;
+  stream->cache_dir = http_cache_dir();
+  stream->peek_off = 0;
   try {
-    response = request.fetch();
-  } catch (const std::runtime_error &e) {
-    log_error(_("error retrieving '%s': %s\n"), url, e.what());
-    return GPG_ERR_NO_DATA;
+    stream->thread = std::thread(crl_stream_run, stream, fds[1],
+                                 (long)ctrl->timeout);
+  } catch (const std::system_error &e) {
+    log_error("error starting CRL fetch thread: %s\n", e.what());
+    close(fds[1]);
+    crl_stream_release(stream);
+    return GPG_ERR_GENERAL;
   }
 
-  /* Check for PEM, such as http://grid.fzk.de/ca/gridka-crl.pem (2008-2017). */
-  if (response.size()) {
-    uint8_t c = response[0];
-    if (((c & 0xc0) >> 6) == 0 /* class: universal */
-        && (c & 0x1f) == 16    /* sequence */
-        && (c & 0x20) /* is constructed */)
-      ; /* Binary data.  */
-    else {
-      /* Decode PEM.  */
-      gpgrt_b64state_t b64state;
-      b64state = gpgrt_b64dec_start("");
-      size_t new_size;
-      gpgrt_b64dec_proc(b64state, (void *)response.data(), response.size(),
-                        &new_size);
-      gpgrt_b64dec_finish(b64state);
-      response.resize(new_size);
-    }
+  /* Wait for the first data, so that a failed request is reported
+     right away.  */
+  do
+    n = recv(stream->fd, buffer, sizeof buffer, 0);
+  while (n == -1 && errno == EINTR);
+  if (n <= 0) {
+    std::string error = crl_stream_error(stream);
+    crl_stream_release(stream);
+    log_error(_("error retrieving '%s': %s\n"), url,
+              error.empty() ? "no data" : error.c_str());
+    return GPG_ERR_NO_DATA;
   }
+  stream->peek.assign(buffer, n);
 
   err = ksba_reader_new(reader);
-  if (!err) {
-    err = ksba_reader_set_mem(*reader, response.data(), response.size());
-  }
+  if (!err) err = ksba_reader_set_cb(*reader, crl_stream_read_cb, stream);
   if (err) {
     log_error(_("error initializing reader object: %s\n"), gpg_strerror(err));
     ksba_reader_release(*reader);
     *reader = NULL;
+    crl_stream_release(stream);
+    return err;
   }
-  return err;
+
+  std::lock_guard<std::mutex> guard(crl_streams_lock);
+  crl_streams[*reader] = stream;
+  return 0;
 }
 
 /* Fetch CRL for ISSUER using a default server. Return the entire CRL
@@ -180,11 +351,23 @@ gpg_error_t fetch_cert_by_url(ctrl_t ctrl, const char *url,
 }
 
 /* This function is to be used to close the reader object.  In
-   addition to running ksba_reader_release it also releases the LDAP
-   or HTTP contexts associated with that reader.  */
+   addition to running ksba_reader_release it also stops the HTTP
+   transfer associated with that reader.  */
 void crl_close_reader(ksba_reader_t reader) {
+  crl_stream_t stream = NULL;
+
   if (!reader) return;
 
+  {
+    std::lock_guard<std::mutex> guard(crl_streams_lock);
+    auto it = crl_streams.find(reader);
+    if (it != crl_streams.end()) {
+      stream = it->second;
+      crl_streams.erase(it);
+    }
+  }
+
   /* Now get rid of the reader object. */
   ksba_reader_release(reader);
+  crl_stream_release(stream);
 }
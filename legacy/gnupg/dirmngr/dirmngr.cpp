@@ -21,11 +21,18 @@
 
 #include <config.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
+#include <mutex>
+#include <thread>
 
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -52,6 +59,7 @@
 #include "crlcache.h"
 #include "crlfetch.h"
 #include "misc.h"
+#include "ocsp.h"
 
 #ifndef ENAMETOOLONG
 #define ENAMETOOLONG EINVAL
@@ -68,6 +76,7 @@ enum cmd_and_opt_values {
   oNoVerbose = 500,
 
   aServer,
+  aDaemon,
   aListCRLs,
   aLoadCRL,
   aFetchCRL,
@@ -98,6 +107,7 @@ enum cmd_and_opt_values {
   oOCSPMaxPeriod,
   oOCSPCurrentPeriod,
   oMaxReplies,
+  oMaxCachedCerts,
   oHkpCaCert,
   oFakedSystemTime,
   oForce,
@@ -110,6 +120,7 @@ enum cmd_and_opt_values {
   oKeyServer,
   oConnectTimeout,
   oConnectQuickTimeout,
+  oWorkerThreads,
   aTest
 };
 
@@ -118,6 +129,7 @@ static ARGPARSE_OPTS opts[] = {
     ARGPARSE_group(300, N_("@Commands:\n ")),
 
     ARGPARSE_c(aServer, "server", N_("run in server mode (foreground)")),
+    ARGPARSE_c(aDaemon, "daemon", N_("run in daemon mode (background)")),
     ARGPARSE_c(aListCRLs, "list-crls",
                N_("list the contents of the CRL cache")),
     ARGPARSE_c(aLoadCRL, "load-crl", N_("|FILE|load CRL from FILE into cache")),
@@ -161,6 +173,7 @@ static ARGPARSE_OPTS opts[] = {
 
     ARGPARSE_s_i(oMaxReplies, "max-replies",
                  N_("|N|do not return more than N items in one query")),
+    ARGPARSE_s_u(oMaxCachedCerts, "max-cached-certs", "@"),
 
     ARGPARSE_s_s(oKeyServer, "keyserver", "@"),
     ARGPARSE_s_s(oHkpCaCert, "hkp-cacert",
@@ -180,6 +193,8 @@ static ARGPARSE_OPTS opts[] = {
     ARGPARSE_s_s(oIgnoreCertExtension, "ignore-cert-extension", "@"),
     ARGPARSE_s_i(oConnectTimeout, "connect-timeout", "@"),
     ARGPARSE_s_i(oConnectQuickTimeout, "connect-quick-timeout", "@"),
+    ARGPARSE_s_u(oWorkerThreads, "worker-threads",
+                 N_("|N|serve up to N connections at once in daemon mode")),
 
     ARGPARSE_group(302, N_("@\n(See the \"info\" manual for a complete listing "
                            "of all commands and options)\n")),
@@ -203,6 +218,9 @@ static struct debug_flags_s debug_flags[] = {
 };
 
 #define DEFAULT_MAX_REPLIES 10
+#define DEFAULT_MAX_CACHED_CERTS 10000
+
+#define DEFAULT_WORKER_THREADS 8
 
 #define DEFAULT_CONNECT_TIMEOUT (15 * 1000)      /* 15 seconds */
 #define DEFAULT_CONNECT_QUICK_TIMEOUT (2 * 1000) /*  2 seconds */
@@ -214,8 +232,22 @@ static char *current_logfile;
 /* Helper to implement --debug-level. */
 static const char *debug_level;
 
+/* The name of the socket in daemon mode.  Malloced.  */
+static char *socket_name;
+
+/* Set by the signal handler to stop accepting new connections.  */
+static volatile sig_atomic_t shutdown_pending;
+
 /* Counter for the active connections.  */
-static int active_connections;
+static std::atomic<int> active_connections;
+
+/* Accepted connections waiting for a worker thread in daemon mode.
+   CONN_QUEUE_CLOSED is set on shutdown to let the workers terminate
+   once the queue has been drained.  */
+static std::deque<int> conn_queue;
+static bool conn_queue_closed;
+static std::mutex conn_queue_lock;
+static std::condition_variable conn_queue_cond;
 
 /* A list of filenames registred with --hkp-cacert.  */
 static std::vector<std::string> hkp_cacert_filenames;
@@ -223,6 +255,7 @@ static std::vector<std::string> hkp_cacert_filenames;
 /* Prototypes. */
 static void cleanup(void);
 static fingerprint_list_t parse_ocsp_signer(const char *string);
+static void handle_connections(int listen_fd);
 
 static const char *my_strusage(int level) {
   const char *p = NULL;
@@ -332,6 +365,7 @@ static int parse_rereadable_options(ARGPARSE_ARGS *pargs, int reread) {
     opt.ocsp_max_period = 90 * 86400;      /* 90 days.  */
     opt.ocsp_current_period = 3 * 60 * 60; /* 3 hours. */
     opt.max_replies = DEFAULT_MAX_REPLIES;
+    opt.max_cached_certs = DEFAULT_MAX_CACHED_CERTS;
     while (opt.ocsp_signer) {
       fingerprint_list_t tmp = opt.ocsp_signer->next;
       xfree(opt.ocsp_signer);
@@ -420,6 +454,10 @@ static int parse_rereadable_options(ARGPARSE_ARGS *pargs, int reread) {
     case oMaxReplies:
       opt.max_replies = pargs->r.ret_int;
       break;
+    case oMaxCachedCerts:
+      opt.max_cached_certs = pargs->r.ret_ulong;
+      if (!opt.max_cached_certs) opt.max_cached_certs = DEFAULT_MAX_CACHED_CERTS;
+      break;
 
     case oHkpCaCert: {
       /* FIXME: We are not supporting this anymore, but could.  */
@@ -575,6 +613,7 @@ next_pass:
     if (parse_rereadable_options(&pargs, 0)) continue; /* Already handled */
     switch (pargs.r_opt) {
       case aServer:
+      case aDaemon:
       case aShutdown:
       case aFlush:
       case aListCRLs:
@@ -636,6 +675,10 @@ next_pass:
         opt.force = 1;
         break;
 
+      case oWorkerThreads:
+        opt.worker_threads = pargs.r.ret_ulong;
+        break;
+
       default:
         pargs.err = configfp ? 1 : 2;
         break;
@@ -691,6 +734,8 @@ next_pass:
 
   post_option_parsing();
 
+  if (!opt.worker_threads) opt.worker_threads = DEFAULT_WORKER_THREADS;
+
   /* Ready.  Now to our duties. */
   if (!cmd) cmd = aServer;
   rc = 0;
@@ -713,7 +758,32 @@ next_pass:
 
     cert_cache_init(hkp_cacert_filenames);
     crl_cache_init();
-    start_command_handler();
+    start_command_handler(ASSUAN_INVALID_FD);
+  } else if (cmd == aDaemon) {
+    int fd;
+
+    if (argc) wrong_args("--daemon");
+
+    socket_name = make_filename(gnupg_homedir(), DIRMNGR_SOCK_NAME, NULL);
+    fd = create_server_socket(socket_name, opt.verbose);
+    if (fd == -1) dirmngr_exit(2);
+
+    if (logfile) {
+      log_set_file(logfile);
+      log_set_prefix(NULL, GPGRT_LOG_WITH_TIME | GPGRT_LOG_WITH_PID);
+    }
+
+    if (!nodetach) {
+      if (detach_server(!!logfile)) dirmngr_exit(1);
+      opt.running_detached = 1;
+    }
+
+    cert_cache_init(hkp_cacert_filenames);
+    crl_cache_init();
+    handle_connections(fd);
+    gnupg_remove(socket_name);
+    xfree(socket_name);
+    socket_name = NULL;
   } else if (cmd == aListCRLs) {
     /* Just list the CRL cache and exit. */
     if (argc) wrong_args("--list-crls");
@@ -760,21 +830,121 @@ next_pass:
     /* Delete cache and exit. */
     if (argc) wrong_args("--flush");
     rc = crl_cache_flush();
+    if (!rc) rc = ocsp_cache_flush();
   }
   cleanup();
   return !!rc;
 }
 
 static void cleanup(void) {
+  ocsp_cache_deinit();
   crl_cache_deinit();
   cert_cache_deinit(1);
 }
 
 void dirmngr_exit(int rc) {
   cleanup();
+  if (socket_name) gnupg_remove(socket_name);
   exit(rc);
 }
 
+/* Return the name of the socket we are listening on in daemon mode
+   or NULL if we are running as a pipe server.  */
+const char *dirmngr_get_current_socket_name(void) { return socket_name; }
+
+/* Signal handler for the daemon: stop accepting connections.  The
+   connections already accepted are served to their end.  */
+static void handle_signal(int signo) {
+  (void)signo;
+  shutdown_pending = 1;
+}
+
+/* The body of a worker thread in daemon mode: serve connections from
+   the queue until it is closed and empty.  Each connection gets its
+   own control object from start_command_handler, so the workers share
+   only the caches, which do their own locking.  */
+static void worker_thread(void) {
+  for (;;) {
+    int fd;
+
+    {
+      std::unique_lock<std::mutex> lock(conn_queue_lock);
+      conn_queue_cond.wait(
+          lock, [] { return conn_queue_closed || !conn_queue.empty(); });
+      if (conn_queue.empty()) return;
+      fd = conn_queue.front();
+      conn_queue.pop_front();
+    }
+
+    active_connections++;
+    start_command_handler(assuan_fdopen(fd));
+    active_connections--;
+  }
+}
+
+/* Accept connections on LISTEN_FD and hand them to a fixed pool of
+   opt.worker_threads threads until SIGTERM or SIGINT is received.
+   Returns after all accepted connections have been served.  */
+static void handle_connections(int listen_fd) {
+  std::vector<std::thread> workers;
+  struct sigaction sa;
+  struct pollfd pfd;
+
+  memset(&sa, 0, sizeof sa);
+  sa.sa_handler = handle_signal;
+  sa.sa_flags = SA_RESTART; /* Don't disturb the active connections.  */
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGTERM, &sa, NULL);
+  sigaction(SIGINT, &sa, NULL);
+  /* A client going away must not kill the daemon.  */
+  sa.sa_handler = SIG_IGN;
+  sigaction(SIGPIPE, &sa, NULL);
+
+  for (unsigned int i = 0; i < opt.worker_threads; i++)
+    workers.emplace_back(worker_thread);
+
+  log_info(_("%s %s started\n"), strusage(11), strusage(13));
+
+  pfd.fd = listen_fd;
+  pfd.events = POLLIN;
+  while (!shutdown_pending) {
+    int fd;
+
+    /* Wake up once a second to check for a pending shutdown.  */
+    pfd.revents = 0;
+    if (poll(&pfd, 1, 1000) <= 0) continue;
+
+    fd = accept(listen_fd, NULL, NULL);
+    if (fd == -1) {
+      if (errno != EINTR && errno != EAGAIN && errno != ECONNABORTED)
+        log_error(_("accept failed: %s\n"), strerror(errno));
+      continue;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    if (DBG_IPC)
+      log_debug("new connection on fd %d (%d active)\n", fd,
+                active_connections.load());
+
+    std::lock_guard<std::mutex> lock(conn_queue_lock);
+    conn_queue.push_back(fd);
+    conn_queue_cond.notify_one();
+  }
+
+  close(listen_fd);
+  if (active_connections.load())
+    log_info(_("shutdown pending, waiting for %d active connections\n"),
+             active_connections.load());
+  {
+    std::lock_guard<std::mutex> lock(conn_queue_lock);
+    conn_queue_closed = true;
+  }
+  conn_queue_cond.notify_all();
+  for (auto &worker : workers) worker.join();
+
+  log_info(_("%s %s stopped\n"), strusage(11), strusage(13));
+}
+
 void dirmngr_init_default_ctrl(ctrl_t ctrl) {
   if (opt.http_proxy) ctrl->http_proxy = xstrdup(opt.http_proxy);
   ctrl->http_no_crl = 1;
@@ -96,6 +96,10 @@ struct dirmngr_options {
 
   int max_replies{0};
 
+  /* Maximum number of certificates kept in the certificate cache in
+     addition to the permanently loaded ones.  */
+  unsigned int max_cached_certs{0};
+
   const char *ocsp_responder{nullptr}; /* Standard OCSP responder's URL. */
   fingerprint_list_t ocsp_signer{
       nullptr}; /* The list of fingerprints with allowed
@@ -108,6 +112,9 @@ struct dirmngr_options {
                                       current after nextUpdate. */
 
   std::vector<std::string> keyserver; /* List of default keyservers.  */
+
+  /* Number of threads serving connections in daemon mode.  */
+  unsigned int worker_threads{0};
 };
 extern struct dirmngr_options dirmngr_opt;
 #define opt dirmngr_opt
@@ -179,7 +186,7 @@ ksba_cert_t get_issuing_cert_local(ctrl_t ctrl, const char *issuer);
 ksba_cert_t get_cert_local_ski(ctrl_t ctrl, const char *name,
                                ksba_sexp_t keyid);
 gpg_error_t get_istrusted_from_client(ctrl_t ctrl, const char *hexfpr);
-void start_command_handler();
+void start_command_handler(assuan_fd_t fd);
 gpg_error_t dirmngr_status(ctrl_t ctrl, const char *keyword, ...);
 gpg_error_t dirmngr_status_help(ctrl_t ctrl, const char *text);
 
@@ -112,6 +112,9 @@ static gpg_error_t send_request(ctrl_t ctrl, const std::string &url,
 
   NeoPG::Http request;
   request.set_url(url).forbid_reuse().set_timeout(ctrl->timeout).no_cache();
+  /* Revalidate earlier responses instead of downloading them again.
+     POST requests are never cached.  */
+  request.set_cache_dir(http_cache_dir());
 
   if (opt.http_proxy)
     request.set_proxy(opt.http_proxy);
@@ -71,6 +71,8 @@ gpg_error_t ks_http_fetch(ctrl_t ctrl, const char *url, std::string &response) {
   /* ctrl->http_no_crl support?  */
   NeoPG::Http request;
   request.set_url(url).forbid_reuse().set_timeout(ctrl->timeout).no_cache();
+  /* Revalidate earlier responses instead of downloading them again.  */
+  request.set_cache_dir(http_cache_dir());
 
   if (opt.http_proxy)
     request.set_proxy(opt.http_proxy);
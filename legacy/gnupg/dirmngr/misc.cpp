@@ -413,3 +413,15 @@ gpg_error_t armor_data(char **r_string, const void *data, size_t datalen) {
   *r_string = buffer;
   return 0;
 }
+
+/* Return the directory for cached HTTP responses, which lives next to
+   the CRL cache, or an empty string if there is no cache directory.
+   Its size is bounded by the cache limits of NeoPG::Http.  */
+std::string http_cache_dir(void) {
+  if (!opt.homedir_cache) return std::string();
+
+  char *dname = make_filename(opt.homedir_cache, "http.d", NULL);
+  std::string result(dname);
+  xfree(dname);
+  return result;
+}
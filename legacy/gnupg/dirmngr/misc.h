@@ -65,4 +65,9 @@ gpg_error_t create_estream_ksba_reader(ksba_reader_t *r_reader, estream_t fp);
    responsible for freeing *R_STRING.  */
 gpg_error_t armor_data(char **r_string, const void *data, size_t datalen);
 
+/* Return the directory for cached HTTP responses, which lives next to
+   the CRL cache, or an empty string if there is no cache directory.
+   Its size is bounded by the cache limits of NeoPG::Http.  */
+std::string http_cache_dir(void);
+
 #endif /* MISC_H */
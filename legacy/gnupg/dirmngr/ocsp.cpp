@@ -23,6 +23,14 @@
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
 
 #include <neopg/http.h>
 
@@ -35,6 +43,48 @@
 /* The maximum size we allow as a response from an OCSP reponder. */
 #define MAX_RESPONSE_SIZE 65536
 
+/* The file with the cached OCSP responses, relative to the cache
+   directory, and the version of its format.  */
+#define OCSP_CACHE_FILE "ocsp-cache.txt"
+#define OCSP_CACHE_VERSION 1
+
+/* The fraction of a response's lifetime at the end of which a fresh
+   response is fetched in the background.  */
+#define OCSP_PREFETCH_FRACTION 4
+
+/* The verified status of one certificate as returned by an OCSP
+   responder.  */
+struct ocsp_answer_s {
+  std::string url; /* The responder which gave the answer.  */
+  ksba_status_t status{KSBA_STATUS_NONE};
+  ksba_crl_reason_t reason{0};
+  ksba_isotime_t this_update{};
+  ksba_isotime_t next_update{};
+  ksba_isotime_t revocation_time{};
+  /* Fingerprint of the responder certificate if the client has to
+     check it (see validate_responder_cert), or empty.  */
+  std::string responder;
+
+  /* Only used for cached answers.  */
+  time_t expires{0};      /* The answer must not be used after this.  */
+  time_t refresh{0};      /* Prefetch a fresh answer after this.  */
+  bool refreshing{false}; /* A prefetch is running.  */
+};
+
+/* The OCSP response cache.  It maps the CertID, that is the issuer's
+   fingerprint and the serial number, to the last verified answer, so
+   that repeated checks of the same certificate need neither network
+   access nor a signature verification.  The cache is kept in
+   OCSP_CACHE_FILE and shared with other dirmngr processes.  */
+static std::map<std::string, ocsp_answer_s> ocsp_cache;
+static bool ocsp_cache_loaded;
+static std::mutex ocsp_cache_lock;
+
+/* The number of running prefetch threads, protected by
+   ocsp_cache_lock.  */
+static unsigned int ocsp_prefetch_active;
+static std::condition_variable ocsp_prefetch_done;
+
 static const char oidstr_ocsp[] = "1.3.6.1.5.5.7.48.1";
 
 /* Telesec attribute used to implement a positive confirmation.
@@ -236,7 +286,8 @@ static gpg_error_t do_ocsp_request(ctrl_t ctrl, ksba_ocsp_t ocsp,
    SIGNER_FPR_LIST is not NULL we simply check that CERT matches one
    of the fingerprints in this list. */
 static gpg_error_t validate_responder_cert(ctrl_t ctrl, ksba_cert_t cert,
-                                           fingerprint_list_t signer_fpr_list) {
+                                           fingerprint_list_t signer_fpr_list,
+                                           std::string *r_responder) {
   gpg_error_t err;
   char *fpr;
 
@@ -271,6 +322,7 @@ static gpg_error_t validate_responder_cert(ctrl_t ctrl, ksba_cert_t cert,
        all. */
     fpr = get_fingerprint_hexstring(cert);
     dirmngr_status(ctrl, "ONLY_VALID_IF_CERT_VALID", fpr, NULL);
+    *r_responder = fpr;
     xfree(fpr);
     err = 0;
   }
@@ -281,7 +333,8 @@ static gpg_error_t validate_responder_cert(ctrl_t ctrl, ksba_cert_t cert,
 /* Helper for check_signature. */
 static int check_signature_core(ctrl_t ctrl, ksba_cert_t cert,
                                 gcry_sexp_t s_sig, gcry_sexp_t s_hash,
-                                fingerprint_list_t signer_fpr_list) {
+                                fingerprint_list_t signer_fpr_list,
+                                std::string *r_responder) {
   gpg_error_t err;
   ksba_sexp_t pubkey;
   gcry_sexp_t s_pkey = NULL;
@@ -293,7 +346,8 @@ static int check_signature_core(ctrl_t ctrl, ksba_cert_t cert,
     err = canon_sexp_to_gcry(pubkey, &s_pkey);
   xfree(pubkey);
   if (!err) err = gcry_pk_verify(s_sig, s_hash, s_pkey);
-  if (!err) err = validate_responder_cert(ctrl, cert, signer_fpr_list);
+  if (!err)
+    err = validate_responder_cert(ctrl, cert, signer_fpr_list, r_responder);
   if (!err) {
     gcry_sexp_release(s_pkey);
     return 0; /* Successfully verified the signature. */
@@ -309,10 +363,12 @@ static int check_signature_core(ctrl_t ctrl, ksba_cert_t cert,
    the response.  This function automagically finds the correct public
    key.  If SIGNER_FPR_LIST is not NULL, the default OCSP reponder has been
    used and thus the certificate is one of those identified by
-   the fingerprints. */
+   the fingerprints.  The fingerprint of a responder certificate which
+   the client needs to check is stored at R_RESPONDER. */
 static gpg_error_t check_signature(ctrl_t ctrl, ksba_ocsp_t ocsp,
                                    gcry_sexp_t s_sig, gcry_md_hd_t md,
-                                   fingerprint_list_t signer_fpr_list) {
+                                   fingerprint_list_t signer_fpr_list,
+                                   std::string *r_responder) {
   gpg_error_t err;
   int algo, cert_idx;
   gcry_sexp_t s_hash;
@@ -342,7 +398,8 @@ static gpg_error_t check_signature(ctrl_t ctrl, ksba_ocsp_t ocsp,
     cert = get_cert_byhexfpr(signer_fpr_list->hexfpr);
     if (!cert) cert = get_cert_local(ctrl, signer_fpr_list->hexfpr);
     if (cert) {
-      err = check_signature_core(ctrl, cert, s_sig, s_hash, signer_fpr_list);
+      err = check_signature_core(ctrl, cert, s_sig, s_hash, signer_fpr_list,
+                                 r_responder);
       ksba_cert_release(cert);
       cert = NULL;
       if (!err) {
@@ -392,7 +449,8 @@ static gpg_error_t check_signature(ctrl_t ctrl, ksba_ocsp_t ocsp,
     ksba_free(keyid);
 
     if (cert) {
-      err = check_signature_core(ctrl, cert, s_sig, s_hash, signer_fpr_list);
+      err = check_signature_core(ctrl, cert, s_sig, s_hash, signer_fpr_list,
+                                 r_responder);
       ksba_cert_release(cert);
       if (!err) {
         gcry_sexp_release(s_hash);
@@ -406,29 +464,435 @@ static gpg_error_t check_signature(ctrl_t ctrl, ksba_ocsp_t ocsp,
   return GPG_ERR_NO_PUBKEY;
 }
 
+/* Ask the OCSP responder at URL for the status of CERT, check the
+   signature of the response and store the result at ANSWER.  The
+   times in the answer are not checked here.  */
+static gpg_error_t ocsp_query(ctrl_t ctrl, ksba_cert_t cert,
+                              ksba_cert_t issuer_cert, const char *url,
+                              fingerprint_list_t default_signer,
+                              ocsp_answer_s *answer) {
+  gpg_error_t err;
+  ksba_ocsp_t ocsp = NULL;
+  ksba_sexp_t sigval = NULL;
+  gcry_sexp_t s_sig = NULL;
+  ksba_isotime_t produced_at;
+  gcry_md_hd_t md = NULL;
+
+  answer->url = url;
+  answer->responder.clear();
+
+  /* Create an OCSP instance.  */
+  err = ksba_ocsp_new(&ocsp);
+  if (err) {
+    log_error(_("failed to allocate OCSP context: %s\n"), gpg_strerror(err));
+    goto leave;
+  }
+
+  /* Ask the OCSP responder. */
+  err = gcry_md_open(&md, GCRY_MD_SHA1, 0);
+  if (err) {
+    log_error(_("failed to establish a hashing context for OCSP: %s\n"),
+              gpg_strerror(err));
+    goto leave;
+  }
+  err = do_ocsp_request(ctrl, ocsp, md, url, cert, issuer_cert);
+  if (err) goto leave;
+
+  /* We got a useful answer, check that the answer has a valid signature. */
+  sigval = ksba_ocsp_get_sig_val(ocsp, produced_at);
+  if (!sigval || !*produced_at) {
+    err = GPG_ERR_INV_OBJ;
+    goto leave;
+  }
+  if ((err = canon_sexp_to_gcry(sigval, &s_sig))) goto leave;
+  xfree(sigval);
+  sigval = NULL;
+  err = check_signature(ctrl, ocsp, s_sig, md, default_signer,
+                        &answer->responder);
+  if (err) goto leave;
+
+  /* We only support one certificate per request.  Check that the
+     answer matches the right certificate. */
+  err = ksba_ocsp_get_status(ocsp, cert, &answer->status, answer->this_update,
+                             answer->next_update, answer->revocation_time,
+                             &answer->reason);
+  if (err) {
+    log_error(_("error getting OCSP status for target certificate: %s\n"),
+              gpg_strerror(err));
+    goto leave;
+  }
+
+leave:
+  gcry_md_close(md);
+  gcry_sexp_release(s_sig);
+  xfree(sigval);
+  ksba_ocsp_release(ocsp);
+  return err;
+}
+
+/* Check that the times in ANSWER are current.  */
+static gpg_error_t ocsp_check_times(const ocsp_answer_s *answer) {
+  gpg_error_t err = 0;
+  ksba_isotime_t current_time;
+  ksba_isotime_t tmp_time;
+
+  /* Allow for some clock skew. */
+  gnupg_get_isotime(current_time);
+  add_seconds_to_isotime(current_time, opt.ocsp_max_clock_skew);
+
+  if (strcmp(answer->this_update, current_time) > 0) {
+    log_error(_("OCSP responder returned a status in the future\n"));
+    log_info("used now: %s  this_update: %s\n", current_time,
+             answer->this_update);
+    if (!err) err = GPG_ERR_TIME_CONFLICT;
+  }
+
+  /* Check that THIS_UPDATE is not too far back in the past. */
+  gnupg_copy_time(tmp_time, answer->this_update);
+  add_seconds_to_isotime(tmp_time,
+                         opt.ocsp_max_period + opt.ocsp_max_clock_skew);
+  if (!*tmp_time || strcmp(tmp_time, current_time) < 0) {
+    log_error(_("OCSP responder returned a non-current status\n"));
+    log_info("used now: %s  this_update: %s\n", current_time,
+             answer->this_update);
+    if (!err) err = GPG_ERR_TIME_CONFLICT;
+  }
+
+  /* Check that we are not beyound NEXT_UPDATE  (plus some extra time). */
+  if (*answer->next_update) {
+    gnupg_copy_time(tmp_time, answer->next_update);
+    add_seconds_to_isotime(tmp_time,
+                           opt.ocsp_current_period + opt.ocsp_max_clock_skew);
+    if (!*tmp_time || strcmp(tmp_time, current_time) < 0) {
+      log_error(_("OCSP responder returned an too old status\n"));
+      log_info("used now: %s  next_update: %s\n", current_time,
+               answer->next_update);
+      if (!err) err = GPG_ERR_TIME_CONFLICT;
+    }
+  }
+
+  return err;
+}
+
+/* Return the cache key for CERT issued by ISSUER_CERT.  Like the
+   CertID of an OCSP request, it is made up of the issuer and the
+   serial number.  Returns an empty string on error.  */
+static std::string ocsp_cache_key(ksba_cert_t cert, ksba_cert_t issuer_cert) {
+  std::string key;
+  char *fpr = get_fingerprint_hexstring(issuer_cert);
+  ksba_sexp_t serial = ksba_cert_get_serial(cert);
+  char *serialstr = serial ? serial_hex(serial) : NULL;
+
+  if (fpr && serialstr) key = std::string(fpr) + "." + serialstr;
+  xfree(serialstr);
+  ksba_free(serial);
+  xfree(fpr);
+  return key;
+}
+
+/* Compute when ANSWER expires and when it should be refreshed.  An
+   answer is not used beyond its nextUpdate time nor after the maximum
+   period allowed for a response.  Returns false if the times are
+   not usable.  */
+static bool ocsp_answer_set_lifetime(ocsp_answer_s *answer) {
+  time_t this_update, next_update;
+
+  this_update = isotime2epoch(answer->this_update);
+  if (this_update == (time_t)(-1)) return false;
+  answer->expires = this_update + opt.ocsp_max_period;
+  if (*answer->next_update) {
+    next_update = isotime2epoch(answer->next_update);
+    if (next_update == (time_t)(-1)) return false;
+    if (next_update < answer->expires) answer->expires = next_update;
+  }
+  if (answer->expires <= this_update) return false;
+
+  answer->refresh = answer->expires -
+                    (answer->expires - this_update) / OCSP_PREFETCH_FRACTION;
+  answer->refreshing = false;
+  return true;
+}
+
+/* Read the cache file FNAME and add its entries to CACHE.  Expired
+   entries are skipped.  A missing file is not an error.  */
+static void ocsp_cache_read(const char *fname,
+                            std::map<std::string, ocsp_answer_s> &cache) {
+  estream_t fp;
+  char *line = NULL;
+  size_t maxlen = 0;
+  ssize_t len;
+  unsigned int lineno = 0;
+  time_t now = gnupg_get_time();
+
+  fp = es_fopen(fname, "r");
+  if (!fp) {
+    if (errno != ENOENT)
+      log_error(_("error opening '%s': %s\n"), fname, strerror(errno));
+    return;
+  }
+
+  while ((len = es_read_line(fp, &line, &maxlen, NULL)) > 0) {
+    char *fields[9];
+    char *p = line;
+    int i;
+    ocsp_answer_s answer;
+
+    lineno++;
+    if (line[len - 1] == '\n') line[--len] = 0;
+    if (*line == '#' || !*line) continue;
+    if (*line == 'v') {
+      if (atoi(line + 2) != OCSP_CACHE_VERSION) {
+        log_info(_("ignoring '%s': unknown version\n"), fname);
+        break;
+      }
+      continue;
+    }
+
+    /* c:KEY:STATUS:REASON:THIS_UPDATE:NEXT_UPDATE:REVOCATION:RESPONDER:URL */
+    for (i = 0; i < 8 && p; i++) {
+      fields[i] = p;
+      p = strchr(p, ':');
+      if (p) *p++ = 0;
+    }
+    fields[8] = p;
+    if (!p || strcmp(fields[0], "c") || !*fields[1] ||
+        (strcmp(fields[2], "g") && strcmp(fields[2], "r")) ||
+        strlen(fields[4]) >= sizeof(ksba_isotime_t) ||
+        strlen(fields[5]) >= sizeof(ksba_isotime_t) ||
+        strlen(fields[6]) >= sizeof(ksba_isotime_t)) {
+      log_info(_("%s:%u: invalid line ignored\n"), fname, lineno);
+      continue;
+    }
+
+    answer.status = *fields[2] == 'g' ? KSBA_STATUS_GOOD : KSBA_STATUS_REVOKED;
+    answer.reason = (ksba_crl_reason_t)atoi(fields[3]);
+    strcpy(answer.this_update, fields[4]);
+    strcpy(answer.next_update, fields[5]);
+    strcpy(answer.revocation_time, fields[6]);
+    answer.responder = fields[7];
+    answer.url = fields[8];
+    if (ocsp_answer_set_lifetime(&answer) && answer.expires > now)
+      cache[fields[1]] = answer;
+  }
+  if (len < 0)
+    log_error(_("error reading '%s': %s\n"), fname, strerror(errno));
+  xfree(line);
+  es_fclose(fp);
+}
+
+/* Load the cache file on first use.  Must be called with
+   ocsp_cache_lock held.  */
+static void ocsp_cache_load(void) {
+  char *fname;
+
+  if (ocsp_cache_loaded || !opt.homedir_cache) return;
+  ocsp_cache_loaded = true;
+
+  fname = make_filename(opt.homedir_cache, OCSP_CACHE_FILE, NULL);
+  ocsp_cache_read(fname, ocsp_cache);
+  xfree(fname);
+}
+
+/* Write the cache back to its file.  Answers stored by other dirmngr
+   processes in the meantime are merged in.  Must be called with
+   ocsp_cache_lock held.  */
+static void ocsp_cache_write(void) {
+  gpg_error_t err = 0;
+  char *fname;
+  char *tmpfname = NULL;
+  estream_t fp;
+  std::map<std::string, ocsp_answer_s> others;
+  time_t now = gnupg_get_time();
+
+  if (!opt.homedir_cache) return;
+  fname = make_filename(opt.homedir_cache, OCSP_CACHE_FILE, NULL);
+
+  ocsp_cache_read(fname, others);
+  for (auto &item : others) {
+    auto it = ocsp_cache.find(item.first);
+    if (it == ocsp_cache.end())
+      ocsp_cache.insert(item);
+    else if (strcmp(it->second.this_update, item.second.this_update) < 0) {
+      bool refreshing = it->second.refreshing;
+      it->second = item.second;
+      it->second.refreshing = refreshing;
+    }
+  }
+
+  gpgrt_asprintf(&tmpfname, "%s-%u.tmp", fname, (unsigned int)getpid());
+  fp = tmpfname ? es_fopen(tmpfname, "w") : NULL;
+  if (!fp) {
+    log_error(_("error creating '%s': %s\n"), tmpfname ? tmpfname : fname,
+              strerror(errno));
+    goto leave;
+  }
+
+  es_fprintf(fp, "# OCSP response cache - do not edit\nv:%d\n",
+             OCSP_CACHE_VERSION);
+  for (auto it = ocsp_cache.begin(); it != ocsp_cache.end();) {
+    const ocsp_answer_s &answer = it->second;
+
+    if (answer.expires <= now) {
+      it = ocsp_cache.erase(it);
+      continue;
+    }
+    if (answer.url.find('\n') == std::string::npos)
+      es_fprintf(fp, "c:%s:%c:%d:%s:%s:%s:%s:%s\n", it->first.c_str(),
+                 answer.status == KSBA_STATUS_GOOD ? 'g' : 'r',
+                 (int)answer.reason, answer.this_update, answer.next_update,
+                 answer.revocation_time, answer.responder.c_str(),
+                 answer.url.c_str());
+    ++it;
+  }
+
+  if (es_ferror(fp)) err = gpg_error_from_syserror();
+  if (es_fclose(fp) && !err) err = gpg_error_from_syserror();
+  if (!err && rename(tmpfname, fname)) err = gpg_error_from_syserror();
+  if (err) {
+    log_error(_("error writing '%s': %s\n"), fname, gpg_strerror(err));
+    gnupg_remove(tmpfname);
+  }
+
+leave:
+  xfree(tmpfname);
+  xfree(fname);
+}
+
+/* Look up the cached answer for KEY from the responder URL and store
+   it at ANSWER.  Returns false if there is none which may still be
+   used.  If the answer is about to expire and no prefetch is running
+   for it, *R_PREFETCH is set and the caller shall start one.  */
+static bool ocsp_cache_get(const std::string &key, const char *url,
+                           ocsp_answer_s *answer, bool *r_prefetch) {
+  std::lock_guard<std::mutex> lock(ocsp_cache_lock);
+  time_t now = gnupg_get_time();
+
+  *r_prefetch = false;
+  ocsp_cache_load();
+
+  auto it = ocsp_cache.find(key);
+  if (it == ocsp_cache.end() || it->second.url != url ||
+      it->second.expires <= now)
+    return false;
+
+  if (now >= it->second.refresh && !it->second.refreshing) {
+    it->second.refreshing = true;
+    *r_prefetch = true;
+  }
+  *answer = it->second;
+  return true;
+}
+
+/* Store ANSWER for KEY in the cache.  Only good and revoked answers
+   are kept; any other status removes an existing entry.  */
+static void ocsp_cache_put(const std::string &key, ocsp_answer_s answer) {
+  std::lock_guard<std::mutex> lock(ocsp_cache_lock);
+
+  ocsp_cache_load();
+  if ((answer.status == KSBA_STATUS_GOOD ||
+       answer.status == KSBA_STATUS_REVOKED) &&
+      ocsp_answer_set_lifetime(&answer))
+    ocsp_cache[key] = answer;
+  else if (!ocsp_cache.erase(key))
+    return;
+  ocsp_cache_write();
+}
+
+/* Account for the end of a prefetch for KEY.  If it failed, the next
+   attempt is delayed to half of the remaining lifetime.  */
+static void ocsp_prefetch_finish(const std::string &key, bool success) {
+  std::lock_guard<std::mutex> lock(ocsp_cache_lock);
+
+  if (!success) {
+    auto it = ocsp_cache.find(key);
+    if (it != ocsp_cache.end()) {
+      time_t now = gnupg_get_time();
+      it->second.refreshing = false;
+      if (it->second.expires > now)
+        it->second.refresh = now + (it->second.expires - now) / 2;
+    }
+  }
+
+  ocsp_prefetch_active--;
+  ocsp_prefetch_done.notify_all();
+}
+
+/* The thread function fetching a fresh answer for the cache entry
+   KEY.  This runs without a client connection, so nothing can be
+   inquired from the client.  Takes ownership of the certificate
+   references.  */
+static void ocsp_prefetch_run(std::string key, std::string url,
+                              ksba_cert_t cert, ksba_cert_t issuer_cert,
+                              fingerprint_list_t default_signer) {
+  struct server_control_s ctrlbuf;
+  ocsp_answer_s answer;
+  gpg_error_t err;
+
+  memset(&ctrlbuf, 0, sizeof ctrlbuf);
+  dirmngr_init_default_ctrl(&ctrlbuf);
+
+  err = ocsp_query(&ctrlbuf, cert, issuer_cert, url.c_str(), default_signer,
+                   &answer);
+  if (!err) err = ocsp_check_times(&answer);
+  if (!err)
+    ocsp_cache_put(key, answer);
+  else if (opt.verbose)
+    log_info(_("prefetching OCSP response from '%s' failed: %s\n"),
+             url.c_str(), gpg_strerror(err));
+
+  release_ctrl_ocsp_certs(&ctrlbuf);
+  dirmngr_deinit_default_ctrl(&ctrlbuf);
+  ksba_cert_release(cert);
+  ksba_cert_release(issuer_cert);
+  ocsp_prefetch_finish(key, !err);
+}
+
+/* Start fetching a fresh answer for the cache entry KEY in the
+   background.  */
+static void ocsp_prefetch(const std::string &key, const char *url,
+                          ksba_cert_t cert, ksba_cert_t issuer_cert,
+                          fingerprint_list_t default_signer) {
+  {
+    std::lock_guard<std::mutex> lock(ocsp_cache_lock);
+    ocsp_prefetch_active++;
+  }
+
+  ksba_cert_ref(cert);
+  ksba_cert_ref(issuer_cert);
+  try {
+    std::thread(ocsp_prefetch_run, key, std::string(url), cert, issuer_cert,
+                default_signer)
+        .detach();
+  } catch (const std::system_error &e) {
+    log_error("error starting OCSP prefetch thread: %s\n", e.what());
+    ksba_cert_release(cert);
+    ksba_cert_release(issuer_cert);
+    ocsp_prefetch_finish(key, false);
+  }
+}
+
 /* Check whether the certificate either given by fingerprint CERT_FPR
    or directly through the CERT object is valid by running an OCSP
    transaction.  With FORCE_DEFAULT_RESPONDER set only the configured
-   default responder is used. */
+   default responder is used.  A cached answer from the same responder
+   is used as long as it is current. */
 gpg_error_t ocsp_isvalid(ctrl_t ctrl, ksba_cert_t cert, const char *cert_fpr,
                          int force_default_responder) {
   gpg_error_t err;
-  ksba_ocsp_t ocsp = NULL;
+  gpg_error_t time_err = 0;
   ksba_cert_t issuer_cert = NULL;
-  ksba_sexp_t sigval = NULL;
-  gcry_sexp_t s_sig = NULL;
-  ksba_isotime_t current_time;
-  ksba_isotime_t this_update, next_update, revocation_time, produced_at;
-  ksba_isotime_t tmp_time;
+  ocsp_answer_s answer;
+  ksba_isotime_t this_update, next_update, revocation_time;
   ksba_status_t status;
   ksba_crl_reason_t reason;
   char *url_buffer = NULL;
   const char *url;
-  gcry_md_hd_t md = NULL;
   int i, idx;
   char *oid;
   ksba_name_t name;
   fingerprint_list_t default_signer = NULL;
+  std::string cache_key;
+  bool prefetch;
 
   /* Get the certificate.  */
   if (cert) {
@@ -454,13 +918,6 @@ gpg_error_t ocsp_isvalid(ctrl_t ctrl, ksba_cert_t cert, const char *cert_fpr,
     }
   }
 
-  /* Create an OCSP instance.  */
-  err = ksba_ocsp_new(&ocsp);
-  if (err) {
-    log_error(_("failed to allocate OCSP context: %s\n"), gpg_strerror(err));
-    goto leave;
-  }
-
   /* Figure out the OCSP responder to use.
      1. Try to get the reponder from the certificate.
         We do only take http and https style URIs into account.
@@ -506,37 +963,31 @@ gpg_error_t ocsp_isvalid(ctrl_t ctrl, ksba_cert_t cert, const char *cert_fpr,
     if (opt.verbose) log_info(_("using OCSP responder '%s'\n"), url);
   }
 
-  /* Ask the OCSP responder. */
-  err = gcry_md_open(&md, GCRY_MD_SHA1, 0);
-  if (err) {
-    log_error(_("failed to establish a hashing context for OCSP: %s\n"),
-              gpg_strerror(err));
-    goto leave;
-  }
-  err = do_ocsp_request(ctrl, ocsp, md, url, cert, issuer_cert);
-  if (err) goto leave;
-
-  /* We got a useful answer, check that the answer has a valid signature. */
-  sigval = ksba_ocsp_get_sig_val(ocsp, produced_at);
-  if (!sigval || !*produced_at) {
-    err = GPG_ERR_INV_OBJ;
-    goto leave;
+  /* Use a cached answer if possible.  Otherwise ask the responder and
+     remember a current answer.  */
+  err = 0;
+  cache_key = ocsp_cache_key(cert, issuer_cert);
+  if (!cache_key.empty() &&
+      ocsp_cache_get(cache_key, url, &answer, &prefetch)) {
+    if (opt.verbose)
+      log_info(_("using cached OCSP response from '%s'\n"), url);
+    if (!answer.responder.empty())
+      dirmngr_status(ctrl, "ONLY_VALID_IF_CERT_VALID",
+                     answer.responder.c_str(), NULL);
+    if (prefetch)
+      ocsp_prefetch(cache_key, url, cert, issuer_cert, default_signer);
+  } else {
+    err = ocsp_query(ctrl, cert, issuer_cert, url, default_signer, &answer);
+    if (err) goto leave;
+    time_err = ocsp_check_times(&answer);
+    if (!time_err && !cache_key.empty()) ocsp_cache_put(cache_key, answer);
   }
-  if ((err = canon_sexp_to_gcry(sigval, &s_sig))) goto leave;
-  xfree(sigval);
-  sigval = NULL;
-  err = check_signature(ctrl, ocsp, s_sig, md, default_signer);
-  if (err) goto leave;
 
-  /* We only support one certificate per request.  Check that the
-     answer matches the right certificate. */
-  err = ksba_ocsp_get_status(ocsp, cert, &status, this_update, next_update,
-                             revocation_time, &reason);
-  if (err) {
-    log_error(_("error getting OCSP status for target certificate: %s\n"),
-              gpg_strerror(err));
-    goto leave;
-  }
+  status = answer.status;
+  reason = answer.reason;
+  gnupg_copy_time(this_update, answer.this_update);
+  gnupg_copy_time(next_update, answer.next_update);
+  gnupg_copy_time(revocation_time, answer.revocation_time);
 
   /* In case the certificate has been revoked, we better invalidate
      our cached validation status. */
@@ -609,45 +1060,11 @@ gpg_error_t ocsp_isvalid(ctrl_t ctrl, ksba_cert_t cert, const char *cert_fpr,
   else if (status != KSBA_STATUS_GOOD)
     err = GPG_ERR_GENERAL;
 
-  /* Allow for some clock skew. */
-  gnupg_get_isotime(current_time);
-  add_seconds_to_isotime(current_time, opt.ocsp_max_clock_skew);
-
-  if (strcmp(this_update, current_time) > 0) {
-    log_error(_("OCSP responder returned a status in the future\n"));
-    log_info("used now: %s  this_update: %s\n", current_time, this_update);
-    if (!err) err = GPG_ERR_TIME_CONFLICT;
-  }
-
-  /* Check that THIS_UPDATE is not too far back in the past. */
-  gnupg_copy_time(tmp_time, this_update);
-  add_seconds_to_isotime(tmp_time,
-                         opt.ocsp_max_period + opt.ocsp_max_clock_skew);
-  if (!*tmp_time || strcmp(tmp_time, current_time) < 0) {
-    log_error(_("OCSP responder returned a non-current status\n"));
-    log_info("used now: %s  this_update: %s\n", current_time, this_update);
-    if (!err) err = GPG_ERR_TIME_CONFLICT;
-  }
-
-  /* Check that we are not beyound NEXT_UPDATE  (plus some extra time). */
-  if (*next_update) {
-    gnupg_copy_time(tmp_time, next_update);
-    add_seconds_to_isotime(tmp_time,
-                           opt.ocsp_current_period + opt.ocsp_max_clock_skew);
-    if (!*tmp_time && strcmp(tmp_time, current_time) < 0) {
-      log_error(_("OCSP responder returned an too old status\n"));
-      log_info("used now: %s  next_update: %s\n", current_time, next_update);
-      if (!err) err = GPG_ERR_TIME_CONFLICT;
-    }
-  }
+  if (!err) err = time_err;
 
 leave:
-  gcry_md_close(md);
-  gcry_sexp_release(s_sig);
-  xfree(sigval);
   ksba_cert_release(issuer_cert);
   ksba_cert_release(cert);
-  ksba_ocsp_release(ocsp);
   xfree(url_buffer);
   return err;
 }
@@ -660,3 +1077,29 @@ void release_ctrl_ocsp_certs(ctrl_t ctrl) {
     ctrl->ocsp_certs = tmp;
   }
 }
+
+/* Remove all cached OCSP responses.  */
+gpg_error_t ocsp_cache_flush(void) {
+  gpg_error_t err = 0;
+  char *fname;
+  std::lock_guard<std::mutex> lock(ocsp_cache_lock);
+
+  ocsp_cache.clear();
+  ocsp_cache_loaded = true;
+  if (!opt.homedir_cache) return 0;
+
+  fname = make_filename(opt.homedir_cache, OCSP_CACHE_FILE, NULL);
+  if (gnupg_remove(fname) && errno != ENOENT) {
+    err = gpg_error_from_syserror();
+    log_error(_("failed to remove '%s': %s\n"), fname, gpg_strerror(err));
+  }
+  xfree(fname);
+  return err;
+}
+
+/* Wait for the background prefetches to finish.  */
+void ocsp_cache_deinit(void) {
+  std::unique_lock<std::mutex> lock(ocsp_cache_lock);
+
+  ocsp_prefetch_done.wait(lock, [] { return ocsp_prefetch_active == 0; });
+}
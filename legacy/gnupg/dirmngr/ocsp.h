@@ -28,4 +28,10 @@ gpg_error_t ocsp_isvalid(ctrl_t ctrl, ksba_cert_t cert, const char *cert_fpr,
 /* Release the list of OCSP certificates hold in the CTRL object. */
 void release_ctrl_ocsp_certs(ctrl_t ctrl);
 
+/* Remove all cached OCSP responses.  */
+gpg_error_t ocsp_cache_flush(void);
+
+/* Wait for the background prefetches to finish.  */
+void ocsp_cache_deinit(void);
+
 #endif /*OCSP_H*/
@@ -34,6 +34,7 @@
 #include <botan/hash.h>
 #include <botan/hex.h>
 #include <sstream>
+#include <string>
 
 #include <assuan.h>
 #include "dirmngr.h"
@@ -1338,15 +1339,20 @@ static int register_commands(assuan_context_t ctx) {
   return 0;
 }
 
-/* Startup the server and run the main command loop.  With FD = -1,
-   use stdin/stdout. */
-void start_command_handler() {
+/* Startup the server and run the main command loop.  With FD =
+   ASSUAN_INVALID_FD, use stdin/stdout, otherwise serve the connected
+   socket FD, which is closed on return.  In the latter case this runs
+   on a worker thread of the daemon, so errors only end this
+   connection.  */
+void start_command_handler(assuan_fd_t fd) {
   static const char hello[] = "Dirmngr " VERSION " at your service";
-  static char *hello_line;
+  std::string hello_line;
   int rc;
   assuan_context_t ctx;
   ctrl_t ctrl;
   assuan_fd_t filedes[2];
+  /* Until the assuan context takes it over.  */
+  assuan_fd_t close_fd = fd;
 
   ctrl = (ctrl_t)xtrycalloc(1, sizeof *ctrl);
   if (ctrl)
@@ -1355,6 +1361,7 @@ void start_command_handler() {
   if (!ctrl || !ctrl->server_local) {
     log_error(_("can't allocate control structure: %s\n"), strerror(errno));
     xfree(ctrl);
+    if (close_fd != ASSUAN_INVALID_FD) close(close_fd);
     return;
   }
 
@@ -1363,38 +1370,37 @@ void start_command_handler() {
   rc = assuan_new(&ctx);
   if (rc) {
     log_error(_("failed to allocate assuan context: %s\n"), gpg_strerror(rc));
-    dirmngr_exit(2);
+    if (fd == ASSUAN_INVALID_FD) dirmngr_exit(2);
+    goto leave;
   }
 
-  filedes[0] = assuan_fdopen(0);
-  filedes[1] = assuan_fdopen(1);
+  if (fd == ASSUAN_INVALID_FD) {
+    filedes[0] = assuan_fdopen(0);
+    filedes[1] = assuan_fdopen(1);
+  } else {
+    filedes[0] = fd;
+    filedes[1] = fd;
+  }
   rc = assuan_init_pipe_server(ctx, filedes);
+  if (!rc) {
+    close_fd = ASSUAN_INVALID_FD; /* Closed by assuan_release.  */
+    rc = register_commands(ctx);
+  }
   if (rc) {
     assuan_release(ctx);
     log_error(_("failed to initialize the server: %s\n"), gpg_strerror(rc));
-    dirmngr_exit(2);
-  }
-
-  rc = register_commands(ctx);
-  if (rc) {
-    log_error(_("failed to the register commands with Assuan: %s\n"),
-              gpg_strerror(rc));
-    dirmngr_exit(2);
+    if (fd == ASSUAN_INVALID_FD) dirmngr_exit(2);
+    goto leave;
   }
 
-  if (!hello_line) {
-    hello_line = xtryasprintf(
-        "Home: %s\n"
-        "Config: %s\n"
-        "%s",
-        gnupg_homedir(), opt.config_filename ? opt.config_filename : "[none]",
-        hello);
-  }
+  hello_line = std::string("Home: ") + gnupg_homedir() + "\nConfig: " +
+               (opt.config_filename ? opt.config_filename : "[none]") + "\n" +
+               hello;
 
   ctrl->server_local->assuan_ctx = ctx;
   assuan_set_pointer(ctx, ctrl);
 
-  assuan_set_hello_line(ctx, hello_line);
+  assuan_set_hello_line(ctx, hello_line.c_str());
   assuan_register_option_handler(ctx, option_handler);
 
   for (;;) {
@@ -1417,8 +1423,10 @@ void start_command_handler() {
   ctrl->server_local->assuan_ctx = NULL;
   assuan_release(ctx);
 
-  if (ctrl->server_local->stopme) dirmngr_exit(0);
+  if (ctrl->server_local->stopme && fd == ASSUAN_INVALID_FD) dirmngr_exit(0);
 
+leave:
+  if (close_fd != ASSUAN_INVALID_FD) close(close_fd);
   release_ctrl_ocsp_certs(ctrl);
   xfree(ctrl->server_local);
   dirmngr_deinit_default_ctrl(ctrl);
@@ -39,14 +39,7 @@
 
 #define MAX_LINELEN 20000
 
-#define CRCINIT 0xB704CE
-#define CRCPOLY 0X864CFB
-#define CRCUPDATE(a, c)                                 \
-  do {                                                  \
-    a = ((a) << 8) ^ crc_table[((a)&0xff >> 16) ^ (c)]; \
-    a &= 0x00ffffff;                                    \
-  } while (0)
-static u32 crc_table[256];
+#define CRCINIT GCRY_CRC24_INIT
 static byte bintoasc[] =
     "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
     "abcdefghijklmnopqrstuvwxyz"
@@ -138,24 +131,9 @@ int push_armor_filter(armor_filter_context_t *afx, iobuf_t iobuf) {
 }
 
 static void initialize(void) {
-  int i, j;
-  u32 t;
+  int i;
   byte *s;
 
-  /* init the crc lookup table */
-  crc_table[0] = 0;
-  for (i = j = 0; j < 128; j++) {
-    t = crc_table[j];
-    if (t & 0x00800000) {
-      t <<= 1;
-      crc_table[i++] = t ^ CRCPOLY;
-      crc_table[i++] = t;
-    } else {
-      t <<= 1;
-      crc_table[i++] = t;
-      crc_table[i++] = t ^ CRCPOLY;
-    }
-  }
   /* build the helptable for radix64 to bin conversion */
   for (i = 0; i < 256; i++)
     asctobin[i] = 255; /* used to detect invalid characters */
@@ -670,7 +648,7 @@ static int radix64_read(armor_filter_context_t *afx, IOBUF a, size_t *retn,
   int checkcrc = 0;
   int rc = 0;
   size_t n = 0;
-  int idx, i, onlypad = 0;
+  int idx, onlypad = 0;
   u32 crc;
 
   crc = afx->crc;
@@ -759,9 +737,7 @@ static int radix64_read(armor_filter_context_t *afx, IOBUF a, size_t *retn,
     idx = (idx + 1) % 4;
   }
 
-  for (i = 0; i < n; i++)
-    crc = (crc << 8) ^ crc_table[((crc >> 16) & 0xff) ^ buf[i]];
-  crc &= 0x00ffffff;
+  crc = gcry_crc24_update(crc, buf, n);
   afx->crc = crc;
   afx->idx = idx;
   afx->radbuf[0] = val;
@@ -1010,9 +986,7 @@ static int armor_filter(void *opaque, int control, IOBUF a, byte *buf,
     idx2 = afx->idx2;
     for (i = 0; i < idx; i++) radbuf[i] = afx->radbuf[i];
 
-    for (i = 0; i < size; i++)
-      crc = (crc << 8) ^ crc_table[((crc >> 16) & 0xff) ^ buf[i]];
-    crc &= 0x00ffffff;
+    crc = gcry_crc24_update(crc, buf, size);
 
     for (; size; buf++, size--) {
       radbuf[idx++] = *buf;
@@ -210,6 +210,7 @@ enum cmd_and_opt_values {
   oCompletesNeeded,
   oMarginalsNeeded,
   oMaxCertDepth,
+  oWotThreads,
   oCompliance,
   oGnuPG,
   oRFC4880,
@@ -504,6 +505,7 @@ const static ARGPARSE_OPTS opts[] = {
     ARGPARSE_s_i(oCompletesNeeded, "completes-needed", "@"),
     ARGPARSE_s_i(oMarginalsNeeded, "marginals-needed", "@"),
     ARGPARSE_s_i(oMaxCertDepth, "max-cert-depth", "@"),
+    ARGPARSE_s_i(oWotThreads, "wot-threads", "@"),
     ARGPARSE_s_s(oTrustedKey, "trusted-key", "@"),
 
     ARGPARSE_s_s(oCompliance, "compliance", "@"),
@@ -1869,6 +1871,9 @@ next_pass:
       case oMaxCertDepth:
         opt.max_cert_depth = pargs.r.ret_int;
         break;
+      case oWotThreads:
+        opt.wot_threads = pargs.r.ret_int;
+        break;
 
 #ifndef NO_TRUST_MODELS
       case oTrustDBName:
@@ -2652,6 +2657,8 @@ next_pass:
     log_error(_("marginals-needed must be greater than 1\n"));
   if (opt.max_cert_depth < 1 || opt.max_cert_depth > 255)
     log_error(_("max-cert-depth must be in the range from 1 to 255\n"));
+  if (opt.wot_threads < 0)
+    log_error(_("wot-threads must not be negative\n"));
   if (opt.def_cert_level < 0 || opt.def_cert_level > 3)
     log_error(_("invalid default-cert-level; must be 0, 1, 2, or 3\n"));
   if (opt.min_cert_level < 1 || opt.min_cert_level > 3)
@@ -3478,6 +3485,8 @@ next_pass:
 void g10_exit(int rc) {
   if (DBG_CLOCK) log_clock("stop");
 
+  sig_cache_flush();
+
   if ((opt.debug & DBG_MEMSTAT_VALUE)) {
     keydb_dump_stats();
     sig_check_dump_stats();
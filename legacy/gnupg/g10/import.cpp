@@ -1322,7 +1322,7 @@ static int import_one(ctrl_t ctrl, kbnode_t keyblock,
          importing and locally exported key. */
 
       clear_ownertrusts(ctrl, pk);
-      if (non_self) revalidation_mark(ctrl);
+      if (non_self) revalidation_mark_key(ctrl, pk);
     }
     keydb_release(hd);
 
@@ -1403,7 +1403,7 @@ static int import_one(ctrl_t ctrl, kbnode_t keyblock,
         log_error(_("error writing keyring '%s': %s\n"),
                   keydb_get_resource_name(hd), gpg_strerror(rc));
       else if (non_self)
-        revalidation_mark(ctrl);
+        revalidation_mark_key(ctrl, pk);
 
       /* We are ready.  */
       if (!opt.quiet && !silent) {
@@ -2028,7 +2028,7 @@ static int import_revoke_cert(ctrl_t ctrl, kbnode_t node,
      ultimate trust back, but is a reasonable solution for now. */
   if (get_ownertrust(ctrl, pk) == TRUST_ULTIMATE) clear_ownertrusts(ctrl, pk);
 
-  revalidation_mark(ctrl);
+  revalidation_mark_key(ctrl, pk);
 
 leave:
   keydb_release(hd);
@@ -2058,6 +2058,23 @@ static int chk_self_sigs(ctrl_t ctrl, kbnode_t keyblock, u32 *keyid,
   u32 bsdate = 0, rsdate = 0;
   kbnode_t bsnode = NULL, rsnode = NULL;
 
+  /* Verify the self-signatures in one go, so that the checks below
+     are answered from the cache.  */
+  if (!opt.no_sig_cache) {
+    std::vector<kbnode_t> roots, nodes;
+
+    for (n = keyblock; (n = find_next_kbnode(n, 0));) {
+      if (n->pkt->pkttype != PKT_SIGNATURE) continue;
+      sig = n->pkt->pkt.signature;
+      if (keyid[0] != sig->keyid[0] || keyid[1] != sig->keyid[1]) continue;
+      roots.push_back(keyblock);
+      nodes.push_back(n);
+    }
+    if (!nodes.empty())
+      check_key_signatures_mt(ctrl, roots.data(), nodes.data(), nodes.size(),
+                              1);
+  }
+
   for (n = keyblock; (n = find_next_kbnode(n, 0));) {
     if (n->pkt->pkttype == PKT_PUBLIC_SUBKEY) {
       knode = n;
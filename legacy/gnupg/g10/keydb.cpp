@@ -637,6 +637,7 @@ gpg_error_t keydb_add_resource(const char *url, unsigned int flags) {
       if (err) goto leave;
 
       err = keybox_register_file(filename, 0, &token);
+      if (!err && !read_only) sig_cache_register(filename);
       if (!err) {
         if (used_resources >= MAX_KEYDB_RESOURCES)
           err = GPG_ERR_RESOURCE_LIMIT;
@@ -1210,7 +1211,10 @@ gpg_error_t keydb_update_keyblock(ctrl_t ctrl, KEYDB_HANDLE hd, kbnode_t kb) {
   }
 
   unlock_all(hd);
-  if (!err) keydb_stats.update_keyblocks++;
+  if (!err) {
+    keydb_stats.update_keyblocks++;
+    sig_cache_forget_keyblock(kb);
+  }
   return err;
 }
 
@@ -243,6 +243,12 @@ int sign_symencrypt_file(
 /*-- sig-check.c --*/
 void sig_check_dump_stats(void);
 
+/* Functions to manage the persistent signature cache which is kept
+   next to the keybox FILENAME.  */
+void sig_cache_register(const char *filename);
+void sig_cache_forget_keyblock(kbnode_t keyblock);
+void sig_cache_flush(void);
+
 /* SIG is a revocation signature.  Check if any of PK's designated
    revokers generated it.  If so, return 0.  Note: this function
    (correctly) doesn't care if the designated revoker is revoked.  */
@@ -262,6 +268,11 @@ int check_key_signature(ctrl_t ctrl, kbnode_t root, kbnode_t sig,
 int check_key_signature2(ctrl_t ctrl, kbnode_t root, kbnode_t node,
                          PKT_public_key *check_pk, PKT_public_key *ret_pk,
                          int *is_selfsig, u32 *r_expiredate, int *r_expired);
+/* Verify a batch of key signatures using several threads and cache
+   the results in the signature packets.  See the implementation for
+   details.  */
+void check_key_signatures_mt(ctrl_t ctrl, kbnode_t *roots, kbnode_t *nodes,
+                             size_t n, int nthreads);
 
 /* Returns whether SIGNER generated the signature SIG over the packet
    PACKET, which is a key, subkey or uid, and comes from the key block
@@ -211,6 +211,9 @@ struct options {
   int marginals_needed{3};
   int completes_needed{1};
   int max_cert_depth{5};
+  /* Number of threads used to verify certifications while updating
+     the trustdb; 0 picks the number of CPUs.  */
+  int wot_threads{0};
 
   tao::optional<std::string> def_new_key_algo;
 
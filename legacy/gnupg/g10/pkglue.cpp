@@ -24,6 +24,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <vector>
+
 #include "../common/util.h"
 #include "gpg.h"
 #include "main.h"
@@ -44,16 +46,77 @@ gcry_mpi_t get_mpi_from_sexp(gcry_sexp_t sexp, const char *item, int mpifmt) {
   return data;
 }
 
-/****************
- * Emulate our old PK interface here - sometime in the future we might
- * change the internal design to directly fit to libgcrypt.
- */
-int pk_verify(pubkey_algo_t pkalgo, gcry_mpi_t hash, gcry_mpi_t *data,
-              gcry_mpi_t *pkey) {
+/* Store the EdDSA signature values DATA[0] and DATA[1] at R_R and
+ * R_S, left padded to NEEDEDFIXEDLEN bytes.  The caller must release
+ * the values which differ from those in DATA.  */
+static int eddsa_sig_values(gcry_mpi_t *data, unsigned int neededfixedlen,
+                            gcry_mpi_t *r_r, gcry_mpi_t *r_s) {
+  gcry_mpi_t r = data[0];
+  gcry_mpi_t s = data[1];
+  size_t rlen, slen, n; /* (bytes) */
+  char buf[64];
+  int rc;
+
+  log_assert(neededfixedlen <= sizeof buf);
+
+  if (!r || !s)
+    return GPG_ERR_BAD_MPI;
+  else if ((rlen = (gcry_mpi_get_nbits(r) + 7) / 8) > neededfixedlen || !rlen)
+    return GPG_ERR_BAD_MPI;
+  else if ((slen = (gcry_mpi_get_nbits(s) + 7) / 8) > neededfixedlen || !slen)
+    return GPG_ERR_BAD_MPI;
+
+  /* We need to fixup the length in case of leading zeroes.
+   * OpenPGP does not allow leading zeroes and the parser for
+   * the signature packet has no information on the use curve,
+   * thus we need to do it here.  We won't do it for opaque
+   * MPIs under the assumption that they are known to be fine;
+   * we won't see them here anyway but the check is anyway
+   * required.  Fixme: A nifty feature for gcry_sexp_build
+   * would be a format to left pad the value (e.g. "%*M"). */
+  rc = 0;
+
+  if (rlen < neededfixedlen && !gcry_mpi_get_flag(r, GCRYMPI_FLAG_OPAQUE) &&
+      !(rc = gcry_mpi_print(GCRYMPI_FMT_USG, (unsigned char *)(buf),
+                            sizeof buf, &n, r))) {
+    log_assert(n < neededfixedlen);
+    memmove(buf + (neededfixedlen - n), buf, n);
+    memset(buf, 0, neededfixedlen - n);
+    r = gcry_mpi_set_opaque_copy(NULL, buf, neededfixedlen * 8);
+  }
+  if (slen < neededfixedlen && !gcry_mpi_get_flag(s, GCRYMPI_FLAG_OPAQUE) &&
+      !(rc = gcry_mpi_print(GCRYMPI_FMT_USG, (unsigned char *)(buf),
+                            sizeof buf, &n, s))) {
+    log_assert(n < neededfixedlen);
+    memmove(buf + (neededfixedlen - n), buf, n);
+    memset(buf, 0, neededfixedlen - n);
+    s = gcry_mpi_set_opaque_copy(NULL, buf, neededfixedlen * 8);
+  }
+
+  if (rc) {
+    if (r != data[0]) gcry_mpi_release(r);
+    if (s != data[1]) gcry_mpi_release(s);
+    return rc;
+  }
+
+  *r_r = r;
+  *r_s = s;
+  return 0;
+}
+
+/* Build the S-expressions for verifying the signature DATA over HASH
+ * with the public key PKEY and store them at R_SIG, R_HASH and
+ * R_PKEY.  On error they are set to NULL.  */
+static int build_verify_sexps(pubkey_algo_t pkalgo, gcry_mpi_t hash,
+                              gcry_mpi_t *data, gcry_mpi_t *pkey,
+                              gcry_sexp_t *r_sig, gcry_sexp_t *r_hash,
+                              gcry_sexp_t *r_pkey) {
   gcry_sexp_t s_sig, s_hash, s_pkey;
   int rc;
   unsigned int neededfixedlen = 0;
 
+  *r_sig = *r_hash = *r_pkey = NULL;
+
   /* Make a sexp from pkey.  */
   if (pkalgo == PUBKEY_ALGO_DSA) {
     rc = gcry_sexp_build(&s_pkey, NULL, "(public-key(dsa(p%m)(q%m)(g%m)(y%m)))",
@@ -115,50 +178,11 @@ int pk_verify(pubkey_algo_t pkalgo, gcry_mpi_t hash, gcry_mpi_t *data,
       rc = gcry_sexp_build(&s_sig, NULL, "(sig-val(ecdsa(r%m)(s%m)))", data[0],
                            data[1]);
   } else if (pkalgo == PUBKEY_ALGO_EDDSA) {
-    gcry_mpi_t r = data[0];
-    gcry_mpi_t s = data[1];
-    size_t rlen, slen, n; /* (bytes) */
-    char buf[64];
-
-    log_assert(neededfixedlen <= sizeof buf);
-
-    if (!r || !s)
-      rc = GPG_ERR_BAD_MPI;
-    else if ((rlen = (gcry_mpi_get_nbits(r) + 7) / 8) > neededfixedlen || !rlen)
-      rc = GPG_ERR_BAD_MPI;
-    else if ((slen = (gcry_mpi_get_nbits(s) + 7) / 8) > neededfixedlen || !slen)
-      rc = GPG_ERR_BAD_MPI;
-    else {
-      /* We need to fixup the length in case of leading zeroes.
-       * OpenPGP does not allow leading zeroes and the parser for
-       * the signature packet has no information on the use curve,
-       * thus we need to do it here.  We won't do it for opaque
-       * MPIs under the assumption that they are known to be fine;
-       * we won't see them here anyway but the check is anyway
-       * required.  Fixme: A nifty feature for gcry_sexp_build
-       * would be a format to left pad the value (e.g. "%*M"). */
-      rc = 0;
-
-      if (rlen < neededfixedlen && !gcry_mpi_get_flag(r, GCRYMPI_FLAG_OPAQUE) &&
-          !(rc = gcry_mpi_print(GCRYMPI_FMT_USG, (unsigned char *)(buf),
-                                sizeof buf, &n, r))) {
-        log_assert(n < neededfixedlen);
-        memmove(buf + (neededfixedlen - n), buf, n);
-        memset(buf, 0, neededfixedlen - n);
-        r = gcry_mpi_set_opaque_copy(NULL, buf, neededfixedlen * 8);
-      }
-      if (slen < neededfixedlen && !gcry_mpi_get_flag(s, GCRYMPI_FLAG_OPAQUE) &&
-          !(rc = gcry_mpi_print(GCRYMPI_FMT_USG, (unsigned char *)(buf),
-                                sizeof buf, &n, s))) {
-        log_assert(n < neededfixedlen);
-        memmove(buf + (neededfixedlen - n), buf, n);
-        memset(buf, 0, neededfixedlen - n);
-        s = gcry_mpi_set_opaque_copy(NULL, buf, neededfixedlen * 8);
-      }
-
-      if (!rc)
-        rc = gcry_sexp_build(&s_sig, NULL, "(sig-val(eddsa(r%M)(s%M)))", r, s);
+    gcry_mpi_t r, s;
 
+    rc = eddsa_sig_values(data, neededfixedlen, &r, &s);
+    if (!rc) {
+      rc = gcry_sexp_build(&s_sig, NULL, "(sig-val(eddsa(r%M)(s%M)))", r, s);
       if (r != data[0]) gcry_mpi_release(r);
       if (s != data[1]) gcry_mpi_release(s);
     }
@@ -176,6 +200,59 @@ int pk_verify(pubkey_algo_t pkalgo, gcry_mpi_t hash, gcry_mpi_t *data,
   } else
     BUG();
 
+  if (rc) {
+    gcry_sexp_release(s_sig);
+    gcry_sexp_release(s_hash);
+    gcry_sexp_release(s_pkey);
+    return rc;
+  }
+
+  *r_sig = s_sig;
+  *r_hash = s_hash;
+  *r_pkey = s_pkey;
+  return 0;
+}
+
+/****************
+ * Emulate our old PK interface here - sometime in the future we might
+ * change the internal design to directly fit to libgcrypt.
+ */
+int pk_verify(pubkey_algo_t pkalgo, gcry_mpi_t hash, gcry_mpi_t *data,
+              gcry_mpi_t *pkey) {
+  gcry_sexp_t s_sig, s_hash, s_pkey;
+  int rc;
+
+  /* Hand the MPIs directly to libgcrypt, which saves building and
+     parsing the S-expressions.  Elgamal still takes the long way.  */
+  if (pkalgo == PUBKEY_ALGO_RSA || pkalgo == PUBKEY_ALGO_RSA_S) {
+    if (!data[0]) return GPG_ERR_BAD_MPI;
+    return gcry_pk_verify_mpi(GCRY_PK_RSA, NULL, hash, data, pkey);
+  } else if (pkalgo == PUBKEY_ALGO_DSA) {
+    if (!data[0] || !data[1]) return GPG_ERR_BAD_MPI;
+    return gcry_pk_verify_mpi(GCRY_PK_DSA, NULL, hash, data, pkey);
+  } else if (pkalgo == PUBKEY_ALGO_ECDSA || pkalgo == PUBKEY_ALGO_EDDSA) {
+    std::string oid = openpgp_oid_to_str(pkey[0]);
+    gcry_ecc_curve_t curve;
+    gcry_mpi_t sig[2];
+
+    if (!oid.length()) return gpg_error_from_syserror();
+    curve = gcry_ecc_lookup_curve(oid.c_str());
+    if (!curve) return GPG_ERR_UNKNOWN_CURVE;
+    if (pkalgo == PUBKEY_ALGO_ECDSA) {
+      if (!data[0] || !data[1]) return GPG_ERR_BAD_MPI;
+      return gcry_pk_verify_mpi(GCRY_PK_ECDSA, curve, hash, data, pkey + 1);
+    }
+
+    rc = eddsa_sig_values(data, openpgp_oid_is_ed25519(pkey[0]) ? 256 / 8 : 0,
+                          &sig[0], &sig[1]);
+    if (rc) return rc;
+    rc = gcry_pk_verify_mpi(GCRY_PK_EDDSA, curve, hash, sig, pkey + 1);
+    if (sig[0] != data[0]) gcry_mpi_release(sig[0]);
+    if (sig[1] != data[1]) gcry_mpi_release(sig[1]);
+    return rc;
+  }
+
+  rc = build_verify_sexps(pkalgo, hash, data, pkey, &s_sig, &s_hash, &s_pkey);
   if (!rc) rc = gcry_pk_verify(s_sig, s_hash, s_pkey);
 
   gcry_sexp_release(s_sig);
@@ -184,6 +261,45 @@ int pk_verify(pubkey_algo_t pkalgo, gcry_mpi_t hash, gcry_mpi_t *data,
   return rc;
 }
 
+/* Verify the N signatures of ITEMS like pk_verify and store the
+ * result of each in its RC field.  The EdDSA signatures are handed
+ * to libgcrypt in one call, which verifies them together; the others
+ * take the direct way of pk_verify.  */
+void pk_verify_batch(struct pk_verify_item *items, size_t n) {
+  std::vector<gcry_sexp_t> sigs, hashes, pkeys;
+  std::vector<gpg_error_t> results;
+  std::vector<size_t> idx;
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    gcry_sexp_t s_sig, s_hash, s_pkey;
+
+    if (items[i].pkalgo != PUBKEY_ALGO_EDDSA) {
+      items[i].rc = pk_verify(items[i].pkalgo, items[i].hash, items[i].data,
+                              items[i].pkey);
+      continue;
+    }
+    items[i].rc = build_verify_sexps(items[i].pkalgo, items[i].hash,
+                                     items[i].data, items[i].pkey, &s_sig,
+                                     &s_hash, &s_pkey);
+    if (items[i].rc) continue;
+    sigs.push_back(s_sig);
+    hashes.push_back(s_hash);
+    pkeys.push_back(s_pkey);
+    idx.push_back(i);
+  }
+
+  results.resize(idx.size());
+  gcry_pk_verify_batch(sigs.data(), hashes.data(), pkeys.data(), idx.size(),
+                       results.data());
+  for (i = 0; i < idx.size(); i++) {
+    items[idx[i]].rc = results[i];
+    gcry_sexp_release(sigs[i]);
+    gcry_sexp_release(hashes[i]);
+    gcry_sexp_release(pkeys[i]);
+  }
+}
+
 /****************
  * Emulate our old PK interface here - sometime in the future we might
  * change the internal design to directly fit to libgcrypt.
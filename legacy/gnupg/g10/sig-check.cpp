@@ -20,9 +20,21 @@
  */
 
 #include <config.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "../common/compliance.h"
 #include "../common/status.h"
@@ -47,12 +59,324 @@ struct {
   unsigned int cached;  /* Number of seen cache entries.  */
   unsigned int goodsig; /* Number of good verifications from the cache.  */
   unsigned int badsig;  /* Number of bad verifications from the cache.  */
+  unsigned int file_hit;  /* Number of hits in the persistent cache.  */
+  unsigned int file_miss; /* Number of misses in the persistent cache.  */
 } cache_stats;
 
+/* The persistent signature cache.
+ *
+ * This remembers the outcome of the public key operation for key
+ * signatures across invocations, so that the same certifications and
+ * self-signatures are not verified again on each run.  An entry is
+ * looked up by the fingerprint of the signer and a SHA-256 hash over
+ * the final digest of the signed data and the signature values; it
+ * can thus only match the very same signature over the very same
+ * key material and user ID.  Everything else (expiration,
+ * revocation, semantics) is checked by the callers as usual.
+ *
+ * The file lives next to the first writable keybox and is an
+ * append-only log of records:
+ *
+ *   1 byte   length of the fingerprint (N)
+ *   N bytes  fingerprint of the signer
+ *  32 bytes  cache key
+ *   1 byte   SIGCACHE_BAD, SIGCACHE_GOOD or SIGCACHE_FORGET
+ *
+ * A SIGCACHE_FORGET record (with a zero key) drops all entries of
+ * the signer; it is written when the signer's keyblock is updated.
+ * New records are appended by sig_cache_flush, which rewrites the
+ * file if it contains too many stale records.  */
+#define SIGCACHE_MAGIC "NPGSIGC1"
+#define SIGCACHE_MAGICLEN 8
+#define SIGCACHE_KEYLEN 32
+#define SIGCACHE_BAD 0
+#define SIGCACHE_GOOD 1
+#define SIGCACHE_FORGET 2
+
+typedef std::unordered_map<std::string, byte> sig_cache_entries_t;
+
+static char *sig_cache_fname;
+static int sig_cache_loaded;
+static std::unordered_map<std::string, sig_cache_entries_t> sig_cache;
+static size_t sig_cache_nentries; /* Number of live entries.  */
+static size_t sig_cache_nrecords; /* Number of records in the file.  */
+static std::string sig_cache_pending; /* Records not yet written.  */
+static size_t sig_cache_npending;
+
 /* Dump verification stats.  */
 void sig_check_dump_stats(void) {
   log_info("sig_cache: total=%u cached=%u good=%u bad=%u\n", cache_stats.total,
            cache_stats.cached, cache_stats.goodsig, cache_stats.badsig);
+  log_info("sig_cache_file: hit=%u miss=%u entries=%lu\n",
+           cache_stats.file_hit, cache_stats.file_miss,
+           (unsigned long)sig_cache_nentries);
+}
+
+/* Use a persistent signature cache for the keybox FILENAME.  Only the
+   first call has an effect.  */
+void sig_cache_register(const char *filename) {
+  size_t n;
+
+  if (sig_cache_fname) return;
+
+  n = strlen(filename);
+  if (n > 4 && !strcmp(filename + n - 4, ".kbx")) n -= 4;
+  sig_cache_fname = (char *)xmalloc(n + 10);
+  memcpy(sig_cache_fname, filename, n);
+  strcpy(sig_cache_fname + n, ".sigcache");
+}
+
+/* Apply a record to the in-memory cache.  */
+static void sig_cache_apply(const std::string &fpr, const std::string &key,
+                            byte flag) {
+  if (flag == SIGCACHE_FORGET) {
+    auto it = sig_cache.find(fpr);
+    if (it != sig_cache.end()) {
+      sig_cache_nentries -= it->second.size();
+      sig_cache.erase(it);
+    }
+    return;
+  }
+
+  auto res = sig_cache[fpr].insert(std::make_pair(key, flag));
+  if (res.second)
+    sig_cache_nentries++;
+  else
+    res.first->second = flag;
+}
+
+/* Read the cache file.  A missing file is not an error and a
+   truncated or damaged tail is ignored.  */
+static void sig_cache_load(void) {
+  std::string buf;
+  struct stat st;
+  size_t off;
+  int fd;
+
+  sig_cache_loaded = 1;
+  if (!sig_cache_fname) return;
+
+  fd = open(sig_cache_fname, O_RDONLY);
+  if (fd == -1) {
+    if (errno != ENOENT)
+      log_info(_("can't open '%s': %s\n"), sig_cache_fname, strerror(errno));
+    return;
+  }
+  if (!fstat(fd, &st) && st.st_size > 0) {
+    buf.resize(st.st_size);
+    for (off = 0; off < buf.size();) {
+      ssize_t n = read(fd, &buf[off], buf.size() - off);
+      if (n == -1 && errno == EINTR) continue;
+      if (n <= 0) break;
+      off += n;
+    }
+    buf.resize(off);
+  }
+  close(fd);
+
+  if (buf.size() < SIGCACHE_MAGICLEN ||
+      memcmp(buf.data(), SIGCACHE_MAGIC, SIGCACHE_MAGICLEN)) {
+    if (buf.size()) log_info("%s: invalid signature cache\n", sig_cache_fname);
+    return;
+  }
+
+  for (off = SIGCACHE_MAGICLEN; off < buf.size();) {
+    size_t fprlen = (byte)buf[off];
+
+    if (!fprlen || fprlen > MAX_FINGERPRINT_LEN ||
+        buf.size() - off < 1 + fprlen + SIGCACHE_KEYLEN + 1)
+      break;
+    sig_cache_apply(buf.substr(off + 1, fprlen),
+                    buf.substr(off + 1 + fprlen, SIGCACHE_KEYLEN),
+                    buf[off + 1 + fprlen + SIGCACHE_KEYLEN]);
+    sig_cache_nrecords++;
+    off += 1 + fprlen + SIGCACHE_KEYLEN + 1;
+  }
+  if (off != buf.size())
+    log_info("%s: signature cache is damaged - tail ignored\n",
+             sig_cache_fname);
+}
+
+/* Append a record to the pending records and apply it.  */
+static void sig_cache_put(const std::string &fpr, const std::string &key,
+                          byte flag) {
+  sig_cache_pending.push_back((char)fpr.size());
+  sig_cache_pending += fpr;
+  sig_cache_pending += key;
+  sig_cache_pending.push_back((char)flag);
+  sig_cache_npending++;
+  sig_cache_apply(fpr, key, flag);
+}
+
+/* Compute the cache key for the signature SIG by SIGNER over the data
+   in the finalized DIGEST.  Returns false if the signature is not to
+   be cached.  */
+static bool sig_cache_key(PKT_public_key *signer, PKT_signature *sig,
+                          gcry_md_hd_t digest, std::string *r_fpr,
+                          std::string *r_key) {
+  byte fpr[MAX_FINGERPRINT_LEN];
+  size_t fprlen;
+  gcry_md_hd_t md;
+  int i, nsig;
+
+  if (!sig_cache_fname || opt.no_sig_cache || !IS_CERT(sig)) return false;
+
+  nsig = pubkey_get_nsig((pubkey_algo_t)sig->pubkey_algo);
+  if (!nsig) return false;
+
+  if (gcry_md_open(&md, GCRY_MD_SHA256, 0)) return false;
+  gcry_md_putc(md, sig->pubkey_algo);
+  gcry_md_putc(md, sig->digest_algo);
+  gcry_md_write(md, gcry_md_read(digest, sig->digest_algo),
+                gcry_md_get_algo_dlen(sig->digest_algo));
+  for (i = 0; i < nsig; i++) {
+    gcry_mpi_t a = sig->data[i];
+    unsigned char *buf;
+    unsigned int nbits;
+    size_t n;
+
+    if (!a) {
+      gcry_md_close(md);
+      return false;
+    }
+    if (gcry_mpi_get_flag(a, GCRYMPI_FLAG_OPAQUE)) {
+      const void *p = gcry_mpi_get_opaque(a, &nbits);
+      gcry_md_write(md, p, (nbits + 7) / 8);
+    } else if (!gcry_mpi_aprint(GCRYMPI_FMT_PGP, &buf, &n, a)) {
+      gcry_md_write(md, buf, n);
+      gcry_free(buf);
+    } else {
+      gcry_md_close(md);
+      return false;
+    }
+  }
+  r_key->assign((const char *)gcry_md_read(md, GCRY_MD_SHA256),
+                SIGCACHE_KEYLEN);
+  gcry_md_close(md);
+
+  fingerprint_from_pk(signer, fpr, &fprlen);
+  r_fpr->assign((const char *)fpr, fprlen);
+  return true;
+}
+
+/* Look up a signature in the persistent cache.  Returns 0 for a good
+   signature, GPG_ERR_BAD_SIGNATURE for a bad one and -1 if the
+   signature is not cached.  */
+static int sig_cache_lookup(const std::string &fpr, const std::string &key) {
+  if (!sig_cache_loaded) sig_cache_load();
+
+  auto it = sig_cache.find(fpr);
+  if (it != sig_cache.end()) {
+    auto entry = it->second.find(key);
+    if (entry != it->second.end()) {
+      cache_stats.file_hit++;
+      return entry->second == SIGCACHE_GOOD ? 0 : GPG_ERR_BAD_SIGNATURE;
+    }
+  }
+  cache_stats.file_miss++;
+  return -1;
+}
+
+/* Store the result RC of verifying a signature in the persistent
+   cache.  Only definite results are stored.  */
+static void sig_cache_store(const std::string &fpr, const std::string &key,
+                            int rc) {
+  if (rc && rc != GPG_ERR_BAD_SIGNATURE) return;
+  if (!sig_cache_loaded) sig_cache_load();
+  sig_cache_put(fpr, key, rc ? SIGCACHE_BAD : SIGCACHE_GOOD);
+}
+
+/* Drop the cached results for signatures made by any key in the
+   keyblock KEYBLOCK.  This is called when the keyblock is updated.  */
+void sig_cache_forget_keyblock(kbnode_t keyblock) {
+  byte fpr[MAX_FINGERPRINT_LEN];
+  size_t fprlen;
+  kbnode_t node;
+
+  if (!sig_cache_fname) return;
+  if (!sig_cache_loaded) sig_cache_load();
+
+  for (node = keyblock; node; node = node->next) {
+    if (node->pkt->pkttype != PKT_PUBLIC_KEY &&
+        node->pkt->pkttype != PKT_PUBLIC_SUBKEY)
+      continue;
+    fingerprint_from_pk(node->pkt->pkt.public_key, fpr, &fprlen);
+    std::string key_fpr((const char *)fpr, fprlen);
+    if (sig_cache.count(key_fpr))
+      sig_cache_put(key_fpr, std::string(SIGCACHE_KEYLEN, '\0'),
+                    SIGCACHE_FORGET);
+  }
+}
+
+/* Write all of BUF to FD.  */
+static int sig_cache_write(int fd, const std::string &buf) {
+  size_t off = 0;
+
+  while (off < buf.size()) {
+    ssize_t n = write(fd, buf.data() + off, buf.size() - off);
+    if (n == -1 && errno == EINTR) continue;
+    if (n <= 0) return -1;
+    off += n;
+  }
+  return 0;
+}
+
+/* Rewrite the cache file from the in-memory cache.  */
+static void sig_cache_compact(void) {
+  std::string buf(SIGCACHE_MAGIC, SIGCACHE_MAGICLEN);
+  char *tmpname = xstrconcat(sig_cache_fname, ".tmp", NULL);
+  size_t nrecords = 0;
+  int fd;
+
+  for (auto &signer : sig_cache)
+    for (auto &entry : signer.second) {
+      buf.push_back((char)signer.first.size());
+      buf += signer.first;
+      buf += entry.first;
+      buf.push_back((char)entry.second);
+      nrecords++;
+    }
+
+  fd = open(tmpname, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+  if (fd == -1 || sig_cache_write(fd, buf) || close(fd) ||
+      gnupg_rename_file(tmpname, sig_cache_fname)) {
+    log_info(_("can't write '%s': %s\n"), sig_cache_fname, strerror(errno));
+    if (fd != -1) gnupg_remove(tmpname);
+  } else
+    sig_cache_nrecords = nrecords;
+  xfree(tmpname);
+}
+
+/* Write the pending records of the persistent cache.  Records are
+   appended with a single write, so that concurrent processes do not
+   interleave them.  */
+void sig_cache_flush(void) {
+  struct stat st;
+  int fd;
+
+  if (!sig_cache_fname || !sig_cache_npending || opt.dry_run) return;
+
+  /* Rewrite the file if most of its records are stale.  */
+  if (sig_cache_nrecords + sig_cache_npending > 2 * sig_cache_nentries + 1000)
+    sig_cache_compact();
+  else {
+    fd = open(sig_cache_fname, O_WRONLY | O_APPEND | O_CREAT,
+              S_IRUSR | S_IWUSR);
+    if (fd == -1)
+      log_info(_("can't open '%s': %s\n"), sig_cache_fname, strerror(errno));
+    else {
+      if (!fstat(fd, &st) && !st.st_size)
+        sig_cache_pending.insert(0, SIGCACHE_MAGIC, SIGCACHE_MAGICLEN);
+      if (sig_cache_write(fd, sig_cache_pending))
+        log_info(_("can't write '%s': %s\n"), sig_cache_fname,
+                 strerror(errno));
+      else
+        sig_cache_nrecords += sig_cache_npending;
+      close(fd);
+    }
+  }
+  sig_cache_pending.clear();
+  sig_cache_npending = 0;
 }
 
 /* Check a signature.  This is shorthand for check_signature2 with
@@ -386,15 +710,15 @@ static int check_signature_end(PKT_public_key *pk, PKT_signature *sig,
   return rc;
 }
 
-/* This function is similar to check_signature_end, but it only checks
-   whether the signature was generated by PK.  It does not check
-   expiration, revocation, etc.  */
-static int check_signature_end_simple(PKT_public_key *pk, PKT_signature *sig,
-                                      gcry_md_hd_t digest) {
-  gcry_mpi_t result = NULL;
-  int rc = 0;
+/* Add the signature trailer of SIG to DIGEST, finalize it and store
+   the value to be verified with PK at R_RESULT.  The caller must
+   release it with gcry_mpi_release.  */
+static int finish_signature_digest(PKT_public_key *pk, PKT_signature *sig,
+                                   gcry_md_hd_t digest, gcry_mpi_t *r_result) {
   gcry_md_algos algo = (gcry_md_algos)sig->digest_algo;
 
+  *r_result = NULL;
+
   if (opt.weak_digests.count(algo)) {
     print_digest_rejected_note(algo);
     return GPG_ERR_DIGEST_ALGO;
@@ -443,11 +767,32 @@ static int check_signature_end_simple(PKT_public_key *pk, PKT_signature *sig,
   gcry_md_final(digest);
 
   /* Convert the digest to an MPI.  */
-  result = encode_md_value(pk, digest, sig->digest_algo);
-  if (!result) return GPG_ERR_GENERAL;
+  *r_result = encode_md_value(pk, digest, sig->digest_algo);
+  if (!*r_result) return GPG_ERR_GENERAL;
 
-  /* Verify the signature.  */
-  rc = pk_verify((pubkey_algo_t)(pk->pubkey_algo), result, sig->data, pk->pkey);
+  return 0;
+}
+
+/* This function is similar to check_signature_end, but it only checks
+   whether the signature was generated by PK.  It does not check
+   expiration, revocation, etc.  */
+static int check_signature_end_simple(PKT_public_key *pk, PKT_signature *sig,
+                                      gcry_md_hd_t digest) {
+  gcry_mpi_t result = NULL;
+  int rc = 0;
+  std::string cache_fpr, cache_key;
+  bool use_cache;
+
+  rc = finish_signature_digest(pk, sig, digest, &result);
+  if (rc) return rc;
+
+  /* Verify the signature unless we already know the result.  */
+  use_cache = sig_cache_key(pk, sig, digest, &cache_fpr, &cache_key);
+  if (!use_cache || (rc = sig_cache_lookup(cache_fpr, cache_key)) == -1) {
+    rc = pk_verify((pubkey_algo_t)(pk->pubkey_algo), result, sig->data,
+                   pk->pkey);
+    if (use_cache) sig_cache_store(cache_fpr, cache_key, rc);
+  }
   gcry_mpi_release(result);
 
   if (!rc && sig->flags.unknown_critical) {
@@ -1010,3 +1355,193 @@ int check_key_signature2(ctrl_t ctrl, kbnode_t root, kbnode_t node,
 
   return rc;
 }
+
+/* The maximum number of signatures a thread of
+   check_key_signatures_mt verifies in one go.  */
+#define VERIFY_BATCH_SIZE 32
+
+/* A key signature prepared by check_key_signatures_mt.  */
+struct sig_check_job {
+  PKT_signature *sig;
+  PKT_public_key *signer; /* The signer; points into the keyblock
+                             unless SIGNER_ALLOCED is set.  */
+  int signer_alloced;
+  gcry_mpi_t hash; /* The finalized digest to verify.  */
+  bool use_cache;   /* Store the result in the persistent cache.  */
+  bool cached;      /* RC has been taken from the persistent cache.  */
+  std::string cache_fpr, cache_key;
+  int rc;
+};
+
+/* Prepare the key signature NODE of the keyblock ROOT for
+ * verification by a worker thread: look up the signer and hash the
+ * signed data like check_key_signature2 does.  Returns false if the
+ * signature should rather be left to check_key_signature, which will
+ * then report the problem.  */
+static bool prepare_sig_job(ctrl_t ctrl, kbnode_t root, kbnode_t node,
+                            struct sig_check_job *job) {
+  PKT_public_key *pk = root->pkt->pkt.public_key;
+  PKT_signature *sig = node->pkt->pkt.signature;
+  kbnode_t unode = NULL, snode = NULL, n;
+  gcry_md_hd_t md;
+  int rc;
+
+  job->sig = sig;
+
+  if (sig->sig_class == 0x10 || sig->sig_class == 0x11 ||
+      sig->sig_class == 0x12 || sig->sig_class == 0x13 ||
+      sig->sig_class == 0x30) {
+    unode = find_prev_kbnode(root, node, PKT_USER_ID);
+    if (!unode) return false;
+  } else if (sig->sig_class == 0x18 || sig->sig_class == 0x28) {
+    snode = find_prev_kbnode(root, node, PKT_PUBLIC_SUBKEY);
+    if (!snode) return false;
+    if (sig->sig_class == 0x28) job->signer = pk;
+  } else if (sig->sig_class == 0x1f)
+    job->signer = pk;
+  else if (sig->sig_class == 0x20) {
+    /* Revocations by a designated revoker are checked differently.  */
+    if (keyid_cmp(pk_keyid(pk), sig->keyid)) return false;
+    job->signer = pk;
+  } else
+    return false;
+  if (openpgp_pk_test_algo((pubkey_algo_t)(sig->pubkey_algo)) ||
+      openpgp_md_test_algo((digest_algo_t)(sig->digest_algo)))
+    return false;
+  /* Same as check_key_signature2, see the BUG note there.  */
+  if (check_signature_metadata_validity(pk, sig, NULL, NULL)) return false;
+
+  /* Find the signer like check_signature_over_key_or_uid does.  */
+  if (!job->signer && keyid_cmp(pk_keyid(pk), sig->keyid) == 0)
+    job->signer = pk;
+  for (n = root->next; n && !job->signer; n = n->next)
+    if (n->pkt->pkttype == PKT_PUBLIC_SUBKEY &&
+        keyid_cmp(pk_keyid(n->pkt->pkt.public_key), sig->keyid) == 0)
+      job->signer = n->pkt->pkt.public_key;
+  if (!job->signer) {
+    job->signer = (PKT_public_key *)xmalloc_clear(sizeof *job->signer);
+    job->signer_alloced = 1;
+    if (get_pubkey(ctrl, job->signer, sig->keyid)) {
+      xfree(job->signer);
+      job->signer = NULL;
+      job->signer_alloced = 0;
+      return false;
+    }
+  }
+
+  if (gcry_md_open(&md, sig->digest_algo, 0)) BUG();
+  hash_public_key(md, pk);
+  if (unode)
+    hash_uid_packet(unode->pkt->pkt.user_id, md, sig);
+  else if (snode)
+    hash_public_key(md, snode->pkt->pkt.public_key);
+  rc = finish_signature_digest(job->signer, sig, md, &job->hash);
+  if (!rc) {
+    job->use_cache =
+        sig_cache_key(job->signer, sig, md, &job->cache_fpr, &job->cache_key);
+    if (job->use_cache &&
+        (job->rc = sig_cache_lookup(job->cache_fpr, job->cache_key)) != -1)
+      job->cached = true;
+  }
+  gcry_md_close(md);
+  if (rc) {
+    if (job->signer_alloced) free_public_key(job->signer);
+    job->signer = NULL;
+    job->signer_alloced = 0;
+    return false;
+  }
+
+  return true;
+}
+
+/* Verify the key signatures NODES[0..N-1], each of which belongs to
+ * the keyblock ROOTS[i], using up to NTHREADS threads, and store the
+ * results in the signature packets so that a following
+ * check_key_signature on them is answered from the cache.
+ *
+ * Each thread hands up to VERIFY_BATCH_SIZE signatures at a time to
+ * pk_verify_batch, which verifies EdDSA signatures together.  Only
+ * the public key operations run concurrently; looking up the
+ * signers, hashing and updating the packets is done by the calling
+ * thread in the order given, so the keydb and the key caches are
+ * never accessed from more than one thread.  Signatures which have
+ * already been checked or which can't be prepared (e.g. because the
+ * signer is missing) are left alone.  */
+void check_key_signatures_mt(ctrl_t ctrl, kbnode_t *roots, kbnode_t *nodes,
+                             size_t n, int nthreads) {
+  std::vector<sig_check_job> jobs;
+  std::vector<std::thread> workers;
+  std::atomic<size_t> next(0);
+  size_t i, chunk;
+
+  if (opt.no_sig_cache) return; /* The results could not be used.  */
+
+  jobs.reserve(n);
+  for (i = 0; i < n; i++) {
+    struct sig_check_job job = {};
+
+    if (nodes[i]->pkt->pkt.signature->flags.checked) continue;
+    if (prepare_sig_job(ctrl, roots[i], nodes[i], &job))
+      jobs.push_back(std::move(job));
+  }
+
+  if (nthreads > (int)jobs.size()) nthreads = jobs.size();
+  /* Small enough batches that all threads get some work.  */
+  chunk = nthreads > 0 ? jobs.size() / nthreads : 1;
+  if (chunk > VERIFY_BATCH_SIZE) chunk = VERIFY_BATCH_SIZE;
+  if (!chunk) chunk = 1;
+
+  auto worker = [&jobs, &next, chunk]() {
+    std::vector<struct pk_verify_item> items;
+    std::vector<struct sig_check_job *> batch;
+    size_t start, idx;
+
+    while ((start = next.fetch_add(chunk)) < jobs.size()) {
+      items.clear();
+      batch.clear();
+      for (idx = start; idx < jobs.size() && idx < start + chunk; idx++) {
+        struct sig_check_job *job = &jobs[idx];
+        struct pk_verify_item item;
+
+        if (job->cached) continue;
+        item.pkalgo = (pubkey_algo_t)(job->signer->pubkey_algo);
+        item.hash = job->hash;
+        item.data = job->sig->data;
+        item.pkey = job->signer->pkey;
+        item.rc = 0;
+        items.push_back(item);
+        batch.push_back(job);
+      }
+      pk_verify_batch(items.data(), items.size());
+      for (idx = 0; idx < batch.size(); idx++) batch[idx]->rc = items[idx].rc;
+    }
+  };
+
+  /* The calling thread does its share of the work, so that we still
+     finish if no threads could be created.  */
+  for (i = 1; i < (size_t)nthreads; i++) {
+    try {
+      workers.emplace_back(worker);
+    } catch (const std::system_error &e) {
+      log_info("can't start verification thread: %s\n", e.what());
+      break;
+    }
+  }
+  worker();
+  for (auto &thr : workers) thr.join();
+
+  for (auto &job : jobs) {
+    if (job.use_cache && !job.cached)
+      sig_cache_store(job.cache_fpr, job.cache_key, job.rc);
+    if (!job.rc && job.sig->flags.unknown_critical) {
+      log_info(_("assuming bad signature from key %s"
+                 " due to an unknown critical bit\n"),
+               keystr_from_pk(job.signer));
+      job.rc = GPG_ERR_BAD_SIGNATURE;
+    }
+    cache_sig_result(job.sig, job.rc);
+
+    gcry_mpi_release(job.hash);
+    if (job.signer_alloced) free_public_key(job.signer);
+  }
+}
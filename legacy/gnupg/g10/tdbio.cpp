@@ -27,6 +27,13 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
 
 #include "../common/iobuf.h"
 #include "../common/status.h"
@@ -48,9 +55,12 @@
 #endif
 
 /*
- * Yes, this is a very simple implementation. We should really
- * use a page aligned buffer and read complete pages.
- * To implement a simple trannsaction system, this is sufficient.
+ * The record cache.  All entries are kept on CACHE_LIST; entries
+ * holding a record are additionally indexed by their record number
+ * in CACHE_INDEX so that lookups do not need to walk the list.
+ * Entries which have been discarded are kept on CACHE_FREE for
+ * reuse.  To implement a simple transaction system, this is
+ * sufficient.
  */
 typedef struct cache_ctrl_struct *CACHE_CTRL;
 struct cache_ctrl_struct {
@@ -69,9 +79,15 @@ struct cache_ctrl_struct {
 #define MAX_CACHE_ENTRIES_SOFT 200
 #define MAX_CACHE_ENTRIES_HARD 10000
 
+/* The maximum number of records written with one pwritev call.  */
+#define MAX_WRITE_BATCH 64
+
 /* The cache is controlled by these variables.  */
 static CACHE_CTRL cache_list;
+static std::unordered_map<unsigned long, CACHE_CTRL> cache_index;
+static std::vector<CACHE_CTRL> cache_free;
 static int cache_entries;
+static int cache_dirty_entries;
 static int cache_is_dirty;
 
 /* An object to pass information to cmp_krec_fpr. */
@@ -98,6 +114,9 @@ static int is_locked;
 /* The file descriptor of the trustdb.  */
 static int db_fd = -1;
 
+/* A flag indicating that the trustdb was opened read-only.  */
+static int db_rdonly;
+
 /* A flag indicating that a transaction is active.  */
 static int in_transaction;
 
@@ -145,37 +164,132 @@ static void release_write_lock(void) {
  * a cache miss.
  */
 static const char *get_record_from_cache(unsigned long recno) {
+  auto it = cache_index.find(recno);
+
+  if (it == cache_index.end()) return NULL;
+  return it->second->data;
+}
+
+/*
+ * Allocate a new cache item and link it into the cache list.  The
+ * item is not yet in use.
+ */
+static CACHE_CTRL new_cache_item(void) {
   CACHE_CTRL r;
 
-  for (r = cache_list; r; r = r->next) {
-    if (r->flags.used && r->recno == recno) return r->data;
-  }
-  return NULL;
+  r = (CACHE_CTRL)xmalloc(sizeof *r);
+  r->flags.used = 0;
+  r->flags.dirty = 0;
+  r->next = cache_list;
+  cache_list = r;
+  return r;
+}
+
+/*
+ * Store DATA for record RECNO in the unused cache item R and mark it
+ * as dirty.
+ */
+static void fill_cache_item(CACHE_CTRL r, unsigned long recno,
+                            const char *data) {
+  r->flags.used = 1;
+  r->flags.dirty = 1;
+  r->recno = recno;
+  memcpy(r->data, data, TRUST_RECORD_LEN);
+  cache_index[recno] = r;
+  cache_entries++;
+  cache_dirty_entries++;
+  cache_is_dirty = 1;
 }
 
 /*
- * Write a cached item back to the trustdb file.
+ * Remove the cache item R from the index and put it on the free
+ * list.  A dirty item must have been written back before.
+ */
+static void discard_cache_item(CACHE_CTRL r) {
+  log_assert(r->flags.used && !r->flags.dirty);
+  cache_index.erase(r->recno);
+  r->flags.used = 0;
+  cache_entries--;
+  cache_free.push_back(r);
+}
+
+/* Helper for write_cache_items to sort by record number.  */
+static bool cmp_cache_item_recno(CACHE_CTRL a, CACHE_CTRL b) {
+  return a->recno < b->recno;
+}
+
+/*
+ * Write the N cached items at ITEMS, which must have consecutive
+ * record numbers, back to the trustdb file.
  *
  * Returns: 0 on success or an error code.
  */
-static int write_cache_item(CACHE_CTRL r) {
+static int write_cache_run(CACHE_CTRL *items, size_t n) {
   gpg_error_t err;
-  int n;
+  off_t offset = (off_t)items[0]->recno * TRUST_RECORD_LEN;
+  ssize_t nwritten;
+  size_t i;
+
+#ifdef HAVE_PWRITEV
+  struct iovec iov[MAX_WRITE_BATCH];
 
-  if (lseek(db_fd, r->recno * TRUST_RECORD_LEN, SEEK_SET) == -1) {
+  log_assert(n <= MAX_WRITE_BATCH);
+  for (i = 0; i < n; i++) {
+    iov[i].iov_base = items[i]->data;
+    iov[i].iov_len = TRUST_RECORD_LEN;
+  }
+  nwritten = pwritev(db_fd, iov, n, offset);
+  if (nwritten != (ssize_t)(n * TRUST_RECORD_LEN)) {
     err = gpg_error_from_syserror();
-    log_error(_("trustdb rec %lu: lseek failed: %s\n"), r->recno,
-              strerror(errno));
+    log_error(_("trustdb rec %lu: write failed (n=%d): %s\n"), items[0]->recno,
+              (int)nwritten, strerror(errno));
     return err;
   }
-  n = write(db_fd, r->data, TRUST_RECORD_LEN);
-  if (n != TRUST_RECORD_LEN) {
+#else
+  if (lseek(db_fd, offset, SEEK_SET) == -1) {
     err = gpg_error_from_syserror();
-    log_error(_("trustdb rec %lu: write failed (n=%d): %s\n"), r->recno, n,
+    log_error(_("trustdb rec %lu: lseek failed: %s\n"), items[0]->recno,
               strerror(errno));
     return err;
   }
-  r->flags.dirty = 0;
+  for (i = 0; i < n; i++) {
+    nwritten = write(db_fd, items[i]->data, TRUST_RECORD_LEN);
+    if (nwritten != TRUST_RECORD_LEN) {
+      err = gpg_error_from_syserror();
+      log_error(_("trustdb rec %lu: write failed (n=%d): %s\n"),
+                items[i]->recno, (int)nwritten, strerror(errno));
+      return err;
+    }
+  }
+#endif
+
+  for (i = 0; i < n; i++) {
+    items[i]->flags.dirty = 0;
+    cache_dirty_entries--;
+  }
+  return 0;
+}
+
+/*
+ * Write the dirty cached items in ITEMS back to the trustdb file.
+ * The items are sorted by record number so that runs of adjacent
+ * records are written with a single system call.
+ *
+ * Returns: 0 on success or an error code.
+ */
+static int write_cache_items(std::vector<CACHE_CTRL> &items) {
+  size_t i, n;
+  int rc;
+
+  std::sort(items.begin(), items.end(), cmp_cache_item_recno);
+  for (i = 0; i < items.size(); i += n) {
+    for (n = 1; i + n < items.size() && n < MAX_WRITE_BATCH &&
+                items[i + n]->recno == items[i]->recno + n;
+         n++)
+      ;
+    rc = write_cache_run(&items[i], n);
+    if (rc) return rc;
+  }
   return 0;
 }
 
@@ -186,62 +300,43 @@ static int write_cache_item(CACHE_CTRL r) {
  * Returns: 0 on success or an error code.
  */
 static int put_record_into_cache(unsigned long recno, const char *data) {
-  CACHE_CTRL r, unused;
-  int dirty_count = 0;
-  int clean_count = 0;
+  CACHE_CTRL r;
+  int clean_count;
+  auto it = cache_index.find(recno);
 
   /* See whether we already cached this one.  */
-  for (unused = NULL, r = cache_list; r; r = r->next) {
-    if (!r->flags.used) {
-      if (!unused) unused = r;
-    } else if (r->recno == recno) {
-      if (!r->flags.dirty) {
-        /* Hmmm: should we use a copy and compare? */
-        if (memcmp(r->data, data, TRUST_RECORD_LEN)) {
-          r->flags.dirty = 1;
-          cache_is_dirty = 1;
-        }
+  if (it != cache_index.end()) {
+    r = it->second;
+    if (!r->flags.dirty) {
+      /* Hmmm: should we use a copy and compare? */
+      if (memcmp(r->data, data, TRUST_RECORD_LEN)) {
+        r->flags.dirty = 1;
+        cache_dirty_entries++;
+        cache_is_dirty = 1;
       }
-      memcpy(r->data, data, TRUST_RECORD_LEN);
-      return 0;
-    }
-    if (r->flags.used) {
-      if (r->flags.dirty)
-        dirty_count++;
-      else
-        clean_count++;
     }
+    memcpy(r->data, data, TRUST_RECORD_LEN);
+    return 0;
   }
 
   /* Not in the cache: add a new entry. */
-  if (unused) {
+  if (!cache_free.empty()) {
     /* Reuse this entry. */
-    r = unused;
-    r->flags.used = 1;
-    r->recno = recno;
-    memcpy(r->data, data, TRUST_RECORD_LEN);
-    r->flags.dirty = 1;
-    cache_is_dirty = 1;
-    cache_entries++;
+    r = cache_free.back();
+    cache_free.pop_back();
+    fill_cache_item(r, recno, data);
     return 0;
   }
 
   /* See whether we reached the limit. */
   if (cache_entries < MAX_CACHE_ENTRIES_SOFT) {
     /* No: Put into cache.  */
-    r = (CACHE_CTRL)xmalloc(sizeof *r);
-    r->flags.used = 1;
-    r->recno = recno;
-    memcpy(r->data, data, TRUST_RECORD_LEN);
-    r->flags.dirty = 1;
-    r->next = cache_list;
-    cache_list = r;
-    cache_is_dirty = 1;
-    cache_entries++;
+    fill_cache_item(new_cache_item(), recno, data);
     return 0;
   }
 
   /* Cache is full: discard some clean entries.  */
+  clean_count = cache_entries - cache_dirty_entries;
   if (clean_count) {
     int n;
 
@@ -249,24 +344,18 @@ static int put_record_into_cache(unsigned long recno, const char *data) {
     n = clean_count / 3;
     if (!n) n = 1;
 
-    for (unused = NULL, r = cache_list; r; r = r->next) {
+    for (r = cache_list; r && n; r = r->next) {
       if (r->flags.used && !r->flags.dirty) {
-        if (!unused) unused = r;
-        r->flags.used = 0;
-        cache_entries--;
-        if (!--n) break;
+        discard_cache_item(r);
+        n--;
       }
     }
 
     /* Now put into the cache.  */
-    log_assert(unused);
-    r = unused;
-    r->flags.used = 1;
-    r->recno = recno;
-    memcpy(r->data, data, TRUST_RECORD_LEN);
-    r->flags.dirty = 1;
-    cache_is_dirty = 1;
-    cache_entries++;
+    log_assert(!cache_free.empty());
+    r = cache_free.back();
+    cache_free.pop_back();
+    fill_cache_item(r, recno, data);
     return 0;
   }
 
@@ -277,15 +366,7 @@ static int put_record_into_cache(unsigned long recno, const char *data) {
     if (cache_entries < MAX_CACHE_ENTRIES_HARD) {
       if (opt.debug && !(cache_entries % 100))
         log_debug("increasing tdbio cache size\n");
-      r = (CACHE_CTRL)xmalloc(sizeof *r);
-      r->flags.used = 1;
-      r->recno = recno;
-      memcpy(r->data, data, TRUST_RECORD_LEN);
-      r->flags.dirty = 1;
-      r->next = cache_list;
-      cache_list = r;
-      cache_is_dirty = 1;
-      cache_entries++;
+      fill_cache_item(new_cache_item(), recno, data);
       return 0;
     }
     /* Hard limit for the cache size reached.  */
@@ -293,37 +374,32 @@ static int put_record_into_cache(unsigned long recno, const char *data) {
     return GPG_ERR_RESOURCE_LIMIT;
   }
 
-  if (dirty_count) {
-    int n;
+  if (cache_dirty_entries) {
+    std::vector<CACHE_CTRL> victims;
+    int n, rc;
 
     /* Discard some dirty entries. */
-    n = dirty_count / 5;
+    n = cache_dirty_entries / 5;
     if (!n) n = 1;
 
-    take_write_lock();
-    for (unused = NULL, r = cache_list; r; r = r->next) {
+    for (r = cache_list; r && n; r = r->next) {
       if (r->flags.used && r->flags.dirty) {
-        int rc;
-
-        rc = write_cache_item(r);
-        if (rc) return rc;
-        if (!unused) unused = r;
-        r->flags.used = 0;
-        cache_entries--;
-        if (!--n) break;
+        victims.push_back(r);
+        n--;
       }
     }
+
+    take_write_lock();
+    rc = write_cache_items(victims);
     release_write_lock();
+    if (rc) return rc;
+
+    for (auto victim : victims) discard_cache_item(victim);
 
     /* Now put into the cache.  */
-    log_assert(unused);
-    r = unused;
-    r->flags.used = 1;
-    r->recno = recno;
-    memcpy(r->data, data, TRUST_RECORD_LEN);
-    r->flags.dirty = 1;
-    cache_is_dirty = 1;
-    cache_entries++;
+    r = cache_free.back();
+    cache_free.pop_back();
+    fill_cache_item(r, recno, data);
     return 0;
   }
 
@@ -334,12 +410,20 @@ static int put_record_into_cache(unsigned long recno, const char *data) {
 /* Return true if the cache is dirty.  */
 int tdbio_is_dirty() { return cache_is_dirty; }
 
+/* Return true if the trustdb could only be opened for reading.  */
+int tdbio_is_readonly() {
+  if (db_fd == -1) open_db();
+  return db_rdonly;
+}
+
 /*
  * Flush the cache.  This cannot be used while in a transaction.
  */
 int tdbio_sync() {
+  std::vector<CACHE_CTRL> dirty;
   CACHE_CTRL r;
   int did_lock = 0;
+  int rc;
 
   if (db_fd == -1) open_db();
   if (in_transaction) log_bug("tdbio: syncing while in transaction\n");
@@ -348,12 +432,13 @@ int tdbio_sync() {
 
   if (!take_write_lock()) did_lock = 1;
 
+  dirty.reserve(cache_dirty_entries);
   for (r = cache_list; r; r = r->next) {
-    if (r->flags.used && r->flags.dirty) {
-      int rc = write_cache_item(r);
-      if (rc) return rc;
-    }
+    if (r->flags.used && r->flags.dirty) dirty.push_back(r);
   }
+  rc = write_cache_items(dirty);
+  if (rc) return rc;
+
   cache_is_dirty = 0;
   if (did_lock) release_write_lock();
 
@@ -568,7 +653,10 @@ static void open_db() {
                       )) {
     /* Take care of read-only trustdbs.  */
     db_fd = open(db_name, O_RDONLY | MY_O_BINARY);
-    if (db_fd != -1 && !opt.quiet) log_info(_("Note: trustdb not writable\n"));
+    if (db_fd != -1) {
+      db_rdonly = 1;
+      if (!opt.quiet) log_info(_("Note: trustdb not writable\n"));
+    }
   }
   if (db_fd == -1)
     log_fatal(_("can't open '%s': %s\n"), db_name, strerror(errno));
@@ -702,6 +790,46 @@ int tdbio_write_nextcheck(ctrl_t ctrl, unsigned long stamp) {
   return 1;
 }
 
+/*
+ * Read and return the web of trust state (TDB_WOT_* flags) from the
+ * trustdb.  On a read problem the process is terminated.
+ */
+byte tdbio_read_wot_state(void) {
+  TRUSTREC vr;
+  int rc;
+
+  rc = tdbio_read_record(0, &vr, RECTYPE_VER);
+  if (rc)
+    log_fatal(_("%s: error reading version record: %s\n"), db_name,
+              gpg_strerror(rc));
+  return vr.r.ver.wot_state;
+}
+
+/*
+ * Write the web of trust state STATE to the trustdb.  On a read or
+ * write problem the process is terminated.
+ *
+ * Return: True if the state actually changed.
+ */
+int tdbio_write_wot_state(ctrl_t ctrl, byte state) {
+  TRUSTREC vr;
+  int rc;
+
+  rc = tdbio_read_record(0, &vr, RECTYPE_VER);
+  if (rc)
+    log_fatal(_("%s: error reading version record: %s\n"), db_name,
+              gpg_strerror(rc));
+
+  if (vr.r.ver.wot_state == state) return 0;
+
+  vr.r.ver.wot_state = state;
+  rc = tdbio_write_record(ctrl, &vr);
+  if (rc)
+    log_fatal(_("%s: error writing version record: %s\n"), db_name,
+              gpg_strerror(rc));
+  return 1;
+}
+
 /*
  * Return the record number of the trusthash table or create one if it
  * does not yet exist.  On a read or write problem the process is
@@ -1094,8 +1222,10 @@ void tdbio_dump_record(TRUSTREC *rec, estream_t fp) {
       es_fprintf(fp, "trust ");
       for (i = 0; i < 20; i++)
         es_fprintf(fp, "%02X", rec->r.trust.fingerprint[i]);
-      es_fprintf(fp, ", ot=%d, d=%d, vl=%lu\n", rec->r.trust.ownertrust,
-                 rec->r.trust.depth, rec->r.trust.validlist);
+      es_fprintf(fp, ", ot=%d, d=%d, vl=%lu, kd=%d, f=%d\n",
+                 rec->r.trust.ownertrust, rec->r.trust.depth,
+                 rec->r.trust.validlist, rec->r.trust.klist_depth,
+                 rec->r.trust.flags);
       break;
 
     case RECTYPE_VALID:
@@ -1128,12 +1258,17 @@ int tdbio_read_record(unsigned long recnum, TRUSTREC *rec, int expected) {
 
   buf = (const byte *)get_record_from_cache(recnum);
   if (!buf) {
+#ifdef HAVE_PREAD
+    n = pread(db_fd, readbuf, TRUST_RECORD_LEN,
+              (off_t)recnum * TRUST_RECORD_LEN);
+#else
     if (lseek(db_fd, recnum * TRUST_RECORD_LEN, SEEK_SET) == -1) {
       err = gpg_error_from_syserror();
       log_error(_("trustdb: lseek failed: %s\n"), strerror(errno));
       return err;
     }
     n = read(db_fd, readbuf, TRUST_RECORD_LEN);
+#endif
     if (!n) {
       return -1; /* eof */
     } else if (n != TRUST_RECORD_LEN) {
@@ -1169,7 +1304,8 @@ int tdbio_read_record(unsigned long recnum, TRUSTREC *rec, int expected) {
         rec->r.ver.cert_depth = *p++;
         rec->r.ver.trust_model = *p++;
         rec->r.ver.min_cert_level = *p++;
-        p += 2;
+        rec->r.ver.wot_state = *p++;
+        p++;
         rec->r.ver.created = buf32_to_ulong(p);
         p += 4;
         rec->r.ver.nextcheck = buf32_to_ulong(p);
@@ -1220,6 +1356,11 @@ int tdbio_read_record(unsigned long recnum, TRUSTREC *rec, int expected) {
       rec->r.trust.min_ownertrust = *p++;
       p++;
       rec->r.trust.validlist = buf32_to_ulong(p);
+      p += 4;
+      rec->r.trust.klist_depth = *p++;
+      rec->r.trust.trust_depth = *p++;
+      rec->r.trust.trust_value = *p++;
+      rec->r.trust.flags = *p++;
       break;
 
     case RECTYPE_VALID:
@@ -1275,7 +1416,8 @@ int tdbio_write_record(ctrl_t ctrl, TRUSTREC *rec) {
       *p++ = rec->r.ver.cert_depth;
       *p++ = rec->r.ver.trust_model;
       *p++ = rec->r.ver.min_cert_level;
-      p += 2;
+      *p++ = rec->r.ver.wot_state;
+      p++;
       ulongtobuf(p, rec->r.ver.created);
       p += 4;
       ulongtobuf(p, rec->r.ver.nextcheck);
@@ -1319,6 +1461,10 @@ int tdbio_write_record(ctrl_t ctrl, TRUSTREC *rec) {
       p++;
       ulongtobuf(p, rec->r.trust.validlist);
       p += 4;
+      *p++ = rec->r.trust.klist_depth;
+      *p++ = rec->r.trust.trust_depth;
+      *p++ = rec->r.trust.trust_value;
+      *p++ = rec->r.trust.flags;
       break;
 
     case RECTYPE_VALID:
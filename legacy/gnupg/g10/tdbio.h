@@ -40,6 +40,14 @@
 #define RECTYPE_VALID 13
 #define RECTYPE_FREE 254
 
+/* Flags for the wot_state field of the version record.  */
+#define TDB_WOT_INDEXED 1 /* Certifier depths are recorded.  */
+#define TDB_WOT_PENDING 2 /* Some keys need to be revalidated.  */
+
+/* Flags for the flags field of a trust record.  */
+#define TDB_TRUST_REGEXP 1  /* Certifier with a trust regexp.  */
+#define TDB_TRUST_PENDING 2 /* Key needs to be revalidated.  */
+
 struct trust_record {
   int rectype;
   int mark;
@@ -54,6 +62,7 @@ struct trust_record {
       byte cert_depth;
       byte trust_model;
       byte min_cert_level;
+      byte wot_state;          /* TDB_WOT_* flags */
       unsigned long created;   /* timestamp of trustdb creation  */
       unsigned long nextcheck; /* timestamp of next scheduled check */
       unsigned long reserved;
@@ -78,6 +87,10 @@ struct trust_record {
       byte depth;
       unsigned long validlist;
       byte min_ownertrust;
+      byte klist_depth; /* 1 + depth used as certifier, 0 if never.  */
+      byte trust_depth; /* Trust signature depth and value of the  */
+      byte trust_value; /* certifier.  */
+      byte flags;       /* TDB_TRUST_* flags */
     } trust;
     struct {
       byte namehash[20];
@@ -102,7 +115,10 @@ int tdbio_db_matches_options(void);
 byte tdbio_read_model(void);
 unsigned long tdbio_read_nextcheck(void);
 int tdbio_write_nextcheck(ctrl_t ctrl, unsigned long stamp);
+byte tdbio_read_wot_state(void);
+int tdbio_write_wot_state(ctrl_t ctrl, byte state);
 int tdbio_is_dirty(void);
+int tdbio_is_readonly(void);
 int tdbio_sync(void);
 int tdbio_delete_record(ctrl_t ctrl, unsigned long recnum);
 unsigned long tdbio_new_recnum(ctrl_t ctrl);
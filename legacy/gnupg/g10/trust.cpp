@@ -257,6 +257,14 @@ void revalidation_mark(ctrl_t ctrl) {
 #endif
 }
 
+void revalidation_mark_key(ctrl_t ctrl, PKT_public_key *pk) {
+#ifndef NO_TRUST_MODELS
+  tdb_revalidation_mark_key(ctrl, pk);
+#else
+  (void)pk;
+#endif
+}
+
 void check_trustdb_stale(ctrl_t ctrl) {
 #ifndef NO_TRUST_MODELS
   tdb_check_trustdb_stale(ctrl);
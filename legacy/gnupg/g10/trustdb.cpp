@@ -23,6 +23,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <thread>
+#include <vector>
+
 #ifndef DISABLE_REGEX
 #include <regex.h>
 #include <sys/types.h>
@@ -66,6 +69,7 @@ static struct key_item *utk_list;      /* all ultimately trusted keys */
 static int pending_check_trustdb;
 
 static int validate_keys(ctrl_t ctrl, int interactive);
+static int read_trust_record(ctrl_t ctrl, PKT_public_key *pk, TRUSTREC *rec);
 
 /**********************************************
  ************* some helpers *******************
@@ -430,12 +434,13 @@ void check_trustdb(ctrl_t ctrl) {
       unsigned long scheduled;
 
       scheduled = tdbio_read_nextcheck();
-      if (!scheduled) {
+      if (!scheduled && !(tdbio_read_wot_state() & TDB_WOT_PENDING)) {
         log_info(_("no need for a trustdb check\n"));
         return;
       }
 
-      if (scheduled > make_timestamp()) {
+      if (scheduled > make_timestamp() &&
+          !(tdbio_read_wot_state() & TDB_WOT_PENDING)) {
         log_info(_("next trustdb check due at %s\n"), strtimestamp(scheduled));
         return;
       }
@@ -469,6 +474,56 @@ void tdb_revalidation_mark(ctrl_t ctrl) {
   pending_check_trustdb = 1;
 }
 
+/*
+ * Mark the key PK as changed.  Unlike tdb_revalidation_mark this does
+ * not schedule a full check; instead the next check only revalidates
+ * the marked keys, unless it finds that the change may affect other
+ * keys as well.  This requires that the last full check recorded the
+ * certifier depths, otherwise a full check is scheduled.
+ */
+void tdb_revalidation_mark_key(ctrl_t ctrl, PKT_public_key *pk) {
+  TRUSTREC rec;
+  gpg_error_t err;
+  byte state;
+
+  init_trustdb(ctrl, 0);
+  if (trustdb_args.no_trustdb && opt.trust_model == TM_ALWAYS) return;
+
+  state = tdbio_read_wot_state();
+  if (tdbio_is_readonly()) {
+    /* Like tdb_revalidation_mark only schedule a check; it can't be
+       recorded in a read-only trustdb anyway.  */
+    pending_check_trustdb = 1;
+    return;
+  }
+  if (!(state & TDB_WOT_INDEXED)) {
+    tdb_revalidation_mark(ctrl);
+    return;
+  }
+
+  err = read_trust_record(ctrl, pk, &rec);
+  if (err == GPG_ERR_NOT_FOUND) { /* no record yet - create a new one */
+    size_t dummy;
+
+    memset(&rec, 0, sizeof rec);
+    rec.recnum = tdbio_new_recnum(ctrl);
+    rec.rectype = RECTYPE_TRUST;
+    fingerprint_from_pk(pk, rec.r.trust.fingerprint, &dummy);
+  } else if (err) {
+    tdbio_invalid();
+    return;
+  }
+
+  if (DBG_TRUST)
+    log_debug("key %s: marked for revalidation\n", keystr_from_pk(pk));
+
+  rec.r.trust.flags |= TDB_TRUST_PENDING;
+  write_record(ctrl, &rec);
+  tdbio_write_wot_state(ctrl, state | TDB_WOT_PENDING);
+  do_sync();
+  pending_check_trustdb = 1;
+}
+
 int trustdb_pending_check(void) { return pending_check_trustdb; }
 
 /* If the trustdb is dirty, and we're interactive, update it.
@@ -804,7 +859,8 @@ void tdb_check_trustdb_stale(ctrl_t ctrl) {
 
     did_nextcheck = 1;
     scheduled = tdbio_read_nextcheck();
-    if ((scheduled && scheduled <= make_timestamp()) || pending_check_trustdb) {
+    if ((scheduled && scheduled <= make_timestamp()) || pending_check_trustdb ||
+        (tdbio_read_wot_state() & TDB_WOT_PENDING)) {
       if (opt.no_auto_check_trustdb) {
         pending_check_trustdb = 1;
         if (!opt.quiet) log_info(_("please do a --check-trustdb\n"));
@@ -1361,18 +1417,142 @@ static int search_skipfnc(void *opaque, u32 *kid, int dummy_uid_no) {
   return test_key_hash_table((KeyHashTable)opaque, kid);
 }
 
+/* Number of keyblocks whose certifications are verified together.  */
+#define VALIDATE_BATCH_SIZE 256
+
+/* Return the number of threads to use for verifying certifications.  */
+static int validate_thread_count(void) {
+  int n = opt.wot_threads;
+
+  if (n <= 0) n = std::thread::hardware_concurrency();
+  return n > 0 ? n : 1;
+}
+
+/*
+ * Verify the certifications from keys in KLIST on the keyblocks in
+ * BATCH concurrently.  This only fills the signature cache of the
+ * packets; mark_usable_uid_certs then uses the cached results.  The
+ * selection of signatures matches the one done there.
+ */
+static void precheck_key_list_certs(ctrl_t ctrl,
+                                    const std::vector<KBNODE> &batch,
+                                    struct key_item *klist, int nthreads) {
+  std::vector<KBNODE> roots, nodes;
+
+  for (KBNODE kb : batch) {
+    PKT_public_key *pk = kb->pkt->pkt.public_key;
+    KBNODE node;
+    int use_uid = 0;
+    u32 main_kid[2];
+
+    if (pk->has_expired || pk->flags.revoked) continue;
+    keyid_from_pk(pk, main_kid);
+    for (node = kb; node; node = node->next) {
+      PKT_signature *sig;
+
+      if (node->pkt->pkttype == PKT_USER_ID) {
+        use_uid = !node->pkt->pkt.user_id->flags.revoked &&
+                  !node->pkt->pkt.user_id->flags.expired;
+        continue;
+      }
+      if (node->pkt->pkttype == PKT_PUBLIC_SUBKEY) break;
+      if (!use_uid || node->pkt->pkttype != PKT_SIGNATURE) continue;
+      sig = node->pkt->pkt.signature;
+      if (sig->keyid[0] == main_kid[0] && sig->keyid[1] == main_kid[1])
+        continue;
+      if (!IS_UID_SIG(sig) && !IS_UID_REV(sig)) continue;
+      if (sig->sig_class >= 0x11 && sig->sig_class <= 0x13 &&
+          sig->sig_class - 0x10 < opt.min_cert_level)
+        continue;
+      if (!is_in_klist(klist, sig)) continue;
+      roots.push_back(kb);
+      nodes.push_back(node);
+    }
+  }
+
+  if (!nodes.empty())
+    check_key_signatures_mt(ctrl, roots.data(), nodes.data(), nodes.size(),
+                            nthreads);
+}
+
+/*
+ * Validate the keyblocks in BATCH in order and append the suitable
+ * ones to the key_array KEYS.  All keyblocks in BATCH are consumed.
+ */
+static void validate_key_batch(ctrl_t ctrl, std::vector<KBNODE> &batch,
+                               KeyHashTable full_trust, struct key_item *klist,
+                               u32 curtime, u32 *next_expire,
+                               struct key_array **keys, size_t *nkeys,
+                               size_t *maxkeys) {
+  int nthreads = validate_thread_count();
+
+  if (nthreads > 1 && batch.size() > 1)
+    precheck_key_list_certs(ctrl, batch, klist, nthreads);
+
+  for (KBNODE keyblock : batch) {
+    PKT_public_key *pk = keyblock->pkt->pkt.public_key;
+    u32 kid[2];
+
+    /* The keyblock has been read before the previous ones in the
+       batch have been validated; skip it if the search would have
+       done so.  */
+    keyid_from_pk(pk, kid);
+    if (test_key_hash_table(full_trust, kid)) {
+      release_kbnode(keyblock);
+      continue;
+    }
+
+    if (pk->has_expired || pk->flags.revoked) {
+      /* it does not make sense to look further at those keys */
+      mark_keyblock_seen(full_trust, keyblock);
+    } else if (validate_one_keyblock(ctrl, keyblock, klist, curtime,
+                                     next_expire)) {
+      KBNODE node;
+
+      if (pk->expiredate && pk->expiredate >= curtime &&
+          pk->expiredate < *next_expire)
+        *next_expire = pk->expiredate;
+
+      if (*nkeys == *maxkeys) {
+        *maxkeys += 1000;
+        *keys = (key_array *)xrealloc(*keys, (*maxkeys + 1) * sizeof **keys);
+      }
+      (*keys)[(*nkeys)++].keyblock = keyblock;
+
+      /* Optimization - if all uids are fully trusted, then we
+         never need to consider this key as a candidate again. */
+
+      for (node = keyblock; node; node = node->next)
+        if (node->pkt->pkttype == PKT_USER_ID && !(node->flag & 4)) break;
+
+      if (node == NULL) mark_keyblock_seen(full_trust, keyblock);
+
+      continue;
+    }
+
+    release_kbnode(keyblock);
+  }
+  batch.clear();
+}
+
 /*
  * Scan all keys and return a key_array of all suitable keys from
  * kllist.  The caller has to pass keydb handle so that we don't use
  * to create our own.  Returns either a key_array or NULL in case of
  * an error.  No results found are indicated by an empty array.
  * Caller hast to release the returned array.
+ *
+ * Keyblocks are read in batches of VALIDATE_BATCH_SIZE so that the
+ * certifications to check can be verified on several threads (see
+ * --wot-threads); the validation itself is still done in keyring
+ * order and yields the same result as a sequential run.
  */
 static struct key_array *validate_key_list(ctrl_t ctrl, KEYDB_HANDLE hd,
                                            KeyHashTable full_trust,
                                            struct key_item *klist, u32 curtime,
                                            u32 *next_expire) {
   KBNODE keyblock = NULL;
+  std::vector<KBNODE> batch;
   struct key_array *keys = NULL;
   size_t nkeys, maxkeys;
   int rc;
@@ -1405,8 +1585,6 @@ static struct key_array *validate_key_list(ctrl_t ctrl, KEYDB_HANDLE hd,
 
   desc.mode = KEYDB_SEARCH_MODE_NEXT; /* change mode */
   do {
-    PKT_public_key *pk;
-
     rc = keydb_get_keyblock(hd, &keyblock);
     if (rc) {
       log_error("keydb_get_keyblock failed: %s\n", gpg_strerror(rc));
@@ -1424,37 +1602,12 @@ static struct key_array *validate_key_list(ctrl_t ctrl, KEYDB_HANDLE hd,
     /* prepare the keyblock for further processing */
     merge_keys_and_selfsig(ctrl, keyblock);
     clear_kbnode_flags(keyblock);
-    pk = keyblock->pkt->pkt.public_key;
-    if (pk->has_expired || pk->flags.revoked) {
-      /* it does not make sense to look further at those keys */
-      mark_keyblock_seen(full_trust, keyblock);
-    } else if (validate_one_keyblock(ctrl, keyblock, klist, curtime,
-                                     next_expire)) {
-      KBNODE node;
-
-      if (pk->expiredate && pk->expiredate >= curtime &&
-          pk->expiredate < *next_expire)
-        *next_expire = pk->expiredate;
-
-      if (nkeys == maxkeys) {
-        maxkeys += 1000;
-        keys = (key_array *)xrealloc(keys, (maxkeys + 1) * sizeof *keys);
-      }
-      keys[nkeys++].keyblock = keyblock;
-
-      /* Optimization - if all uids are fully trusted, then we
-         never need to consider this key as a candidate again. */
-
-      for (node = keyblock; node; node = node->next)
-        if (node->pkt->pkttype == PKT_USER_ID && !(node->flag & 4)) break;
-
-      if (node == NULL) mark_keyblock_seen(full_trust, keyblock);
-
-      keyblock = NULL;
-    }
-
-    release_kbnode(keyblock);
+    batch.push_back(keyblock);
     keyblock = NULL;
+
+    if (batch.size() >= VALIDATE_BATCH_SIZE)
+      validate_key_batch(ctrl, batch, full_trust, klist, curtime, next_expire,
+                         &keys, &nkeys, &maxkeys);
   } while (!(rc = keydb_search(hd, &desc, 1, NULL)));
 
   if (rc && rc != GPG_ERR_NOT_FOUND) {
@@ -1462,10 +1615,14 @@ static struct key_array *validate_key_list(ctrl_t ctrl, KEYDB_HANDLE hd,
     goto die;
   }
 
+  validate_key_batch(ctrl, batch, full_trust, klist, curtime, next_expire,
+                     &keys, &nkeys, &maxkeys);
+
   keys[nkeys].keyblock = NULL;
   return keys;
 
 die:
+  for (KBNODE kb : batch) release_kbnode(kb);
   keys[nkeys].keyblock = NULL;
   release_key_array(keys);
   return NULL;
@@ -1480,8 +1637,13 @@ static void reset_trust_records(ctrl_t ctrl) {
   for (recnum = 1; !tdbio_read_record(recnum, &rec, 0); recnum++) {
     if (rec.rectype == RECTYPE_TRUST) {
       count++;
-      if (rec.r.trust.min_ownertrust) {
+      if (rec.r.trust.min_ownertrust || rec.r.trust.klist_depth ||
+          rec.r.trust.flags) {
         rec.r.trust.min_ownertrust = 0;
+        rec.r.trust.klist_depth = 0;
+        rec.r.trust.trust_depth = 0;
+        rec.r.trust.trust_value = 0;
+        rec.r.trust.flags = 0;
         write_record(ctrl, &rec);
       }
 
@@ -1503,6 +1665,269 @@ static void reset_trust_records(ctrl_t ctrl) {
   }
 }
 
+/*
+ * Record in the trust record of PK that the key K has been added to
+ * the list of certifiers for DEPTH.  This is what
+ * revalidate_pending_key needs to know about the certifiers of a key.
+ *
+ * Note: Caller has to do a sync.
+ */
+static void store_klist_info(ctrl_t ctrl, PKT_public_key *pk,
+                             struct key_item *k, int depth) {
+  TRUSTREC rec;
+  gpg_error_t err;
+
+  err = read_trust_record(ctrl, pk, &rec);
+  if (err == GPG_ERR_NOT_FOUND) { /* no record yet - create a new one */
+    size_t dummy;
+
+    memset(&rec, 0, sizeof rec);
+    rec.recnum = tdbio_new_recnum(ctrl);
+    rec.rectype = RECTYPE_TRUST;
+    fingerprint_from_pk(pk, rec.r.trust.fingerprint, &dummy);
+  } else if (err) {
+    tdbio_invalid();
+    return;
+  }
+
+  rec.r.trust.klist_depth = depth + 1;
+  rec.r.trust.trust_depth = k->trust_depth;
+  rec.r.trust.trust_value = k->trust_value;
+  if (k->trust_regexp) rec.r.trust.flags |= TDB_TRUST_REGEXP;
+  write_record(ctrl, &rec);
+}
+
+/*
+ * Revalidate the key with the trust record TREC, which has been
+ * marked by tdb_revalidation_mark_key.  This repeats the steps of
+ * validate_keys for this single key, but takes the certifiers of each
+ * depth from the trust records written by the last full check instead
+ * of scanning the whole keyring.  NDEPTHS is the number of depths the
+ * last full check went through.
+ *
+ * Returns: True if the change may affect the validity of other keys,
+ *          in which case a full check is required.
+ *
+ * Note: Caller has to do a sync.
+ */
+static int revalidate_pending_key(ctrl_t ctrl, TRUSTREC *trec, int ndepths,
+                                  u32 curtime, u32 *next_expire) {
+  std::vector<struct key_item *> klists(ndepths, NULL);
+  KeyHashTable seen, stored;
+  KBNODE keyblock, node;
+  PKT_public_key *pk;
+  TRUSTREC rec;
+  unsigned long recno;
+  u32 kid[2];
+  int depth;
+  int klist_depth = 0;
+  int need_full = 0;
+
+  /* A key with ownertrust or a trust signature changes the validity
+     of the keys it certifies.  */
+  if ((trec->r.trust.ownertrust & TRUST_MASK) >= TRUST_MARGINAL ||
+      trec->r.trust.min_ownertrust >= TRUST_MARGINAL ||
+      trec->r.trust.trust_depth || trec->r.trust.trust_value)
+    return 1;
+
+  if (get_pubkey_byfprint(ctrl, NULL, &keyblock, trec->r.trust.fingerprint,
+                          20)) {
+    /* The key has been deleted.  Unless it was a certifier, there is
+       nothing left to revalidate; drop the mark.  */
+    if (trec->r.trust.klist_depth) return 1;
+    read_record(trec->recnum, &rec, RECTYPE_TRUST);
+    rec.r.trust.flags &= ~TDB_TRUST_PENDING;
+    write_record(ctrl, &rec);
+    return 0;
+  }
+
+  keyid_from_pk(keyblock->pkt->pkt.public_key, kid);
+  if (tdb_keyid_is_utk(kid)) {
+    release_kbnode(keyblock);
+    return 1;
+  }
+
+  /* Collect all certifiers of the key by the depth at which the last
+     full check used them.  */
+  seen = new_key_hash_table();
+  for (node = keyblock; node && !need_full; node = node->next) {
+    PKT_signature *sig;
+    PKT_public_key *spk;
+    struct key_item *k;
+
+    if (node->pkt->pkttype != PKT_SIGNATURE) continue;
+    sig = node->pkt->pkt.signature;
+    if ((sig->keyid[0] == kid[0] && sig->keyid[1] == kid[1]) ||
+        test_key_hash_table(seen, sig->keyid))
+      continue;
+    add_key_hash_table(seen, sig->keyid);
+
+    spk = (PKT_public_key *)xmalloc_clear(sizeof *spk);
+    if (!get_pubkey(ctrl, spk, sig->keyid) &&
+        !read_trust_record(ctrl, spk, &rec) && rec.r.trust.klist_depth &&
+        rec.r.trust.klist_depth <= ndepths) {
+      if ((rec.r.trust.flags & TDB_TRUST_REGEXP)) need_full = 1;
+
+      k = new_key_item();
+      k->kid[0] = sig->keyid[0];
+      k->kid[1] = sig->keyid[1];
+      if (tdb_keyid_is_utk(sig->keyid))
+        k->ownertrust = TRUST_ULTIMATE;
+      else
+        k->ownertrust = (rec.r.trust.ownertrust & TRUST_MASK);
+      k->min_ownertrust = rec.r.trust.min_ownertrust;
+      if (k->ownertrust < k->min_ownertrust) k->ownertrust = k->min_ownertrust;
+      k->trust_depth = rec.r.trust.trust_depth;
+      k->trust_value = rec.r.trust.trust_value;
+      k->next = klists[rec.r.trust.klist_depth - 1];
+      klists[rec.r.trust.klist_depth - 1] = k;
+    }
+    free_public_key(spk);
+  }
+  release_key_hash_table(seen);
+  release_kbnode(keyblock);
+
+  /* Clear the old validity of the key.  */
+  recno = trec->r.trust.validlist;
+  while (recno && !need_full) {
+    read_record(recno, &rec, RECTYPE_VALID);
+    if ((rec.r.valid.validity & TRUST_MASK) || rec.r.valid.marginal_count ||
+        rec.r.valid.full_count) {
+      rec.r.valid.validity &= ~TRUST_MASK;
+      rec.r.valid.marginal_count = rec.r.valid.full_count = 0;
+      write_record(ctrl, &rec);
+    }
+    recno = rec.r.valid.next;
+  }
+
+  stored = new_key_hash_table();
+  for (depth = 0; depth < ndepths && !need_full; depth++) {
+    struct key_item *klist = klists[depth];
+    int any_full = 0, all_full = 1;
+
+    keyblock = get_pubkeyblock(ctrl, kid);
+    if (!keyblock) break;
+    merge_keys_and_selfsig(ctrl, keyblock);
+    clear_kbnode_flags(keyblock);
+    pk = keyblock->pkt->pkt.public_key;
+    if (pk->has_expired || pk->flags.revoked) {
+      /* it does not make sense to look further at those keys */
+      release_kbnode(keyblock);
+      break;
+    }
+
+    if (!klist) {
+      /* Without certifiers validate_one_keyblock only looks at the
+         expiration of the user IDs.  */
+      for (node = keyblock; node; node = node->next) {
+        PKT_user_id *uid;
+
+        if (node->pkt->pkttype != PKT_USER_ID) continue;
+        uid = node->pkt->pkt.user_id;
+        if (!uid->flags.revoked && !uid->flags.expired && uid->expiredate &&
+            uid->expiredate < *next_expire)
+          *next_expire = uid->expiredate;
+      }
+    } else if (validate_one_keyblock(ctrl, keyblock, klist, curtime,
+                                     next_expire)) {
+      if (pk->expiredate && pk->expiredate >= curtime &&
+          pk->expiredate < *next_expire)
+        *next_expire = pk->expiredate;
+
+      store_validation_status(ctrl, depth, keyblock, stored);
+
+      for (node = keyblock; node; node = node->next) {
+        if (node->pkt->pkttype != PKT_USER_ID) continue;
+        if ((node->flag & 4))
+          any_full = 1;
+        else
+          all_full = 0;
+      }
+
+      /* The key is now a certifier for the next depth.  */
+      if (any_full && !klist_depth) {
+        klist_depth = depth + 2;
+        if (pk->trust_depth || pk->trust_value || pk->trust_regexp)
+          need_full = 1;
+      }
+    } else
+      all_full = 0;
+
+    release_kbnode(keyblock);
+
+    /* A fully valid key is never considered again.  */
+    if (all_full) break;
+  }
+  release_key_hash_table(stored);
+
+  for (depth = 0; depth < ndepths; depth++) release_key_items(klists[depth]);
+
+  /* The keys certified by this key see a different list of
+     certifiers.  */
+  if (klist_depth != trec->r.trust.klist_depth) need_full = 1;
+
+  if (!need_full) {
+    read_record(trec->recnum, &rec, RECTYPE_TRUST);
+    rec.r.trust.flags &= ~TDB_TRUST_PENDING;
+    write_record(ctrl, &rec);
+  }
+
+  return need_full;
+}
+
+/*
+ * Revalidate the keys marked by tdb_revalidation_mark_key without a
+ * full check of the trustdb.
+ *
+ * Returns: True if a full check is required instead.
+ */
+static int validate_pending_keys(ctrl_t ctrl) {
+  std::vector<TRUSTREC> pending;
+  TRUSTREC rec;
+  unsigned long recnum, scheduled;
+  u32 start_time, next_expire;
+  int ndepths = 0;
+  byte state;
+
+  state = tdbio_read_wot_state();
+  if (!(state & TDB_WOT_INDEXED) || !(state & TDB_WOT_PENDING)) return 1;
+  if (!tdbio_db_matches_options()) return 1;
+
+  start_time = make_timestamp();
+  scheduled = tdbio_read_nextcheck();
+  if (scheduled && scheduled <= start_time) return 1;
+
+  for (recnum = 1; !tdbio_read_record(recnum, &rec, 0); recnum++) {
+    if (rec.rectype != RECTYPE_TRUST) continue;
+    if (rec.r.trust.klist_depth > ndepths) ndepths = rec.r.trust.klist_depth;
+    if ((rec.r.trust.flags & TDB_TRUST_PENDING)) pending.push_back(rec);
+  }
+  if (ndepths > opt.max_cert_depth) ndepths = opt.max_cert_depth;
+
+  next_expire = scheduled ? scheduled : 0xffffffff;
+  for (auto &trec : pending) {
+    if (revalidate_pending_key(ctrl, &trec, ndepths, start_time,
+                               &next_expire)) {
+      if (DBG_TRUST) log_debug("revalidation requires a full check\n");
+      return 1;
+    }
+  }
+
+  if (next_expire == 0xffffffff || next_expire < start_time)
+    tdbio_write_nextcheck(ctrl, 0);
+  else
+    tdbio_write_nextcheck(ctrl, next_expire);
+  tdbio_write_wot_state(ctrl, TDB_WOT_INDEXED);
+  do_sync();
+  pending_check_trustdb = 0;
+
+  if (!opt.quiet)
+    log_info(ngettext("%d key revalidated\n", "%d keys revalidated\n",
+                      (int)pending.size()),
+             (int)pending.size());
+  return 0;
+}
+
 /*
  * Run the key validation procedure.
  *
@@ -1526,6 +1951,8 @@ static void reset_trust_records(ctrl_t ctrl) {
  *           End Loop
  *         Ready
  *
+ * Unless INTERACTIVE is set, only the keys marked by
+ * tdb_revalidation_mark_key are revalidated if that is sufficient.
  */
 static int validate_keys(ctrl_t ctrl, int interactive) {
   int rc = 0;
@@ -1541,6 +1968,8 @@ static int validate_keys(ctrl_t ctrl, int interactive) {
   KeyHashTable stored, used, full_trust;
   u32 start_time, next_expire;
 
+  if (!interactive && !validate_pending_keys(ctrl)) return 0;
+
   kdb = keydb_new();
   if (!kdb) return gpg_error_from_syserror();
 
@@ -1580,6 +2009,7 @@ static int validate_keys(ctrl_t ctrl, int interactive) {
       if (node->pkt->pkttype == PKT_USER_ID)
         update_validity(ctrl, pk, node->pkt->pkt.user_id, 0, TRUST_ULTIMATE);
     }
+    store_klist_info(ctrl, pk, k, 0);
     if (pk->expiredate && pk->expiredate >= start_time &&
         pk->expiredate < next_expire)
       next_expire = pk->expiredate;
@@ -1708,6 +2138,8 @@ static int validate_keys(ctrl_t ctrl, int interactive) {
                               kar->keyblock->pkt->pkt.public_key->trust_regexp);
             k->next = klist;
             klist = k;
+            store_klist_info(ctrl, kar->keyblock->pkt->pkt.public_key, k,
+                             depth + 1);
             break;
           }
         }
@@ -1738,6 +2170,8 @@ leave:
                  strtimestamp(next_expire));
     }
 
+    tdbio_write_wot_state(ctrl, TDB_WOT_INDEXED);
+
     rc2 = tdbio_update_version_record(ctrl);
     if (rc2) {
       log_error(_("unable to update trustdb version record: "
@@ -0,0 +1,108 @@
+/* assuan-socket-connect.c - Assuan socket based client
+   Copyright (C) 2002, 2003, 2004, 2009 Free Software Foundation, Inc.
+
+   This file is part of Assuan.
+
+   Assuan is free software; you can redistribute it and/or modify it
+   under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation; either version 2.1 of
+   the License, or (at your option) any later version.
+
+   Assuan is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifndef HAVE_W32_SYSTEM
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#endif
+
+#include "assuan-defs.h"
+#include "debug.h"
+
+/* Make a connection to the Unix domain socket NAME and return a new
+   Assuan context in CTX.  SERVER_PID is currently not used but may
+   become handy in the future.  FLAGS is a bit vector and is
+   currently not used; pass 0.  This is the counterpart to a server
+   which accepts connections on a listening socket and runs one
+   pipe server per connection on the connected socket.  */
+gpg_error_t assuan_socket_connect(assuan_context_t ctx, const char *name,
+                                  pid_t server_pid, unsigned int flags) {
+#ifdef HAVE_W32_SYSTEM
+  (void)ctx;
+  (void)name;
+  (void)server_pid;
+  (void)flags;
+  return GPG_ERR_NOT_IMPLEMENTED;
+#else
+  gpg_error_t err;
+  assuan_response_t response;
+  int off;
+  int fd;
+  struct sockaddr_un srvr_addr;
+
+  TRACE_BEG2(ctx, ASSUAN_LOG_CTX, "assuan_socket_connect", ctx,
+             "name=%s, flags=0x%x", name ? name : "(null)", flags);
+  (void)server_pid;
+
+  if (!ctx || !name) return TRACE_ERR(GPG_ERR_ASS_INV_VALUE);
+
+  if (strlen(name) + 1 >= sizeof srvr_addr.sun_path)
+    return TRACE_ERR(GPG_ERR_ASS_INV_VALUE);
+
+  fd = _assuan_socket(ctx, PF_LOCAL, SOCK_STREAM, 0);
+  if (fd == -1) return TRACE_ERR(gpg_error_from_syserror());
+
+  memset(&srvr_addr, 0, sizeof srvr_addr);
+  srvr_addr.sun_family = AF_LOCAL;
+  strcpy(srvr_addr.sun_path, name);
+
+  if (_assuan_connect(ctx, fd, (struct sockaddr *)&srvr_addr,
+                      offsetof(struct sockaddr_un, sun_path) +
+                          strlen(srvr_addr.sun_path) + 1) == -1) {
+    TRACE2(ctx, ASSUAN_LOG_SYSIO, "assuan_socket_connect", ctx,
+           "can't connect to `%s': %s\n", name, strerror(errno));
+    _assuan_close(ctx, fd);
+    return TRACE_ERR(GPG_ERR_ASS_CONNECT_FAILED);
+  }
+
+  ctx->engine.release = _assuan_client_release;
+  ctx->finish_handler = _assuan_client_finish;
+  ctx->max_accepts = 1;
+  ctx->accept_handler = NULL;
+  ctx->inbound.fd = fd;
+  ctx->outbound.fd = fd;
+  /* The server is not our child, so there is nothing to wait for.  */
+  ctx->pid = ASSUAN_INVALID_PID;
+  _assuan_init_uds_io(ctx);
+
+  /* Initial handshake.  */
+  err = _assuan_read_from_server(ctx, &response, &off, 0);
+  if (err)
+    TRACE1(ctx, ASSUAN_LOG_SYSIO, "assuan_socket_connect", ctx,
+           "can't connect to server: %s\n", gpg_strerror(err));
+  else if (response != ASSUAN_RESPONSE_OK) {
+    TRACE1(ctx, ASSUAN_LOG_SYSIO, "assuan_socket_connect", ctx,
+           "can't connect to server: `%s'\n", ctx->inbound.line);
+    err = GPG_ERR_ASS_CONNECT_FAILED;
+  }
+
+  if (err) _assuan_reset(ctx);
+
+  return TRACE_ERR(err);
+#endif
+}
@@ -325,6 +325,10 @@ gpg_error_t assuan_pipe_connect(assuan_context_t ctx, const char *name,
                                 void (*atfork)(void *, int), void *atforkvalue,
                                 unsigned int flags);
 
+/*-- assuan-socket-connect.c --*/
+gpg_error_t assuan_socket_connect(assuan_context_t ctx, const char *name,
+                                  pid_t server_pid, unsigned int flags);
+
 /*-- context.c --*/
 pid_t assuan_get_pid(assuan_context_t ctx);
 
@@ -0,0 +1,175 @@
+/* socketconnect - Check connecting to a server on a Unix domain socket.
+   Copyright 2017 The NeoPG developers
+
+   NeoPG is released under the Simplified BSD License (see license.txt)
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../src/assuan.h"
+#include "common.h"
+
+/*
+
+       S E R V E R
+
+*/
+
+static gpg_error_t cmd_echo(assuan_context_t ctx, char *line) {
+  log_info("got ECHO command (%s)\n", line);
+  return assuan_send_data(ctx, line, strlen(line));
+}
+
+/* Serve the connection FD the way a daemon does: one pipe server per
+   accepted connection, using the socket for both directions.  */
+static void server(int fd) {
+  int rc;
+  assuan_context_t ctx;
+  assuan_fd_t filedes[2];
+
+  rc = assuan_new(&ctx);
+  if (rc) log_fatal("assuan_new failed: %s\n", gpg_strerror(rc));
+
+  filedes[0] = fd;
+  filedes[1] = fd;
+  rc = assuan_init_pipe_server(ctx, filedes);
+  if (rc) log_fatal("assuan_init_pipe_server failed: %s\n", gpg_strerror(rc));
+
+  rc = assuan_register_command(ctx, "ECHO", cmd_echo, NULL);
+  if (rc) log_fatal("assuan_register_command failed: %s\n", gpg_strerror(rc));
+
+  for (;;) {
+    rc = assuan_accept(ctx);
+    if (rc) {
+      if (rc != -1) log_error("assuan_accept failed: %s\n", gpg_strerror(rc));
+      break;
+    }
+
+    rc = assuan_process(ctx);
+    if (rc) log_error("assuan_process failed: %s\n", gpg_strerror(rc));
+  }
+
+  assuan_release(ctx);
+}
+
+/*
+
+       C L I E N T
+
+*/
+
+static gpg_error_t data_cb(void *opaque, const void *buffer, size_t length) {
+  size_t *total = (size_t *)opaque;
+
+  *total += length;
+  return 0;
+}
+
+static void client(const char *name) {
+  gpg_error_t err;
+  assuan_context_t ctx;
+  size_t total;
+  int i;
+
+  err = assuan_new(&ctx);
+  if (err) log_fatal("assuan_new failed: %s\n", gpg_strerror(err));
+
+  err = assuan_socket_connect(ctx, name, 0, 0);
+  if (err) {
+    log_error("assuan_socket_connect failed: %s\n", gpg_strerror(err));
+    errorcount++;
+    assuan_release(ctx);
+    return;
+  }
+
+  for (i = 0; i < 3; i++) {
+    total = 0;
+    err = assuan_transact(ctx, "ECHO hello", data_cb, &total, NULL, NULL,
+                          NULL, NULL);
+    if (err) {
+      log_error("sending ECHO failed: %s\n", gpg_strerror(err));
+      errorcount++;
+    } else if (total != 5) {
+      log_error("ECHO returned %u bytes instead of 5\n", (unsigned int)total);
+      errorcount++;
+    }
+  }
+
+  assuan_release(ctx);
+}
+
+/*
+
+     M A I N
+
+*/
+int socketconnect_main(int argc, char **argv) {
+  struct sockaddr_un addr;
+  char name[] = "/tmp/assuan-test-XXXXXX";
+  char *sockname;
+  int listen_fd;
+  pid_t pid;
+  int status;
+
+  (void)argc;
+  (void)argv;
+  assuan_set_assuan_log_prefix(log_prefix);
+
+  if (!mkdtemp(name)) log_fatal("mkdtemp failed: %s\n", strerror(errno));
+  sockname = xstrconcat(name, "/S.test", NULL);
+
+  memset(&addr, 0, sizeof addr);
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, sockname);
+  listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd == -1 ||
+      bind(listen_fd, (struct sockaddr *)&addr, SUN_LEN(&addr)) ||
+      listen(listen_fd, 1))
+    log_fatal("can't create socket: %s\n", strerror(errno));
+
+  /* Connecting to a socket nobody listens on must fail cleanly.  */
+  {
+    assuan_context_t ctx;
+    char *noname = xstrconcat(name, "/S.none", NULL);
+
+    assuan_new(&ctx);
+    if (!assuan_socket_connect(ctx, noname, 0, 0)) {
+      log_error("connecting to a missing socket succeeded\n");
+      errorcount++;
+    }
+    assuan_release(ctx);
+    xfree(noname);
+  }
+
+  pid = fork();
+  if (pid == (pid_t)-1) log_fatal("fork failed: %s\n", strerror(errno));
+  if (!pid) {
+    int fd = accept(listen_fd, NULL, NULL);
+
+    if (fd == -1) _exit(1);
+    server(fd);
+    close(fd);
+    _exit(0);
+  }
+  close(listen_fd);
+
+  client(sockname);
+
+  if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+      WEXITSTATUS(status)) {
+    log_error("server did not terminate properly\n");
+    errorcount++;
+  }
+
+  unlink(sockname);
+  rmdir(name);
+  xfree(sockname);
+  return errorcount ? 1 : 0;
+}
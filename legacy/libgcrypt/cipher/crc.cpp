@@ -613,6 +613,21 @@ static void crc24rfc2440_final(void *context) {
   buf_put_le32(ctx->buf, ctx->CRC);
 }
 
+/* Update the OpenPGP CRC-24 value CRC, as specified in RFC 4880, with
+   the INLEN bytes at INBUF and return the new value.  Start with
+   GCRY_CRC24_INIT.  This is the same code as the CRC24RFC2440 digest
+   without the need to open a digest handle, which is what the armor
+   filters want as they update the checksum on every line.  */
+unsigned int _gcry_crc24_update(unsigned int crc, const void *inbuf,
+                                size_t inlen) {
+  CRC_CONTEXT ctx;
+
+  crc24rfc2440_init(&ctx, 0);
+  ctx.CRC = _gcry_bswap32((crc & 0xffffff) << 8);
+  crc24rfc2440_write(&ctx, inbuf, inlen);
+  return _gcry_bswap32(crc24_final(ctx.CRC)) >> 8;
+}
+
 /* We allow the CRC algorithms even in FIPS mode because they are
    actually no cryptographic primitives.  */
 
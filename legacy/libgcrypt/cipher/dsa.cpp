@@ -1051,6 +1051,44 @@ leave:
   return rc;
 }
 
+/* Verify the signature SIG = {r, s} over DATA with the key PKEY =
+   {p, q, g, y}.  */
+static gpg_error_t dsa_verify_mpi(int algo, gcry_ecc_curve_t curve,
+                                  gcry_mpi_t data, gcry_mpi_t *sig,
+                                  gcry_mpi_t *pkey) {
+  gpg_error_t rc;
+  DSA_public_key pk;
+  gcry_mpi_t sig_r, sig_s;
+
+  (void)algo;
+  (void)curve;
+
+  if (!data || !sig[0] || !sig[1] || !pkey[0] || !pkey[1] || !pkey[2] ||
+      !pkey[3])
+    return GPG_ERR_NO_OBJ;
+
+  sig_r = _gcry_pk_util_mpi_copy(sig[0], 0);
+  sig_s = _gcry_pk_util_mpi_copy(sig[1], 0);
+  pk.p = _gcry_pk_util_mpi_copy(pkey[0], 0);
+  pk.q = _gcry_pk_util_mpi_copy(pkey[1], 0);
+  pk.g = _gcry_pk_util_mpi_copy(pkey[2], 0);
+  pk.y = _gcry_pk_util_mpi_copy(pkey[3], 0);
+  if (!sig_r || !sig_s || !pk.p || !pk.q || !pk.g || !pk.y)
+    rc = GPG_ERR_INV_OBJ;
+  else
+    rc = verify(sig_r, sig_s, data, &pk);
+
+  _gcry_mpi_release(pk.p);
+  _gcry_mpi_release(pk.q);
+  _gcry_mpi_release(pk.g);
+  _gcry_mpi_release(pk.y);
+  _gcry_mpi_release(sig_r);
+  _gcry_mpi_release(sig_s);
+  if (DBG_CIPHER)
+    log_debug("dsa_verify    => %s\n", rc ? gpg_strerror(rc) : "Good");
+  return rc;
+}
+
 /* Return the number of bits for the key described by PARMS.  On error
  * 0 is returned.  The format of PARMS starts with the algorithm name;
  * for example:
@@ -1257,4 +1295,9 @@ gcry_pk_spec_t _gcry_pubkey_spec_dsa = {GCRY_PK_DSA,
                                         dsa_sign,
                                         dsa_verify,
                                         dsa_get_nbits,
-                                        run_selftests};
+                                        run_selftests,
+                                        NULL,
+                                        NULL,
+                                        NULL,
+                                        NULL,
+                                        dsa_verify_mpi};
@@ -20,6 +20,8 @@
 #ifndef GCRY_ECC_COMMON_H
 #define GCRY_ECC_COMMON_H
 
+#include <mutex>
+
 /* Definition of a curve.  */
 typedef struct {
   enum gcry_mpi_ec_models model; /* The model descrinbing this curve.  */
@@ -34,6 +36,13 @@ typedef struct {
   const char *name;   /* Name of the curve or NULL.  */
 } elliptic_curve_t;
 
+/* A curve from cipher/ecc-curves.c with its parameters as MPIs, see
+   _gcry_ecc_lookup_curve.  */
+struct gcry_ecc_curve {
+  std::once_flag init; /* Guards E.  */
+  elliptic_curve_t E;
+};
+
 typedef struct {
   elliptic_curve_t E;
   mpi_point_struct Q; /* Q = [d]G  */
@@ -45,6 +54,18 @@ typedef struct {
   gcry_mpi_t d;
 } ECC_secret_key;
 
+/* One signature for _gcry_ecc_eddsa_verify_batch.  The fields are
+   the arguments of _gcry_ecc_eddsa_verify; RC receives its result.  */
+typedef struct {
+  gcry_mpi_t input;
+  ECC_public_key *pkey;
+  gcry_mpi_t r;
+  gcry_mpi_t s;
+  int hashalgo;
+  gcry_mpi_t pk;
+  gpg_error_t rc;
+} eddsa_verify_item_t;
+
 /* Set the value from S into D.  */
 static inline void point_set(mpi_point_t d, mpi_point_t s) {
   mpi_set(d->x, s->x);
@@ -111,6 +132,7 @@ gpg_error_t _gcry_ecc_eddsa_sign(gcry_mpi_t input, ECC_secret_key *sk,
 gpg_error_t _gcry_ecc_eddsa_verify(gcry_mpi_t input, ECC_public_key *pk,
                                    gcry_mpi_t r, gcry_mpi_t s, int hashalgo,
                                    gcry_mpi_t pkmpi);
+void _gcry_ecc_eddsa_verify_batch(eddsa_verify_item_t *items, size_t n);
 
 /*-- ecc-gost.c --*/
 gpg_error_t _gcry_ecc_gost_sign(gcry_mpi_t input, ECC_secret_key *skey,
@@ -105,6 +105,10 @@ typedef struct {
   const char *n;         /* The order of the base point.  */
   const char *g_x, *g_y; /* Base point.  */
   const char *h;         /* Cofactor.  */
+
+  /* Dedicated arithmetic for the field or NULL for the generic
+     code.  */
+  const mpi_ec_field_t *field;
 } ecc_domain_parms_t;
 
 /* This static table defines all available curves.  */
@@ -118,7 +122,7 @@ static const ecc_domain_parms_t domain_parms[] = {
      "0x1000000000000000000000000000000014DEF9DEA2F79CD65812631A5CF5D3ED",
      "0x216936D3CD6E53FEC0A4E231FDD6DC5C692CC7609525A7B2C9562D608F25D51A",
      "0x6666666666666666666666666666666666666666666666666666666666666658",
-     "0x08"},
+     "0x08", &_gcry_mpi_ec_field_25519},
     {/* (y^2 = x^3 + 486662*x^2 + x) */
      "Curve25519", 256, (enum gcry_mpi_ec_models)MPI_EC_MONTGOMERY,
      (ecc_dialects)ECC_DIALECT_STANDARD,
@@ -127,7 +131,7 @@ static const ecc_domain_parms_t domain_parms[] = {
      "0x1000000000000000000000000000000014DEF9DEA2F79CD65812631A5CF5D3ED",
      "0x0000000000000000000000000000000000000000000000000000000000000009",
      "0x20AE19A1B8A086B4E01EDD2C7748D14C923D4D7E6D7C61B229E9C5A27ECED3D9",
-     "0x08"},
+     "0x08", &_gcry_mpi_ec_field_25519},
 #if 0  /* No real specs yet found.  */
     {
       /* x^2 + y^2 = 1 + 3617x^2y^2 mod 2^414 - 17 */
@@ -172,7 +176,7 @@ static const ecc_domain_parms_t domain_parms[] = {
 
      "0x6b17d1f2e12c4247f8bce6e563a440f277037d812deb33a0f4a13945d898c296",
      "0x4fe342e2fe1a7f9b8ee7eb4a7c0f9e162bce33576b315ececbb6406837bf51f5",
-     "0x01"},
+     "0x01", &_gcry_mpi_ec_field_nist256},
     {"NIST P-384", 384, (enum gcry_mpi_ec_models)MPI_EC_WEIERSTRASS,
      (ecc_dialects)ECC_DIALECT_STANDARD,
      "0xfffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffe"
@@ -188,7 +192,7 @@ static const ecc_domain_parms_t domain_parms[] = {
      "5502f25dbf55296c3a545e3872760ab7",
      "0x3617de4a96262c6f5d9e98bf9292dc29f8f41dbd289a147ce9da3113b5f0b8c0"
      "0a60b1ce1d7e819d7a431d7c90ea0e5f",
-     "0x01"},
+     "0x01", &_gcry_mpi_ec_field_nist384},
     {"NIST P-521", 521, (enum gcry_mpi_ec_models)MPI_EC_WEIERSTRASS,
      (ecc_dialects)ECC_DIALECT_STANDARD,
      "0x01ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff"
@@ -431,6 +435,100 @@ static int find_domain_parms_idx(const char *name) {
   return -1;
 }
 
+/* Return the dedicated field arithmetic of the curves in domain_parms
+   with the prime P, or NULL if there is none.  */
+const mpi_ec_field_t *_gcry_ecc_get_field(gcry_mpi_t p) {
+  const mpi_ec_field_t *field;
+  gcry_mpi_t tmp;
+  int idx, match;
+
+  if (mpi_is_opaque(p)) return NULL;
+
+  for (idx = 0; domain_parms[idx].desc; idx++) {
+    field = domain_parms[idx].field;
+    if (!field || field->nlimbs != (unsigned int)mpi_get_nlimbs(p)) continue;
+
+    tmp = scanval(domain_parms[idx].p);
+    match = !mpi_cmp(tmp, p);
+    mpi_free(tmp);
+    if (match) return field;
+  }
+
+  return NULL;
+}
+
+/* The base points of the curves in domain_parms.  */
+static struct mpi_ec_base_s base_points[DIM(domain_parms)];
+
+/* Return true if the domain parameter STRING equals VALUE.  A
+   negative parameter is taken modulo P like _gcry_ecc_fill_in_curve
+   does.  */
+static int param_matches(const char *string, gcry_mpi_t p, gcry_mpi_t value) {
+  gcry_mpi_t tmp;
+  int match;
+
+  tmp = scanval(string);
+  if (tmp->sign) mpi_add(tmp, p, tmp);
+  match = !mpi_cmp(tmp, value);
+  mpi_free(tmp);
+  return match;
+}
+
+/* Return the base point of the curve in domain_parms with the model
+   and the domain parameters P, A and B of EC, or NULL if there is no
+   such curve.  */
+mpi_ec_base_t _gcry_ecc_get_base(mpi_ec_t ec) {
+  const ecc_domain_parms_t *parms;
+  mpi_ec_base_t base;
+  int idx;
+
+  if (!ec->p || !ec->a || !ec->b || mpi_is_opaque(ec->p) ||
+      mpi_is_opaque(ec->a) || mpi_is_opaque(ec->b))
+    return NULL;
+
+  for (idx = 0; domain_parms[idx].desc; idx++) {
+    parms = domain_parms + idx;
+    if (parms->model != ec->model ||
+        (parms->nbits + BITS_PER_MPI_LIMB - 1) / BITS_PER_MPI_LIMB !=
+            (unsigned int)mpi_get_nlimbs(ec->p))
+      continue;
+    if (!param_matches(parms->p, ec->p, ec->p) ||
+        !param_matches(parms->a, ec->p, ec->a) ||
+        !param_matches(parms->b, ec->p, ec->b))
+      continue;
+
+    base = base_points + idx;
+    std::call_once(base->init, [base, parms]() {
+      base->x = scanval(parms->g_x);
+      base->y = scanval(parms->g_y);
+    });
+    return base;
+  }
+
+  return NULL;
+}
+
+/* The curves in domain_parms, see _gcry_ecc_lookup_curve.  */
+static struct gcry_ecc_curve curves[DIM(domain_parms)];
+
+/* Return the curve with NAME, which may also be an alias or an OID,
+   or NULL if there is no such curve.  The parameters are converted to
+   MPIs on first use and then shared read-only by all threads.  */
+gcry_ecc_curve_t _gcry_ecc_lookup_curve(const char *name) {
+  struct gcry_ecc_curve *curve;
+  int idx;
+
+  if (!name) return NULL;
+  idx = find_domain_parms_idx(name);
+  if (idx < 0) return NULL;
+
+  curve = curves + idx;
+  std::call_once(curve->init, [curve, idx]() {
+    _gcry_ecc_fill_in_curve(0, domain_parms[idx].desc, &curve->E, NULL);
+  });
+  return curve;
+}
+
 /* Generate the crypto system setup.  This function takes the NAME of
    a curve or the desired number of bits and stores at R_CURVE the
    parameters of the named curve or those of a suitable curve.  If
@@ -565,7 +663,7 @@ const char *_gcry_ecc_get_curve(gcry_sexp_t keyparms, int iterator,
 
   if (!keyparms) {
     idx = iterator;
-    if (idx >= 0 && idx < DIM(domain_parms)) {
+    if (idx >= 0 && (size_t)idx < DIM(domain_parms)) {
       result = domain_parms[idx].desc;
       if (r_nbits) *r_nbits = domain_parms[idx].nbits;
     }
@@ -232,6 +232,15 @@ gpg_error_t _gcry_ecc_eddsa_recover_x(gcry_mpi_t x, gcry_mpi_t y, int sign,
     if (!mpi_cmp(t, u)) rc = GPG_ERR_INV_OBJ;
   }
 
+  /* If u/v is not a square, there is no point with this y and v·x^2
+     is neither u nor -u.  */
+  if (!rc) {
+    mpi_mulm(t, x, x, ec->p);
+    mpi_mulm(t, t, v, ec->p);
+    mpi_mod(u, u, ec->p);
+    if (mpi_cmp(t, u)) rc = GPG_ERR_INV_OBJ;
+  }
+
   /* Choose the desired square root according to parity */
   if (mpi_test_bit(x, 0) != !!sign) mpi_sub(x, ec->p, x);
 
@@ -568,6 +577,8 @@ gpg_error_t _gcry_ecc_eddsa_sign(gcry_mpi_t input, ECC_secret_key *skey,
   reverse_buffer(digest, 64);
   if (DBG_CIPHER) log_printhex("     r", digest, 64);
   _gcry_mpi_set_buffer(r, digest, 64, 0);
+  /* Reduce R so that it is covered by the base point table.  */
+  mpi_mod(r, r, skey->E.n);
   _gcry_mpi_ec_mul_point(&I, r, &skey->E.G, ctx);
   if (DBG_CIPHER) log_printpnt("   r", &I, ctx);
 
@@ -620,48 +631,50 @@ leave:
   return rc;
 }
 
-/* Verify an EdDSA signature.  See sign_eddsa for the reference.
- * Check if R_IN and S_IN verifies INPUT.  PKEY has the curve
- * parameters and PK is the EdDSA style encoded public key.
- */
-gpg_error_t _gcry_ecc_eddsa_verify(gcry_mpi_t input, ECC_public_key *pkey,
-                                   gcry_mpi_t r_in, gcry_mpi_t s_in,
-                                   int hashalgo, gcry_mpi_t pk) {
+/* An EdDSA signature decoded for verification.  */
+typedef struct {
+  mpi_point_struct Q; /* The public key.  */
+  gcry_mpi_t h;       /* H(encodepoint(R) + encodepoint(pk) + m).  */
+  gcry_mpi_t s;
+  const void *rbuf; /* The encoded R.  */
+  size_t rlen;
+} eddsa_sig_t;
+
+static void eddsa_sig_init(eddsa_sig_t *sig) {
+  point_init(&sig->Q);
+  sig->h = mpi_new(0);
+  sig->s = mpi_new(0);
+  sig->rbuf = NULL;
+  sig->rlen = 0;
+}
+
+static void eddsa_sig_free(eddsa_sig_t *sig) {
+  point_free(&sig->Q);
+  _gcry_mpi_release(sig->h);
+  _gcry_mpi_release(sig->s);
+}
+
+/* Decode the public key PK and the signature R_IN, S_IN over INPUT
+ * into SIG for verification on the curve of CTX.  The caller has
+ * checked that the MPIs are opaque and HASHALGO is supported.  */
+static gpg_error_t eddsa_verify_prepare(eddsa_sig_t *sig, mpi_ec_t ctx,
+                                        gcry_mpi_t input, gcry_mpi_t r_in,
+                                        gcry_mpi_t s_in, int hashalgo,
+                                        gcry_mpi_t pk) {
   int rc;
-  mpi_ec_t ctx = NULL;
-  int b;
+  int b = ctx->nbits / 8;
   unsigned int tmp;
-  mpi_point_struct Q;          /* Public key.  */
   unsigned char *encpk = NULL; /* Encoded public key.  */
   unsigned int encpklen;
-  const void *mbuf, *rbuf;
-  unsigned char *tbuf = NULL;
-  size_t mlen, rlen;
-  unsigned int tlen;
+  const void *mbuf;
+  size_t mlen;
   unsigned char digest[64];
   gcry_buffer_t hvec[3];
-  gcry_mpi_t h, s;
-  mpi_point_struct Ia, Ib;
-
-  if (!mpi_is_opaque(input) || !mpi_is_opaque(r_in) || !mpi_is_opaque(s_in))
-    return GPG_ERR_INV_DATA;
-  if (hashalgo != GCRY_MD_SHA512) return GPG_ERR_DIGEST_ALGO;
-
-  point_init(&Q);
-  point_init(&Ia);
-  point_init(&Ib);
-  h = mpi_new(0);
-  s = mpi_new(0);
-
-  ctx = _gcry_mpi_ec_p_internal_new(pkey->E.model, pkey->E.dialect, 0,
-                                    pkey->E.p, pkey->E.a, pkey->E.b);
-  b = ctx->nbits / 8;
-  if (b != 256 / 8) return GPG_ERR_INTERNAL; /* We only support 256 bit. */
 
   /* Decode and check the public key.  */
-  rc = _gcry_ecc_eddsa_decodepoint(pk, ctx, &Q, &encpk, &encpklen);
+  rc = _gcry_ecc_eddsa_decodepoint(pk, ctx, &sig->Q, &encpk, &encpklen);
   if (rc) goto leave;
-  if (!_gcry_mpi_ec_curve_point(&Q, ctx)) {
+  if (!_gcry_mpi_ec_curve_point(&sig->Q, ctx)) {
     rc = GPG_ERR_BROKEN_PUBKEY;
     goto leave;
   }
@@ -675,18 +688,18 @@ gpg_error_t _gcry_ecc_eddsa_verify(gcry_mpi_t input, ECC_public_key *pkey,
   mbuf = mpi_get_opaque(input, &tmp);
   mlen = (tmp + 7) / 8;
   if (DBG_CIPHER) log_printhex("     m", mbuf, mlen);
-  rbuf = mpi_get_opaque(r_in, &tmp);
-  rlen = (tmp + 7) / 8;
-  if (DBG_CIPHER) log_printhex("     r", rbuf, rlen);
-  if (rlen != b) {
+  sig->rbuf = mpi_get_opaque(r_in, &tmp);
+  sig->rlen = (tmp + 7) / 8;
+  if (DBG_CIPHER) log_printhex("     r", sig->rbuf, sig->rlen);
+  if (sig->rlen != b) {
     rc = GPG_ERR_INV_LENGTH;
     goto leave;
   }
 
   /* h = H(encodepoint(R) + encodepoint(pk) + m)  */
-  hvec[0].data = (char *)rbuf;
+  hvec[0].data = (char *)sig->rbuf;
   hvec[0].off = 0;
-  hvec[0].len = rlen;
+  hvec[0].len = sig->rlen;
   hvec[1].data = encpk;
   hvec[1].off = 0;
   hvec[1].len = encpklen;
@@ -697,11 +710,8 @@ gpg_error_t _gcry_ecc_eddsa_verify(gcry_mpi_t input, ECC_public_key *pkey,
   if (rc) goto leave;
   reverse_buffer(digest, 64);
   if (DBG_CIPHER) log_printhex(" H(R+)", digest, 64);
-  _gcry_mpi_set_buffer(h, digest, 64, 0);
+  _gcry_mpi_set_buffer(sig->h, digest, 64, 0);
 
-  /* According to the paper the best way for verification is:
-         encodepoint(sG - h·Q) = encodepoint(r)
-     because we don't need to decode R. */
   {
     void *sbuf;
     unsigned int slen;
@@ -710,7 +720,7 @@ gpg_error_t _gcry_ecc_eddsa_verify(gcry_mpi_t input, ECC_public_key *pkey,
     slen = (tmp + 7) / 8;
     reverse_buffer((unsigned char *)(sbuf), slen);
     if (DBG_CIPHER) log_printhex("     s", sbuf, slen);
-    _gcry_mpi_set_buffer(s, sbuf, slen, 0);
+    _gcry_mpi_set_buffer(sig->s, sbuf, slen, 0);
     xfree(sbuf);
     if (slen != b) {
       rc = GPG_ERR_INV_LENGTH;
@@ -718,27 +728,267 @@ gpg_error_t _gcry_ecc_eddsa_verify(gcry_mpi_t input, ECC_public_key *pkey,
     }
   }
 
-  _gcry_mpi_ec_mul_point(&Ia, s, &pkey->E.G, ctx);
-  _gcry_mpi_ec_mul_point(&Ib, h, &Q, ctx);
+leave:
+  xfree(encpk);
+  return rc;
+}
+
+/* Check the decoded signature SIG on the curve of CTX with the base
+ * point G.  According to the paper the best way for verification is:
+ *     encodepoint(sG - h·Q) = encodepoint(r)
+ * because we don't need to decode R. */
+static gpg_error_t eddsa_verify_check(eddsa_sig_t *sig, mpi_ec_t ctx,
+                                      mpi_point_t G) {
+  gpg_error_t rc;
+  mpi_point_struct Ia, Ib;
+  gcry_mpi_t x, y;
+  unsigned char *tbuf = NULL;
+  unsigned int tlen;
+
+  point_init(&Ia);
+  point_init(&Ib);
+  x = mpi_new(0);
+  y = mpi_new(0);
+
+  _gcry_mpi_ec_mul_point(&Ia, sig->s, G, ctx);
+  _gcry_mpi_ec_mul_point(&Ib, sig->h, &sig->Q, ctx);
   _gcry_mpi_sub(Ib.x, ctx->p, Ib.x);
   _gcry_mpi_ec_add_points(&Ia, &Ia, &Ib, ctx);
-  rc = _gcry_ecc_eddsa_encodepoint(&Ia, ctx, s, h, 0, &tbuf, &tlen);
-  if (rc) goto leave;
-  if (tlen != rlen || memcmp(tbuf, rbuf, tlen)) {
+  rc = _gcry_ecc_eddsa_encodepoint(&Ia, ctx, x, y, 0, &tbuf, &tlen);
+  if (!rc && (tlen != sig->rlen || memcmp(tbuf, sig->rbuf, tlen)))
     rc = GPG_ERR_BAD_SIGNATURE;
-    goto leave;
-  }
-
-  rc = 0;
 
-leave:
-  xfree(encpk);
   xfree(tbuf);
-  _gcry_mpi_ec_free(ctx);
-  _gcry_mpi_release(s);
-  _gcry_mpi_release(h);
+  _gcry_mpi_release(x);
+  _gcry_mpi_release(y);
   point_free(&Ia);
   point_free(&Ib);
-  point_free(&Q);
   return rc;
 }
+
+/* Verify an EdDSA signature.  See sign_eddsa for the reference.
+ * Check if R_IN and S_IN verifies INPUT.  PKEY has the curve
+ * parameters and PK is the EdDSA style encoded public key.
+ */
+gpg_error_t _gcry_ecc_eddsa_verify(gcry_mpi_t input, ECC_public_key *pkey,
+                                   gcry_mpi_t r_in, gcry_mpi_t s_in,
+                                   int hashalgo, gcry_mpi_t pk) {
+  int rc;
+  mpi_ec_t ctx;
+  eddsa_sig_t sig;
+
+  if (!mpi_is_opaque(input) || !mpi_is_opaque(r_in) || !mpi_is_opaque(s_in))
+    return GPG_ERR_INV_DATA;
+  if (hashalgo != GCRY_MD_SHA512) return GPG_ERR_DIGEST_ALGO;
+
+  ctx = _gcry_mpi_ec_p_internal_new(pkey->E.model, pkey->E.dialect, 0,
+                                    pkey->E.p, pkey->E.a, pkey->E.b);
+  if (ctx->nbits != 256) {
+    _gcry_mpi_ec_free(ctx);
+    return GPG_ERR_INTERNAL; /* We only support 256 bit. */
+  }
+
+  eddsa_sig_init(&sig);
+  rc = eddsa_verify_prepare(&sig, ctx, input, r_in, s_in, hashalgo, pk);
+  if (!rc) rc = eddsa_verify_check(&sig, ctx, &pkey->E.G);
+
+  eddsa_sig_free(&sig);
+  _gcry_mpi_ec_free(ctx);
+  return rc;
+}
+
+/* Return true if the curves of A and B are the same.  */
+static int eddsa_same_curve(ECC_public_key *a, ECC_public_key *b) {
+  return (a->E.model == b->E.model && a->E.dialect == b->E.dialect &&
+          !mpi_cmp(a->E.p, b->E.p) && !mpi_cmp(a->E.a, b->E.a) &&
+          !mpi_cmp(a->E.b, b->E.b) && !mpi_cmp(a->E.n, b->E.n) &&
+          !mpi_cmp(a->E.G.x, b->E.G.x) && !mpi_cmp(a->E.G.y, b->E.G.y) &&
+          !mpi_cmp(a->E.G.z, b->E.G.z));
+}
+
+/* Return true if N·P is the neutral element for the order N of the
+ * base point, that is if the point P on the Edwards curve of CTX has
+ * no component of small order.  P must be public.  */
+static int eddsa_torsion_free(mpi_point_t P, gcry_mpi_t n, mpi_ec_t ctx) {
+  mpi_point_struct T;
+  gcry_mpi_t x, y;
+  int ok;
+
+  point_init(&T);
+  x = mpi_new(0);
+  y = mpi_new(0);
+
+  _gcry_mpi_ec_mul_points(&T, &n, &P, 1, ctx);
+  ok = (!_gcry_mpi_ec_get_affine(x, y, &T, ctx) && !mpi_cmp_ui(x, 0) &&
+        !mpi_cmp_ui(y, 1));
+
+  _gcry_mpi_release(x);
+  _gcry_mpi_release(y);
+  point_free(&T);
+  return ok;
+}
+
+/* Verify the N EdDSA signatures of ITEMS and store the result of each
+ * in its RC field.  The signatures on the curve of the first one are
+ * checked together with the random linear combination method of
+ * Bernstein et al.: with random 128 bit values z_i, the equations
+ *     s_i·G = R_i + h_i·Q_i
+ * are taken to hold if
+ *     8·(sum(z_i·s_i)·G - sum(z_i·R_i) - sum(z_i·h_i·Q_i)) = 0,
+ * which needs one multi-scalar multiplication instead of two scalar
+ * multiplications per signature.  The factor 8 is the cofactor, so
+ * the sum only shows that each equation holds up to a point of small
+ * order.  _gcry_ecc_eddsa_verify checks the equation without the
+ * cofactor, and the results must not depend on whether a signature
+ * was verified alone or in a batch, because callers cache them.  The
+ * difference s_i·G - R_i - h_i·Q_i can only have a small order
+ * component if R_i or Q_i has one, so signatures whose R_i or Q_i
+ * is not in the subgroup of order n are verified alone.  If the
+ * combination does not vanish, the signatures are verified one by
+ * one to find the bad ones.  */
+void _gcry_ecc_eddsa_verify_batch(eddsa_verify_item_t *items, size_t n) {
+  ECC_public_key *pkey = n ? items[0].pkey : NULL;
+  mpi_ec_t ctx = NULL;
+  eddsa_sig_t *sigs = NULL;
+  mpi_point_struct *R = NULL;
+  gcry_mpi_t *scalars = NULL;
+  mpi_point_t *points = NULL;
+  unsigned char *zbuf = NULL;
+  size_t *idx = NULL;
+  mpi_point_struct sum, T;
+  gcry_mpi_t z, zs, x, y;
+  size_t i, m;
+  int good;
+
+  for (i = 0; i < n; i++) items[i].rc = GPG_ERR_GENERAL;
+
+  if (n > 1 && pkey->E.model == MPI_EC_EDWARDS) {
+    sigs = (eddsa_sig_t *)xtrycalloc(n, sizeof *sigs);
+    R = (mpi_point_struct *)xtrycalloc(n, sizeof *R);
+    scalars = (gcry_mpi_t *)xtrycalloc(2 * n, sizeof *scalars);
+    points = (mpi_point_t *)xtrycalloc(2 * n, sizeof *points);
+    zbuf = (unsigned char *)xtrymalloc(16 * n);
+    idx = (size_t *)xtrycalloc(n, sizeof *idx);
+  }
+  if (!sigs || !R || !scalars || !points || !zbuf || !idx) {
+    xfree(sigs);
+    xfree(R);
+    xfree(scalars);
+    xfree(points);
+    xfree(zbuf);
+    xfree(idx);
+    for (i = 0; i < n; i++)
+      items[i].rc = _gcry_ecc_eddsa_verify(items[i].input, items[i].pkey,
+                                           items[i].r, items[i].s,
+                                           items[i].hashalgo, items[i].pk);
+    return;
+  }
+
+  ctx = _gcry_mpi_ec_p_internal_new(pkey->E.model, pkey->E.dialect, 0,
+                                    pkey->E.p, pkey->E.a, pkey->E.b);
+
+  /* Decode the signatures and R.  Signatures which can't take part,
+     including those with a non-canonical encoding of R or with an R
+     or a public key which is not torsion free, are verified alone.
+     Each public key is checked only once, as a key often made several
+     of the signatures.  */
+  for (i = m = 0; i < n; i++) {
+    eddsa_verify_item_t *item = items + i;
+    eddsa_sig_t *sig = sigs + m;
+    size_t j;
+
+    if (ctx->nbits != 256 || !eddsa_same_curve(item->pkey, pkey) ||
+        !mpi_is_opaque(item->input) || !mpi_is_opaque(item->r) ||
+        !mpi_is_opaque(item->s) || item->hashalgo != GCRY_MD_SHA512) {
+      item->rc = _gcry_ecc_eddsa_verify(item->input, item->pkey, item->r,
+                                        item->s, item->hashalgo, item->pk);
+      continue;
+    }
+
+    eddsa_sig_init(sig);
+    point_init(&R[m]);
+    item->rc = eddsa_verify_prepare(sig, ctx, item->input, item->r, item->s,
+                                    item->hashalgo, item->pk);
+    for (j = 0; !item->rc && j < m; j++)
+      if (!mpi_cmp(sigs[j].Q.x, sig->Q.x) && !mpi_cmp(sigs[j].Q.y, sig->Q.y))
+        break;
+    if (!item->rc &&
+        (_gcry_ecc_eddsa_decodepoint(item->r, ctx, &R[m], NULL, NULL) ||
+         mpi_cmp(R[m].x, ctx->p) >= 0 || mpi_cmp(R[m].y, ctx->p) >= 0 ||
+         !eddsa_torsion_free(&R[m], pkey->E.n, ctx) ||
+         (j == m && !eddsa_torsion_free(&sig->Q, pkey->E.n, ctx))))
+      item->rc = eddsa_verify_check(sig, ctx, &pkey->E.G);
+    else if (!item->rc) {
+      item->rc = GPG_ERR_GENERAL; /* Decided below.  */
+      idx[m++] = i;
+      continue;
+    }
+    eddsa_sig_free(sig);
+    point_free(&R[m]);
+  }
+
+  if (m == 1)
+    items[idx[0]].rc = eddsa_verify_check(&sigs[0], ctx, &pkey->E.G);
+  else if (m > 1) {
+    z = mpi_new(0);
+    zs = mpi_new(0);
+    x = mpi_new(0);
+    y = mpi_new(0);
+    point_init(&sum);
+    point_init(&T);
+
+    /* -R_i with z_i and -Q_i with z_i·h_i mod n.  The factor 8 makes
+       the reduction of the scalars modulo n possible.  */
+    _gcry_create_nonce(zbuf, 16 * m);
+    for (i = 0; i < m; i++) {
+      _gcry_mpi_set_buffer(z, zbuf + 16 * i, 16, 0);
+      mpi_mulm(x, z, sigs[i].s, pkey->E.n);
+      mpi_addm(zs, zs, x, pkey->E.n);
+
+      scalars[2 * i] = mpi_copy(z);
+      mpi_sub(R[i].x, ctx->p, R[i].x);
+      points[2 * i] = &R[i];
+      scalars[2 * i + 1] = mpi_new(0);
+      mpi_mulm(scalars[2 * i + 1], z, sigs[i].h, pkey->E.n);
+      mpi_sub(sigs[i].Q.x, ctx->p, sigs[i].Q.x);
+      points[2 * i + 1] = &sigs[i].Q;
+    }
+    _gcry_mpi_ec_mul_points(&sum, scalars, points, 2 * m, ctx);
+    _gcry_mpi_ec_mul_point(&T, zs, &pkey->E.G, ctx);
+    _gcry_mpi_ec_add_points(&sum, &sum, &T, ctx);
+    for (i = 0; i < 3; i++) _gcry_mpi_ec_dup_point(&sum, &sum, ctx);
+
+    good = (!_gcry_mpi_ec_get_affine(x, y, &sum, ctx) && !mpi_cmp_ui(x, 0) &&
+            !mpi_cmp_ui(y, 1));
+    for (i = 0; i < m; i++) {
+      if (good)
+        items[idx[i]].rc = 0;
+      else {
+        /* Restore Q.  */
+        mpi_sub(sigs[i].Q.x, ctx->p, sigs[i].Q.x);
+        items[idx[i]].rc = eddsa_verify_check(&sigs[i], ctx, &pkey->E.G);
+      }
+      _gcry_mpi_release(scalars[2 * i]);
+      _gcry_mpi_release(scalars[2 * i + 1]);
+    }
+
+    _gcry_mpi_release(z);
+    _gcry_mpi_release(zs);
+    _gcry_mpi_release(x);
+    _gcry_mpi_release(y);
+    point_free(&sum);
+    point_free(&T);
+  }
+
+  for (i = 0; i < m; i++) {
+    eddsa_sig_free(&sigs[i]);
+    point_free(&R[i]);
+  }
+  _gcry_mpi_ec_free(ctx);
+  xfree(sigs);
+  xfree(R);
+  xfree(scalars);
+  xfree(points);
+  xfree(zbuf);
+  xfree(idx);
+}
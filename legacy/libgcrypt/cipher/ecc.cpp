@@ -866,169 +866,285 @@ leave:
   return rc;
 }
 
-static gpg_error_t ecc_verify(gcry_sexp_t s_sig, gcry_sexp_t s_data,
-                              gcry_sexp_t s_keyparms) {
-  gpg_error_t rc;
+/* The parameters of a signature verification, see ecc_verify_parse.  */
+struct ecc_verify_parms {
   struct pk_encoding_ctx ctx;
-  gcry_sexp_t l1 = NULL;
-  char *curvename = NULL;
-  gcry_mpi_t mpi_g = NULL;
-  gcry_mpi_t mpi_q = NULL;
-  gcry_mpi_t sig_r = NULL;
-  gcry_mpi_t sig_s = NULL;
-  gcry_mpi_t data = NULL;
+  gcry_sexp_t l1;
+  char *curvename;
+  gcry_mpi_t mpi_g;
+  gcry_mpi_t mpi_q;
+  gcry_mpi_t sig_r;
+  gcry_mpi_t sig_s;
+  gcry_mpi_t data;
   ECC_public_key pk;
   int sigflags;
+};
 
-  memset(&pk, 0, sizeof pk);
-  _gcry_pk_util_init_encoding_ctx(&ctx, PUBKEY_OP_VERIFY,
+/* Extract the data S_DATA, the signature S_SIG and the key S_KEYPARMS
+   of a verification into V.  V must be released with
+   ecc_verify_release even on error.  */
+static gpg_error_t ecc_verify_parse(struct ecc_verify_parms *v,
+                                    gcry_sexp_t s_sig, gcry_sexp_t s_data,
+                                    gcry_sexp_t s_keyparms) {
+  gpg_error_t rc;
+
+  memset(v, 0, sizeof *v);
+  _gcry_pk_util_init_encoding_ctx(&v->ctx, PUBKEY_OP_VERIFY,
                                   ecc_get_nbits(s_keyparms));
 
   /* Extract the data.  */
-  rc = _gcry_pk_util_data_to_mpi(s_data, &data, &ctx);
-  if (rc) goto leave;
-  if (DBG_CIPHER) log_mpidump("ecc_verify data", data);
+  rc = _gcry_pk_util_data_to_mpi(s_data, &v->data, &v->ctx);
+  if (rc) return rc;
+  if (DBG_CIPHER) log_mpidump("ecc_verify data", v->data);
 
   /*
    * Extract the signature value.
    */
-  rc = _gcry_pk_util_preparse_sigval(s_sig, ecc_names, &l1, &sigflags);
-  if (rc) goto leave;
-  rc = sexp_extract_param(l1, NULL,
-                          (sigflags & PUBKEY_FLAG_EDDSA) ? "/rs" : "rs", &sig_r,
-                          &sig_s, NULL);
-  if (rc) goto leave;
+  rc = _gcry_pk_util_preparse_sigval(s_sig, ecc_names, &v->l1, &v->sigflags);
+  if (rc) return rc;
+  rc = sexp_extract_param(v->l1, NULL,
+                          (v->sigflags & PUBKEY_FLAG_EDDSA) ? "/rs" : "rs",
+                          &v->sig_r, &v->sig_s, NULL);
+  if (rc) return rc;
   if (DBG_CIPHER) {
-    log_mpidump("ecc_verify  s_r", sig_r);
-    log_mpidump("ecc_verify  s_s", sig_s);
-  }
-  if ((ctx.flags & PUBKEY_FLAG_EDDSA) ^ (sigflags & PUBKEY_FLAG_EDDSA)) {
-    rc = GPG_ERR_CONFLICT; /* Inconsistent use of flag/algoname.  */
-    goto leave;
+    log_mpidump("ecc_verify  s_r", v->sig_r);
+    log_mpidump("ecc_verify  s_s", v->sig_s);
   }
+  if ((v->ctx.flags & PUBKEY_FLAG_EDDSA) ^ (v->sigflags & PUBKEY_FLAG_EDDSA))
+    return GPG_ERR_CONFLICT; /* Inconsistent use of flag/algoname.  */
 
   /*
    * Extract the key.
    */
-  if ((ctx.flags & PUBKEY_FLAG_PARAM))
-    rc = sexp_extract_param(s_keyparms, NULL, "-p?a?b?g?n?h?/q", &pk.E.p,
-                            &pk.E.a, &pk.E.b, &mpi_g, &pk.E.n, &pk.E.h, &mpi_q,
-                            NULL);
+  if ((v->ctx.flags & PUBKEY_FLAG_PARAM))
+    rc = sexp_extract_param(s_keyparms, NULL, "-p?a?b?g?n?h?/q", &v->pk.E.p,
+                            &v->pk.E.a, &v->pk.E.b, &v->mpi_g, &v->pk.E.n,
+                            &v->pk.E.h, &v->mpi_q, NULL);
   else
-    rc = sexp_extract_param(s_keyparms, NULL, "/q", &mpi_q, NULL);
-  if (rc) goto leave;
-  if (mpi_g) {
-    point_init(&pk.E.G);
-    rc = _gcry_ecc_os2ec(&pk.E.G, mpi_g);
-    if (rc) goto leave;
+    rc = sexp_extract_param(s_keyparms, NULL, "/q", &v->mpi_q, NULL);
+  if (rc) return rc;
+  if (v->mpi_g) {
+    point_init(&v->pk.E.G);
+    rc = _gcry_ecc_os2ec(&v->pk.E.G, v->mpi_g);
+    if (rc) return rc;
   }
   /* Add missing parameters using the optional curve parameter.  */
-  sexp_release(l1);
-  l1 = sexp_find_token(s_keyparms, "curve", 5);
-  if (l1) {
-    curvename = sexp_nth_string(l1, 1);
-    if (curvename) {
-      rc = _gcry_ecc_fill_in_curve(0, curvename, &pk.E, NULL);
-      if (rc) goto leave;
+  sexp_release(v->l1);
+  v->l1 = sexp_find_token(s_keyparms, "curve", 5);
+  if (v->l1) {
+    v->curvename = sexp_nth_string(v->l1, 1);
+    if (v->curvename) {
+      rc = _gcry_ecc_fill_in_curve(0, v->curvename, &v->pk.E, NULL);
+      if (rc) return rc;
     }
   }
   /* Guess required fields if a curve parameter has not been given.
      FIXME: This is a crude hacks.  We need to fix that.  */
-  if (!curvename) {
-    pk.E.model =
-        ((sigflags & PUBKEY_FLAG_EDDSA) ? MPI_EC_EDWARDS : MPI_EC_WEIERSTRASS);
-    pk.E.dialect = ((sigflags & PUBKEY_FLAG_EDDSA) ? ECC_DIALECT_ED25519
-                                                   : ECC_DIALECT_STANDARD);
-    if (!pk.E.h) pk.E.h = mpi_const(MPI_C_ONE);
+  if (!v->curvename) {
+    v->pk.E.model = ((v->sigflags & PUBKEY_FLAG_EDDSA) ? MPI_EC_EDWARDS
+                                                       : MPI_EC_WEIERSTRASS);
+    v->pk.E.dialect = ((v->sigflags & PUBKEY_FLAG_EDDSA)
+                           ? ECC_DIALECT_ED25519
+                           : ECC_DIALECT_STANDARD);
+    if (!v->pk.E.h) v->pk.E.h = mpi_const(MPI_C_ONE);
   }
 
   if (DBG_CIPHER) {
-    log_debug("ecc_verify info: %s/%s%s\n", _gcry_ecc_model2str(pk.E.model),
-              _gcry_ecc_dialect2str(pk.E.dialect),
-              (sigflags & PUBKEY_FLAG_EDDSA) ? "+EdDSA" : "");
-    if (pk.E.name) log_debug("ecc_verify name: %s\n", pk.E.name);
-    log_printmpi("ecc_verify    p", pk.E.p);
-    log_printmpi("ecc_verify    a", pk.E.a);
-    log_printmpi("ecc_verify    b", pk.E.b);
-    log_printpnt("ecc_verify  g", &pk.E.G, NULL);
-    log_printmpi("ecc_verify    n", pk.E.n);
-    log_printmpi("ecc_verify    h", pk.E.h);
-    log_printmpi("ecc_verify    q", mpi_q);
-  }
-  if (!pk.E.p || !pk.E.a || !pk.E.b || !pk.E.G.x || !pk.E.n || !pk.E.h ||
-      !mpi_q) {
-    rc = GPG_ERR_NO_OBJ;
-    goto leave;
+    log_debug("ecc_verify info: %s/%s%s\n", _gcry_ecc_model2str(v->pk.E.model),
+              _gcry_ecc_dialect2str(v->pk.E.dialect),
+              (v->sigflags & PUBKEY_FLAG_EDDSA) ? "+EdDSA" : "");
+    if (v->pk.E.name) log_debug("ecc_verify name: %s\n", v->pk.E.name);
+    log_printmpi("ecc_verify    p", v->pk.E.p);
+    log_printmpi("ecc_verify    a", v->pk.E.a);
+    log_printmpi("ecc_verify    b", v->pk.E.b);
+    log_printpnt("ecc_verify  g", &v->pk.E.G, NULL);
+    log_printmpi("ecc_verify    n", v->pk.E.n);
+    log_printmpi("ecc_verify    h", v->pk.E.h);
+    log_printmpi("ecc_verify    q", v->mpi_q);
+  }
+  if (!v->pk.E.p || !v->pk.E.a || !v->pk.E.b || !v->pk.E.G.x || !v->pk.E.n ||
+      !v->pk.E.h || !v->mpi_q)
+    return GPG_ERR_NO_OBJ;
+
+  return 0;
+}
+
+/* Verify the signature parsed into V.  */
+static gpg_error_t ecc_verify_parsed(struct ecc_verify_parms *v) {
+  gpg_error_t rc;
+  ECC_public_key *pk = &v->pk;
+
+  if ((v->sigflags & PUBKEY_FLAG_EDDSA))
+    return _gcry_ecc_eddsa_verify(v->data, pk, v->sig_r, v->sig_s,
+                                  v->ctx.hash_algo, v->mpi_q);
+
+  point_init(&pk->Q);
+  if ((v->sigflags & PUBKEY_FLAG_GOST)) {
+    rc = _gcry_ecc_os2ec(&pk->Q, v->mpi_q);
+    if (rc) return rc;
+
+    return _gcry_ecc_gost_verify(v->data, pk, v->sig_r, v->sig_s);
   }
 
-  /*
-   * Verify the signature.
-   */
-  if ((sigflags & PUBKEY_FLAG_EDDSA)) {
-    rc = _gcry_ecc_eddsa_verify(data, &pk, sig_r, sig_s, ctx.hash_algo, mpi_q);
-  } else if ((sigflags & PUBKEY_FLAG_GOST)) {
-    point_init(&pk.Q);
-    rc = _gcry_ecc_os2ec(&pk.Q, mpi_q);
-    if (rc) goto leave;
+  if (pk->E.dialect == ECC_DIALECT_ED25519) {
+    mpi_ec_t ec;
 
-    rc = _gcry_ecc_gost_verify(data, &pk, sig_r, sig_s);
+    /* Fixme: Factor the curve context setup out of eddsa_verify
+       and ecdsa_verify. So that we don't do it twice.  */
+    ec = _gcry_mpi_ec_p_internal_new(pk->E.model, pk->E.dialect, 0, pk->E.p,
+                                     pk->E.a, pk->E.b);
+
+    rc = _gcry_ecc_eddsa_decodepoint(v->mpi_q, ec, &pk->Q, NULL, NULL);
+    _gcry_mpi_ec_free(ec);
   } else {
-    point_init(&pk.Q);
-    if (pk.E.dialect == ECC_DIALECT_ED25519) {
-      mpi_ec_t ec;
+    rc = _gcry_ecc_os2ec(&pk->Q, v->mpi_q);
+  }
+  if (rc) return rc;
 
-      /* Fixme: Factor the curve context setup out of eddsa_verify
-         and ecdsa_verify. So that we don't do it twice.  */
-      ec = _gcry_mpi_ec_p_internal_new(pk.E.model, pk.E.dialect, 0, pk.E.p,
-                                       pk.E.a, pk.E.b);
+  if (mpi_is_opaque(v->data)) {
+    const void *abuf;
+    unsigned int abits, qbits;
+    gcry_mpi_t a;
 
-      rc = _gcry_ecc_eddsa_decodepoint(mpi_q, ec, &pk.Q, NULL, NULL);
-      _gcry_mpi_ec_free(ec);
-    } else {
-      rc = _gcry_ecc_os2ec(&pk.Q, mpi_q);
+    qbits = mpi_get_nbits(pk->E.n);
+
+    abuf = mpi_get_opaque(v->data, &abits);
+    rc = _gcry_mpi_scan(&a, GCRYMPI_FMT_USG, abuf, (abits + 7) / 8, NULL);
+    if (!rc) {
+      if (abits > qbits) mpi_rshift(a, a, abits - qbits);
+
+      rc = _gcry_ecc_ecdsa_verify(a, pk, v->sig_r, v->sig_s);
+      _gcry_mpi_release(a);
     }
-    if (rc) goto leave;
+  } else
+    rc = _gcry_ecc_ecdsa_verify(v->data, pk, v->sig_r, v->sig_s);
+  return rc;
+}
 
-    if (mpi_is_opaque(data)) {
-      const void *abuf;
-      unsigned int abits, qbits;
-      gcry_mpi_t a;
+static void ecc_verify_release(struct ecc_verify_parms *v) {
+  _gcry_mpi_release(v->pk.E.p);
+  _gcry_mpi_release(v->pk.E.a);
+  _gcry_mpi_release(v->pk.E.b);
+  _gcry_mpi_release(v->mpi_g);
+  point_free(&v->pk.E.G);
+  _gcry_mpi_release(v->pk.E.n);
+  _gcry_mpi_release(v->pk.E.h);
+  _gcry_mpi_release(v->mpi_q);
+  point_free(&v->pk.Q);
+  _gcry_mpi_release(v->data);
+  _gcry_mpi_release(v->sig_r);
+  _gcry_mpi_release(v->sig_s);
+  xfree(v->curvename);
+  sexp_release(v->l1);
+  _gcry_pk_util_free_encoding_ctx(&v->ctx);
+}
 
-      qbits = mpi_get_nbits(pk.E.n);
+static gpg_error_t ecc_verify(gcry_sexp_t s_sig, gcry_sexp_t s_data,
+                              gcry_sexp_t s_keyparms) {
+  gpg_error_t rc;
+  struct ecc_verify_parms v;
 
-      abuf = mpi_get_opaque(data, &abits);
-      rc = _gcry_mpi_scan(&a, GCRYMPI_FMT_USG, abuf, (abits + 7) / 8, NULL);
-      if (!rc) {
-        if (abits > qbits) mpi_rshift(a, a, abits - qbits);
+  rc = ecc_verify_parse(&v, s_sig, s_data, s_keyparms);
+  if (!rc) rc = ecc_verify_parsed(&v);
+  ecc_verify_release(&v);
+  if (DBG_CIPHER)
+    log_debug("ecc_verify    => %s\n", rc ? gpg_strerror(rc) : "Good");
+  return rc;
+}
 
-        rc = _gcry_ecc_ecdsa_verify(a, &pk, sig_r, sig_s);
-        _gcry_mpi_release(a);
-      }
-    } else
-      rc = _gcry_ecc_ecdsa_verify(data, &pk, sig_r, sig_s);
-  }
+/* Verify the signature SIG = {r, s} over DATA with the key PKEY = {q}
+   on CURVE.  ALGO is GCRY_PK_EDDSA for an EdDSA signature over the
+   message DATA with SHA-512; otherwise DATA is the hash value of an
+   ECDSA signature.  */
+static gpg_error_t ecc_verify_mpi(int algo, gcry_ecc_curve_t curve,
+                                  gcry_mpi_t data, gcry_mpi_t *sig,
+                                  gcry_mpi_t *pkey) {
+  gpg_error_t rc;
+  struct ecc_verify_parms v;
+  int eddsa = algo == GCRY_PK_EDDSA;
+
+  memset(&v, 0, sizeof v);
+  _gcry_pk_util_init_encoding_ctx(&v.ctx, PUBKEY_OP_VERIFY, 0);
+  if (eddsa) {
+    v.ctx.flags |= PUBKEY_FLAG_EDDSA;
+    v.ctx.hash_algo = GCRY_MD_SHA512;
+    v.sigflags = PUBKEY_FLAG_EDDSA;
+  }
+
+  /* The same representation as with ecc_verify_parse.  */
+  v.data = _gcry_pk_util_mpi_copy(data, eddsa || mpi_is_opaque(data));
+  v.sig_r = _gcry_pk_util_mpi_copy(sig[0], eddsa);
+  v.sig_s = _gcry_pk_util_mpi_copy(sig[1], eddsa);
+  v.mpi_q = _gcry_pk_util_mpi_copy(pkey[0], 1);
+
+  /* The verification only reads the curve, so it is borrowed from
+     CURVE and not released below.  */
+  if (curve) v.pk.E = curve->E;
+  if (!curve || !v.data || !v.sig_r || !v.sig_s || !v.mpi_q)
+    rc = GPG_ERR_NO_OBJ;
+  else
+    rc = ecc_verify_parsed(&v);
 
-leave:
-  _gcry_mpi_release(pk.E.p);
-  _gcry_mpi_release(pk.E.a);
-  _gcry_mpi_release(pk.E.b);
-  _gcry_mpi_release(mpi_g);
-  point_free(&pk.E.G);
-  _gcry_mpi_release(pk.E.n);
-  _gcry_mpi_release(pk.E.h);
-  _gcry_mpi_release(mpi_q);
-  point_free(&pk.Q);
-  _gcry_mpi_release(data);
-  _gcry_mpi_release(sig_r);
-  _gcry_mpi_release(sig_s);
-  xfree(curvename);
-  sexp_release(l1);
-  _gcry_pk_util_free_encoding_ctx(&ctx);
+  memset(&v.pk.E, 0, sizeof v.pk.E);
+  ecc_verify_release(&v);
   if (DBG_CIPHER)
     log_debug("ecc_verify    => %s\n", rc ? gpg_strerror(rc) : "Good");
   return rc;
 }
 
+/* Verify N signatures.  The EdDSA signatures are handed over to
+   _gcry_ecc_eddsa_verify_batch; the others are verified one by
+   one.  */
+static gpg_error_t ecc_verify_batch(gcry_sexp_t *s_sig, gcry_sexp_t *s_data,
+                                    gcry_sexp_t *s_keyparms, size_t n,
+                                    gpg_error_t *results) {
+  struct ecc_verify_parms *v;
+  eddsa_verify_item_t *items;
+  size_t *idx;
+  size_t i, m;
+
+  v = (struct ecc_verify_parms *)xtrycalloc(n, sizeof *v);
+  items = (eddsa_verify_item_t *)xtrycalloc(n, sizeof *items);
+  idx = (size_t *)xtrycalloc(n, sizeof *idx);
+  if (!v || !items || !idx) {
+    gpg_error_t err = gpg_error_from_syserror();
+    xfree(v);
+    xfree(items);
+    xfree(idx);
+    return err;
+  }
+
+  for (i = m = 0; i < n; i++) {
+    results[i] = ecc_verify_parse(&v[i], s_sig[i], s_data[i], s_keyparms[i]);
+    if (results[i]) continue;
+    if (!(v[i].sigflags & PUBKEY_FLAG_EDDSA)) {
+      results[i] = ecc_verify_parsed(&v[i]);
+      continue;
+    }
+    items[m].input = v[i].data;
+    items[m].pkey = &v[i].pk;
+    items[m].r = v[i].sig_r;
+    items[m].s = v[i].sig_s;
+    items[m].hashalgo = v[i].ctx.hash_algo;
+    items[m].pk = v[i].mpi_q;
+    idx[m++] = i;
+  }
+
+  _gcry_ecc_eddsa_verify_batch(items, m);
+  for (i = 0; i < m; i++) results[idx[i]] = items[i].rc;
+
+  for (i = 0; i < n; i++) {
+    ecc_verify_release(&v[i]);
+    if (DBG_CIPHER)
+      log_debug("ecc_verify    => %s\n",
+                results[i] ? gpg_strerror(results[i]) : "Good");
+  }
+  xfree(v);
+  xfree(items);
+  xfree(idx);
+  return 0;
+}
+
 /* ecdh raw is classic 2-round DH protocol published in 1976.
  *
  * Overview of ecc_encrypt_raw and ecc_decrypt_raw.
@@ -1891,4 +2007,6 @@ gcry_pk_spec_t _gcry_pubkey_spec_ecc = {
     run_selftests,
     compute_keygrip,
     _gcry_ecc_get_curve,
-    _gcry_ecc_get_param_sexp};
+    _gcry_ecc_get_param_sexp,
+    ecc_verify_batch,
+    ecc_verify_mpi};
@@ -38,6 +38,7 @@ void _gcry_pk_util_init_encoding_ctx(struct pk_encoding_ctx *ctx,
 void _gcry_pk_util_free_encoding_ctx(struct pk_encoding_ctx *ctx);
 gpg_error_t _gcry_pk_util_data_to_mpi(gcry_sexp_t input, gcry_mpi_t *ret_mpi,
                                       struct pk_encoding_ctx *ctx);
+gcry_mpi_t _gcry_pk_util_mpi_copy(gcry_mpi_t a, int opaque);
 
 /*-- rsa-common.c --*/
 gpg_error_t _gcry_rsa_pkcs1_encode_for_enc(gcry_mpi_t *r_result,
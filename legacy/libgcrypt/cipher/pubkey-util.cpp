@@ -538,6 +538,30 @@ void _gcry_pk_util_free_encoding_ctx(struct pk_encoding_ctx *ctx) {
   xfree(ctx->label);
 }
 
+/* Return a copy of the MPI A for a public key operation which gets
+   its parameters as MPIs.  The copy is opaque if OPAQUE is set and a
+   plain MPI otherwise, like sexp_extract_param returns the parameters
+   with and without the "/" prefix.  Returns NULL if A is NULL.  */
+gcry_mpi_t _gcry_pk_util_mpi_copy(gcry_mpi_t a, int opaque) {
+  gcry_mpi_t b;
+  const void *p;
+  unsigned char *buf;
+  unsigned int n;
+
+  if (!a) return NULL;
+  if (!mpi_is_opaque(a) == !opaque) return mpi_copy(a);
+
+  if (opaque) {
+    buf = _gcry_mpi_get_buffer(a, 0, &n, NULL);
+    if (!buf) return NULL;
+    return mpi_set_opaque(NULL, buf, n * 8);
+  }
+
+  p = mpi_get_opaque(a, &n);
+  if (_gcry_mpi_scan(&b, GCRYMPI_FMT_USG, p, (n + 7) / 8, NULL)) return NULL;
+  return b;
+}
+
 /* Take the hash value and convert into an MPI, suitable for
    passing to the low level functions.  We currently support the
    old style way of passing just a MPI and the modern interface which
@@ -399,6 +399,99 @@ leave:
   return rc;
 }
 
+/* Verify the signature SIG over DATA with the public key PKEY of
+   algorithm ALGO like _gcry_pk_verify, but with the parameters given
+   as MPIs instead of S-expressions.  See gcry_pk_verify_mpi for the
+   order of the parameters.  */
+gpg_error_t _gcry_pk_verify_mpi(int algo, gcry_ecc_curve_t curve,
+                                gcry_mpi_t data, gcry_mpi_t *sig,
+                                gcry_mpi_t *pkey) {
+  gcry_pk_spec_t *spec;
+
+  spec = spec_from_algo(algo == GCRY_PK_EDDSA ? GCRY_PK_ECC : algo);
+  if (!spec) return GPG_ERR_PUBKEY_ALGO;
+  if (!spec->verify_mpi) return GPG_ERR_NOT_IMPLEMENTED;
+
+  return spec->verify_mpi(algo, curve, data, sig, pkey);
+}
+
+/* Verify the N signatures S_SIG[i] over S_HASH[i] with the public
+   keys S_PKEY[i], as _gcry_pk_verify does, and store the result of
+   each in RESULTS[i].  Signatures of algorithms which support it are
+   verified together, which is faster than verifying them one by one.
+   Returns 0 if all signatures are good or else the first error in
+   RESULTS.  If the batch could not be processed, that error is stored
+   in all of RESULTS.  */
+gpg_error_t _gcry_pk_verify_batch(gcry_sexp_t *s_sig, gcry_sexp_t *s_hash,
+                                  gcry_sexp_t *s_pkey, size_t n,
+                                  gpg_error_t *results) {
+  gpg_error_t rc = 0;
+  gcry_pk_spec_t **specs;
+  gcry_sexp_t *keyparms;
+  gcry_sexp_t *bsig, *bhash, *bkey;
+  gpg_error_t *bres;
+  size_t *idx;
+  size_t i, j, m;
+
+  specs = (gcry_pk_spec_t **)xtrycalloc(n, sizeof *specs);
+  keyparms = (gcry_sexp_t *)xtrycalloc(n, sizeof *keyparms);
+  bsig = (gcry_sexp_t *)xtrycalloc(3 * n, sizeof *bsig);
+  bres = (gpg_error_t *)xtrycalloc(n, sizeof *bres);
+  idx = (size_t *)xtrycalloc(n, sizeof *idx);
+  if (n && (!specs || !keyparms || !bsig || !bres || !idx)) {
+    rc = gpg_error_from_syserror();
+    goto fail;
+  }
+  bhash = bsig + n;
+  bkey = bsig + 2 * n;
+
+  for (i = 0; i < n; i++) {
+    results[i] = spec_from_sexp(s_pkey[i], 0, &specs[i], &keyparms[i]);
+    if (!results[i] && !specs[i]->verify) results[i] = GPG_ERR_NOT_IMPLEMENTED;
+    if (results[i]) specs[i] = NULL;
+  }
+
+  for (i = 0; i < n; i++) {
+    if (!specs[i]) continue;
+    if (!specs[i]->verify_batch) {
+      results[i] = specs[i]->verify(s_sig[i], s_hash[i], keyparms[i]);
+      specs[i] = NULL;
+      continue;
+    }
+
+    /* Collect the remaining signatures of this algorithm.  */
+    for (j = i, m = 0; j < n; j++) {
+      if (specs[j] != specs[i]) continue;
+      bsig[m] = s_sig[j];
+      bhash[m] = s_hash[j];
+      bkey[m] = keyparms[j];
+      idx[m++] = j;
+    }
+    rc = specs[i]->verify_batch(bsig, bhash, bkey, m, bres);
+    if (rc) goto fail;
+    for (j = 0; j < m; j++) {
+      results[idx[j]] = bres[j];
+      specs[idx[j]] = NULL;
+    }
+  }
+
+  for (i = 0; i < n && !rc; i++) rc = results[i];
+  goto leave;
+
+fail:
+  for (i = 0; i < n; i++) results[i] = rc;
+
+leave:
+  if (keyparms)
+    for (i = 0; i < n; i++) sexp_release(keyparms[i]);
+  xfree(specs);
+  xfree(keyparms);
+  xfree(bsig);
+  xfree(bres);
+  xfree(idx);
+  return rc;
+}
+
 /*
    Test a key.
 
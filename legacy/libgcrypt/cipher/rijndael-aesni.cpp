@@ -0,0 +1,398 @@
+/* AES-NI accelerated AES for Libgcrypt
+ * Copyright 2017 The NeoPG developers
+ *
+ * This file is part of Libgcrypt.
+ *
+ * Libgcrypt is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * Libgcrypt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This is written with compiler intrinsics.  The functions using AES
+   instructions carry a target attribute, so that the rest of the
+   library does not need to be compiled for a CPU with AES-NI; the
+   code here must only be called if HWF_INTEL_AESNI is set.
+
+   The modes which allow it (CTR, CBC and CFB decryption) process
+   eight blocks at once to hide the latency of the AES instructions.
+   The encryption key schedule is the standard one in byte order,
+   the decryption key schedule is for the equivalent inverse cipher
+   and stored in reverse order.  */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./cipher-internal.h"
+#include "bufhelp.h"
+#include "cipher.h"
+#include "g10lib.h"
+#include "rijndael-internal.h"
+#include "types.h"
+
+#ifdef USE_AESNI
+
+#include <emmintrin.h>
+#include <wmmintrin.h>
+
+#define AESNI_FUNC __attribute__((target("sse2,aes")))
+
+/* Number of blocks processed in parallel.  */
+#define AESNI_WAY 8
+
+static inline AESNI_FUNC __m128i load_key(const byte *key) {
+  return _mm_loadu_si128((const __m128i *)(const void *)key);
+}
+
+static inline AESNI_FUNC __m128i load_block(const unsigned char *p) {
+  return _mm_loadu_si128((const __m128i *)(const void *)p);
+}
+
+static inline AESNI_FUNC void store_block(unsigned char *p, __m128i x) {
+  _mm_storeu_si128((__m128i *)(void *)p, x);
+}
+
+static inline AESNI_FUNC __m128i encrypt1(const RIJNDAEL_context *ctx,
+                                          __m128i x) {
+  const int rounds = ctx->rounds;
+  int r;
+
+  x = _mm_xor_si128(x, load_key(ctx->keyschenc[0][0]));
+  for (r = 1; r < rounds; r++)
+    x = _mm_aesenc_si128(x, load_key(ctx->keyschenc[r][0]));
+  return _mm_aesenclast_si128(x, load_key(ctx->keyschenc[rounds][0]));
+}
+
+static inline AESNI_FUNC __m128i decrypt1(const RIJNDAEL_context *ctx,
+                                          __m128i x) {
+  const int rounds = ctx->rounds;
+  int r;
+
+  x = _mm_xor_si128(x, load_key(ctx->keyschdec[0][0]));
+  for (r = 1; r < rounds; r++)
+    x = _mm_aesdec_si128(x, load_key(ctx->keyschdec[r][0]));
+  return _mm_aesdeclast_si128(x, load_key(ctx->keyschdec[rounds][0]));
+}
+
+/* Encrypt the AESNI_WAY blocks in B in place.  The round keys are
+   loaded once per round and shared by all blocks.  */
+static inline AESNI_FUNC void encrypt8(const RIJNDAEL_context *ctx,
+                                       __m128i b[AESNI_WAY]) {
+  const int rounds = ctx->rounds;
+  __m128i k;
+  int r, i;
+
+  k = load_key(ctx->keyschenc[0][0]);
+  for (i = 0; i < AESNI_WAY; i++) b[i] = _mm_xor_si128(b[i], k);
+  for (r = 1; r < rounds; r++) {
+    k = load_key(ctx->keyschenc[r][0]);
+    for (i = 0; i < AESNI_WAY; i++) b[i] = _mm_aesenc_si128(b[i], k);
+  }
+  k = load_key(ctx->keyschenc[rounds][0]);
+  for (i = 0; i < AESNI_WAY; i++) b[i] = _mm_aesenclast_si128(b[i], k);
+}
+
+static inline AESNI_FUNC void decrypt8(const RIJNDAEL_context *ctx,
+                                       __m128i b[AESNI_WAY]) {
+  const int rounds = ctx->rounds;
+  __m128i k;
+  int r, i;
+
+  k = load_key(ctx->keyschdec[0][0]);
+  for (i = 0; i < AESNI_WAY; i++) b[i] = _mm_xor_si128(b[i], k);
+  for (r = 1; r < rounds; r++) {
+    k = load_key(ctx->keyschdec[r][0]);
+    for (i = 0; i < AESNI_WAY; i++) b[i] = _mm_aesdec_si128(b[i], k);
+  }
+  k = load_key(ctx->keyschdec[rounds][0]);
+  for (i = 0; i < AESNI_WAY; i++) b[i] = _mm_aesdeclast_si128(b[i], k);
+}
+
+/* Apply the S-box to the four bytes of W.  With all four columns
+   being equal, ShiftRows has no effect and AESENCLAST with a zero
+   round key is just SubBytes.  */
+static AESNI_FUNC u32 sub_word(u32 w) {
+  __m128i x = _mm_set1_epi32((int)w);
+
+  x = _mm_aesenclast_si128(x, _mm_setzero_si128());
+  return (u32)_mm_cvtsi128_si32(x);
+}
+
+void AESNI_FUNC _gcry_aes_aesni_do_setkey(RIJNDAEL_context *ctx,
+                                          const byte *key) {
+  static const byte rcon[10] = {0x01, 0x02, 0x04, 0x08, 0x10,
+                                0x20, 0x40, 0x80, 0x1b, 0x36};
+  int rounds = ctx->rounds;
+  int nk = rounds - 6;
+  u32 w[4 * (MAXROUNDS + 1)];
+  u32 t;
+  int i, r;
+
+  for (i = 0; i < nk; i++) w[i] = buf_get_le32(key + 4 * i);
+  for (i = nk; i < 4 * (rounds + 1); i++) {
+    t = w[i - 1];
+    if (i % nk == 0)
+      t = sub_word((t >> 8) | (t << 24)) ^ rcon[i / nk - 1];
+    else if (nk > 6 && i % nk == 4)
+      t = sub_word(t);
+    w[i] = w[i - nk] ^ t;
+  }
+
+  for (r = 0; r <= rounds; r++)
+    for (i = 0; i < 4; i++) buf_put_le32(ctx->keyschenc[r][i], w[4 * r + i]);
+
+  wipememory(w, sizeof w);
+}
+
+/* Make a decryption key from an encryption key. */
+void AESNI_FUNC _gcry_aes_aesni_prepare_decryption(RIJNDAEL_context *ctx) {
+  const int rounds = ctx->rounds;
+  __m128i k;
+  int r;
+
+  k = load_key(ctx->keyschenc[rounds][0]);
+  _mm_storeu_si128((__m128i *)(void *)ctx->keyschdec[0][0], k);
+  for (r = 1; r < rounds; r++) {
+    k = _mm_aesimc_si128(load_key(ctx->keyschenc[rounds - r][0]));
+    _mm_storeu_si128((__m128i *)(void *)ctx->keyschdec[r][0], k);
+  }
+  k = load_key(ctx->keyschenc[0][0]);
+  _mm_storeu_si128((__m128i *)(void *)ctx->keyschdec[rounds][0], k);
+}
+
+unsigned int AESNI_FUNC _gcry_aes_aesni_encrypt(const RIJNDAEL_context *ctx,
+                                                unsigned char *dst,
+                                                const unsigned char *src) {
+  store_block(dst, encrypt1(ctx, load_block(src)));
+  return 0;
+}
+
+unsigned int AESNI_FUNC _gcry_aes_aesni_decrypt(const RIJNDAEL_context *ctx,
+                                                unsigned char *dst,
+                                                const unsigned char *src) {
+  store_block(dst, decrypt1(ctx, load_block(src)));
+  return 0;
+}
+
+void AESNI_FUNC _gcry_aes_aesni_cfb_enc(RIJNDAEL_context *ctx,
+                                        unsigned char *outbuf,
+                                        const unsigned char *inbuf,
+                                        unsigned char *iv, size_t nblocks) {
+  __m128i x = load_block(iv);
+
+  for (; nblocks; nblocks--) {
+    x = _mm_xor_si128(encrypt1(ctx, x), load_block(inbuf));
+    store_block(outbuf, x);
+    outbuf += BLOCKSIZE;
+    inbuf += BLOCKSIZE;
+  }
+
+  store_block(iv, x);
+}
+
+void AESNI_FUNC _gcry_aes_aesni_cbc_enc(RIJNDAEL_context *ctx,
+                                        unsigned char *outbuf,
+                                        const unsigned char *inbuf,
+                                        unsigned char *iv, size_t nblocks,
+                                        int cbc_mac) {
+  __m128i x = load_block(iv);
+
+  for (; nblocks; nblocks--) {
+    x = encrypt1(ctx, _mm_xor_si128(x, load_block(inbuf)));
+    store_block(outbuf, x);
+    inbuf += BLOCKSIZE;
+    if (!cbc_mac) outbuf += BLOCKSIZE;
+  }
+
+  store_block(iv, x);
+}
+
+/* Return the big endian 128 bit counter HI:LO as a block.  */
+static inline AESNI_FUNC __m128i ctr_block(u64 hi, u64 lo) {
+  return _mm_set_epi64x((long long)be_bswap64(lo), (long long)be_bswap64(hi));
+}
+
+void AESNI_FUNC _gcry_aes_aesni_ctr_enc(RIJNDAEL_context *ctx,
+                                        unsigned char *outbuf,
+                                        const unsigned char *inbuf,
+                                        unsigned char *ctr, size_t nblocks) {
+  __m128i b[AESNI_WAY];
+  u64 hi = buf_get_be64(ctr);
+  u64 lo = buf_get_be64(ctr + 8);
+  int i;
+
+  for (; nblocks >= AESNI_WAY; nblocks -= AESNI_WAY) {
+    for (i = 0; i < AESNI_WAY; i++) {
+      b[i] = ctr_block(hi, lo);
+      if (!++lo) hi++;
+    }
+    encrypt8(ctx, b);
+    for (i = 0; i < AESNI_WAY; i++)
+      store_block(outbuf + i * BLOCKSIZE,
+                  _mm_xor_si128(b[i], load_block(inbuf + i * BLOCKSIZE)));
+    outbuf += AESNI_WAY * BLOCKSIZE;
+    inbuf += AESNI_WAY * BLOCKSIZE;
+  }
+
+  for (; nblocks; nblocks--) {
+    __m128i x = encrypt1(ctx, ctr_block(hi, lo));
+
+    if (!++lo) hi++;
+    store_block(outbuf, _mm_xor_si128(x, load_block(inbuf)));
+    outbuf += BLOCKSIZE;
+    inbuf += BLOCKSIZE;
+  }
+
+  buf_put_be64(ctr, hi);
+  buf_put_be64(ctr + 8, lo);
+}
+
+void AESNI_FUNC _gcry_aes_aesni_cfb_dec(RIJNDAEL_context *ctx,
+                                        unsigned char *outbuf,
+                                        const unsigned char *inbuf,
+                                        unsigned char *iv, size_t nblocks) {
+  __m128i b[AESNI_WAY];
+  __m128i c[AESNI_WAY];
+  __m128i x = load_block(iv);
+  int i;
+
+  for (; nblocks >= AESNI_WAY; nblocks -= AESNI_WAY) {
+    /* The cipher input is the IV followed by the previous ciphertext
+       blocks, so all blocks can be encrypted at once.  */
+    for (i = 0; i < AESNI_WAY; i++) c[i] = load_block(inbuf + i * BLOCKSIZE);
+    b[0] = x;
+    for (i = 1; i < AESNI_WAY; i++) b[i] = c[i - 1];
+    x = c[AESNI_WAY - 1];
+    encrypt8(ctx, b);
+    for (i = 0; i < AESNI_WAY; i++)
+      store_block(outbuf + i * BLOCKSIZE, _mm_xor_si128(b[i], c[i]));
+    outbuf += AESNI_WAY * BLOCKSIZE;
+    inbuf += AESNI_WAY * BLOCKSIZE;
+  }
+
+  for (; nblocks; nblocks--) {
+    __m128i cx = load_block(inbuf);
+
+    store_block(outbuf, _mm_xor_si128(encrypt1(ctx, x), cx));
+    x = cx;
+    outbuf += BLOCKSIZE;
+    inbuf += BLOCKSIZE;
+  }
+
+  store_block(iv, x);
+}
+
+void AESNI_FUNC _gcry_aes_aesni_cbc_dec(RIJNDAEL_context *ctx,
+                                        unsigned char *outbuf,
+                                        const unsigned char *inbuf,
+                                        unsigned char *iv, size_t nblocks) {
+  __m128i b[AESNI_WAY];
+  __m128i c[AESNI_WAY];
+  __m128i x = load_block(iv);
+  int i;
+
+  for (; nblocks >= AESNI_WAY; nblocks -= AESNI_WAY) {
+    /* INBUF may be the same as OUTBUF, so load all ciphertext blocks
+       before storing anything.  */
+    for (i = 0; i < AESNI_WAY; i++) {
+      c[i] = load_block(inbuf + i * BLOCKSIZE);
+      b[i] = c[i];
+    }
+    decrypt8(ctx, b);
+    store_block(outbuf, _mm_xor_si128(b[0], x));
+    for (i = 1; i < AESNI_WAY; i++)
+      store_block(outbuf + i * BLOCKSIZE, _mm_xor_si128(b[i], c[i - 1]));
+    x = c[AESNI_WAY - 1];
+    outbuf += AESNI_WAY * BLOCKSIZE;
+    inbuf += AESNI_WAY * BLOCKSIZE;
+  }
+
+  for (; nblocks; nblocks--) {
+    __m128i cx = load_block(inbuf);
+
+    store_block(outbuf, _mm_xor_si128(decrypt1(ctx, cx), x));
+    x = cx;
+    outbuf += BLOCKSIZE;
+    inbuf += BLOCKSIZE;
+  }
+
+  store_block(iv, x);
+}
+
+void AESNI_FUNC _gcry_aes_aesni_ocb_crypt(gcry_cipher_hd_t c,
+                                          void *outbuf_arg,
+                                          const void *inbuf_arg,
+                                          size_t nblocks, int encrypt) {
+  RIJNDAEL_context *ctx = (RIJNDAEL_context *)(void *)&c->context.c;
+  unsigned char *outbuf = (unsigned char *)outbuf_arg;
+  const unsigned char *inbuf = (const unsigned char *)inbuf_arg;
+  __m128i offset = load_block(c->u_iv.iv);
+  __m128i checksum = load_block(c->u_ctr.ctr);
+  __m128i x;
+
+  for (; nblocks; nblocks--) {
+    u64 i = ++c->u_mode.ocb.data_nblocks;
+    const unsigned char *l = ocb_get_l(c, i);
+
+    /* Offset_i = Offset_{i-1} xor L_{ntz(i)} */
+    offset = _mm_xor_si128(offset, load_block(l));
+    x = load_block(inbuf);
+    if (encrypt) {
+      /* Checksum_i = Checksum_{i-1} xor P_i  */
+      checksum = _mm_xor_si128(checksum, x);
+      /* C_i = Offset_i xor ENCIPHER(K, P_i xor Offset_i)  */
+      x = encrypt1(ctx, _mm_xor_si128(x, offset));
+      x = _mm_xor_si128(x, offset);
+    } else {
+      /* P_i = Offset_i xor DECIPHER(K, C_i xor Offset_i)  */
+      x = decrypt1(ctx, _mm_xor_si128(x, offset));
+      x = _mm_xor_si128(x, offset);
+      /* Checksum_i = Checksum_{i-1} xor P_i  */
+      checksum = _mm_xor_si128(checksum, x);
+    }
+    store_block(outbuf, x);
+
+    inbuf += BLOCKSIZE;
+    outbuf += BLOCKSIZE;
+  }
+
+  store_block(c->u_iv.iv, offset);
+  store_block(c->u_ctr.ctr, checksum);
+}
+
+void AESNI_FUNC _gcry_aes_aesni_ocb_auth(gcry_cipher_hd_t c,
+                                         const void *abuf_arg,
+                                         size_t nblocks) {
+  RIJNDAEL_context *ctx = (RIJNDAEL_context *)(void *)&c->context.c;
+  const unsigned char *abuf = (const unsigned char *)abuf_arg;
+  __m128i offset = load_block(c->u_mode.ocb.aad_offset);
+  __m128i sum = load_block(c->u_mode.ocb.aad_sum);
+
+  for (; nblocks; nblocks--) {
+    u64 i = ++c->u_mode.ocb.aad_nblocks;
+    const unsigned char *l = ocb_get_l(c, i);
+
+    /* Offset_i = Offset_{i-1} xor L_{ntz(i)} */
+    offset = _mm_xor_si128(offset, load_block(l));
+    /* Sum_i = Sum_{i-1} xor ENCIPHER(K, A_i xor Offset_i)  */
+    sum = _mm_xor_si128(
+        sum, encrypt1(ctx, _mm_xor_si128(load_block(abuf), offset)));
+
+    abuf += BLOCKSIZE;
+  }
+
+  store_block(c->u_mode.ocb.aad_offset, offset);
+  store_block(c->u_mode.ocb.aad_sum, sum);
+}
+
+#endif /*USE_AESNI*/
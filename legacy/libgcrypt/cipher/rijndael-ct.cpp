@@ -0,0 +1,466 @@
+/* Constant-time bitsliced AES implementation
+ * Copyright 2017 The NeoPG developers
+ *
+ * This file is part of Libgcrypt.
+ *
+ * Libgcrypt is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * Libgcrypt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This implementation does not use any table lookups or secret
+   dependent branches and is used if no hardware support for AES is
+   available.  Four blocks are processed in parallel: the 64 bytes of
+   the four states are stored as eight 64 bit words, where word B
+   holds bit B of every byte.  Bit 16 * N + I of a word belongs to
+   byte I of the state of block N, I being the usual column major
+   index (I = ROW + 4 * COLUMN).
+
+   SubBytes is computed as the inversion in GF(2^8), done as an
+   exponentiation to the power of 254, followed by the affine
+   transformation.  ShiftRows and MixColumns are bit permutations and
+   XORs on these words.  */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bufhelp.h"
+#include "cipher.h"
+#include "g10lib.h"
+#include "rijndael-internal.h"
+#include "types.h"
+
+#ifdef USE_CT
+
+#define NBLOCKS 4
+
+/* An upper bound of the stack used by the bitsliced code.  */
+#define CT_BURN_DEPTH 1024
+
+/* The round keys in bitsliced form are stored in the space of the
+   decryption key schedule, which is not needed by this
+   implementation.  Each round key needs eight 16 bit words.  */
+#define ct_rk(ctx) ((const u16(*)[8])(const void *)(ctx)->keyschdec)
+#define ct_rk_w(ctx) ((u16(*)[8])(void *)(ctx)->keyschdec)
+
+/* Transpose the 8x8 bit matrix in X.  */
+static inline u64 transpose8(u64 x) {
+  u64 t;
+
+  t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+  x = x ^ t ^ (t << 7);
+  t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+  x = x ^ t ^ (t << 14);
+  t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+  x = x ^ t ^ (t << 28);
+  return x;
+}
+
+/* Convert the 64 bytes at IN into bitsliced form.  */
+static void ct_load(u64 q[8], const byte *in) {
+  int g, b;
+
+  for (b = 0; b < 8; b++) q[b] = 0;
+  for (g = 0; g < 8; g++) {
+    u64 x = transpose8(buf_get_le64(in + 8 * g));
+
+    for (b = 0; b < 8; b++) q[b] |= ((x >> (8 * b)) & 0xff) << (8 * g);
+  }
+}
+
+/* Convert Q back into 64 bytes at OUT.  */
+static void ct_store(byte *out, const u64 q[8]) {
+  int g, b;
+
+  for (g = 0; g < 8; g++) {
+    u64 x = 0;
+
+    for (b = 0; b < 8; b++) x |= ((q[b] >> (8 * g)) & 0xff) << (8 * b);
+    buf_put_le64(out + 8 * g, transpose8(x));
+  }
+}
+
+/* R = A * B in GF(2^8) modulo x^8 + x^4 + x^3 + x + 1.  R may be the
+   same as A or B.  */
+static inline void gf_mul(u64 r[8], const u64 a[8], const u64 b[8]) {
+  u64 p[15];
+  int i, j;
+
+  for (i = 0; i < 15; i++) p[i] = 0;
+  for (i = 0; i < 8; i++)
+    for (j = 0; j < 8; j++) p[i + j] ^= a[i] & b[j];
+  for (i = 14; i >= 8; i--) {
+    p[i - 4] ^= p[i];
+    p[i - 5] ^= p[i];
+    p[i - 7] ^= p[i];
+    p[i - 8] ^= p[i];
+  }
+  for (i = 0; i < 8; i++) r[i] = p[i];
+}
+
+/* R = A^(2^N) in GF(2^8).  Squaring is linear.  R may be the same as
+   A.  */
+static inline void gf_sqr(u64 r[8], const u64 a[8], int n) {
+  u64 t[8];
+
+  for (int i = 0; i < 8; i++) t[i] = a[i];
+  while (n--) {
+    r[0] = t[0] ^ t[4] ^ t[6];
+    r[1] = t[4] ^ t[6] ^ t[7];
+    r[2] = t[1] ^ t[5];
+    r[3] = t[4] ^ t[5] ^ t[6] ^ t[7];
+    r[4] = t[2] ^ t[4] ^ t[7];
+    r[5] = t[5] ^ t[6];
+    r[6] = t[3] ^ t[5];
+    r[7] = t[6] ^ t[7];
+    for (int i = 0; i < 8; i++) t[i] = r[i];
+  }
+}
+
+/* Q = Q^254, which is the inverse of Q and maps 0 to 0.  */
+static void gf_inv(u64 q[8]) {
+  u64 x2[8], x3[8], x12[8], x14[8], x15[8], t[8];
+
+  gf_sqr(x2, q, 1);
+  gf_mul(x3, x2, q);
+  gf_sqr(x12, x3, 2);
+  gf_mul(x14, x12, x2);
+  gf_mul(x15, x12, x3);
+  gf_sqr(t, x15, 4);
+  gf_mul(q, t, x14);
+}
+
+static void sub_bytes(u64 q[8]) {
+  u64 b[8];
+  int i;
+
+  gf_inv(q);
+  for (i = 0; i < 8; i++) b[i] = q[i];
+  for (i = 0; i < 8; i++)
+    q[i] = b[i] ^ b[(i + 4) & 7] ^ b[(i + 5) & 7] ^ b[(i + 6) & 7] ^
+           b[(i + 7) & 7];
+  /* Add the constant 0x63.  */
+  q[0] = ~q[0];
+  q[1] = ~q[1];
+  q[5] = ~q[5];
+  q[6] = ~q[6];
+}
+
+static void inv_sub_bytes(u64 q[8]) {
+  u64 b[8];
+  int i;
+
+  for (i = 0; i < 8; i++) b[i] = q[i];
+  for (i = 0; i < 8; i++)
+    q[i] = b[(i + 2) & 7] ^ b[(i + 5) & 7] ^ b[(i + 7) & 7];
+  /* Add the constant 0x05.  */
+  q[0] = ~q[0];
+  q[2] = ~q[2];
+  gf_inv(q);
+}
+
+/* Rotate the bytes of row R to the left by R columns, or to the right
+   if INVERSE is set.  Within a 16 bit lane this is a rotation of the
+   bits by 4 * R positions.  */
+static inline u64 shift_rows_1(u64 x, int inverse) {
+  const u64 row1 = 0x2222222222222222ULL;
+  const u64 row2 = 0x4444444444444444ULL;
+  const u64 row3 = 0x8888888888888888ULL;
+  u64 r1 = x & row1, r2 = x & row2, r3 = x & row3;
+
+  if (inverse) {
+    r1 = ((r1 << 4) & 0xFFF0FFF0FFF0FFF0ULL) |
+         ((r1 >> 12) & 0x000F000F000F000FULL);
+    r3 = ((r3 >> 4) & 0x0FFF0FFF0FFF0FFFULL) |
+         ((r3 << 12) & 0xF000F000F000F000ULL);
+  } else {
+    r1 = ((r1 >> 4) & 0x0FFF0FFF0FFF0FFFULL) |
+         ((r1 << 12) & 0xF000F000F000F000ULL);
+    r3 = ((r3 << 4) & 0xFFF0FFF0FFF0FFF0ULL) |
+         ((r3 >> 12) & 0x000F000F000F000FULL);
+  }
+  r2 = ((r2 >> 8) & 0x00FF00FF00FF00FFULL) |
+       ((r2 << 8) & 0xFF00FF00FF00FF00ULL);
+
+  return (x & 0x1111111111111111ULL) | r1 | r2 | r3;
+}
+
+static void shift_rows(u64 q[8], int inverse) {
+  for (int i = 0; i < 8; i++) q[i] = shift_rows_1(q[i], inverse);
+}
+
+/* Rotate the rows within each column by N, so that row R of the
+   result is row R + N of X.  */
+static inline u64 rot_rows(u64 x, int n) {
+  switch (n) {
+    case 1:
+      return ((x >> 1) & 0x7777777777777777ULL) |
+             ((x << 3) & 0x8888888888888888ULL);
+    case 2:
+      return ((x >> 2) & 0x3333333333333333ULL) |
+             ((x << 2) & 0xCCCCCCCCCCCCCCCCULL);
+    default:
+      return ((x >> 3) & 0x1111111111111111ULL) |
+             ((x << 1) & 0xEEEEEEEEEEEEEEEEULL);
+  }
+}
+
+/* R = 2 * A in GF(2^8).  R must not be the same as A.  */
+static inline void xtime(u64 r[8], const u64 a[8]) {
+  r[0] = a[7];
+  r[1] = a[0] ^ a[7];
+  r[2] = a[1];
+  r[3] = a[2] ^ a[7];
+  r[4] = a[3] ^ a[7];
+  r[5] = a[4];
+  r[6] = a[5];
+  r[7] = a[6];
+}
+
+static void mix_columns(u64 q[8]) {
+  u64 t[8], r1[8], x[8];
+  int i;
+
+  /* out_r = 2 * (a_r ^ a_r+1) ^ a_r+1 ^ a_r+2 ^ a_r+3 */
+  for (i = 0; i < 8; i++) {
+    r1[i] = rot_rows(q[i], 1);
+    t[i] = q[i] ^ r1[i];
+  }
+  xtime(x, t);
+  for (i = 0; i < 8; i++)
+    q[i] = x[i] ^ r1[i] ^ rot_rows(q[i], 2) ^ rot_rows(q[i], 3);
+}
+
+static void inv_mix_columns(u64 q[8]) {
+  u64 t[8], x[8];
+  int i;
+
+  /* InvMixColumns is MixColumns after adding 4 * (a_r ^ a_r+2) to
+     every row.  */
+  for (i = 0; i < 8; i++) t[i] = q[i] ^ rot_rows(q[i], 2);
+  xtime(x, t);
+  xtime(t, x);
+  for (i = 0; i < 8; i++) q[i] ^= t[i];
+  mix_columns(q);
+}
+
+static inline void add_round_key(u64 q[8], const u16 rk[8]) {
+  for (int i = 0; i < 8; i++) q[i] ^= (u64)rk[i] * 0x0001000100010001ULL;
+}
+
+/* Encrypt the NBLOCKS blocks in BUF in place.  */
+static void ct_encrypt_blocks(const RIJNDAEL_context *ctx, byte *buf) {
+  const u16(*rk)[8] = ct_rk(ctx);
+  int rounds = ctx->rounds;
+  u64 q[8];
+  int r;
+
+  ct_load(q, buf);
+  add_round_key(q, rk[0]);
+  for (r = 1; r < rounds; r++) {
+    sub_bytes(q);
+    shift_rows(q, 0);
+    mix_columns(q);
+    add_round_key(q, rk[r]);
+  }
+  sub_bytes(q);
+  shift_rows(q, 0);
+  add_round_key(q, rk[rounds]);
+  ct_store(buf, q);
+
+  wipememory(q, sizeof q);
+}
+
+/* Decrypt the NBLOCKS blocks in BUF in place.  */
+static void ct_decrypt_blocks(const RIJNDAEL_context *ctx, byte *buf) {
+  const u16(*rk)[8] = ct_rk(ctx);
+  int rounds = ctx->rounds;
+  u64 q[8];
+  int r;
+
+  ct_load(q, buf);
+  add_round_key(q, rk[rounds]);
+  for (r = rounds - 1; r > 0; r--) {
+    shift_rows(q, 1);
+    inv_sub_bytes(q);
+    add_round_key(q, rk[r]);
+    inv_mix_columns(q);
+  }
+  shift_rows(q, 1);
+  inv_sub_bytes(q);
+  add_round_key(q, rk[0]);
+  ct_store(buf, q);
+
+  wipememory(q, sizeof q);
+}
+
+/* Apply the S-box to the four bytes of W.  */
+static u32 sub_word(u32 w) {
+  byte buf[NBLOCKS * BLOCKSIZE];
+  u64 q[8];
+
+  memset(buf, 0, sizeof buf);
+  buf_put_le32(buf, w);
+  ct_load(q, buf);
+  sub_bytes(q);
+  ct_store(buf, q);
+  w = buf_get_le32(buf);
+
+  wipememory(buf, sizeof buf);
+  wipememory(q, sizeof q);
+  return w;
+}
+
+/* Expand KEY into the encryption key schedule and its bitsliced
+   form.  CTX->ROUNDS must already be set.  */
+void _gcry_aes_ct_do_setkey(RIJNDAEL_context *ctx, const byte *key) {
+  static const byte rcon[10] = {0x01, 0x02, 0x04, 0x08, 0x10,
+                                0x20, 0x40, 0x80, 0x1b, 0x36};
+  int rounds = ctx->rounds;
+  int nk = rounds - 6;
+  u32 w[4 * (MAXROUNDS + 1)];
+  u32 t;
+  int i, r, b;
+
+  for (i = 0; i < nk; i++) w[i] = buf_get_le32(key + 4 * i);
+  for (i = nk; i < 4 * (rounds + 1); i++) {
+    t = w[i - 1];
+    if (i % nk == 0)
+      t = sub_word((t >> 8) | (t << 24)) ^ rcon[i / nk - 1];
+    else if (nk > 6 && i % nk == 4)
+      t = sub_word(t);
+    w[i] = w[i - nk] ^ t;
+  }
+
+  for (r = 0; r <= rounds; r++) {
+    u16 *rk = ct_rk_w(ctx)[r];
+
+    for (i = 0; i < 4; i++) buf_put_le32(ctx->keyschenc[r][i], w[4 * r + i]);
+    for (b = 0; b < 8; b++) {
+      rk[b] = 0;
+      for (i = 0; i < BLOCKSIZE; i++)
+        rk[b] |= ((ctx->keyschenc[r][i / 4][i % 4] >> b) & 1) << i;
+    }
+  }
+
+  wipememory(w, sizeof w);
+}
+
+unsigned int _gcry_aes_ct_encrypt(const RIJNDAEL_context *ctx,
+                                  unsigned char *dst,
+                                  const unsigned char *src) {
+  byte buf[NBLOCKS * BLOCKSIZE];
+
+  memset(buf + BLOCKSIZE, 0, sizeof buf - BLOCKSIZE);
+  buf_cpy(buf, src, BLOCKSIZE);
+  ct_encrypt_blocks(ctx, buf);
+  buf_cpy(dst, buf, BLOCKSIZE);
+  wipememory(buf, sizeof buf);
+
+  return CT_BURN_DEPTH;
+}
+
+unsigned int _gcry_aes_ct_decrypt(const RIJNDAEL_context *ctx,
+                                  unsigned char *dst,
+                                  const unsigned char *src) {
+  byte buf[NBLOCKS * BLOCKSIZE];
+
+  memset(buf + BLOCKSIZE, 0, sizeof buf - BLOCKSIZE);
+  buf_cpy(buf, src, BLOCKSIZE);
+  ct_decrypt_blocks(ctx, buf);
+  buf_cpy(dst, buf, BLOCKSIZE);
+  wipememory(buf, sizeof buf);
+
+  return CT_BURN_DEPTH;
+}
+
+unsigned int _gcry_aes_ct_ctr_enc(RIJNDAEL_context *ctx, unsigned char *outbuf,
+                                  const unsigned char *inbuf,
+                                  unsigned char *ctr, size_t nblocks) {
+  byte buf[NBLOCKS * BLOCKSIZE];
+  size_t n, i;
+  int j;
+
+  while (nblocks) {
+    n = nblocks < NBLOCKS ? nblocks : NBLOCKS;
+    for (i = 0; i < n; i++) {
+      buf_cpy(buf + i * BLOCKSIZE, ctr, BLOCKSIZE);
+      for (j = BLOCKSIZE; j > 0; j--) {
+        ctr[j - 1]++;
+        if (ctr[j - 1]) break;
+      }
+    }
+    ct_encrypt_blocks(ctx, buf);
+    buf_xor(outbuf, buf, inbuf, n * BLOCKSIZE);
+    outbuf += n * BLOCKSIZE;
+    inbuf += n * BLOCKSIZE;
+    nblocks -= n;
+  }
+
+  wipememory(buf, sizeof buf);
+  return CT_BURN_DEPTH;
+}
+
+unsigned int _gcry_aes_ct_cfb_dec(RIJNDAEL_context *ctx, unsigned char *outbuf,
+                                  const unsigned char *inbuf,
+                                  unsigned char *iv, size_t nblocks) {
+  byte buf[NBLOCKS * BLOCKSIZE];
+  size_t n;
+
+  while (nblocks) {
+    n = nblocks < NBLOCKS ? nblocks : NBLOCKS;
+    /* The cipher input is the IV followed by the previous ciphertext
+       blocks.  */
+    buf_cpy(buf, iv, BLOCKSIZE);
+    buf_cpy(buf + BLOCKSIZE, inbuf, (n - 1) * BLOCKSIZE);
+    buf_cpy(iv, inbuf + (n - 1) * BLOCKSIZE, BLOCKSIZE);
+    ct_encrypt_blocks(ctx, buf);
+    buf_xor(outbuf, buf, inbuf, n * BLOCKSIZE);
+    outbuf += n * BLOCKSIZE;
+    inbuf += n * BLOCKSIZE;
+    nblocks -= n;
+  }
+
+  wipememory(buf, sizeof buf);
+  return CT_BURN_DEPTH;
+}
+
+unsigned int _gcry_aes_ct_cbc_dec(RIJNDAEL_context *ctx, unsigned char *outbuf,
+                                  const unsigned char *inbuf,
+                                  unsigned char *iv, size_t nblocks) {
+  byte buf[NBLOCKS * BLOCKSIZE];
+  byte prev[NBLOCKS * BLOCKSIZE];
+  size_t n;
+
+  while (nblocks) {
+    n = nblocks < NBLOCKS ? nblocks : NBLOCKS;
+    /* INBUF may be the same as OUTBUF, so keep the values to XOR
+       with.  */
+    buf_cpy(buf, inbuf, n * BLOCKSIZE);
+    buf_cpy(prev, iv, BLOCKSIZE);
+    buf_cpy(prev + BLOCKSIZE, inbuf, (n - 1) * BLOCKSIZE);
+    buf_cpy(iv, inbuf + (n - 1) * BLOCKSIZE, BLOCKSIZE);
+    ct_decrypt_blocks(ctx, buf);
+    buf_xor(outbuf, buf, prev, n * BLOCKSIZE);
+    outbuf += n * BLOCKSIZE;
+    inbuf += n * BLOCKSIZE;
+    nblocks -= n;
+  }
+
+  wipememory(buf, sizeof buf);
+  wipememory(prev, sizeof prev);
+  return CT_BURN_DEPTH;
+}
+
+#endif /*USE_CT*/
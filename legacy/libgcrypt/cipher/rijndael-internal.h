@@ -84,6 +84,14 @@
 #endif
 #endif /* ENABLE_AESNI_SUPPORT */
 
+/* USE_CT indicates whether to use the bitsliced constant-time code
+   instead of the lookup tables if no hardware support is available.
+   The tables are faster but leak the key through cache timings.  */
+#undef USE_CT
+#ifndef DISABLE_AES_CT
+#define USE_CT 1
+#endif /* DISABLE_AES_CT */
+
 /* USE_ARM_CE indicates whether to enable ARMv8 Crypto Extension assembly
  * code. */
 #undef USE_ARM_CE
@@ -145,6 +153,9 @@ typedef struct RIJNDAEL_context_s {
 #ifdef USE_ARM_CE
   unsigned int use_arm_ce : 1; /* ARMv8 CE shall be used.  */
 #endif                         /*USE_ARM_CE*/
+#ifdef USE_CT
+  unsigned int use_ct : 1; /* The bitsliced code shall be used.  */
+#endif                     /*USE_CT*/
   rijndael_cryptfn_t encrypt_fn;
   rijndael_cryptfn_t decrypt_fn;
   rijndael_prefetchfn_t prefetch_enc_fn;
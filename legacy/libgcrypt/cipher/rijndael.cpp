@@ -203,10 +203,34 @@ extern void _gcry_aes_armv8_ce_ocb_auth(gcry_cipher_hd_t c,
                                         const void *abuf_arg, size_t nblocks);
 #endif /*USE_ARM_ASM*/
 
+#ifdef USE_CT
+/* Bitsliced constant-time implementation of AES */
+extern void _gcry_aes_ct_do_setkey(RIJNDAEL_context *ctx, const byte *key);
+
+extern unsigned int _gcry_aes_ct_encrypt(const RIJNDAEL_context *ctx,
+                                         unsigned char *dst,
+                                         const unsigned char *src);
+extern unsigned int _gcry_aes_ct_decrypt(const RIJNDAEL_context *ctx,
+                                         unsigned char *dst,
+                                         const unsigned char *src);
+extern unsigned int _gcry_aes_ct_ctr_enc(RIJNDAEL_context *ctx,
+                                         unsigned char *outbuf,
+                                         const unsigned char *inbuf,
+                                         unsigned char *ctr, size_t nblocks);
+extern unsigned int _gcry_aes_ct_cfb_dec(RIJNDAEL_context *ctx,
+                                         unsigned char *outbuf,
+                                         const unsigned char *inbuf,
+                                         unsigned char *iv, size_t nblocks);
+extern unsigned int _gcry_aes_ct_cbc_dec(RIJNDAEL_context *ctx,
+                                         unsigned char *outbuf,
+                                         const unsigned char *inbuf,
+                                         unsigned char *iv, size_t nblocks);
+#else  /*!USE_CT*/
 static unsigned int do_encrypt(const RIJNDAEL_context *ctx, unsigned char *bx,
                                const unsigned char *ax);
 static unsigned int do_decrypt(const RIJNDAEL_context *ctx, unsigned char *bx,
                                const unsigned char *ax);
+#endif /*!USE_CT*/
 
 /* All the numbers.  */
 #include "rijndael-tables.h"
@@ -282,6 +306,9 @@ static gpg_error_t do_setkey(RIJNDAEL_context *ctx, const byte *key,
 #ifdef USE_ARM_CE
   ctx->use_arm_ce = 0;
 #endif
+#ifdef USE_CT
+  ctx->use_ct = 0;
+#endif
 
   if (0) {
     ;
@@ -323,12 +350,22 @@ static gpg_error_t do_setkey(RIJNDAEL_context *ctx, const byte *key,
     ctx->use_arm_ce = 1;
   }
 #endif
+#ifdef USE_CT
+  else {
+    ctx->encrypt_fn = _gcry_aes_ct_encrypt;
+    ctx->decrypt_fn = _gcry_aes_ct_decrypt;
+    ctx->prefetch_enc_fn = NULL;
+    ctx->prefetch_dec_fn = NULL;
+    ctx->use_ct = 1;
+  }
+#else  /*!USE_CT*/
   else {
     ctx->encrypt_fn = do_encrypt;
     ctx->decrypt_fn = do_decrypt;
     ctx->prefetch_enc_fn = prefetch_enc;
     ctx->prefetch_dec_fn = prefetch_dec;
   }
+#endif /*!USE_CT*/
 
   /* NB: We don't yet support Padlock hardware key generation.  */
 
@@ -346,6 +383,10 @@ static gpg_error_t do_setkey(RIJNDAEL_context *ctx, const byte *key,
 #ifdef USE_ARM_CE
   else if (ctx->use_arm_ce)
     _gcry_aes_armv8_ce_setkey(ctx, key);
+#endif
+#ifdef USE_CT
+  else if (ctx->use_ct)
+    _gcry_aes_ct_do_setkey(ctx, key);
 #endif
   else {
     const byte *sbox = ((const byte *)encT) + 1;
@@ -464,6 +505,11 @@ static void prepare_decryption(RIJNDAEL_context *ctx) {
     /* Padlock does not need decryption subkeys. */
   }
 #endif /*USE_PADLOCK*/
+#ifdef USE_CT
+  else if (ctx->use_ct) {
+    /* The bitsliced code runs the key schedule backwards. */
+  }
+#endif /*USE_CT*/
   else {
     const byte *sbox = ((const byte *)encT) + 1;
 
@@ -512,6 +558,7 @@ static void prepare_decryption(RIJNDAEL_context *ctx) {
   }
 }
 
+#ifndef USE_CT
 #if !defined(USE_ARM_ASM) && !defined(USE_AMD64_ASM)
 /* Encrypt one block. A and B may be the same. */
 static unsigned int do_encrypt_fn(const RIJNDAEL_context *ctx, unsigned char *b,
@@ -671,6 +718,7 @@ static unsigned int do_encrypt(const RIJNDAEL_context *ctx, unsigned char *bx,
   return do_encrypt_fn(ctx, bx, ax);
 #endif /* !USE_ARM_ASM && !USE_AMD64_ASM*/
 }
+#endif /*!USE_CT*/
 
 static unsigned int rijndael_encrypt(void *context, byte *b, const byte *a) {
   RIJNDAEL_context *ctx = (RIJNDAEL_context *)context;
@@ -819,6 +867,11 @@ void _gcry_aes_ctr_enc(void *context, unsigned char *ctr, void *outbuf_arg,
     burn_depth = 0;
   }
 #endif /*USE_ARM_CE*/
+#ifdef USE_CT
+  else if (ctx->use_ct) {
+    burn_depth = _gcry_aes_ct_ctr_enc(ctx, outbuf, inbuf, ctr, nblocks);
+  }
+#endif /*USE_CT*/
   else {
     union {
       unsigned char x1[16] ATTR_ALIGNED_16;
@@ -846,6 +899,7 @@ void _gcry_aes_ctr_enc(void *context, unsigned char *ctr, void *outbuf_arg,
   if (burn_depth) _gcry_burn_stack(burn_depth + 4 * sizeof(void *));
 }
 
+#ifndef USE_CT
 #if !defined(USE_ARM_ASM) && !defined(USE_AMD64_ASM)
 /* Decrypt one block.  A and B may be the same. */
 static unsigned int do_decrypt_fn(const RIJNDAEL_context *ctx, unsigned char *b,
@@ -1005,6 +1059,7 @@ static unsigned int do_decrypt(const RIJNDAEL_context *ctx, unsigned char *bx,
   return do_decrypt_fn(ctx, bx, ax);
 #endif /*!USE_ARM_ASM && !USE_AMD64_ASM*/
 }
+#endif /*!USE_CT*/
 
 static inline void check_decryption_preparation(RIJNDAEL_context *ctx) {
   if (!ctx->decryption_prepared) {
@@ -1056,6 +1111,11 @@ void _gcry_aes_cfb_dec(void *context, unsigned char *iv, void *outbuf_arg,
     burn_depth = 0;
   }
 #endif /*USE_ARM_CE*/
+#ifdef USE_CT
+  else if (ctx->use_ct) {
+    burn_depth = _gcry_aes_ct_cfb_dec(ctx, outbuf, inbuf, iv, nblocks);
+  }
+#endif /*USE_CT*/
   else {
     rijndael_cryptfn_t encrypt_fn = ctx->encrypt_fn;
 
@@ -1105,6 +1165,11 @@ void _gcry_aes_cbc_dec(void *context, unsigned char *iv, void *outbuf_arg,
     burn_depth = 0;
   }
 #endif /*USE_ARM_CE*/
+#ifdef USE_CT
+  else if (ctx->use_ct) {
+    burn_depth = _gcry_aes_ct_cbc_dec(ctx, outbuf, inbuf, iv, nblocks);
+  }
+#endif /*USE_CT*/
   else {
     unsigned char savebuf[BLOCKSIZE] ATTR_ALIGNED_16;
     rijndael_cryptfn_t decrypt_fn = ctx->decrypt_fn;
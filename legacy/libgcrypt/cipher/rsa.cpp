@@ -809,7 +809,14 @@ static int check_secret_key(RSA_secret_key *sk) {
  */
 static void public_x(gcry_mpi_t output, gcry_mpi_t input,
                      RSA_public_key *pkey) {
-  if (output == input) /* powm doesn't like output and input the same */
+  /* The modulus is public and usually used for many operations, so
+     its Montgomery context is kept around.  */
+  mpi_mont_t mont = mpi_mont_cached(pkey->n);
+
+  if (mont) {
+    mpi_powm_mont(output, input, pkey->e, mont);
+    mpi_mont_free(mont);
+  } else if (output == input) /* powm doesn't like output and input the same */
   {
     gcry_mpi_t x = mpi_alloc(mpi_get_nlimbs(input) * 2);
     mpi_powm(x, input, pkey->e, pkey->n);
@@ -1422,6 +1429,41 @@ leave:
   return rc;
 }
 
+/* Verify the signature SIG = {s} over the raw DATA with the key PKEY
+   = {n, e}.  */
+static gpg_error_t rsa_verify_mpi(int algo, gcry_ecc_curve_t curve,
+                                  gcry_mpi_t data, gcry_mpi_t *sig,
+                                  gcry_mpi_t *pkey) {
+  gpg_error_t rc;
+  RSA_public_key pk;
+  gcry_mpi_t s, result;
+
+  (void)algo;
+  (void)curve;
+
+  if (!data || !sig[0] || !pkey[0] || !pkey[1]) return GPG_ERR_NO_OBJ;
+  if (mpi_is_opaque(data)) return GPG_ERR_INV_DATA;
+
+  s = _gcry_pk_util_mpi_copy(sig[0], 0);
+  pk.n = _gcry_pk_util_mpi_copy(pkey[0], 0);
+  pk.e = _gcry_pk_util_mpi_copy(pkey[1], 0);
+  if (!s || !pk.n || !pk.e)
+    rc = GPG_ERR_INV_OBJ;
+  else {
+    result = mpi_new(0);
+    public_x(result, s, &pk);
+    rc = mpi_cmp(result, data) ? GPG_ERR_BAD_SIGNATURE : 0;
+    _gcry_mpi_release(result);
+  }
+
+  _gcry_mpi_release(pk.n);
+  _gcry_mpi_release(pk.e);
+  _gcry_mpi_release(s);
+  if (DBG_CIPHER)
+    log_debug("rsa_verify    => %s\n", rc ? gpg_strerror(rc) : "Good");
+  return rc;
+}
+
 /* Return the number of bits for the key described by PARMS.  On error
  * 0 is returned.  The format of PARMS starts with the algorithm name;
  * for example:
@@ -1769,4 +1811,8 @@ gcry_pk_spec_t _gcry_pubkey_spec_rsa = {
     rsa_verify,
     rsa_get_nbits,
     run_selftests,
-    compute_keygrip};
+    compute_keygrip,
+    NULL,
+    NULL,
+    NULL,
+    rsa_verify_mpi};
@@ -45,6 +45,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <thread>
+#include <vector>
+
 #include "bufhelp.h"
 #include "g10lib.h"
 #include "kdf-internal.h"
@@ -215,6 +218,35 @@ static void scrypt_ro_mix(u32 r, unsigned char *B, u64 N, unsigned char *tmp1,
 #endif
 }
 
+/* Run ROMix on the lanes FIRST, FIRST + STEP, ... below P of B.  The
+   lanes are independent, so several of these may run at once, each
+   with its own scratch memory.  */
+static gpg_error_t scrypt_lanes(u32 r, unsigned char *B, u64 N, u32 p,
+                                u32 first, u32 step) {
+  size_t r128 = r * 128;
+  unsigned char *tmp1;
+  unsigned char *tmp2;
+  u32 i;
+
+  tmp1 = (unsigned char *)xtrymalloc(N * r128);
+  if (!tmp1) return gpg_error_from_syserror();
+
+  tmp2 = (unsigned char *)xtrymalloc(64 + r128);
+  if (!tmp2) {
+    gpg_error_t ec = gpg_error_from_syserror();
+    xfree(tmp1);
+    return ec;
+  }
+
+  for (i = first; i < p; i += step)
+    scrypt_ro_mix(r, &B[i * r128], N, tmp1, tmp2);
+
+  wipememory(tmp1, N * r128);
+  xfree(tmp2);
+  xfree(tmp1);
+  return 0;
+}
+
 /*
  *
  */
@@ -228,9 +260,8 @@ gpg_error_t _gcry_kdf_scrypt(const unsigned char *passwd, size_t passwdlen,
 
   gpg_error_t ec;
   u32 i;
+  u32 nthreads;
   unsigned char *B = NULL;
-  unsigned char *tmp1 = NULL;
-  unsigned char *tmp2 = NULL;
   size_t r128;
   size_t nbytes;
 
@@ -256,35 +287,45 @@ gpg_error_t _gcry_kdf_scrypt(const unsigned char *passwd, size_t passwdlen,
   if (nbytes < r128) return GPG_ERR_ENOMEM;
 
   B = (unsigned char *)xtrymalloc(p * r128);
-  if (!B) {
-    ec = gpg_error_from_syserror();
-    goto leave;
-  }
-
-  tmp1 = (unsigned char *)xtrymalloc(N * r128);
-  if (!tmp1) {
-    ec = gpg_error_from_syserror();
-    goto leave;
-  }
-
-  tmp2 = (unsigned char *)xtrymalloc(64 + r128);
-  if (!tmp2) {
-    ec = gpg_error_from_syserror();
-    goto leave;
-  }
+  if (!B) return gpg_error_from_syserror();
 
   ec = _gcry_kdf_pkdf2(passwd, passwdlen, GCRY_MD_SHA256, salt, saltlen,
                        1 /* iterations */, p * r128, B);
-
-  for (i = 0; !ec && i < p; i++) scrypt_ro_mix(r, &B[i * r128], N, tmp1, tmp2);
-
-  for (i = 0; !ec && i < p; i++)
+  if (ec) goto leave;
+
+  /* The P lanes are spread over up to one thread per CPU; this is
+     what lets a parallelization parameter above 1 reduce the wall
+     clock time of the derivation.  Each thread needs its own N * 128
+     * R bytes of scratch memory.  */
+  nthreads = std::thread::hardware_concurrency();
+  if (nthreads > p) nthreads = p;
+  if (nthreads > 1) {
+    std::vector<std::thread> threads;
+    std::vector<gpg_error_t> errs(nthreads, 0);
+
+    try {
+      for (i = 1; i < nthreads; i++)
+        threads.emplace_back([&errs, i, r, B, N, p, nthreads]() {
+          errs[i] = scrypt_lanes(r, B, N, p, i, nthreads);
+        });
+    } catch (...) {
+      /* Could not start all threads; the lanes of the missing ones
+         are computed below.  */
+    }
+    errs[0] = scrypt_lanes(r, B, N, p, 0, nthreads);
+    for (auto &thread : threads) thread.join();
+    for (i = threads.size() + 1; !errs[0] && i < nthreads; i++)
+      errs[0] = scrypt_lanes(r, B, N, p, i, nthreads);
+    for (i = 0; !ec && i < nthreads; i++) ec = errs[i];
+  } else
+    ec = scrypt_lanes(r, B, N, p, 0, 1);
+
+  if (!ec)
     ec = _gcry_kdf_pkdf2(passwd, passwdlen, GCRY_MD_SHA256, B, p * r128,
                          1 /* iterations */, dkLen, DK);
 
 leave:
-  xfree(tmp2);
-  xfree(tmp1);
+  wipememory(B, p * r128);
   xfree(B);
 
   return ec;
@@ -0,0 +1,116 @@
+/* SHA-1 transform using the Intel SHA extensions
+ * Copyright 2017 The NeoPG developers
+ *
+ * This file is part of Libgcrypt.
+ *
+ * Libgcrypt is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * Libgcrypt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This is written with compiler intrinsics and must only be called
+   if HWF_INTEL_SHAEXT and HWF_INTEL_SSE4_1 are set.  Each SHA1RNDS4
+   instruction does four rounds; the message schedule is computed
+   with SHA1MSG1/SHA1MSG2 three groups of four words ahead.  */
+
+#include <config.h>
+
+#include "g10lib.h"
+#include "sha1.h"
+
+#ifdef USE_SHAEXT
+
+#include <immintrin.h>
+
+#define SHAEXT_FUNC __attribute__((target("sse4.1,sha")))
+
+/* Do four rounds with function F on the message words in CUR.  E
+   holds the A value saved four rounds ago and ESAVE receives the
+   current one.  H is the index of the group and selects the message
+   schedule steps: NXT is completed for the next group, NN gets the
+   W[t-8] term two groups ahead and PRV starts the group three ahead
+   (its slot is free again).  */
+#define ROUNDS4(h, f, e, esave, cur, nxt, nn, prv)             \
+  do {                                                         \
+    if (h == 0)                                                \
+      e = _mm_add_epi32(e, cur);                               \
+    else                                                       \
+      e = _mm_sha1nexte_epu32(e, cur);                         \
+    esave = abcd;                                              \
+    if (h >= 3 && h <= 18) nxt = _mm_sha1msg2_epu32(nxt, cur); \
+    abcd = _mm_sha1rnds4_epu32(abcd, e, f);                    \
+    if (h >= 1 && h <= 16) prv = _mm_sha1msg1_epu32(prv, cur); \
+    if (h >= 2 && h <= 17) nn = _mm_xor_si128(nn, cur);        \
+  } while (0)
+
+/* Transform NBLKS 64 byte blocks at DATA into the five words of
+   STATE.  */
+SHAEXT_FUNC unsigned int _gcry_sha1_transform_intel_shaext(
+    void *state, const unsigned char *data, size_t nblks) {
+  u32 *h = (u32 *)state;
+  const __m128i bswap =
+      _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+  __m128i abcd, abcd_save, e0, e0_save, e1;
+  __m128i m0, m1, m2, m3;
+
+  abcd = _mm_loadu_si128((const __m128i *)(const void *)h);
+  abcd = _mm_shuffle_epi32(abcd, 0x1b);
+  e0 = _mm_set_epi32(h[4], 0, 0, 0);
+
+  while (nblks--) {
+    abcd_save = abcd;
+    e0_save = e0;
+
+    m0 = _mm_loadu_si128((const __m128i *)(const void *)(data + 0));
+    m1 = _mm_loadu_si128((const __m128i *)(const void *)(data + 16));
+    m2 = _mm_loadu_si128((const __m128i *)(const void *)(data + 32));
+    m3 = _mm_loadu_si128((const __m128i *)(const void *)(data + 48));
+    m0 = _mm_shuffle_epi8(m0, bswap);
+    m1 = _mm_shuffle_epi8(m1, bswap);
+    m2 = _mm_shuffle_epi8(m2, bswap);
+    m3 = _mm_shuffle_epi8(m3, bswap);
+
+    ROUNDS4(0, 0, e0, e1, m0, m1, m2, m3);
+    ROUNDS4(1, 0, e1, e0, m1, m2, m3, m0);
+    ROUNDS4(2, 0, e0, e1, m2, m3, m0, m1);
+    ROUNDS4(3, 0, e1, e0, m3, m0, m1, m2);
+    ROUNDS4(4, 0, e0, e1, m0, m1, m2, m3);
+    ROUNDS4(5, 1, e1, e0, m1, m2, m3, m0);
+    ROUNDS4(6, 1, e0, e1, m2, m3, m0, m1);
+    ROUNDS4(7, 1, e1, e0, m3, m0, m1, m2);
+    ROUNDS4(8, 1, e0, e1, m0, m1, m2, m3);
+    ROUNDS4(9, 1, e1, e0, m1, m2, m3, m0);
+    ROUNDS4(10, 2, e0, e1, m2, m3, m0, m1);
+    ROUNDS4(11, 2, e1, e0, m3, m0, m1, m2);
+    ROUNDS4(12, 2, e0, e1, m0, m1, m2, m3);
+    ROUNDS4(13, 2, e1, e0, m1, m2, m3, m0);
+    ROUNDS4(14, 2, e0, e1, m2, m3, m0, m1);
+    ROUNDS4(15, 3, e1, e0, m3, m0, m1, m2);
+    ROUNDS4(16, 3, e0, e1, m0, m1, m2, m3);
+    ROUNDS4(17, 3, e1, e0, m1, m2, m3, m0);
+    ROUNDS4(18, 3, e0, e1, m2, m3, m0, m1);
+    ROUNDS4(19, 3, e1, e0, m3, m0, m1, m2);
+
+    e0 = _mm_sha1nexte_epu32(e0, e0_save);
+    abcd = _mm_add_epi32(abcd, abcd_save);
+
+    data += 64;
+  }
+
+  abcd = _mm_shuffle_epi32(abcd, 0x1b);
+  _mm_storeu_si128((__m128i *)(void *)h, abcd);
+  h[4] = _mm_extract_epi32(e0, 3);
+
+  return 0;
+}
+
+#endif /*USE_SHAEXT*/
@@ -106,6 +106,15 @@ static void sha1_init(void *context, unsigned int flags) {
 
   (void)flags;
 
+#ifdef USE_SHAEXT
+  {
+    unsigned int features = _gcry_get_hw_features();
+
+    hd->use_shaext = (features & HWF_INTEL_SHAEXT) != 0 &&
+                     (features & HWF_INTEL_SSE4_1) != 0;
+  }
+#endif
+
   hd->h0 = 0x67452301;
   hd->h1 = 0xefcdab89;
   hd->h2 = 0x98badcfe;
@@ -282,6 +291,12 @@ static unsigned int transform_blk(void *ctx, const unsigned char *data) {
 #endif
 #endif
 
+#ifdef USE_SHAEXT
+unsigned int _gcry_sha1_transform_intel_shaext(void *state,
+                                               const unsigned char *data,
+                                               size_t nblks);
+#endif
+
 #ifdef USE_SSSE3
 unsigned int _gcry_sha1_transform_amd64_ssse3(void *state,
                                               const unsigned char *data,
@@ -305,6 +320,10 @@ static unsigned int transform(void *ctx, const unsigned char *data,
   SHA1_CONTEXT *hd = (SHA1_CONTEXT *)ctx;
   unsigned int burn;
 
+#ifdef USE_SHAEXT
+  if (hd->use_shaext)
+    return _gcry_sha1_transform_intel_shaext(&hd->h0, data, nblks);
+#endif
 #ifdef USE_BMI2
   if (hd->use_bmi2)
     return _gcry_sha1_transform_amd64_avx_bmi2(&hd->h0, data, nblks) +
@@ -21,6 +21,17 @@
 
 #include "hash-common.h"
 
+/* USE_SHAEXT indicates whether to compile with Intel SHA Extension
+   code.  It is written with intrinsics and shared with
+   sha1-intel-shaext.cpp.  */
+#undef USE_SHAEXT
+#ifdef ENABLE_SHAEXT_SUPPORT
+#if (defined(__i386__) || defined(__x86_64__)) && \
+    (__GNUC__ >= 5 || defined(__clang__))
+#define USE_SHAEXT 1
+#endif
+#endif
+
 /* We need this here for direct use by random-csprng.c. */
 typedef struct {
   gcry_md_block_ctx_t bctx;
@@ -30,6 +41,7 @@ typedef struct {
   unsigned int use_bmi2 : 1;
   unsigned int use_neon : 1;
   unsigned int use_arm_ce : 1;
+  unsigned int use_shaext : 1;
 } SHA1_CONTEXT;
 
 void _gcry_sha1_mixblock_init(SHA1_CONTEXT *hd);
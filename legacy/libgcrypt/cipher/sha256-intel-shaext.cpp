@@ -0,0 +1,141 @@
+/* SHA-256 transform using the Intel SHA extensions
+ * Copyright 2017 The NeoPG developers
+ *
+ * This file is part of Libgcrypt.
+ *
+ * Libgcrypt is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * Libgcrypt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This is written with compiler intrinsics and must only be called
+   if HWF_INTEL_SHAEXT and HWF_INTEL_SSE4_1 are set.  SHA256RNDS2
+   wants the state as the two vectors ABEF and CDGH instead of the
+   natural order and does two rounds; the message schedule is
+   computed with SHA256MSG1/SHA256MSG2 three groups of four words
+   ahead.  */
+
+#include <config.h>
+
+#include "g10lib.h"
+#include "types.h"
+
+/* USE_SHAEXT indicates whether to compile with Intel SHA Extension
+   code.  Keep in sync with sha256.cpp.  */
+#undef USE_SHAEXT
+#ifdef ENABLE_SHAEXT_SUPPORT
+#if (defined(__i386__) || defined(__x86_64__)) && \
+    (__GNUC__ >= 5 || defined(__clang__))
+#define USE_SHAEXT 1
+#endif
+#endif
+
+#ifdef USE_SHAEXT
+
+#include <immintrin.h>
+
+#define SHAEXT_FUNC __attribute__((target("sse4.1,sha")))
+
+static const u32 K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+/* Do four rounds on the message words in CUR.  H is the index of the
+   group and selects the message schedule steps: NXT is completed for
+   the next group using PRV for the W[t-7] term, and PRV then starts
+   the group three ahead (its slot is free again).  */
+#define ROUNDS4(h, cur, nxt, prv)                                        \
+  do {                                                                   \
+    msg = _mm_add_epi32(                                                 \
+        cur, _mm_loadu_si128((const __m128i *)(const void *)&K[4 * h])); \
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);                 \
+    if (h >= 3 && h <= 14) {                                             \
+      nxt = _mm_add_epi32(nxt, _mm_alignr_epi8(cur, prv, 4));            \
+      nxt = _mm_sha256msg2_epu32(nxt, cur);                              \
+    }                                                                    \
+    msg = _mm_shuffle_epi32(msg, 0x0e);                                  \
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);                 \
+    if (h >= 1 && h <= 12) prv = _mm_sha256msg1_epu32(prv, cur);        \
+  } while (0)
+
+/* Transform NBLKS 64 byte blocks at DATA into the eight words of
+   STATE.  */
+SHAEXT_FUNC unsigned int _gcry_sha256_transform_intel_shaext(
+    u32 state[8], const unsigned char *data, size_t nblks) {
+  const __m128i bswap =
+      _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+  __m128i state0, state1, save0, save1, msg, tmp;
+  __m128i m0, m1, m2, m3;
+
+  tmp = _mm_loadu_si128((const __m128i *)(const void *)&state[0]);
+  state1 = _mm_loadu_si128((const __m128i *)(const void *)&state[4]);
+  tmp = _mm_shuffle_epi32(tmp, 0xb1);          /* CDAB */
+  state1 = _mm_shuffle_epi32(state1, 0x1b);    /* EFGH */
+  state0 = _mm_alignr_epi8(tmp, state1, 8);    /* ABEF */
+  state1 = _mm_blend_epi16(state1, tmp, 0xf0); /* CDGH */
+
+  while (nblks--) {
+    save0 = state0;
+    save1 = state1;
+
+    m0 = _mm_loadu_si128((const __m128i *)(const void *)(data + 0));
+    m1 = _mm_loadu_si128((const __m128i *)(const void *)(data + 16));
+    m2 = _mm_loadu_si128((const __m128i *)(const void *)(data + 32));
+    m3 = _mm_loadu_si128((const __m128i *)(const void *)(data + 48));
+    m0 = _mm_shuffle_epi8(m0, bswap);
+    m1 = _mm_shuffle_epi8(m1, bswap);
+    m2 = _mm_shuffle_epi8(m2, bswap);
+    m3 = _mm_shuffle_epi8(m3, bswap);
+
+    ROUNDS4(0, m0, m1, m3);
+    ROUNDS4(1, m1, m2, m0);
+    ROUNDS4(2, m2, m3, m1);
+    ROUNDS4(3, m3, m0, m2);
+    ROUNDS4(4, m0, m1, m3);
+    ROUNDS4(5, m1, m2, m0);
+    ROUNDS4(6, m2, m3, m1);
+    ROUNDS4(7, m3, m0, m2);
+    ROUNDS4(8, m0, m1, m3);
+    ROUNDS4(9, m1, m2, m0);
+    ROUNDS4(10, m2, m3, m1);
+    ROUNDS4(11, m3, m0, m2);
+    ROUNDS4(12, m0, m1, m3);
+    ROUNDS4(13, m1, m2, m0);
+    ROUNDS4(14, m2, m3, m1);
+    ROUNDS4(15, m3, m0, m2);
+
+    state0 = _mm_add_epi32(state0, save0);
+    state1 = _mm_add_epi32(state1, save1);
+
+    data += 64;
+  }
+
+  tmp = _mm_shuffle_epi32(state0, 0x1b);       /* FEBA */
+  state1 = _mm_shuffle_epi32(state1, 0xb1);    /* DCHG */
+  state0 = _mm_blend_epi16(tmp, state1, 0xf0); /* DCBA */
+  state1 = _mm_alignr_epi8(state1, tmp, 8);    /* HGFE */
+  _mm_storeu_si128((__m128i *)(void *)&state[0], state0);
+  _mm_storeu_si128((__m128i *)(void *)&state[4], state1);
+
+  return 0;
+}
+
+#endif /*USE_SHAEXT*/
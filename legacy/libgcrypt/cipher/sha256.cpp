@@ -75,6 +75,16 @@
 #define USE_AVX2 1
 #endif
 
+/* USE_SHAEXT indicates whether to compile with Intel SHA Extension
+   code.  Keep in sync with sha256-intel-shaext.cpp.  */
+#undef USE_SHAEXT
+#ifdef ENABLE_SHAEXT_SUPPORT
+#if (defined(__i386__) || defined(__x86_64__)) && \
+    (__GNUC__ >= 5 || defined(__clang__))
+#define USE_SHAEXT 1
+#endif
+#endif
+
 /* USE_ARM_CE indicates whether to enable ARMv8 Crypto Extension assembly
  * code. */
 #undef USE_ARM_CE
@@ -105,6 +115,9 @@ typedef struct {
 #ifdef USE_ARM_CE
   unsigned int use_arm_ce : 1;
 #endif
+#ifdef USE_SHAEXT
+  unsigned int use_shaext : 1;
+#endif
 } SHA256_CONTEXT;
 
 static unsigned int transform(void *c, const unsigned char *data, size_t nblks);
@@ -114,6 +127,15 @@ static void sha256_init(void *context, unsigned int flags) {
 
   (void)flags;
 
+#ifdef USE_SHAEXT
+  {
+    unsigned int features = _gcry_get_hw_features();
+
+    hd->use_shaext = (features & HWF_INTEL_SHAEXT) != 0 &&
+                     (features & HWF_INTEL_SSE4_1) != 0;
+  }
+#endif
+
   hd->h0 = 0x6a09e667;
   hd->h1 = 0xbb67ae85;
   hd->h2 = 0x3c6ef372;
@@ -135,6 +157,15 @@ static void sha224_init(void *context, unsigned int flags) {
 
   (void)flags;
 
+#ifdef USE_SHAEXT
+  {
+    unsigned int features = _gcry_get_hw_features();
+
+    hd->use_shaext = (features & HWF_INTEL_SHAEXT) != 0 &&
+                     (features & HWF_INTEL_SSE4_1) != 0;
+  }
+#endif
+
   hd->h0 = 0xc1059ed8;
   hd->h1 = 0x367cd507;
   hd->h2 = 0x3070dd17;
@@ -324,6 +355,12 @@ unsigned int _gcry_sha256_transform_amd64_avx2(const void *input_data,
                                                size_t num_blks) ASM_FUNC_ABI;
 #endif
 
+#ifdef USE_SHAEXT
+unsigned int _gcry_sha256_transform_intel_shaext(u32 state[8],
+                                                 const unsigned char *data,
+                                                 size_t nblks);
+#endif
+
 #ifdef USE_ARM_CE
 unsigned int _gcry_sha256_transform_armv8_ce(u32 state[8],
                                              const void *input_data,
@@ -335,6 +372,11 @@ static unsigned int transform(void *ctx, const unsigned char *data,
   SHA256_CONTEXT *hd = (SHA256_CONTEXT *)ctx;
   unsigned int burn;
 
+#ifdef USE_SHAEXT
+  if (hd->use_shaext)
+    return _gcry_sha256_transform_intel_shaext(&hd->h0, data, nblks);
+#endif
+
 #ifdef USE_AVX2
   if (hd->use_avx2)
     return _gcry_sha256_transform_amd64_avx2(data, &hd->h0, nblks) +
@@ -0,0 +1,214 @@
+/* SHA-512 transform using AVX2 for the message schedule
+ * Copyright 2017 The NeoPG developers
+ *
+ * This file is part of Libgcrypt.
+ *
+ * Libgcrypt is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * Libgcrypt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This is written with compiler intrinsics and must only be called
+   if HWF_INTEL_AVX2 and HWF_INTEL_BMI2 are set.  The 80 words of the
+   message schedule are computed four at a time in 256 bit registers,
+   with the round constants already added, while the rounds
+   themselves stay scalar; BMI2 lets the compiler use RORX for the
+   rotations, which does not touch the flags and needs no extra
+   move.  As in the RORX transforms of the Intel whitepaper, the
+   schedule of the next block is computed during the first 64 rounds
+   of the current one, so that the vector unit works while the scalar
+   rounds wait on their dependency chain.  Computing it up front
+   made this slower than the generic code.  */
+
+#include <config.h>
+
+#include "g10lib.h"
+#include "types.h"
+
+/* USE_AVX2_BMI2 indicates whether to compile with the intrinsics
+   based AVX2/BMI2 code.  Keep in sync with sha512.cpp.  */
+#undef USE_AVX2_BMI2
+#ifdef ENABLE_AVX2_SUPPORT
+#if defined(__x86_64__) && (__GNUC__ >= 5 || defined(__clang__))
+#define USE_AVX2_BMI2 1
+#endif
+#endif
+
+#ifdef USE_AVX2_BMI2
+
+#include <immintrin.h>
+
+#define AVX2_FUNC __attribute__((target("avx2,bmi2")))
+
+static inline AVX2_FUNC u64 ror64(u64 x, unsigned int n) {
+  return (x >> n) | (x << (64 - n));
+}
+
+/* Rotate each 64 bit lane of X right by N.  */
+#define VROR(x, n) \
+  _mm256_or_si256(_mm256_srli_epi64(x, n), _mm256_slli_epi64(x, 64 - n))
+#define VROR128(x, n) \
+  _mm_or_si128(_mm_srli_epi64(x, n), _mm_slli_epi64(x, 64 - n))
+
+/* Return the words 1 to 4 of the eight words in A and B.  */
+static inline AVX2_FUNC __m256i shift1(__m256i a, __m256i b) {
+  return _mm256_alignr_epi8(_mm256_permute2x128_si256(a, b, 0x21), a, 8);
+}
+
+static inline AVX2_FUNC __m256i sigma0(__m256i x) {
+  return _mm256_xor_si256(_mm256_xor_si256(VROR(x, 1), VROR(x, 8)),
+                          _mm256_srli_epi64(x, 7));
+}
+
+static inline AVX2_FUNC __m128i sigma1(__m128i x) {
+  return _mm_xor_si128(_mm_xor_si128(VROR128(x, 19), VROR128(x, 61)),
+                       _mm_srli_epi64(x, 6));
+}
+
+/* Compute the next four schedule words from the previous sixteen in
+   W0 to W3.  The sigma1 term depends on the two words before, so the
+   upper half has to wait for the lower one.  */
+static inline AVX2_FUNC __m256i schedule(__m256i w0, __m256i w1, __m256i w2,
+                                         __m256i w3) {
+  __m256i x;
+  __m128i lo, hi;
+
+  x = _mm256_add_epi64(w0, sigma0(shift1(w0, w1)));
+  x = _mm256_add_epi64(x, shift1(w2, w3));
+  lo = _mm_add_epi64(_mm256_castsi256_si128(x),
+                     sigma1(_mm256_extracti128_si256(w3, 1)));
+  hi = _mm_add_epi64(_mm256_extracti128_si256(x, 1), sigma1(lo));
+  return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+#define ROUND(a, b, c, d, e, f, g, h, wk)                       \
+  do {                                                          \
+    u64 t1 = h + (ror64(e, 14) ^ ror64(e, 18) ^ ror64(e, 41)) + \
+             ((e & f) ^ (~e & g)) + wk;                         \
+    u64 t2 = (ror64(a, 28) ^ ror64(a, 34) ^ ror64(a, 39)) +     \
+             ((a & b) ^ (a & c) ^ (b & c));                     \
+    d += t1;                                                    \
+    h = t1 + t2;                                                \
+  } while (0)
+
+/* Store the schedule words 4 * J to 4 * J + 3 in X plus their round
+   constants at WK.  */
+#define STORE_WK(wk, j, x)                              \
+  _mm256_store_si256((__m256i *)(void *)&(wk)[4 * (j)], \
+                     _mm256_add_epi64(x, _mm256_loadu_si256(kv + (j))))
+
+/* Load the message block at DATA into W0 to W3 and store the first
+   sixteen words of its schedule plus the round constants at WK.  */
+#define LOAD_BLOCK(wk, data)                                            \
+  do {                                                                  \
+    const __m256i *dv = (const __m256i *)(const void *)(data);          \
+                                                                        \
+    w0 = _mm256_shuffle_epi8(_mm256_loadu_si256(dv + 0), bswap);        \
+    w1 = _mm256_shuffle_epi8(_mm256_loadu_si256(dv + 1), bswap);        \
+    w2 = _mm256_shuffle_epi8(_mm256_loadu_si256(dv + 2), bswap);        \
+    w3 = _mm256_shuffle_epi8(_mm256_loadu_si256(dv + 3), bswap);        \
+    STORE_WK(wk, 0, w0);                                                \
+    STORE_WK(wk, 1, w1);                                                \
+    STORE_WK(wk, 2, w2);                                                \
+    STORE_WK(wk, 3, w3);                                                \
+  } while (0)
+
+/* Compute the schedule words 4 * J to 4 * J + 3 from W0 to W3, store
+   them at WK and move them into the window.  */
+#define SCHEDULE(wk, j)                   \
+  do {                                    \
+    __m256i x = schedule(w0, w1, w2, w3); \
+                                          \
+    STORE_WK(wk, j, x);                   \
+    w0 = w1;                              \
+    w1 = w2;                              \
+    w2 = w3;                              \
+    w3 = x;                               \
+  } while (0)
+
+/* Transform NBLKS 128 byte blocks at DATA into the eight words of
+   STATE using the round constants K.  Returns the number of bytes of
+   stack to burn.  */
+AVX2_FUNC unsigned int _gcry_sha512_transform_avx2_bmi2(
+    u64 state[8], const unsigned char *data, const u64 k[], size_t nblks) {
+  const __m256i bswap = _mm256_set_epi8(
+      8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12,
+      13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+  const __m256i *kv = (const __m256i *)(const void *)k;
+  u64 wk[2][80] __attribute__((aligned(32)));
+  __m256i w0, w1, w2, w3;
+  u64 a, b, c, d, e, f, g, h;
+  u64 *cur, *next;
+  int i;
+
+  if (!nblks) return 0;
+
+  LOAD_BLOCK(wk[0], data);
+  for (i = 4; i < 20; i++) SCHEDULE(wk[0], i);
+
+  for (cur = wk[0], next = wk[1]; nblks--; data += 128) {
+    u64 *tmp;
+
+    a = state[0];
+    b = state[1];
+    c = state[2];
+    d = state[3];
+    e = state[4];
+    f = state[5];
+    g = state[6];
+    h = state[7];
+
+    i = 0;
+    if (nblks) {
+      LOAD_BLOCK(next, data + 128);
+      for (; i < 64; i += 8) {
+        SCHEDULE(next, i / 4 + 4);
+        ROUND(a, b, c, d, e, f, g, h, cur[i + 0]);
+        ROUND(h, a, b, c, d, e, f, g, cur[i + 1]);
+        ROUND(g, h, a, b, c, d, e, f, cur[i + 2]);
+        ROUND(f, g, h, a, b, c, d, e, cur[i + 3]);
+        SCHEDULE(next, i / 4 + 5);
+        ROUND(e, f, g, h, a, b, c, d, cur[i + 4]);
+        ROUND(d, e, f, g, h, a, b, c, cur[i + 5]);
+        ROUND(c, d, e, f, g, h, a, b, cur[i + 6]);
+        ROUND(b, c, d, e, f, g, h, a, cur[i + 7]);
+      }
+    }
+    for (; i < 80; i += 8) {
+      ROUND(a, b, c, d, e, f, g, h, cur[i + 0]);
+      ROUND(h, a, b, c, d, e, f, g, cur[i + 1]);
+      ROUND(g, h, a, b, c, d, e, f, cur[i + 2]);
+      ROUND(f, g, h, a, b, c, d, e, cur[i + 3]);
+      ROUND(e, f, g, h, a, b, c, d, cur[i + 4]);
+      ROUND(d, e, f, g, h, a, b, c, cur[i + 5]);
+      ROUND(c, d, e, f, g, h, a, b, cur[i + 6]);
+      ROUND(b, c, d, e, f, g, h, a, cur[i + 7]);
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+
+    tmp = cur;
+    cur = next;
+    next = tmp;
+  }
+
+  return sizeof wk + 4 * sizeof(__m256i) + 16 * sizeof(void *);
+}
+
+#endif /*USE_AVX2_BMI2*/
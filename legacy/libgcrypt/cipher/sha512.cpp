@@ -96,6 +96,15 @@
 #define USE_AVX2 1
 #endif
 
+/* USE_AVX2_BMI2 indicates whether to compile with the intrinsics
+   based AVX2/BMI2 code.  Keep in sync with sha512-avx2-bmi2.cpp.  */
+#undef USE_AVX2_BMI2
+#ifdef ENABLE_AVX2_SUPPORT
+#if defined(__x86_64__) && (__GNUC__ >= 5 || defined(__clang__))
+#define USE_AVX2_BMI2 1
+#endif
+#endif
+
 typedef struct { u64 h0, h1, h2, h3, h4, h5, h6, h7; } SHA512_STATE;
 
 typedef struct {
@@ -113,6 +122,9 @@ typedef struct {
 #ifdef USE_AVX2
   unsigned int use_avx2 : 1;
 #endif
+#ifdef USE_AVX2_BMI2
+  unsigned int use_avx2_bmi2 : 1;
+#endif
 } SHA512_CONTEXT;
 
 static unsigned int transform(void *context, const unsigned char *data,
@@ -124,6 +136,15 @@ static void sha512_init(void *context, unsigned int flags) {
 
   (void)flags;
 
+#ifdef USE_AVX2_BMI2
+  {
+    unsigned int features = _gcry_get_hw_features();
+
+    ctx->use_avx2_bmi2 = (features & HWF_INTEL_AVX2) != 0 &&
+                         (features & HWF_INTEL_BMI2) != 0;
+  }
+#endif
+
   hd->h0 = U64_C(0x6a09e667f3bcc908);
   hd->h1 = U64_C(0xbb67ae8584caa73b);
   hd->h2 = U64_C(0x3c6ef372fe94f82b);
@@ -146,6 +167,15 @@ static void sha384_init(void *context, unsigned int flags) {
 
   (void)flags;
 
+#ifdef USE_AVX2_BMI2
+  {
+    unsigned int features = _gcry_get_hw_features();
+
+    ctx->use_avx2_bmi2 = (features & HWF_INTEL_AVX2) != 0 &&
+                         (features & HWF_INTEL_BMI2) != 0;
+  }
+#endif
+
   hd->h0 = U64_C(0xcbbb9d5dc1059ed8);
   hd->h1 = U64_C(0x629a292a367cd507);
   hd->h2 = U64_C(0x9159015a3070dd17);
@@ -528,11 +558,22 @@ unsigned int _gcry_sha512_transform_amd64_avx2(const void *input_data,
                                                size_t num_blks) ASM_FUNC_ABI;
 #endif
 
+#ifdef USE_AVX2_BMI2
+unsigned int _gcry_sha512_transform_avx2_bmi2(u64 state[8],
+                                              const unsigned char *data,
+                                              const u64 k[], size_t nblks);
+#endif
+
 static unsigned int transform(void *context, const unsigned char *data,
                               size_t nblks) {
   SHA512_CONTEXT *ctx = (SHA512_CONTEXT *)context;
   unsigned int burn;
 
+#ifdef USE_AVX2_BMI2
+  if (ctx->use_avx2_bmi2)
+    return _gcry_sha512_transform_avx2_bmi2(&ctx->state.h0, data, k, nblks);
+#endif
+
 #ifdef USE_AVX2
   if (ctx->use_avx2)
     return _gcry_sha512_transform_amd64_avx2(data, &ctx->state, nblks) +
@@ -0,0 +1,204 @@
+/* mpih-amd64.cpp  -  x86-64 MPI helper functions
+ * Copyright 2017 The NeoPG developers
+ *
+ * This file is part of Libgcrypt.
+ *
+ * Libgcrypt is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * Libgcrypt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The limb loops below are written in inline assembly because the
+   compilers do not keep the carry in the flags across iterations.
+   The loops are unrolled four times and advance with LEA and JRCXZ,
+   which leave the flags alone.
+
+   _gcry_mpih_add_n and _gcry_mpih_sub_n only need the base
+   instruction set and replace the generic code.  The multiplication
+   loops use MULX, which does not touch the flags, and for the
+   accumulating variants ADCX and ADOX, which keep two independent
+   carry chains in CF and OF: one to add the high half of the previous
+   product and one to add the product to the result.  They must only
+   be called if HWF_INTEL_BMI2 and HWF_INTEL_ADX are set, see
+   _gcry_mpih_use_mulx.  */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "mpi-internal.h"
+
+#ifdef USE_AMD64_MPIH
+
+/* Set by _gcry_mpi_init if the MULX code shall be used.  */
+int _gcry_mpih_use_mulx;
+
+/* Loop over the limbs with STEP, which is expanded with the byte
+   offset of the limb, and ADVANCE the pointers afterwards.  The
+   number of groups of four limbs is expected in RCX and the number of
+   remaining limbs in N1.  The first test clears CF and OF; JRCXZ can
+   only jump 127 bytes, which is not enough to skip the unrolled
+   loop.  */
+#define LIMB_LOOP(step, advance) \
+  "testq %%rcx, %%rcx\n\t"       \
+  "jz 2f\n"                      \
+  "1:\n\t"                       \
+  step("0")                      \
+  step("8")                      \
+  step("16")                     \
+  step("24")                     \
+  advance("32")                  \
+  "leaq -1(%%rcx), %%rcx\n\t"    \
+  "jrcxz 2f\n\t"                 \
+  "jmp 1b\n"                     \
+  "2:\n\t"                       \
+  "movq %[n1], %%rcx\n"          \
+  "3:\n\t"                       \
+  "jrcxz 4f\n\t"                 \
+  step("0")                      \
+  advance("8")                   \
+  "leaq -1(%%rcx), %%rcx\n\t"    \
+  "jmp 3b\n"                     \
+  "4:\n\t"
+
+#define ADVANCE_1(n)               \
+  "leaq " n "(%[s1]), %[s1]\n\t"   \
+  "leaq " n "(%[res]), %[res]\n\t"
+
+#define ADVANCE_2(n)               \
+  "leaq " n "(%[s1]), %[s1]\n\t"   \
+  "leaq " n "(%[s2]), %[s2]\n\t"   \
+  "leaq " n "(%[res]), %[res]\n\t"
+
+#define ADD_N_STEP(off)            \
+  "movq " off "(%[s1]), %[t]\n\t"  \
+  "adcq " off "(%[s2]), %[t]\n\t"  \
+  "movq %[t], " off "(%[res])\n\t"
+
+#define SUB_N_STEP(off)            \
+  "movq " off "(%[s1]), %[t]\n\t"  \
+  "sbbq " off "(%[s2]), %[t]\n\t"  \
+  "movq %[t], " off "(%[res])\n\t"
+
+/* RES = LO + CY + CF, with the carry going to CF.  */
+#define MUL_1_STEP(off)                    \
+  "mulxq " off "(%[s1]), %[lo], %[hi]\n\t" \
+  "adcq %[cy], %[lo]\n\t"                  \
+  "movq %[lo], " off "(%[res])\n\t"        \
+  "movq %[hi], %[cy]\n\t"
+
+/* RES += LO + CY, with the carry of the product in CF and that of the
+   addition in OF.  */
+#define ADDMUL_1_STEP(off)                 \
+  "mulxq " off "(%[s1]), %[lo], %[hi]\n\t" \
+  "adcxq %[cy], %[lo]\n\t"                 \
+  "adoxq " off "(%[res]), %[lo]\n\t"       \
+  "movq %[lo], " off "(%[res])\n\t"        \
+  "movq %[hi], %[cy]\n\t"
+
+/* RES -= LO + CY.  There is no subtraction which uses OF, so this
+   adds to the complement: ~(~RES + X) = RES - X, and the carry out of
+   ~RES + X is the borrow of RES - X.  */
+#define SUBMUL_1_STEP(off)                 \
+  "mulxq " off "(%[s1]), %[lo], %[hi]\n\t" \
+  "adcxq %[cy], %[lo]\n\t"                 \
+  "movq " off "(%[res]), %[t]\n\t"         \
+  "notq %[t]\n\t"                          \
+  "adoxq %[lo], %[t]\n\t"                  \
+  "notq %[t]\n\t"                          \
+  "movq %[t], " off "(%[res])\n\t"         \
+  "movq %[hi], %[cy]\n\t"
+
+mpi_limb_t _gcry_mpih_add_n(mpi_ptr_t res_ptr, mpi_ptr_t s1_ptr,
+                            mpi_ptr_t s2_ptr, mpi_size_t size) {
+  unsigned long n4 = size >> 2;
+  unsigned long n1 = size & 3;
+  mpi_limb_t cy, t;
+
+  asm volatile("xorl %k[cy], %k[cy]\n\t" /* Also clears CF.  */
+               LIMB_LOOP(ADD_N_STEP, ADVANCE_2)
+               "adcl %k[cy], %k[cy]\n\t"
+               : [res] "+r"(res_ptr), [s1] "+r"(s1_ptr), [s2] "+r"(s2_ptr),
+                 [cy] "=&r"(cy), [t] "=&r"(t), "+c"(n4)
+               : [n1] "r"(n1)
+               : "cc", "memory");
+  return cy;
+}
+
+mpi_limb_t _gcry_mpih_sub_n(mpi_ptr_t res_ptr, mpi_ptr_t s1_ptr,
+                            mpi_ptr_t s2_ptr, mpi_size_t size) {
+  unsigned long n4 = size >> 2;
+  unsigned long n1 = size & 3;
+  mpi_limb_t cy, t;
+
+  asm volatile("xorl %k[cy], %k[cy]\n\t"
+               LIMB_LOOP(SUB_N_STEP, ADVANCE_2)
+               "adcl %k[cy], %k[cy]\n\t"
+               : [res] "+r"(res_ptr), [s1] "+r"(s1_ptr), [s2] "+r"(s2_ptr),
+                 [cy] "=&r"(cy), [t] "=&r"(t), "+c"(n4)
+               : [n1] "r"(n1)
+               : "cc", "memory");
+  return cy;
+}
+
+mpi_limb_t _gcry_mpih_mul_1_mulx(mpi_ptr_t res_ptr, mpi_ptr_t s1_ptr,
+                                 mpi_size_t s1_size, mpi_limb_t s2_limb) {
+  unsigned long n4 = s1_size >> 2;
+  unsigned long n1 = s1_size & 3;
+  mpi_limb_t cy, lo, hi;
+
+  asm volatile("xorl %k[cy], %k[cy]\n\t"
+               LIMB_LOOP(MUL_1_STEP, ADVANCE_1)
+               "adcq $0, %[cy]\n\t"
+               : [res] "+r"(res_ptr), [s1] "+r"(s1_ptr), [cy] "=&r"(cy),
+                 [lo] "=&r"(lo), [hi] "=&r"(hi), "+c"(n4)
+               : [n1] "r"(n1), "d"(s2_limb)
+               : "cc", "memory");
+  return cy;
+}
+
+mpi_limb_t _gcry_mpih_addmul_1_mulx(mpi_ptr_t res_ptr, mpi_ptr_t s1_ptr,
+                                    mpi_size_t s1_size, mpi_limb_t s2_limb) {
+  unsigned long n4 = s1_size >> 2;
+  unsigned long n1 = s1_size & 3;
+  mpi_limb_t cy, lo, hi;
+
+  asm volatile("xorl %k[cy], %k[cy]\n\t" /* Also clears CF and OF.  */
+               LIMB_LOOP(ADDMUL_1_STEP, ADVANCE_1)
+               "movl $0, %k[lo]\n\t"
+               "adcxq %[lo], %[cy]\n\t"
+               "adoxq %[lo], %[cy]\n\t"
+               : [res] "+r"(res_ptr), [s1] "+r"(s1_ptr), [cy] "=&r"(cy),
+                 [lo] "=&r"(lo), [hi] "=&r"(hi), "+c"(n4)
+               : [n1] "r"(n1), "d"(s2_limb)
+               : "cc", "memory");
+  return cy;
+}
+
+mpi_limb_t _gcry_mpih_submul_1_mulx(mpi_ptr_t res_ptr, mpi_ptr_t s1_ptr,
+                                    mpi_size_t s1_size, mpi_limb_t s2_limb) {
+  unsigned long n4 = s1_size >> 2;
+  unsigned long n1 = s1_size & 3;
+  mpi_limb_t cy, lo, hi, t;
+
+  asm volatile("xorl %k[cy], %k[cy]\n\t"
+               LIMB_LOOP(SUBMUL_1_STEP, ADVANCE_1)
+               "movl $0, %k[lo]\n\t"
+               "adcxq %[lo], %[cy]\n\t"
+               "adoxq %[lo], %[cy]\n\t"
+               : [res] "+r"(res_ptr), [s1] "+r"(s1_ptr), [cy] "=&r"(cy),
+                 [lo] "=&r"(lo), [hi] "=&r"(hi), [t] "=&r"(t), "+c"(n4)
+               : [n1] "r"(n1), "d"(s2_limb)
+               : "cc", "memory");
+  return cy;
+}
+
+#endif /*USE_AMD64_MPIH*/
@@ -24,8 +24,67 @@
 
 #include "context.h"
 #include "ec-context.h"
+#include "ec-internal.h"
 #include "g10lib.h"
 #include "longlong.h"
 #include "mpi-internal.h"
 
-void _gcry_mpi_ec_ed25519_mod(gcry_mpi_t a) { (void)a; }
+/* Arithmetic modulo p = 2^255 - 19, which is used by Ed25519 and
+   Curve25519.  Since 2^256 = 38 mod p, the high half of a product is
+   folded into the low half by a multiplication with 38.  */
+
+#define LIMBS_25519 (256 / BITS_PER_MPI_LIMB)
+
+static const mpi_limb_t p25519[LIMBS_25519] = {
+    LIMB64(0xffffffff, 0xffffffed), LIMB64(0xffffffff, 0xffffffff),
+    LIMB64(0xffffffff, 0xffffffff), LIMB64(0x7fffffff, 0xffffffff)};
+
+/* RP = TP mod p, where TP has 2 * LIMBS_25519 limbs and is
+   destroyed.  */
+static void reduce_25519(mpi_ptr_t rp, mpi_ptr_t tp) {
+  const mpi_size_t n = LIMBS_25519;
+  mpi_limb_t c[LIMBS_25519];
+  mpi_limb_t cy, top;
+
+  MPN_ZERO(c, n);
+
+  /* Fold the high half; the carry is at most 38.  Folding that may
+     carry once more, after which the low limbs are small enough for
+     the last fold not to carry.  */
+  cy = _gcry_mpih_addmul_1(tp, tp + n, n, 38);
+  c[0] = cy * 38;
+  cy = _gcry_mpih_add_n(tp, tp, c, n);
+  c[0] = cy * 38;
+  _gcry_mpih_add_n(tp, tp, c, n);
+
+  /* Fold bit 255 with 2^255 = 19 mod p.  The result is less than
+     2p.  */
+  top = tp[n - 1] >> (BITS_PER_MPI_LIMB - 1);
+  tp[n - 1] &= ~(mpi_limb_t)0 >> 1;
+  c[0] = top * 19;
+  _gcry_mpih_add_n(tp, tp, c, n);
+
+  ec_field_sub_p(tp, 0, p25519, c, n);
+  MPN_COPY(rp, tp, n);
+}
+
+void _gcry_mpi_ec_ed25519_mod(gcry_mpi_t a) {
+  mpi_limb_t tp[2 * LIMBS_25519];
+
+  ec_field_get(tp, a, 2 * LIMBS_25519);
+  reduce_25519(tp, tp);
+  ec_field_set(a, tp, LIMBS_25519);
+}
+
+void _gcry_mpi_ec_ed25519_mulm(gcry_mpi_t w, gcry_mpi_t u, gcry_mpi_t v) {
+  mpi_limb_t up[LIMBS_25519], vp[LIMBS_25519], tp[2 * LIMBS_25519];
+
+  ec_field_get(up, u, LIMBS_25519);
+  ec_field_get(vp, v, LIMBS_25519);
+  ec_field_mul_n(tp, up, vp, LIMBS_25519);
+  reduce_25519(tp, tp);
+  ec_field_set(w, tp, LIMBS_25519);
+}
+
+const mpi_ec_field_t _gcry_mpi_ec_field_25519 = {
+    LIMBS_25519, _gcry_mpi_ec_ed25519_mod, _gcry_mpi_ec_ed25519_mulm};
@@ -20,6 +20,66 @@
 #ifndef GCRY_EC_INTERNAL_H
 #define GCRY_EC_INTERNAL_H
 
+#include "mpi-internal.h"
+
 void _gcry_mpi_ec_ed25519_mod(gcry_mpi_t a);
+void _gcry_mpi_ec_ed25519_mulm(gcry_mpi_t w, gcry_mpi_t u, gcry_mpi_t v);
+void _gcry_mpi_ec_nist256_mod(gcry_mpi_t a);
+void _gcry_mpi_ec_nist256_mulm(gcry_mpi_t w, gcry_mpi_t u, gcry_mpi_t v);
+void _gcry_mpi_ec_nist384_mod(gcry_mpi_t a);
+void _gcry_mpi_ec_nist384_mulm(gcry_mpi_t w, gcry_mpi_t u, gcry_mpi_t v);
+
+/* Helpers for the field arithmetic of ec-ed25519.c and ec-nist.c.  */
+
+/* Initializer for the limbs of the 64 bit value HI * 2^32 + LO.  */
+#if BITS_PER_MPI_LIMB == 64
+#define LIMB64(hi, lo) (((mpi_limb_t)(hi) << 32) | (lo))
+#elif BITS_PER_MPI_LIMB == 32
+#define LIMB64(hi, lo) (lo), (hi)
+#else
+#error "Unsupported limb size"
+#endif
+
+/* Store the value of A, which has at most N limbs, into the N limbs
+   at RP.  */
+static inline void ec_field_get(mpi_ptr_t rp, gcry_mpi_t a, mpi_size_t n) {
+  mpi_size_t i;
+
+  for (i = 0; i < a->nlimbs; i++) rp[i] = a->d[i];
+  for (; i < n; i++) rp[i] = 0;
+}
+
+/* Set W to the N limbs at AP.  */
+static inline void ec_field_set(gcry_mpi_t w, mpi_ptr_t ap, mpi_size_t n) {
+  RESIZE_IF_NEEDED(w, n);
+  MPN_COPY(w->d, ap, n);
+  w->nlimbs = n;
+  w->sign = 0;
+  MPN_NORMALIZE(w->d, w->nlimbs);
+}
+
+/* RP = UP * VP, with UP and VP of N limbs and RP of 2N limbs.  Unlike
+   _gcry_mpih_mul_n, there are no shortcuts for special limbs.  */
+static inline void ec_field_mul_n(mpi_ptr_t rp, mpi_ptr_t up, mpi_ptr_t vp,
+                                  mpi_size_t n) {
+  mpi_size_t i;
+
+  rp[n] = _gcry_mpih_mul_1(rp, up, n, vp[0]);
+  for (i = 1; i < n; i++) rp[n + i] = _gcry_mpih_addmul_1(rp + i, up, n, vp[i]);
+}
+
+/* Subtract the N limbs of P from the N limbs at RP, plus a carry CY
+   out of them, if that is not negative.  TP is scratch space of N
+   limbs.  */
+static inline void ec_field_sub_p(mpi_ptr_t rp, mpi_limb_t cy,
+                                  const mpi_limb_t *p, mpi_ptr_t tp,
+                                  mpi_size_t n) {
+  mpi_limb_t mask;
+  mpi_size_t i;
+
+  cy |= _gcry_mpih_sub_n(tp, rp, (mpi_ptr_t)p, n) ^ 1;
+  mask = 0 - cy;
+  for (i = 0; i < n; i++) rp[i] = (tp[i] & mask) | (rp[i] & ~mask);
+}
 
 #endif /*GCRY_EC_INTERNAL_H*/
@@ -0,0 +1,151 @@
+/* ec-nist.cpp -  NIST optimized elliptic curve functions
+ * Copyright 2017 The NeoPG developers
+ *
+ * This file is part of Libgcrypt.
+ *
+ * Libgcrypt is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * Libgcrypt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Arithmetic modulo the primes of NIST P-256 and P-384.  These are
+   Solinas primes: 2^(32 * N) mod p is a sum of a few signed powers of
+   2^32 below 2^(32 * (N - 1)).  The reduction folds the words above
+   the low N 32 bit words back with these terms, from the top down,
+   into signed 64 bit accumulators and then propagates the carries.
+   This is the generalization of the word additions and subtractions
+   given in FIPS 186 for the two primes.  */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "context.h"
+#include "ec-context.h"
+#include "ec-internal.h"
+#include "g10lib.h"
+#include "mpi-internal.h"
+
+#define LIMBS_NIST256 (256 / BITS_PER_MPI_LIMB)
+#define LIMBS_NIST384 (384 / BITS_PER_MPI_LIMB)
+#define MAX_WORDS 12
+
+/* Add V * (2^(32 * N) mod p) to the words at ACC.  */
+typedef void (*fold_fn_t)(int64_t *acc, int64_t v);
+
+/* p = 2^256 - 2^224 + 2^192 + 2^96 - 1 */
+static const mpi_limb_t p_nist256[LIMBS_NIST256] = {
+    LIMB64(0xffffffff, 0xffffffff), LIMB64(0x00000000, 0xffffffff),
+    LIMB64(0x00000000, 0x00000000), LIMB64(0xffffffff, 0x00000001)};
+
+/* 2^256 = 2^224 - 2^192 - 2^96 + 1 mod p */
+static inline void fold_nist256(int64_t *acc, int64_t v) {
+  acc[7] += v;
+  acc[6] -= v;
+  acc[3] -= v;
+  acc[0] += v;
+}
+
+/* p = 2^384 - 2^128 - 2^96 + 2^32 - 1 */
+static const mpi_limb_t p_nist384[LIMBS_NIST384] = {
+    LIMB64(0x00000000, 0xffffffff), LIMB64(0xffffffff, 0x00000000),
+    LIMB64(0xffffffff, 0xfffffffe), LIMB64(0xffffffff, 0xffffffff),
+    LIMB64(0xffffffff, 0xffffffff), LIMB64(0xffffffff, 0xffffffff)};
+
+/* 2^384 = 2^128 + 2^96 - 2^32 + 1 mod p */
+static inline void fold_nist384(int64_t *acc, int64_t v) {
+  acc[4] += v;
+  acc[3] += v;
+  acc[1] -= v;
+  acc[0] += v;
+}
+
+/* RP = TP mod p, where TP has 2 * NWORDS 32 bit words, p is given in
+   limbs by P and FOLD adds multiples of 2^(32 * NWORDS) mod p.  RP
+   may be TP.  */
+static inline void reduce_solinas(mpi_ptr_t rp, mpi_ptr_t tp, int nwords,
+                                  const mpi_limb_t *p, fold_fn_t fold) {
+  const int per_limb = BITS_PER_MPI_LIMB / 32;
+  const mpi_size_t nlimbs = nwords / per_limb;
+  int64_t acc[2 * MAX_WORDS];
+  mpi_limb_t sp[MAX_WORDS];
+  int64_t c, v;
+  int i, j, pass;
+
+  for (i = 0; i < 2 * nwords; i++)
+    acc[i] = (u32)(tp[i / per_limb] >> (32 * (i % per_limb)));
+
+  for (i = 2 * nwords - 1; i >= nwords; i--) fold(acc + i - nwords, acc[i]);
+
+  /* The first carry out of the low words is small, so that folding it
+     back can carry at most once more, by one in either direction, and
+     folding that one leaves a value in [0, 2^(32 * NWORDS)), which is
+     less than 2p.  */
+  for (pass = 0; pass < 3; pass++) {
+    c = 0;
+    for (i = 0; i < nwords; i++) {
+      v = acc[i] + c;
+      acc[i] = v & 0xffffffff;
+      c = v >> 32;
+    }
+    if (pass < 2) fold(acc, c);
+  }
+
+  for (i = 0; i < nlimbs; i++) {
+    rp[i] = 0;
+    for (j = 0; j < per_limb; j++)
+      rp[i] |= (mpi_limb_t)acc[i * per_limb + j] << (32 * j);
+  }
+  ec_field_sub_p(rp, 0, p, sp, nlimbs);
+}
+
+void _gcry_mpi_ec_nist256_mod(gcry_mpi_t a) {
+  mpi_limb_t tp[2 * LIMBS_NIST256];
+
+  ec_field_get(tp, a, 2 * LIMBS_NIST256);
+  reduce_solinas(tp, tp, 8, p_nist256, fold_nist256);
+  ec_field_set(a, tp, LIMBS_NIST256);
+}
+
+void _gcry_mpi_ec_nist256_mulm(gcry_mpi_t w, gcry_mpi_t u, gcry_mpi_t v) {
+  mpi_limb_t up[LIMBS_NIST256], vp[LIMBS_NIST256], tp[2 * LIMBS_NIST256];
+
+  ec_field_get(up, u, LIMBS_NIST256);
+  ec_field_get(vp, v, LIMBS_NIST256);
+  ec_field_mul_n(tp, up, vp, LIMBS_NIST256);
+  reduce_solinas(tp, tp, 8, p_nist256, fold_nist256);
+  ec_field_set(w, tp, LIMBS_NIST256);
+}
+
+void _gcry_mpi_ec_nist384_mod(gcry_mpi_t a) {
+  mpi_limb_t tp[2 * LIMBS_NIST384];
+
+  ec_field_get(tp, a, 2 * LIMBS_NIST384);
+  reduce_solinas(tp, tp, 12, p_nist384, fold_nist384);
+  ec_field_set(a, tp, LIMBS_NIST384);
+}
+
+void _gcry_mpi_ec_nist384_mulm(gcry_mpi_t w, gcry_mpi_t u, gcry_mpi_t v) {
+  mpi_limb_t up[LIMBS_NIST384], vp[LIMBS_NIST384], tp[2 * LIMBS_NIST384];
+
+  ec_field_get(up, u, LIMBS_NIST384);
+  ec_field_get(vp, v, LIMBS_NIST384);
+  ec_field_mul_n(tp, up, vp, LIMBS_NIST384);
+  reduce_solinas(tp, tp, 12, p_nist384, fold_nist384);
+  ec_field_set(w, tp, LIMBS_NIST384);
+}
+
+const mpi_ec_field_t _gcry_mpi_ec_field_nist256 = {
+    LIMBS_NIST256, _gcry_mpi_ec_nist256_mod, _gcry_mpi_ec_nist256_mulm};
+
+const mpi_ec_field_t _gcry_mpi_ec_field_nist384 = {
+    LIMBS_NIST384, _gcry_mpi_ec_nist384_mod, _gcry_mpi_ec_nist384_mulm};
@@ -205,8 +205,10 @@ mpi_point_t _gcry_mpi_point_snatch_set(mpi_point_t point, gcry_mpi_t x,
 
 /* W = W mod P.  */
 static void ec_mod(gcry_mpi_t w, mpi_ec_t ec) {
-  if (0 && ec->dialect == ECC_DIALECT_ED25519)
-    _gcry_mpi_ec_ed25519_mod(w);
+  const mpi_ec_field_t *field = ec->t.field;
+
+  if (field && !w->sign && (unsigned int)w->nlimbs <= 2 * field->nlimbs)
+    field->mod(w);
   else if (ec->t.p_barrett)
     _gcry_mpi_mod_barrett(w, w, ec->t.p_barrett);
   else
@@ -225,8 +227,16 @@ static void ec_subm(gcry_mpi_t w, gcry_mpi_t u, gcry_mpi_t v, mpi_ec_t ec) {
 }
 
 static void ec_mulm(gcry_mpi_t w, gcry_mpi_t u, gcry_mpi_t v, mpi_ec_t ctx) {
-  mpi_mul(w, u, v);
-  ec_mod(w, ctx);
+  const mpi_ec_field_t *field = ctx->t.field;
+
+  if (field && !u->sign && !v->sign &&
+      (unsigned int)u->nlimbs <= field->nlimbs &&
+      (unsigned int)v->nlimbs <= field->nlimbs)
+    field->mulm(w, u, v);
+  else {
+    mpi_mul(w, u, v);
+    ec_mod(w, ctx);
+  }
 }
 
 /* W = 2 * U mod P.  */
@@ -269,6 +279,8 @@ static void ec_invm(gcry_mpi_t x, gcry_mpi_t a, mpi_ec_t ctx) {
 void _gcry_mpi_ec_get_reset(mpi_ec_t ec) {
   ec->t.valid.a_is_pminus3 = 0;
   ec->t.valid.two_inv_p = 0;
+  ec->t.valid.base = 0;
+  ec->t.field = ec->p ? _gcry_ecc_get_field(ec->p) : NULL;
 }
 
 /* Accessor for helper variable.  */
@@ -302,7 +314,7 @@ static gcry_mpi_t ec_get_two_inv_p(mpi_ec_t ec) {
 static void ec_p_init(mpi_ec_t ctx, enum gcry_mpi_ec_models model,
                       enum ecc_dialects dialect, int flags, gcry_mpi_t p,
                       gcry_mpi_t a, gcry_mpi_t b) {
-  int i;
+  unsigned int i;
   static int use_barrett;
 
   if (!use_barrett) {
@@ -354,7 +366,7 @@ static void ec_p_init(mpi_ec_t ctx, enum gcry_mpi_ec_models model,
 
 static void ec_deinit(void *opaque) {
   mpi_ec_t ctx = (mpi_ec_t)opaque;
-  int i;
+  unsigned int i;
 
   _gcry_mpi_barrett_free(ctx->t.p_barrett);
 
@@ -1031,6 +1043,202 @@ void _gcry_mpi_ec_sub_points(mpi_point_t result, mpi_point_t p1, mpi_point_t p2,
   }
 }
 
+/* Fixed-base scalar multiplication.  The table of a base point G
+   holds for each window I of BASE_WINDOW bits of the scalar the affine
+   points (J + 1) * 2^(BASE_WINDOW * I) * G for J from 0 to
+   BASE_ENTRIES - 1, followed by -C, where C is the sum of the first
+   points of all windows.  Adding the entry for the digit of each
+   window to -C gives the product without any doubling.  Since no
+   entry is the point at infinity, the additions need no special case
+   for zero digits, and all entries of a window are read to select
+   one, so the memory access pattern does not depend on the scalar.  */
+#define BASE_WINDOW 4
+#define BASE_ENTRIES (1 << BASE_WINDOW)
+
+/* Store the NUM points at P in affine coordinates at TP, using a
+   single inversion.  ACC is an array of NUM scratch variables.  */
+static void ec_base_store(mpi_ptr_t tp, mpi_point_t p, int num,
+                          gcry_mpi_t *acc, mpi_ec_t ctx) {
+  mpi_size_t nlimbs = ctx->p->nlimbs;
+  gcry_mpi_t inv, zi, zi2;
+  int j;
+
+  inv = mpi_new(0);
+  zi = mpi_new(0);
+  zi2 = mpi_new(0);
+
+  mpi_set(acc[0], p[0].z);
+  for (j = 1; j < num; j++) ec_mulm(acc[j], acc[j - 1], p[j].z, ctx);
+  ec_invm(inv, acc[num - 1], ctx);
+
+  for (j = num - 1; j >= 0; j--) {
+    if (j) {
+      ec_mulm(zi, inv, acc[j - 1], ctx);
+      ec_mulm(inv, inv, p[j].z, ctx);
+    } else
+      mpi_set(zi, inv);
+
+    if (ctx->model == MPI_EC_WEIERSTRASS) {
+      /* Jacobian coordinates: x = X / Z^2, y = Y / Z^3.  */
+      ec_mulm(zi2, zi, zi, ctx);
+      ec_mulm(acc[j], p[j].x, zi2, ctx);
+      ec_field_get(tp + 2 * j * nlimbs, acc[j], nlimbs);
+      ec_mulm(zi2, zi2, zi, ctx);
+      ec_mulm(acc[j], p[j].y, zi2, ctx);
+    } else {
+      ec_mulm(acc[j], p[j].x, zi, ctx);
+      ec_field_get(tp + 2 * j * nlimbs, acc[j], nlimbs);
+      ec_mulm(acc[j], p[j].y, zi, ctx);
+    }
+    ec_field_get(tp + (2 * j + 1) * nlimbs, acc[j], nlimbs);
+  }
+
+  mpi_free(inv);
+  mpi_free(zi);
+  mpi_free(zi2);
+}
+
+/* Compute the table of BASE with the arithmetic of CTX.  On error the
+   table is left NULL and the generic code is used.  */
+static void ec_base_build(mpi_ec_base_t base, mpi_ec_t ctx) {
+  mpi_point_struct p[BASE_ENTRIES], b, c;
+  gcry_mpi_t acc[BASE_ENTRIES];
+  mpi_size_t nlimbs = ctx->p->nlimbs;
+  unsigned int nwindows = (ctx->nbits + BASE_WINDOW - 1) / BASE_WINDOW;
+  mpi_ptr_t table;
+  unsigned int i;
+  int j, ok;
+
+  table = (mpi_ptr_t)xtrycalloc((nwindows * BASE_ENTRIES + 1) * 2 * nlimbs,
+                                sizeof *table);
+  if (!table) return;
+
+  for (j = 0; j < BASE_ENTRIES; j++) {
+    point_init(&p[j]);
+    acc[j] = mpi_new(0);
+  }
+  point_init(&b);
+  point_init(&c);
+  mpi_set(b.x, base->x);
+  mpi_set(b.y, base->y);
+  mpi_set_ui(b.z, 1);
+  if (ctx->model == MPI_EC_WEIERSTRASS) {
+    mpi_set_ui(c.x, 1);
+    mpi_set_ui(c.y, 1);
+    mpi_set_ui(c.z, 0);
+  } else {
+    mpi_set_ui(c.x, 0);
+    mpi_set_ui(c.y, 1);
+    mpi_set_ui(c.z, 1);
+  }
+
+  /* B runs through 2^(BASE_WINDOW * I) * G.  */
+  for (i = 0; i < nwindows; i++) {
+    point_set(&p[0], &b);
+    _gcry_mpi_ec_dup_point(&p[1], &b, ctx);
+    for (j = 2; j < BASE_ENTRIES; j++)
+      _gcry_mpi_ec_add_points(&p[j], &p[j - 1], &b, ctx);
+    _gcry_mpi_ec_add_points(&c, &c, &b, ctx);
+    ec_base_store(table + i * BASE_ENTRIES * 2 * nlimbs, p, BASE_ENTRIES, acc,
+                  ctx);
+    point_set(&b, &p[BASE_ENTRIES - 1]);
+  }
+
+  ok = !_gcry_mpi_ec_get_affine(acc[0], acc[1], &c, ctx);
+  if (ok) {
+    /* Negate C.  */
+    if (ctx->model == MPI_EC_WEIERSTRASS)
+      mpi_sub(acc[1], ctx->p, acc[1]);
+    else
+      mpi_sub(acc[0], ctx->p, acc[0]);
+    ec_mod(acc[0], ctx);
+    ec_mod(acc[1], ctx);
+    i = nwindows * BASE_ENTRIES * 2 * nlimbs;
+    ec_field_get(table + i, acc[0], nlimbs);
+    ec_field_get(table + i + nlimbs, acc[1], nlimbs);
+  }
+
+  for (j = 0; j < BASE_ENTRIES; j++) {
+    point_free(&p[j]);
+    mpi_free(acc[j]);
+  }
+  point_free(&b);
+  point_free(&c);
+
+  if (!ok) {
+    xfree(table);
+    return;
+  }
+  base->nlimbs = nlimbs;
+  base->nwindows = nwindows;
+  base->table = table;
+}
+
+/* Set the point T to the affine point at TP.  */
+static void ec_base_load(mpi_point_t t, mpi_ptr_t tp, mpi_size_t nlimbs) {
+  ec_field_set(t->x, tp, nlimbs);
+  ec_field_set(t->y, tp + nlimbs, nlimbs);
+  mpi_set_ui(t->z, 1);
+}
+
+/* Compute RESULT = SCALAR * POINT with the table if POINT is the base
+   point of a known curve and SCALAR is covered by the table.  Return
+   true if the table was used.  */
+static int ec_mul_base(mpi_point_t result, gcry_mpi_t scalar,
+                       mpi_point_t point, mpi_ec_t ctx) {
+  mpi_ec_base_t base;
+  mpi_point_struct t;
+  mpi_ptr_t tp, sel;
+  mpi_size_t nlimbs, n;
+  mpi_limb_t digit, mask;
+  unsigned int i, bit;
+  int j;
+
+  if (!ctx->t.valid.base) {
+    ctx->t.valid.base = 1;
+    ctx->t.base = _gcry_ecc_get_base(ctx);
+  }
+  base = ctx->t.base;
+  if (!base || mpi_cmp_ui(point->z, 1) || mpi_cmp(point->x, base->x) ||
+      mpi_cmp(point->y, base->y))
+    return 0;
+
+  std::call_once(base->once, ec_base_build, base, ctx);
+  if (!base->table || mpi_get_nbits(scalar) > base->nwindows * BASE_WINDOW)
+    return 0;
+
+  nlimbs = base->nlimbs;
+  sel = (mpi_ptr_t)xmalloc(2 * nlimbs * sizeof *sel);
+  point_init(&t);
+
+  ec_base_load(result,
+               base->table + base->nwindows * BASE_ENTRIES * 2 * nlimbs,
+               nlimbs);
+  for (i = 0; i < base->nwindows; i++) {
+    /* The windows do not cross limb boundaries.  */
+    bit = i * BASE_WINDOW;
+    digit = 0;
+    if (bit / BITS_PER_MPI_LIMB < (unsigned int)scalar->nlimbs)
+      digit = scalar->d[bit / BITS_PER_MPI_LIMB] >> (bit % BITS_PER_MPI_LIMB);
+    digit &= BASE_ENTRIES - 1;
+
+    tp = base->table + i * BASE_ENTRIES * 2 * nlimbs;
+    MPN_ZERO(sel, 2 * nlimbs);
+    for (j = 0; j < BASE_ENTRIES; j++, tp += 2 * nlimbs) {
+      mask = ((mpi_limb_t)(j ^ digit) - 1) >> (BITS_PER_MPI_LIMB - 1);
+      mask = 0 - mask;
+      for (n = 0; n < 2 * nlimbs; n++) sel[n] |= tp[n] & mask;
+    }
+    ec_base_load(&t, sel, nlimbs);
+    _gcry_mpi_ec_add_points(result, result, &t, ctx);
+  }
+
+  wipememory(sel, 2 * nlimbs * sizeof *sel);
+  xfree(sel);
+  point_free(&t);
+  return 1;
+}
+
 /* Scalar point multiplication - the main function for ECC.  If takes
    an integer SCALAR and a POINT as well as the usual context CTX.
    RESULT will be set to the resulting point. */
@@ -1040,6 +1248,10 @@ void _gcry_mpi_ec_mul_point(mpi_point_t result, gcry_mpi_t scalar,
   unsigned int i, loops;
   mpi_point_struct p1, p2, p1inv;
 
+  if (ctx->model != MPI_EC_MONTGOMERY && !mpi_has_sign(scalar) &&
+      ec_mul_base(result, scalar, point, ctx))
+    return;
+
   if (ctx->model == MPI_EC_EDWARDS ||
       (ctx->model == MPI_EC_WEIERSTRASS && mpi_is_secure(scalar))) {
     /* Simple left to right binary method.  Algorithm 3.27 from
@@ -1232,6 +1444,76 @@ void _gcry_mpi_ec_mul_point(mpi_point_t result, gcry_mpi_t scalar,
   mpi_free(k);
 }
 
+/* Compute RESULT = SCALARS[0] * POINTS[0] + ... + SCALARS[N-1] *
+   POINTS[N-1] with the interleaved method of Straus: the doublings
+   are shared by all points, and each point only adds a multiple from
+   a small table per window of its scalar.  The scalars must not be
+   negative.  This does not run in constant time and must only be
+   used with public scalars, e.g. for verification.  Montgomery curves
+   are not supported.  */
+#define MULTI_WINDOW 4
+#define MULTI_ENTRIES ((1 << MULTI_WINDOW) - 1)
+
+void _gcry_mpi_ec_mul_points(mpi_point_t result, gcry_mpi_t *scalars,
+                             mpi_point_t *points, unsigned int n,
+                             mpi_ec_t ctx) {
+  mpi_point_struct *table;
+  mpi_point_t t;
+  gcry_mpi_t k;
+  unsigned int i, nbits, bit;
+  int w, j;
+  mpi_limb_t digit;
+
+  if (ctx->model == MPI_EC_MONTGOMERY)
+    log_fatal("%s: %s not yet supported\n", "_gcry_mpi_ec_mul_points",
+              "Montgomery");
+
+  if (ctx->model == MPI_EC_WEIERSTRASS) {
+    mpi_set_ui(result->x, 1);
+    mpi_set_ui(result->y, 1);
+    mpi_set_ui(result->z, 0);
+  } else {
+    mpi_set_ui(result->x, 0);
+    mpi_set_ui(result->y, 1);
+    mpi_set_ui(result->z, 1);
+  }
+
+  /* The multiples 1 to MULTI_ENTRIES of each point.  */
+  table = (mpi_point_struct *)xcalloc(n * MULTI_ENTRIES, sizeof *table);
+  nbits = 0;
+  for (i = 0; i < n; i++) {
+    t = table + i * MULTI_ENTRIES;
+    for (j = 0; j < MULTI_ENTRIES; j++) point_init(&t[j]);
+    point_set(&t[0], points[i]);
+    _gcry_mpi_ec_dup_point(&t[1], &t[0], ctx);
+    for (j = 2; j < MULTI_ENTRIES; j++)
+      _gcry_mpi_ec_add_points(&t[j], &t[j - 1], &t[0], ctx);
+
+    if (mpi_get_nbits(scalars[i]) > nbits) nbits = mpi_get_nbits(scalars[i]);
+  }
+
+  for (w = (nbits + MULTI_WINDOW - 1) / MULTI_WINDOW - 1; w >= 0; w--) {
+    for (j = 0; j < MULTI_WINDOW; j++)
+      _gcry_mpi_ec_dup_point(result, result, ctx);
+
+    /* The windows do not cross limb boundaries.  */
+    bit = w * MULTI_WINDOW;
+    for (i = 0; i < n; i++) {
+      k = scalars[i];
+      if (bit / BITS_PER_MPI_LIMB >= (unsigned int)k->nlimbs) continue;
+      digit = k->d[bit / BITS_PER_MPI_LIMB] >> (bit % BITS_PER_MPI_LIMB);
+      digit &= MULTI_ENTRIES;
+      if (digit) {
+        t = table + i * MULTI_ENTRIES + digit - 1;
+        _gcry_mpi_ec_add_points(result, result, t, ctx);
+      }
+    }
+  }
+
+  for (i = 0; i < n * MULTI_ENTRIES; i++) point_free(&table[i]);
+  xfree(table);
+}
+
 /* Return true if POINT is on the curve described by CTX.  */
 int _gcry_mpi_ec_curve_point(gcry_mpi_point_t point, mpi_ec_t ctx) {
   int res = 0;
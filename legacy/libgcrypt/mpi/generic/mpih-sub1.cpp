@@ -31,6 +31,8 @@
 #include "longlong.h"
 #include "mpi-internal.h"
 
+/* The x86-64 version is in amd64/mpih-amd64.cpp.  */
+#ifndef USE_AMD64_MPIH
 mpi_limb_t _gcry_mpih_sub_n(mpi_ptr_t res_ptr, mpi_ptr_t s1_ptr,
                             mpi_ptr_t s2_ptr, mpi_size_t size) {
   mpi_limb_t x, y, cy;
@@ -58,3 +60,4 @@ mpi_limb_t _gcry_mpih_sub_n(mpi_ptr_t res_ptr, mpi_ptr_t s1_ptr,
 
   return cy;
 }
+#endif /*!USE_AMD64_MPIH*/
@@ -227,6 +227,25 @@ void _gcry_mpih_mul_karatsuba_case(mpi_ptr_t prodp, mpi_ptr_t up,
 mpi_limb_t _gcry_mpih_mul_1(mpi_ptr_t res_ptr, mpi_ptr_t s1_ptr,
                             mpi_size_t s1_size, mpi_limb_t s2_limb);
 
+/*-- amd64/mpih-amd64.cpp --*/
+/* USE_AMD64_MPIH indicates whether the x86-64 limb primitives are
+   compiled.  The x32 ABI is left to the generic code.  */
+#undef USE_AMD64_MPIH
+#if defined(__x86_64__) && !defined(__ILP32__) && BYTES_PER_MPI_LIMB == 8 && \
+    (__GNUC__ >= 5 || defined(__clang__))
+#define USE_AMD64_MPIH 1
+#endif
+
+#ifdef USE_AMD64_MPIH
+extern int _gcry_mpih_use_mulx;
+mpi_limb_t _gcry_mpih_mul_1_mulx(mpi_ptr_t res_ptr, mpi_ptr_t s1_ptr,
+                                 mpi_size_t s1_size, mpi_limb_t s2_limb);
+mpi_limb_t _gcry_mpih_addmul_1_mulx(mpi_ptr_t res_ptr, mpi_ptr_t s1_ptr,
+                                    mpi_size_t s1_size, mpi_limb_t s2_limb);
+mpi_limb_t _gcry_mpih_submul_1_mulx(mpi_ptr_t res_ptr, mpi_ptr_t s1_ptr,
+                                    mpi_size_t s1_size, mpi_limb_t s2_limb);
+#endif
+
 /*-- mpih-div.c --*/
 mpi_limb_t _gcry_mpih_mod_1(mpi_ptr_t dividend_ptr, mpi_size_t dividend_size,
                             mpi_limb_t divisor_limb);
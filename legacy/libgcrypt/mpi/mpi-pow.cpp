@@ -30,9 +30,362 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <mutex>
+
+#include "g10lib.h"
 #include "longlong.h"
 #include "mpi-internal.h"
 
+/* Montgomery exponentiation for odd moduli.
+
+   With R = B^N, where B is the limb base and N the number of limbs of
+   the modulus M, the numbers are kept as X * R mod M.  The product of
+   two such numbers is reduced with REDC, which adds multiples of M to
+   clear the low N limbs and drops them, so no division is needed in
+   the main loop.  The multiplication, squaring and reduction below
+   always work on N limbs and do not branch on the data; the final
+   subtraction of REDC is done with a mask.  The precomputed values
+   only depend on M and are kept in a context, which can be reused for
+   any number of exponentiations.  */
+
+/* Context used with Montgomery multiplication.  */
+struct mont_ctx_s {
+  mpi_size_t n;     /* Number of limbs of M.  */
+  int sec;          /* M is secret and the limbs are in secure memory.  */
+  int refs;         /* Reference count, see _gcry_mpi_mont_cached.  */
+  mpi_limb_t minv;  /* -M^-1 mod B.  */
+  mpi_ptr_t limbs;  /* Allocation holding the three values below.  */
+  mpi_ptr_t mp;     /* The modulus.  */
+  mpi_ptr_t r2;     /* R^2 mod M.  */
+  mpi_ptr_t one;    /* R mod M, i.e. 1 in Montgomery form.  */
+};
+
+/* Protects the reference counts and the cache of contexts.  */
+static std::mutex mont_lock;
+
+/* Contexts of recently used public moduli, most recent first.  */
+#define MONT_CACHE_SIZE 8
+static mpi_mont_t mont_cache[MONT_CACHE_SIZE];
+
+/* Store the N limbs of the value of A, which must be less than B^N,
+   at RP.  */
+static void mont_set_limbs(mpi_ptr_t rp, gcry_mpi_t a, mpi_size_t n) {
+  mpi_size_t i;
+
+  for (i = 0; i < a->nlimbs && i < n; i++) rp[i] = a->d[i];
+  for (; i < n; i++) rp[i] = 0;
+}
+
+/* Create a context for the modulus M.  Returns NULL if M is not odd
+   and positive.  The context does not reference M.  */
+mpi_mont_t _gcry_mpi_mont_init(gcry_mpi_t m) {
+  mpi_mont_t ctx;
+  mpi_size_t n;
+  mpi_limb_t m0, inv;
+  gcry_mpi_t tmp;
+  int i;
+
+  n = m->nlimbs;
+  MPN_NORMALIZE(m->d, n);
+  if (!n || m->sign || !(m->d[0] & 1)) return NULL;
+
+  ctx = (mpi_mont_t)xcalloc(1, sizeof *ctx);
+  ctx->n = n;
+  ctx->sec = mpi_is_secure(m);
+  ctx->refs = 1;
+  ctx->limbs = mpi_alloc_limb_space(3 * n, ctx->sec);
+  ctx->mp = ctx->limbs;
+  ctx->r2 = ctx->limbs + n;
+  ctx->one = ctx->limbs + 2 * n;
+  MPN_COPY(ctx->mp, m->d, n);
+
+  /* Newton iteration for the inverse of M mod B: an odd M0 is its own
+     inverse mod 8 and each step doubles the number of correct
+     bits.  */
+  m0 = m->d[0];
+  inv = m0;
+  for (i = 0; i < 5; i++) inv *= 2 - m0 * inv;
+  ctx->minv = 0 - inv;
+
+  tmp = ctx->sec ? mpi_alloc_secure(2 * n + 1) : mpi_alloc(2 * n + 1);
+  mpi_set_ui(tmp, 1);
+  mpi_lshift_limbs(tmp, 2 * n);
+  mpi_fdiv_r(tmp, tmp, m);
+  mont_set_limbs(ctx->r2, tmp, n);
+  mpi_set_ui(tmp, 1);
+  mpi_lshift_limbs(tmp, n);
+  mpi_fdiv_r(tmp, tmp, m);
+  mont_set_limbs(ctx->one, tmp, n);
+  mpi_free(tmp);
+
+  return ctx;
+}
+
+static void mont_destroy(mpi_mont_t ctx) {
+  _gcry_mpi_free_limb_space(ctx->limbs, ctx->sec ? 3 * ctx->n : 0);
+  xfree(ctx);
+}
+
+/* Release a reference to CTX and free it with the last one.  */
+void _gcry_mpi_mont_free(mpi_mont_t ctx) {
+  if (!ctx) return;
+
+  {
+    std::lock_guard<std::mutex> lock(mont_lock);
+    if (--ctx->refs) return;
+  }
+  mont_destroy(ctx);
+}
+
+/* Return a context for the modulus M, which is taken from a small
+   cache if M has been used recently.  This is meant for the public
+   moduli of keys used over and over, like the RSA modulus for
+   verification; secret moduli must not be kept around and are never
+   cached.  Returns NULL if M is not odd and positive.  The context
+   must be released with _gcry_mpi_mont_free.  */
+mpi_mont_t _gcry_mpi_mont_cached(gcry_mpi_t m) {
+  mpi_mont_t ctx, old;
+  mpi_size_t n;
+  int i;
+
+  if (mpi_is_secure(m)) return _gcry_mpi_mont_init(m);
+
+  n = m->nlimbs;
+  MPN_NORMALIZE(m->d, n);
+  {
+    std::lock_guard<std::mutex> lock(mont_lock);
+    for (i = 0; i < MONT_CACHE_SIZE && mont_cache[i]; i++) {
+      ctx = mont_cache[i];
+      if (ctx->n == n && !_gcry_mpih_cmp(ctx->mp, m->d, n)) {
+        for (; i > 0; i--) mont_cache[i] = mont_cache[i - 1];
+        mont_cache[0] = ctx;
+        ctx->refs++;
+        return ctx;
+      }
+    }
+  }
+
+  ctx = _gcry_mpi_mont_init(m);
+  if (!ctx) return NULL;
+
+  {
+    std::lock_guard<std::mutex> lock(mont_lock);
+    old = mont_cache[MONT_CACHE_SIZE - 1];
+    for (i = MONT_CACHE_SIZE - 1; i > 0; i--) mont_cache[i] = mont_cache[i - 1];
+    mont_cache[0] = ctx;
+    ctx->refs++;
+    if (old && --old->refs) old = NULL;
+  }
+  if (old) mont_destroy(old);
+
+  return ctx;
+}
+
+/* TP = AP * BP, all numbers N limbs long.  TP has 2N limbs.  */
+static void mont_mul_n(mpi_ptr_t tp, mpi_ptr_t ap, mpi_ptr_t bp,
+                       mpi_size_t n) {
+  mpi_size_t i;
+
+  tp[n] = _gcry_mpih_mul_1(tp, ap, n, bp[0]);
+  for (i = 1; i < n; i++) tp[n + i] = _gcry_mpih_addmul_1(tp + i, ap, n, bp[i]);
+}
+
+/* TP = AP^2, with AP N limbs and TP 2N limbs long.  The products of
+   different limbs are computed once and doubled, then the squares of
+   the limbs are added from DP, which also has 2N limbs.  */
+static void mont_sqr_n(mpi_ptr_t tp, mpi_ptr_t ap, mpi_size_t n,
+                       mpi_ptr_t dp) {
+  mpi_size_t i;
+
+  if (n == 1) {
+    umul_ppmm(tp[1], tp[0], ap[0], ap[0]);
+    return;
+  }
+
+  tp[0] = 0;
+  tp[n] = _gcry_mpih_mul_1(tp + 1, ap + 1, n - 1, ap[0]);
+  for (i = 1; i < n - 1; i++)
+    tp[n + i] =
+        _gcry_mpih_addmul_1(tp + 2 * i + 1, ap + i + 1, n - i - 1, ap[i]);
+  tp[2 * n - 1] = _gcry_mpih_lshift(tp + 1, tp + 1, 2 * n - 2, 1);
+
+  for (i = 0; i < n; i++) umul_ppmm(dp[2 * i + 1], dp[2 * i], ap[i], ap[i]);
+  _gcry_mpih_add_n(tp, tp, dp, 2 * n);
+}
+
+/* RP = TP / R mod M, where TP has 2N limbs, is less than M * R and is
+   destroyed.  SP is scratch space of N limbs.  */
+static void mont_redc(mpi_ptr_t rp, mpi_ptr_t tp, mpi_mont_t ctx,
+                      mpi_ptr_t sp) {
+  mpi_size_t n = ctx->n;
+  mpi_limb_t cy, mask;
+  mpi_size_t i;
+
+  /* Add Q * M to clear the limb at TP + I.  The carry belongs to TP +
+     I + N, which will still be changed; it is kept in the cleared limb
+     and all of them are added at once afterwards.  */
+  for (i = 0; i < n; i++)
+    tp[i] = _gcry_mpih_addmul_1(tp + i, ctx->mp, n, tp[i] * ctx->minv);
+  cy = _gcry_mpih_add_n(rp, tp + n, tp, n);
+
+  /* The result is less than 2M; subtract M if it is not less than
+     M.  */
+  cy |= _gcry_mpih_sub_n(sp, rp, ctx->mp, n) ^ 1;
+  mask = 0 - cy;
+  for (i = 0; i < n; i++) rp[i] = (sp[i] & mask) | (rp[i] & ~mask);
+}
+
+/* RP = AP * BP / R mod M.  WP is scratch space of 3N limbs.  */
+static void mont_mul(mpi_ptr_t rp, mpi_ptr_t ap, mpi_ptr_t bp, mpi_mont_t ctx,
+                     mpi_ptr_t wp) {
+  mont_mul_n(wp, ap, bp, ctx->n);
+  mont_redc(rp, wp, ctx, wp + 2 * ctx->n);
+}
+
+/* RP = AP^2 / R mod M.  WP is scratch space of 4N limbs.  */
+static void mont_sqr(mpi_ptr_t rp, mpi_ptr_t ap, mpi_mont_t ctx,
+                     mpi_ptr_t wp) {
+  mont_sqr_n(wp, ap, ctx->n, wp + 2 * ctx->n);
+  mont_redc(rp, wp, ctx, wp + 2 * ctx->n);
+}
+
+/* Return the W bits of the exponent EP of ESIZE limbs starting at bit
+   POS.  */
+static mpi_limb_t mont_window(mpi_ptr_t ep, mpi_size_t esize,
+                              unsigned int pos, unsigned int w) {
+  mpi_size_t i = pos / BITS_PER_MPI_LIMB;
+  unsigned int off = pos % BITS_PER_MPI_LIMB;
+  mpi_limb_t v;
+
+  v = ep[i] >> off;
+  if (off + w > BITS_PER_MPI_LIMB && i + 1 < esize)
+    v |= ep[i + 1] << (BITS_PER_MPI_LIMB - off);
+  return v & (((mpi_limb_t)1 << w) - 1);
+}
+
+/* RP = TABLE[IDX], where TABLE has K entries of N limbs.  All entries
+   are read, so that the memory access does not depend on IDX.  */
+static void mont_select(mpi_ptr_t rp, mpi_ptr_t table, mpi_size_t n,
+                        mpi_limb_t k, mpi_limb_t idx) {
+  mpi_limb_t j, d, mask;
+  mpi_size_t i;
+
+  for (i = 0; i < n; i++) rp[i] = 0;
+  for (j = 0; j < k; j++) {
+    d = j ^ idx;
+    mask = ((d | (0 - d)) >> (BITS_PER_MPI_LIMB - 1)) - 1;
+    for (i = 0; i < n; i++) rp[i] |= table[j * n + i] & mask;
+  }
+}
+
+/****************
+ * RES = BASE ^ EXPO mod M, with the modulus M of CTX.
+ *
+ * This is a fixed window exponentiation: the exponent is processed in
+ * windows of W bits from the top, each of which costs W squarings and
+ * one multiplication by a precomputed power of BASE.  If EXPO is in
+ * secure memory, all its limbs are processed, the multiplication is
+ * also done for windows which are zero and the table entry is
+ * selected without a data dependent memory access.
+ */
+void _gcry_mpi_powm_mont(gcry_mpi_t res, gcry_mpi_t base, gcry_mpi_t expo,
+                         mpi_mont_t ctx) {
+  mpi_size_t n = ctx->n;
+  mpi_ptr_t ep = expo->d;
+  mpi_size_t esize = expo->nlimbs;
+  int esec = mpi_is_secure(expo);
+  int sec = ctx->sec || esec || mpi_is_secure(base);
+  unsigned int nbits, W, pos;
+  mpi_limb_t k, win;
+  mpi_ptr_t space, table, acc, xp, wp;
+  mpi_size_t size, rsize;
+  struct gcry_mpi mod;
+  gcry_mpi_t b;
+
+  MPN_NORMALIZE(ep, esize);
+  if (!esize) {
+    /* Exponent is zero, result is 1 mod M, i.e., 1 or 0 depending on
+       if M equals 1.  */
+    res->nlimbs = (n == 1 && ctx->mp[0] == 1) ? 0 : 1;
+    if (res->nlimbs) {
+      RESIZE_IF_NEEDED(res, 1);
+      res->d[0] = 1;
+    }
+    res->sign = 0;
+    return;
+  }
+
+  nbits = esec ? esize * BITS_PER_MPI_LIMB : mpi_get_nbits(expo);
+  if (nbits > 512)
+    W = 5;
+  else if (nbits > 256)
+    W = 4;
+  else if (nbits > 128)
+    W = 3;
+  else if (nbits > 64)
+    W = 2;
+  else
+    W = 1;
+  k = (mpi_limb_t)1 << W;
+
+  size = (k + 6) * n;
+  space = mpi_alloc_limb_space(size, sec);
+  table = space;
+  acc = table + k * n;
+  xp = acc + n;
+  wp = xp + n;
+
+  /* Reduce the base, which may be negative or larger than M.  */
+  mod.alloced = mod.nlimbs = n;
+  mod.sign = 0;
+  mod.flags = 0;
+  mod.d = ctx->mp;
+  b = sec ? mpi_alloc_secure(n) : mpi_alloc(n);
+  mpi_fdiv_r(b, base, &mod);
+  mont_set_limbs(xp, b, n);
+  mpi_free(b);
+
+  /* TABLE[J] = BASE^J * R mod M.  */
+  MPN_COPY(table, ctx->one, n);
+  mont_mul(table + n, xp, ctx->r2, ctx, wp);
+  for (win = 2; win < k; win++)
+    mont_mul(table + win * n, table + (win - 1) * n, table + n, ctx, wp);
+
+  pos = (nbits - 1) / W * W;
+  win = mont_window(ep, esize, pos, W);
+  if (esec)
+    mont_select(acc, table, n, k, win);
+  else
+    MPN_COPY(acc, table + win * n, n);
+
+  while (pos) {
+    unsigned int i;
+
+    pos -= W;
+    for (i = 0; i < W; i++) mont_sqr(acc, acc, ctx, wp);
+    win = mont_window(ep, esize, pos, W);
+    if (esec) {
+      mont_select(xp, table, n, k, win);
+      mont_mul(acc, acc, xp, ctx, wp);
+    } else if (win)
+      mont_mul(acc, acc, table + win * n, ctx, wp);
+  }
+
+  /* Convert back from Montgomery form.  */
+  MPN_COPY(wp, acc, n);
+  MPN_ZERO(wp + n, n);
+  mont_redc(acc, wp, ctx, wp + 2 * n);
+
+  rsize = n;
+  MPN_NORMALIZE(acc, rsize);
+  RESIZE_IF_NEEDED(res, n);
+  MPN_COPY(res->d, acc, rsize);
+  res->nlimbs = rsize;
+  res->sign = 0;
+
+  _gcry_mpi_free_limb_space(space, sec ? size : 0);
+}
+
 /*
  * When you need old implementation, please add compilation option
  * -DUSE_ALGORITHM_SIMPLE_EXPONENTIATION
@@ -386,6 +739,16 @@ void _gcry_mpi_powm(gcry_mpi_t res, gcry_mpi_t base, gcry_mpi_t expo,
   mpi_ptr_t base_u;
   mpi_size_t base_u_size;
   mpi_size_t max_u_size;
+  mpi_mont_t mont;
+
+  /* Odd moduli, which includes all moduli of the public key
+     algorithms, are done with Montgomery multiplication.  */
+  mont = _gcry_mpi_mont_init(mod);
+  if (mont) {
+    _gcry_mpi_powm_mont(res, base, expo, mont);
+    _gcry_mpi_mont_free(mont);
+    return;
+  }
 
   esize = expo->nlimbs;
   msize = mod->nlimbs;
@@ -30,7 +30,13 @@
 /* Constants allocated right away at startup.  */
 static gcry_mpi_t constants[MPI_NUMBER_OF_CONSTANTS];
 
-const char *_gcry_mpi_get_hw_config(void) { return ""; }
+const char *_gcry_mpi_get_hw_config(void) {
+#ifdef USE_AMD64_MPIH
+  return _gcry_mpih_use_mulx ? "amd64/mulx" : "amd64";
+#else
+  return "";
+#endif
+}
 
 /* Initialize the MPI subsystem.  This is called early and allows to
    do some initialization without taking care of threading issues.  */
@@ -38,6 +44,14 @@ gpg_error_t _gcry_mpi_init(void) {
   int idx;
   unsigned long value;
 
+#ifdef USE_AMD64_MPIH
+  {
+    unsigned int hwf = _gcry_get_hw_features();
+
+    _gcry_mpih_use_mulx = (hwf & HWF_INTEL_BMI2) && (hwf & HWF_INTEL_ADX);
+  }
+#endif
+
   for (idx = 0; idx < MPI_NUMBER_OF_CONSTANTS; idx++) {
     switch (idx) {
       case MPI_C_ZERO:
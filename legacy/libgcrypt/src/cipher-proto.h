@@ -69,6 +69,22 @@ typedef gpg_error_t (*gcry_pk_sign_t)(gcry_sexp_t *r_sig, gcry_sexp_t s_data,
 typedef gpg_error_t (*gcry_pk_verify_t)(gcry_sexp_t s_sig, gcry_sexp_t s_data,
                                         gcry_sexp_t keyparms);
 
+/* Type for the pk_verify_batch function.  It verifies the N
+   signatures S_SIG[i] over S_DATA[i] with KEYPARMS[i] and stores the
+   result of each in RESULTS[i].  An error is returned only if the
+   batch could not be processed at all.  */
+typedef gpg_error_t (*gcry_pk_verify_batch_t)(gcry_sexp_t *s_sig,
+                                              gcry_sexp_t *s_data,
+                                              gcry_sexp_t *keyparms, size_t n,
+                                              gpg_error_t *results);
+
+/* Type for the pk_verify_mpi function.  It verifies the signature
+   with the elements SIG over DATA using the public key with the
+   elements PKEY on the curve CURVE, see gcry_pk_verify_mpi.  */
+typedef gpg_error_t (*gcry_pk_verify_mpi_t)(int algo, gcry_ecc_curve_t curve,
+                                            gcry_mpi_t data, gcry_mpi_t *sig,
+                                            gcry_mpi_t *pkey);
+
 /* Type for the pk_get_nbits function.  */
 typedef unsigned (*gcry_pk_get_nbits_t)(gcry_sexp_t keyparms);
 
@@ -108,6 +124,8 @@ typedef struct gcry_pk_spec {
   pk_comp_keygrip_t comp_keygrip;
   pk_get_curve_t get_curve;
   pk_get_curve_param_t get_curve_param;
+  gcry_pk_verify_batch_t verify_batch; /* Optional.  */
+  gcry_pk_verify_mpi_t verify_mpi;     /* Optional.  */
 } gcry_pk_spec_t;
 
 /*
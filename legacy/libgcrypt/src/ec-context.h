@@ -20,8 +20,34 @@
 #ifndef GCRY_EC_CONTEXT_H
 #define GCRY_EC_CONTEXT_H
 
+#include <mutex>
+
 #include "mpi.h"
 
+/* Arithmetic in GF(p) for a prime of special form.  The functions
+   work on fixed-size limb arrays, reduce with the special form of P
+   and do not branch on the data.  The values must not be negative.  */
+typedef struct {
+  unsigned int nlimbs; /* Number of limbs of P.  */
+  /* W = W mod P, for W of up to 2 * NLIMBS limbs.  */
+  void (*mod)(gcry_mpi_t w);
+  /* W = U * V mod P, for U and V of up to NLIMBS limbs.  */
+  void (*mulm)(gcry_mpi_t w, gcry_mpi_t u, gcry_mpi_t v);
+} mpi_ec_field_t;
+
+/* The base point of a curve from cipher/ecc-curves.c with a table of
+   its multiples for _gcry_mpi_ec_mul_point.  The objects are static,
+   set up on first use and then shared read-only by all threads.  */
+struct mpi_ec_base_s {
+  std::once_flag init;   /* Guards X and Y, see cipher/ecc-curves.c.  */
+  gcry_mpi_t x, y;       /* Affine coordinates of the base point.  */
+  std::once_flag once;   /* Guards the table, see mpi/ec.c.  */
+  unsigned int nlimbs;   /* Number of limbs of each coordinate.  */
+  unsigned int nwindows; /* Number of scalar windows covered.  */
+  mpi_limb_t *table;     /* The multiples or NULL.  */
+};
+typedef struct mpi_ec_base_s *mpi_ec_base_t;
+
 /* This context is used with all our EC functions. */
 struct mpi_ec_ctx_s {
   enum gcry_mpi_ec_models model; /* The model describing this curve.  */
@@ -50,6 +76,7 @@ struct mpi_ec_ctx_s {
     struct {
       unsigned int a_is_pminus3 : 1;
       unsigned int two_inv_p : 1;
+      unsigned int base : 1;
     } valid; /* Flags to help setting the helper vars below.  */
 
     int a_is_pminus3; /* True if A = P - 3. */
@@ -58,6 +85,10 @@ struct mpi_ec_ctx_s {
 
     mpi_barrett_t p_barrett;
 
+    const mpi_ec_field_t *field; /* Dedicated arithmetic for P or NULL.  */
+
+    mpi_ec_base_t base; /* Base point of a known curve or NULL.  */
+
     /* Scratch variables.  */
     gcry_mpi_t scratch[11];
 
@@ -71,7 +102,16 @@ struct mpi_ec_ctx_s {
 /*-- mpi/ec.c --*/
 void _gcry_mpi_ec_get_reset(mpi_ec_t ec);
 
+/*-- mpi/ec-ed25519.c --*/
+extern const mpi_ec_field_t _gcry_mpi_ec_field_25519;
+
+/*-- mpi/ec-nist.c --*/
+extern const mpi_ec_field_t _gcry_mpi_ec_field_nist256;
+extern const mpi_ec_field_t _gcry_mpi_ec_field_nist384;
+
 /*-- cipher/ecc-curves.c --*/
+const mpi_ec_field_t *_gcry_ecc_get_field(gcry_mpi_t p);
+mpi_ec_base_t _gcry_ecc_get_base(mpi_ec_t ec);
 gcry_mpi_t _gcry_ecc_get_mpi(const char *name, mpi_ec_t ec, int copy);
 gcry_mpi_point_t _gcry_ecc_get_point(const char *name, mpi_ec_t ec);
 gpg_error_t _gcry_ecc_set_mpi(const char *name, gcry_mpi_t newvalue,
@@ -211,6 +211,8 @@ char **_gcry_strtokenize(const char *string, const char *delim);
 #define HWF_ARM_PMULL (1 << 19)
 
 #define HWF_INTEL_RDTSC (1 << 20)
+#define HWF_INTEL_SHAEXT (1 << 21)
+#define HWF_INTEL_ADX (1 << 22)
 
 gpg_error_t _gcry_disable_hw_feature(const char *name);
 void _gcry_detect_hw_features(void);
@@ -85,6 +85,12 @@ gpg_error_t _gcry_pk_sign(gcry_sexp_t *result, gcry_sexp_t data,
                           gcry_sexp_t skey);
 gpg_error_t _gcry_pk_verify(gcry_sexp_t sigval, gcry_sexp_t data,
                             gcry_sexp_t pkey);
+gpg_error_t _gcry_pk_verify_mpi(int algo, gcry_ecc_curve_t curve,
+                                gcry_mpi_t data, gcry_mpi_t *sig,
+                                gcry_mpi_t *pkey);
+gpg_error_t _gcry_pk_verify_batch(gcry_sexp_t *sigval, gcry_sexp_t *data,
+                                  gcry_sexp_t *pkey, size_t n,
+                                  gpg_error_t *results);
 gpg_error_t _gcry_pk_testkey(gcry_sexp_t key);
 gpg_error_t _gcry_pk_genkey(gcry_sexp_t *r_key, gcry_sexp_t s_parms);
 gpg_error_t _gcry_pk_ctl(int cmd, void *buffer, size_t buflen);
@@ -97,6 +103,7 @@ unsigned char *_gcry_pk_get_keygrip(gcry_sexp_t key, unsigned char *array);
 const char *_gcry_pk_get_curve(gcry_sexp_t key, int iterator,
                                unsigned int *r_nbits);
 gcry_sexp_t _gcry_pk_get_param(int algo, const char *name);
+gcry_ecc_curve_t _gcry_ecc_lookup_curve(const char *name);
 gpg_error_t _gcry_pubkey_get_sexp(gcry_sexp_t *r_sexp, int mode,
                                   gcry_ctx_t ctx);
 
@@ -114,6 +121,8 @@ void _gcry_md_hash_buffer(int algo, void *digest, const void *buffer,
                           size_t length);
 gpg_error_t _gcry_md_hash_buffers(int algo, unsigned int flags, void *digest,
                                   const gcry_buffer_t *iov, int iovcnt);
+unsigned int _gcry_crc24_update(unsigned int crc, const void *buffer,
+                                size_t length);
 int _gcry_md_get_algo(gcry_md_hd_t hd);
 unsigned int _gcry_md_get_algo_dlen(int algo);
 int _gcry_md_is_enabled(gcry_md_hd_t a, int algo);
@@ -94,6 +94,10 @@ extern "C" {
 struct gcry_context;
 typedef struct gcry_context *gcry_ctx_t;
 
+/* A curve known to libgcrypt, see gcry_ecc_lookup_curve.  */
+struct gcry_ecc_curve;
+typedef const struct gcry_ecc_curve *gcry_ecc_curve_t;
+
 /* The data objects used to hold multi precision integers.  */
 struct gcry_mpi;
 typedef struct gcry_mpi *gcry_mpi_t;
@@ -926,6 +930,26 @@ gpg_error_t gcry_pk_sign(gcry_sexp_t *result, gcry_sexp_t data,
 gpg_error_t gcry_pk_verify(gcry_sexp_t sigval, gcry_sexp_t data,
                            gcry_sexp_t pkey);
 
+/* Check the signature with the elements SIG on DATA using the public
+   key with the elements PKEY like gcry_pk_verify, but without
+   building S-expressions.  The elements are those of the "sig-val"
+   and "public-key" S-expressions in this order: "s" and "ne" for
+   GCRY_PK_RSA, "rs" and "pqgy" for GCRY_PK_DSA and "rs" and "q" for
+   GCRY_PK_ECDSA and GCRY_PK_EDDSA, which also need the CURVE.  DATA
+   is the raw value to check, for EdDSA the message to be hashed with
+   SHA-512. */
+gpg_error_t gcry_pk_verify_mpi(int algo, gcry_ecc_curve_t curve,
+                               gcry_mpi_t data, gcry_mpi_t *sig,
+                               gcry_mpi_t *pkey);
+
+/* Check the N signatures SIGVAL[i] on DATA[i] using the public keys
+   PKEY[i] and store the result of each in RESULTS[i].  EdDSA
+   signatures are verified together, which is faster.  Returns 0 if
+   all signatures are good and an error code otherwise. */
+gpg_error_t gcry_pk_verify_batch(gcry_sexp_t *sigval, gcry_sexp_t *data,
+                                 gcry_sexp_t *pkey, size_t n,
+                                 gpg_error_t *results);
+
 /* Check that private KEY is sane. */
 gpg_error_t gcry_pk_testkey(gcry_sexp_t key);
 
@@ -961,6 +985,11 @@ unsigned char *gcry_pk_get_keygrip(gcry_sexp_t key, unsigned char *array);
 const char *gcry_pk_get_curve(gcry_sexp_t key, int iterator,
                               unsigned int *r_nbits);
 
+/* Return the curve with NAME, which may also be an alias or an OID,
+   or NULL if there is no such curve.  The curve is looked up and set
+   up only once; the handle stays valid and may be shared by threads.  */
+gcry_ecc_curve_t gcry_ecc_lookup_curve(const char *name);
+
 /* Return an S-expression with the parameters of the named ECC curve
    NAME.  ALGO must be set to an ECC algorithm.  */
 gcry_sexp_t gcry_pk_get_param(int algo, const char *name);
@@ -1090,6 +1119,15 @@ void gcry_md_hash_buffer(int algo, void *digest, const void *buffer,
 gpg_error_t gcry_md_hash_buffers(int algo, unsigned int flags, void *digest,
                                  const gcry_buffer_t *iov, int iovcnt);
 
+/* The initial value of the OpenPGP CRC-24.  */
+#define GCRY_CRC24_INIT 0xb704ce
+
+/* Update the OpenPGP CRC-24 value CRC with LENGTH bytes of BUFFER and
+   return the new value.  This computes the same checksum as
+   GCRY_MD_CRC24_RFC2440 but does not need a hash object.  */
+unsigned int gcry_crc24_update(unsigned int crc, const void *buffer,
+                               size_t length);
+
 /* Retrieve the algorithm used with HD.  This does not work reliable
    if more than one algorithm is enabled in HD. */
 int gcry_md_get_algo(gcry_md_hd_t hd);
@@ -0,0 +1,274 @@
+/* hwfeatures.c - Detect hardware features.
+ * Copyright 2017 The NeoPG developers
+ *
+ * This file is part of Libgcrypt.
+ *
+ * Libgcrypt is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * Libgcrypt is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <mutex>
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#include <cpuid.h>
+#define HAS_X86_CPUID 1
+#endif
+#if defined(__linux__) && defined(__aarch64__)
+#include <sys/auxv.h>
+#define HAS_ARM_AUXV 1
+#endif
+
+#include "g10lib.h"
+
+/* The name of the environment variable which may hold a list of
+   hardware features to disable.  This uses the same syntax as
+   GCRYCTL_DISABLE_HWF and is mainly useful to run the test suite
+   against the generic implementations.  */
+#define HWF_DENY_ENVVAR "GCRYPT_DISABLE_HWF"
+
+/* A table to map hardware features to a string.  */
+static struct {
+  unsigned int flag;
+  const char *desc;
+} hwflist[] = {
+    {HWF_PADLOCK_RNG, "padlock-rng"},
+    {HWF_PADLOCK_AES, "padlock-aes"},
+    {HWF_PADLOCK_SHA, "padlock-sha"},
+    {HWF_PADLOCK_MMUL, "padlock-mmul"},
+    {HWF_INTEL_CPU, "intel-cpu"},
+    {HWF_INTEL_FAST_SHLD, "intel-fast-shld"},
+    {HWF_INTEL_BMI2, "intel-bmi2"},
+    {HWF_INTEL_SSSE3, "intel-ssse3"},
+    {HWF_INTEL_SSE4_1, "intel-sse4.1"},
+    {HWF_INTEL_PCLMUL, "intel-pclmul"},
+    {HWF_INTEL_AESNI, "intel-aesni"},
+    {HWF_INTEL_RDRAND, "intel-rdrand"},
+    {HWF_INTEL_AVX, "intel-avx"},
+    {HWF_INTEL_AVX2, "intel-avx2"},
+    {HWF_INTEL_FAST_VPGATHER, "intel-fast-vpgather"},
+    {HWF_INTEL_RDTSC, "intel-rdtsc"},
+    {HWF_INTEL_SHAEXT, "intel-shaext"},
+    {HWF_INTEL_ADX, "intel-adx"},
+    {HWF_ARM_NEON, "arm-neon"},
+    {HWF_ARM_AES, "arm-aes"},
+    {HWF_ARM_SHA1, "arm-sha1"},
+    {HWF_ARM_SHA2, "arm-sha2"},
+    {HWF_ARM_PMULL, "arm-pmull"}};
+
+/* A bit vector with the hardware features which shall not be used.  */
+static unsigned int disabled_hw_features;
+
+/* A bit vector describing the hardware features currently
+   available. */
+static unsigned int hw_features;
+
+/* Guards the one-time detection of HW_FEATURES.  */
+static std::once_flag hw_features_detected;
+
+/* Disable a feature by name.  NAME may be a list of feature names
+   separated by colons, commas or white space; the special name "all"
+   disables all features.  This function is to be used before
+   hardware features are used, but it is also honored for all
+   algorithms setup afterwards.  */
+gpg_error_t _gcry_disable_hw_feature(const char *name) {
+  int i;
+  size_t n1, n2;
+
+  while (name && *name) {
+    n1 = strcspn(name, ":, \t");
+    if (!n1)
+      ;
+    else if (sizeof("all") - 1 == n1 && !strncmp(name, "all", n1))
+      disabled_hw_features = ~0;
+    else {
+      for (i = 0; i < (int)DIM(hwflist); i++) {
+        n2 = strlen(hwflist[i].desc);
+        if (n1 == n2 && !strncmp(hwflist[i].desc, name, n2)) {
+          disabled_hw_features |= hwflist[i].flag;
+          break;
+        }
+      }
+      if (!(i < (int)DIM(hwflist))) return GPG_ERR_INV_NAME;
+    }
+    name += n1;
+    if (*name) name++; /* Skip delimiter ':', ',', ' ' or '\t'.  */
+  }
+  return 0;
+}
+
+/* Return a description of the hardware features which are available
+   and not disabled.  */
+unsigned int _gcry_get_hw_features(void) {
+  _gcry_detect_hw_features();
+  return hw_features & ~disabled_hw_features;
+}
+
+/* Enumerate all features.  The caller is expected to start with an
+   IDX of 0 and then increment IDX until NULL is returned.  */
+const char *_gcry_enum_hw_features(int idx, unsigned int *r_feature) {
+  if (idx < 0 || idx >= (int)DIM(hwflist)) return NULL;
+  if (r_feature) *r_feature = hwflist[idx].flag;
+  return hwflist[idx].desc;
+}
+
+#ifdef HAS_X86_CPUID
+/* Return the extended control register 0, which tells which register
+   states the operating system saves on a context switch.  */
+static unsigned long long get_xgetbv(void) {
+  unsigned int t_eax, t_edx;
+
+  asm volatile("xgetbv" : "=a"(t_eax), "=d"(t_edx) : "c"(0));
+  return t_eax | ((unsigned long long)t_edx << 32);
+}
+
+static unsigned int detect_x86_gnuc(void) {
+  union {
+    char c[12 + 1];
+    unsigned int ui[3];
+  } vendor_id;
+  unsigned int features = 0;
+  unsigned int max_cpuid_level;
+  unsigned int fms, family, model;
+  unsigned int eax, ebx, ecx, edx;
+  int is_intel_cpu = 0;
+  int os_supports_avx = 0;
+  int avoid_vpgather = 0;
+
+  max_cpuid_level = __get_cpuid_max(0, NULL);
+  if (max_cpuid_level < 1) return 0;
+
+  memset(&vendor_id, 0, sizeof vendor_id);
+  __cpuid(0, eax, vendor_id.ui[0], vendor_id.ui[2], vendor_id.ui[1]);
+
+  if (!strcmp(vendor_id.c, "CentaurHauls")) {
+    /* This is a VIA CPU.  Check what PadLock features we have.  */
+    __cpuid(0xC0000000, eax, ebx, ecx, edx);
+    if (eax >= 0xC0000001) {
+      __cpuid(0xC0000001, eax, ebx, ecx, edx);
+      /* Test bits 2 and 3 to see whether the RNG exists and is
+         enabled, 6 and 7 for the ACE, 10 and 11 for the PHE and 12
+         and 13 for the PMM.  */
+      if ((edx & 0x0C) == 0x0C) features |= HWF_PADLOCK_RNG;
+      if ((edx & 0xC0) == 0xC0) features |= HWF_PADLOCK_AES;
+      if ((edx & 0xC00) == 0xC00) features |= HWF_PADLOCK_SHA;
+      if ((edx & 0x3000) == 0x3000) features |= HWF_PADLOCK_MMUL;
+    }
+  } else if (!strcmp(vendor_id.c, "GenuineIntel")) {
+    is_intel_cpu = 1;
+    features |= HWF_INTEL_CPU;
+  }
+
+  __cpuid(1, fms, ebx, ecx, edx);
+
+  family = ((fms & 0xf00) >> 8) + ((fms & 0xff00000) >> 20);
+  model = ((fms & 0xf0) >> 4) + ((fms & 0xf0000) >> 12);
+
+  if (edx & 0x00000010) features |= HWF_INTEL_RDTSC;
+  if (ecx & 0x00000200) features |= HWF_INTEL_SSSE3;
+  if (ecx & 0x00080000) features |= HWF_INTEL_SSE4_1;
+  if (ecx & 0x00000002) features |= HWF_INTEL_PCLMUL;
+  if (ecx & 0x02000000) features |= HWF_INTEL_AESNI;
+  if (ecx & 0x40000000) features |= HWF_INTEL_RDRAND;
+
+  /* AVX is only usable if the OS saves the XMM and YMM state.  */
+  if ((ecx & 0x18000000) == 0x18000000 && (get_xgetbv() & 0x6) == 0x6)
+    os_supports_avx = 1;
+  if (os_supports_avx) features |= HWF_INTEL_AVX;
+
+  if (is_intel_cpu && family == 6) {
+    /* These Intel Core processor models have SHLD/SHRD instruction
+       that can do integer rotation faster than actual ROL/ROR
+       instructions.  On Haswell and Broadwell VPGATHER is slower
+       than a sequence of scalar loads.  */
+    switch (model) {
+      case 0x3C: /* Haswell */
+      case 0x3F:
+      case 0x45:
+      case 0x46:
+      case 0x3D: /* Broadwell */
+      case 0x47:
+      case 0x4F:
+      case 0x56:
+        avoid_vpgather = 1;
+      /* fall through */
+      case 0x2A: /* Sandy Bridge */
+      case 0x2D:
+      case 0x3A: /* Ivy Bridge */
+      case 0x3E:
+      case 0x4E: /* Skylake */
+      case 0x5E:
+      case 0x8E: /* Kaby Lake */
+      case 0x9E:
+      case 0x55: /* Skylake-X */
+        features |= HWF_INTEL_FAST_SHLD;
+        break;
+    }
+  }
+
+  if (max_cpuid_level >= 7) {
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+
+    if ((ebx & 0x00000020) && os_supports_avx) features |= HWF_INTEL_AVX2;
+    if (ebx & 0x00000100) features |= HWF_INTEL_BMI2;
+    if (ebx & 0x00080000) features |= HWF_INTEL_ADX;
+    if (ebx & 0x20000000) features |= HWF_INTEL_SHAEXT;
+  }
+
+  if ((features & HWF_INTEL_AVX2) && is_intel_cpu && !avoid_vpgather)
+    features |= HWF_INTEL_FAST_VPGATHER;
+
+  return features;
+}
+#endif /*HAS_X86_CPUID*/
+
+#ifdef HAS_ARM_AUXV
+static unsigned int detect_arm_auxv(void) {
+  unsigned long hwcap = getauxval(AT_HWCAP);
+  unsigned int features = 0;
+
+  /* The HWCAP_* bits of the aarch64 Linux kernel ABI.  */
+  if (hwcap & (1 << 1)) features |= HWF_ARM_NEON;
+  if (hwcap & (1 << 3)) features |= HWF_ARM_AES;
+  if (hwcap & (1 << 4)) features |= HWF_ARM_PMULL;
+  if (hwcap & (1 << 5)) features |= HWF_ARM_SHA1;
+  if (hwcap & (1 << 6)) features |= HWF_ARM_SHA2;
+
+  return features;
+}
+#endif /*HAS_ARM_AUXV*/
+
+static void detect_hw_features(void) {
+  const char *deny;
+
+#ifdef HAS_X86_CPUID
+  hw_features = detect_x86_gnuc();
+#endif
+#ifdef HAS_ARM_AUXV
+  hw_features = detect_arm_auxv();
+#endif
+
+  deny = getenv(HWF_DENY_ENVVAR);
+  if (deny && _gcry_disable_hw_feature(deny))
+    log_info("%s: unknown hardware feature in '%s'\n", HWF_DENY_ENVVAR, deny);
+}
+
+/* Detect the available hardware features.  This is done only once;
+   later calls return immediately.  */
+void _gcry_detect_hw_features(void) {
+  std::call_once(hw_features_detected, detect_hw_features);
+}
@@ -193,6 +193,22 @@ void _gcry_mpi_mul_barrett(gcry_mpi_t w, gcry_mpi_t u, gcry_mpi_t v,
 void _gcry_mpi_mulpowm(gcry_mpi_t res, gcry_mpi_t *basearray,
                        gcry_mpi_t *exparray, gcry_mpi_t mod);
 
+/*-- mpi-pow.c --*/
+#define mpi_mont_init(m) _gcry_mpi_mont_init((m))
+#define mpi_mont_cached(m) _gcry_mpi_mont_cached((m))
+#define mpi_mont_free(c) _gcry_mpi_mont_free((c))
+#define mpi_powm_mont(w, b, e, c) _gcry_mpi_powm_mont((w), (b), (e), (c))
+
+/* Context used with Montgomery multiplication.  */
+struct mont_ctx_s;
+typedef struct mont_ctx_s *mpi_mont_t;
+
+mpi_mont_t _gcry_mpi_mont_init(gcry_mpi_t m);
+mpi_mont_t _gcry_mpi_mont_cached(gcry_mpi_t m);
+void _gcry_mpi_mont_free(mpi_mont_t ctx);
+void _gcry_mpi_powm_mont(gcry_mpi_t res, gcry_mpi_t base, gcry_mpi_t expo,
+                         mpi_mont_t ctx);
+
 /*-- mpi-scan.c --*/
 #define mpi_trailing_zeros(a) _gcry_mpi_trailing_zeros((a))
 int _gcry_mpi_getbyte(gcry_mpi_t a, unsigned idx);
@@ -261,6 +277,9 @@ void _gcry_mpi_ec_sub_points(mpi_point_t result, mpi_point_t p1, mpi_point_t p2,
                              mpi_ec_t ctx);
 void _gcry_mpi_ec_mul_point(mpi_point_t result, gcry_mpi_t scalar,
                             mpi_point_t point, mpi_ec_t ctx);
+void _gcry_mpi_ec_mul_points(mpi_point_t result, gcry_mpi_t *scalars,
+                             mpi_point_t *points, unsigned int n,
+                             mpi_ec_t ctx);
 int _gcry_mpi_ec_curve_point(gcry_mpi_point_t point, mpi_ec_t ctx);
 
 gcry_mpi_t _gcry_mpi_ec_ec2os(gcry_mpi_point_t point, mpi_ec_t ectx);
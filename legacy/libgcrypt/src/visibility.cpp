@@ -600,6 +600,18 @@ gpg_error_t gcry_pk_verify(gcry_sexp_t sigval, gcry_sexp_t data,
   return _gcry_pk_verify(sigval, data, pkey);
 }
 
+gpg_error_t gcry_pk_verify_mpi(int algo, gcry_ecc_curve_t curve,
+                               gcry_mpi_t data, gcry_mpi_t *sig,
+                               gcry_mpi_t *pkey) {
+  return _gcry_pk_verify_mpi(algo, curve, data, sig, pkey);
+}
+
+gpg_error_t gcry_pk_verify_batch(gcry_sexp_t *sigval, gcry_sexp_t *data,
+                                 gcry_sexp_t *pkey, size_t n,
+                                 gpg_error_t *results) {
+  return _gcry_pk_verify_batch(sigval, data, pkey, n, results);
+}
+
 gpg_error_t gcry_pk_testkey(gcry_sexp_t key) { return _gcry_pk_testkey(key); }
 
 gpg_error_t gcry_pk_genkey(gcry_sexp_t *r_key, gcry_sexp_t s_parms) {
@@ -638,6 +650,10 @@ gcry_sexp_t gcry_pk_get_param(int algo, const char *name) {
   return _gcry_pk_get_param(algo, name);
 }
 
+gcry_ecc_curve_t gcry_ecc_lookup_curve(const char *name) {
+  return _gcry_ecc_lookup_curve(name);
+}
+
 gpg_error_t gcry_pubkey_get_sexp(gcry_sexp_t *r_sexp, int mode,
                                  gcry_ctx_t ctx) {
   return _gcry_pubkey_get_sexp(r_sexp, mode, ctx);
@@ -686,6 +702,11 @@ gpg_error_t gcry_md_hash_buffers(int algo, unsigned int flags, void *digest,
   return _gcry_md_hash_buffers(algo, flags, digest, iov, iovcnt);
 }
 
+unsigned int gcry_crc24_update(unsigned int crc, const void *buffer,
+                               size_t length) {
+  return _gcry_crc24_update(crc, buffer, length);
+}
+
 int gcry_md_get_algo(gcry_md_hd_t hd) { return _gcry_md_get_algo(hd); }
 
 unsigned int gcry_md_get_algo_dlen(int algo) {
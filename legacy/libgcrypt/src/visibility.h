@@ -89,6 +89,7 @@ MARK_VISIBLEX(gcry_md_reset)
 MARK_VISIBLEX(gcry_md_setkey)
 MARK_VISIBLEX(gcry_md_write)
 MARK_VISIBLEX(gcry_md_debug)
+MARK_VISIBLEX(gcry_crc24_update)
 
 MARK_VISIBLEX(gcry_cipher_algo_info)
 MARK_VISIBLEX(gcry_cipher_algo_name)
@@ -133,11 +134,14 @@ MARK_VISIBLEX(gcry_pk_genkey)
 MARK_VISIBLEX(gcry_pk_get_keygrip)
 MARK_VISIBLEX(gcry_pk_get_curve)
 MARK_VISIBLEX(gcry_pk_get_param)
+MARK_VISIBLEX(gcry_ecc_lookup_curve)
 MARK_VISIBLEX(gcry_pk_get_nbits)
 MARK_VISIBLEX(gcry_pk_map_name)
 MARK_VISIBLEX(gcry_pk_sign)
 MARK_VISIBLEX(gcry_pk_testkey)
 MARK_VISIBLEX(gcry_pk_verify)
+MARK_VISIBLEX(gcry_pk_verify_batch)
+MARK_VISIBLEX(gcry_pk_verify_mpi)
 MARK_VISIBLEX(gcry_pubkey_get_sexp)
 
 MARK_VISIBLEX(gcry_random_add_bytes)
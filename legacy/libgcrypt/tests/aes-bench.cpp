@@ -0,0 +1,107 @@
+/* aes-bench.cpp - Benchmark bulk AES decryption
+   Copyright 2017 The NeoPG developers
+
+   NeoPG is released under the Simplified BSD License (see license.txt)
+*/
+
+/* Usage: aes-bench [--disable-hwf NAME] [MBYTES]
+
+   Decrypts MBYTES (default 1024) of data with AES-128 and AES-256 in
+   CFB mode, which is what OpenPGP uses, and for comparison in CBC and
+   CTR mode.  The data is processed in 64 KiB chunks, like the
+   decryption filter does.  With "--disable-hwf intel-aesni" the
+   constant-time software implementation is measured instead.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "gcrypt.h"
+
+#define CHUNKSIZE 65536
+
+static double elapsed(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+static int bench(int algo, int mode, unsigned long mbytes) {
+  std::vector<unsigned char> buf(CHUNKSIZE);
+  unsigned char key[32];
+  unsigned char iv[16];
+  unsigned long nchunks = mbytes * (1024 * 1024 / CHUNKSIZE);
+  gcry_cipher_hd_t hd;
+  gpg_error_t err;
+  double secs;
+
+  memset(key, 0x42, sizeof key);
+  memset(iv, 0x17, sizeof iv);
+  for (size_t i = 0; i < buf.size(); i++) buf[i] = i * 7;
+
+  err = gcry_cipher_open(&hd, algo, mode, 0);
+  if (!err)
+    err = gcry_cipher_setkey(hd, key, gcry_cipher_get_algo_keylen(algo));
+  if (!err && mode == GCRY_CIPHER_MODE_CTR)
+    err = gcry_cipher_setctr(hd, iv, sizeof iv);
+  else if (!err)
+    err = gcry_cipher_setiv(hd, iv, sizeof iv);
+  if (err) {
+    fprintf(stderr, "aes-bench: cipher setup failed: %s\n", gpg_strerror(err));
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < nchunks && !err; i++)
+    err = gcry_cipher_decrypt(hd, buf.data(), buf.size(), NULL, 0);
+  secs = elapsed(start);
+  gcry_cipher_close(hd);
+  if (err) {
+    fprintf(stderr, "aes-bench: decryption failed: %s\n", gpg_strerror(err));
+    return 1;
+  }
+
+  printf("%-7s %-3s decrypt: %lu MiB in %.3f s, %.1f MiB/s\n",
+         gcry_cipher_algo_name(algo),
+         mode == GCRY_CIPHER_MODE_CFB
+             ? "CFB"
+             : mode == GCRY_CIPHER_MODE_CBC ? "CBC" : "CTR",
+         mbytes, secs, mbytes / secs);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  static const int algos[] = {GCRY_CIPHER_AES128, GCRY_CIPHER_AES256};
+  static const int modes[] = {GCRY_CIPHER_MODE_CFB, GCRY_CIPHER_MODE_CBC,
+                              GCRY_CIPHER_MODE_CTR};
+  unsigned long mbytes = 1024;
+  int rc = 0;
+
+  if (argc > 2 && !strcmp(argv[1], "--disable-hwf")) {
+    if (gcry_control(GCRYCTL_DISABLE_HWF, argv[2], NULL)) {
+      fprintf(stderr, "aes-bench: unknown hardware feature '%s'\n", argv[2]);
+      return 1;
+    }
+    argc -= 2;
+    argv += 2;
+  }
+  if (argc > 1) mbytes = strtoul(argv[1], NULL, 10);
+  if (!mbytes || argc > 2) {
+    fprintf(stderr, "usage: aes-bench [--disable-hwf NAME] [MBYTES]\n");
+    return 1;
+  }
+
+  gcry_control(GCRYCTL_INITIALIZATION_FINISHED, 0);
+
+  for (size_t i = 0; i < sizeof algos / sizeof algos[0]; i++)
+    for (size_t j = 0; j < sizeof modes / sizeof modes[0]; j++)
+      rc |= bench(algos[i], modes[j], mbytes);
+
+  return rc;
+}
@@ -1,10 +1,570 @@
+#include <string.h>
+
 #include "gcrypt.h"
 
 #include "gtest/gtest.h"
 
 int hmac_main(int argc, char* argv[]);
+int kdf_main(int argc, char* argv[]);
 
 TEST(GcryptTest, hmac) {
   int result = hmac_main(0, NULL);
   ASSERT_EQ(result, 0);
 }
+
+TEST(GcryptTest, kdf) {
+  int result = kdf_main(0, NULL);
+  ASSERT_EQ(result, 0);
+}
+
+TEST(GcryptTest, disable_hwf) {
+  ASSERT_EQ(gcry_control(GCRYCTL_DISABLE_HWF, "no-such-feature", NULL),
+            GPG_ERR_INV_NAME);
+  ASSERT_EQ(gcry_control(GCRYCTL_DISABLE_HWF, "padlock-rng,padlock-sha", NULL),
+            0);
+}
+
+/* Check multiplication and division, which exercise all limb
+   primitives, on numbers of various sizes.  The all-ones numbers
+   propagate a carry through every limb.  */
+TEST(GcryptTest, mpi_arith) {
+  static const unsigned int sizes[] = {64, 192, 1024, 2080, 4160};
+  gcry_mpi_t a = gcry_mpi_new(0);
+  gcry_mpi_t b = gcry_mpi_new(0);
+  gcry_mpi_t r = gcry_mpi_new(0);
+  gcry_mpi_t p = gcry_mpi_new(0);
+  gcry_mpi_t q = gcry_mpi_new(0);
+  gcry_mpi_t t = gcry_mpi_new(0);
+
+  for (size_t i = 0; i < sizeof sizes / sizeof sizes[0]; i++) {
+    unsigned int k = sizes[i];
+
+    /* (2^k - 1)^2 = 2^2k - 2^(k+1) + 1 */
+    gcry_mpi_set_ui(t, 1);
+    gcry_mpi_lshift(a, t, k);
+    gcry_mpi_sub_ui(a, a, 1);
+    gcry_mpi_mul(p, a, a);
+    gcry_mpi_lshift(q, t, 2 * k);
+    gcry_mpi_lshift(r, t, k + 1);
+    gcry_mpi_sub(q, q, r);
+    gcry_mpi_add_ui(q, q, 1);
+    EXPECT_EQ(gcry_mpi_cmp(p, q), 0) << k << " bits";
+
+    /* (A * B + R) / B = A, remainder R */
+    gcry_mpi_randomize(a, k);
+    gcry_mpi_randomize(b, k / 2 + 64);
+    gcry_mpi_randomize(r, k / 2);
+    gcry_mpi_mul(p, a, b);
+    gcry_mpi_add(p, p, r);
+    gcry_mpi_div(q, t, p, b, 0);
+    EXPECT_EQ(gcry_mpi_cmp(q, a), 0) << k << " bits";
+    EXPECT_EQ(gcry_mpi_cmp(t, r), 0) << k << " bits";
+  }
+
+  gcry_mpi_release(a);
+  gcry_mpi_release(b);
+  gcry_mpi_release(r);
+  gcry_mpi_release(p);
+  gcry_mpi_release(q);
+  gcry_mpi_release(t);
+}
+
+/* Compare gcry_mpi_powm, which uses Montgomery multiplication for odd
+   moduli, with square-and-multiply using gcry_mpi_mulm.  Exponents in
+   secure memory take the constant-time path.  */
+TEST(GcryptTest, mpi_powm) {
+  static const unsigned int sizes[] = {64, 130, 1024, 2048, 4160};
+  gcry_mpi_t m = gcry_mpi_new(0);
+  gcry_mpi_t b = gcry_mpi_new(0);
+  gcry_mpi_t r = gcry_mpi_new(0);
+  gcry_mpi_t t = gcry_mpi_new(0);
+  gcry_mpi_t e = gcry_mpi_snew(0);
+
+  for (size_t i = 0; i < sizeof sizes / sizeof sizes[0]; i++) {
+    unsigned int k = sizes[i];
+
+    for (int odd = 0; odd < 2; odd++) {
+      gcry_mpi_randomize(m, k);
+      gcry_mpi_set_highbit(m, k - 1);
+      if (odd)
+        gcry_mpi_set_bit(m, 0);
+      else
+        gcry_mpi_clear_bit(m, 0);
+      gcry_mpi_randomize(b, k + 32);
+      gcry_mpi_neg(b, b);
+      gcry_mpi_randomize(e, k);
+
+      gcry_mpi_powm(r, b, e, m);
+
+      gcry_mpi_set_ui(t, 1);
+      gcry_mpi_mod(b, b, m);
+      for (int j = gcry_mpi_get_nbits(e) - 1; j >= 0; j--) {
+        gcry_mpi_mulm(t, t, t, m);
+        if (gcry_mpi_test_bit(e, j)) gcry_mpi_mulm(t, t, b, m);
+      }
+      EXPECT_EQ(gcry_mpi_cmp(r, t), 0) << k << " bits, odd " << odd;
+    }
+  }
+
+  gcry_mpi_release(m);
+  gcry_mpi_release(b);
+  gcry_mpi_release(r);
+  gcry_mpi_release(t);
+  gcry_mpi_release(e);
+}
+
+/* Tests which use the MPI and EC functions directly.  These abort if
+   libgcrypt is not initialized, so initialize it as an application
+   does, also when the tests run alone with --gtest_filter.  */
+class GcryptInitTest : public ::testing::Test {
+ protected:
+  static void SetUpTestCase() {
+    gcry_control(GCRYCTL_INITIALIZATION_FINISHED, 0);
+  }
+};
+
+/* Check the curves with dedicated field arithmetic.  The points K * G
+   and (N - K) * G are inverse, so they have the same x coordinate on
+   Weierstrass curves and the same y coordinate on Edwards curves.
+   K = 1 compares (N - 1) * G with G itself.  */
+TEST_F(GcryptInitTest, ec_field) {
+  static const char *curves[] = {"Ed25519", "NIST P-256", "NIST P-384"};
+
+  for (size_t i = 0; i < sizeof curves / sizeof curves[0]; i++) {
+    gcry_ctx_t ctx;
+    gcry_mpi_point_t G, P, Q;
+    gcry_mpi_t n, k, x1, y1, x2, y2;
+    int edwards = !strcmp(curves[i], "Ed25519");
+
+    ASSERT_EQ(gcry_mpi_ec_new(&ctx, NULL, curves[i]), 0) << curves[i];
+    G = gcry_mpi_ec_get_point("g", ctx, 1);
+    n = gcry_mpi_ec_get_mpi("n", ctx, 1);
+    k = gcry_mpi_new(0);
+    P = gcry_mpi_point_new(0);
+    Q = gcry_mpi_point_new(0);
+    x1 = gcry_mpi_new(0);
+    y1 = gcry_mpi_new(0);
+    x2 = gcry_mpi_new(0);
+    y2 = gcry_mpi_new(0);
+
+    for (int j = 0; j < 3; j++) {
+      if (j)
+        gcry_mpi_randomize(k, gcry_mpi_get_nbits(n) - 1);
+      else
+        gcry_mpi_set_ui(k, 1);
+      gcry_mpi_ec_mul(P, k, G, ctx);
+      gcry_mpi_sub(k, n, k);
+      gcry_mpi_ec_mul(Q, k, G, ctx);
+
+      ASSERT_EQ(gcry_mpi_ec_get_affine(x1, y1, P, ctx), 0) << curves[i];
+      ASSERT_EQ(gcry_mpi_ec_get_affine(x2, y2, Q, ctx), 0) << curves[i];
+      EXPECT_TRUE(gcry_mpi_ec_curve_point(Q, ctx)) << curves[i];
+      if (edwards)
+        EXPECT_EQ(gcry_mpi_cmp(y1, y2), 0) << curves[i];
+      else
+        EXPECT_EQ(gcry_mpi_cmp(x1, x2), 0) << curves[i];
+    }
+
+    gcry_mpi_release(k);
+    gcry_mpi_release(n);
+    gcry_mpi_release(x1);
+    gcry_mpi_release(y1);
+    gcry_mpi_release(x2);
+    gcry_mpi_release(y2);
+    gcry_mpi_point_release(P);
+    gcry_mpi_point_release(Q);
+    gcry_mpi_point_release(G);
+    gcry_ctx_release(ctx);
+  }
+}
+
+/* Multiplications of the base point use a table of precomputed
+   multiples.  Compare them with multiplications of the same point in
+   projective coordinates with Z = 2, which do not.  */
+TEST_F(GcryptInitTest, ec_base_table) {
+  static const char *curves[] = {"Ed25519", "NIST P-256", "NIST P-521",
+                                 "brainpoolP256r1"};
+
+  for (size_t i = 0; i < sizeof curves / sizeof curves[0]; i++) {
+    gcry_ctx_t ctx;
+    gcry_mpi_point_t G, G2, P, Q;
+    gcry_mpi_t p, n, k, z, x1, y1, x2, y2;
+    int edwards = !strcmp(curves[i], "Ed25519");
+
+    ASSERT_EQ(gcry_mpi_ec_new(&ctx, NULL, curves[i]), 0) << curves[i];
+    G = gcry_mpi_ec_get_point("g", ctx, 1);
+    p = gcry_mpi_ec_get_mpi("p", ctx, 1);
+    n = gcry_mpi_ec_get_mpi("n", ctx, 1);
+    z = gcry_mpi_set_ui(NULL, 2);
+    x1 = gcry_mpi_new(0);
+    y1 = gcry_mpi_new(0);
+    x2 = gcry_mpi_new(0);
+    y2 = gcry_mpi_new(0);
+
+    /* X * Z, Y * Z for Edwards curves and X * Z^2, Y * Z^3 otherwise.  */
+    gcry_mpi_point_get(x1, y1, NULL, G);
+    gcry_mpi_mulm(x1, x1, z, p);
+    gcry_mpi_mulm(y1, y1, z, p);
+    if (!edwards) {
+      gcry_mpi_mulm(x1, x1, z, p);
+      gcry_mpi_mulm(y1, y1, z, p);
+      gcry_mpi_mulm(y1, y1, z, p);
+    }
+    G2 = gcry_mpi_point_set(NULL, x1, y1, z);
+    P = gcry_mpi_point_new(0);
+    Q = gcry_mpi_point_new(0);
+
+    for (int j = 0; j < 4; j++) {
+      /* Secret scalars are in secure memory.  */
+      k = j & 1 ? gcry_mpi_snew(0) : gcry_mpi_new(0);
+      if (j > 1)
+        gcry_mpi_randomize(k, gcry_mpi_get_nbits(n) - 1);
+      else
+        gcry_mpi_sub_ui(k, n, 1);
+      gcry_mpi_ec_mul(P, k, G, ctx);
+      gcry_mpi_ec_mul(Q, k, G2, ctx);
+
+      ASSERT_EQ(gcry_mpi_ec_get_affine(x1, y1, P, ctx), 0) << curves[i];
+      ASSERT_EQ(gcry_mpi_ec_get_affine(x2, y2, Q, ctx), 0) << curves[i];
+      EXPECT_EQ(gcry_mpi_cmp(x1, x2), 0) << curves[i];
+      EXPECT_EQ(gcry_mpi_cmp(y1, y2), 0) << curves[i];
+      gcry_mpi_release(k);
+    }
+
+    gcry_mpi_release(p);
+    gcry_mpi_release(n);
+    gcry_mpi_release(z);
+    gcry_mpi_release(x1);
+    gcry_mpi_release(y1);
+    gcry_mpi_release(x2);
+    gcry_mpi_release(y2);
+    gcry_mpi_point_release(P);
+    gcry_mpi_point_release(Q);
+    gcry_mpi_point_release(G);
+    gcry_mpi_point_release(G2);
+    gcry_ctx_release(ctx);
+  }
+}
+
+/* Verify Ed25519 signatures by several keys together with an ECDSA
+   signature, once all good and once with two bad ones.  */
+TEST_F(GcryptInitTest, pk_verify_batch) {
+  enum { NKEYS = 3, NSIGS = 7 };
+  gcry_sexp_t keys[NKEYS + 1], pkeys[NSIGS], data[NSIGS], sigs[NSIGS];
+  gcry_sexp_t parms, skey, tmp;
+  gpg_error_t results[NSIGS];
+  unsigned char digest[32];
+  size_t i;
+
+  for (i = 0; i <= NKEYS; i++) {
+    const char *genkey =
+        i < NKEYS ? "(genkey(ecc(curve Ed25519)(flags eddsa)))"
+                  : "(genkey(ecc(curve \"NIST P-256\")))";
+
+    ASSERT_EQ(gcry_sexp_build(&parms, NULL, genkey), 0);
+    ASSERT_EQ(gcry_pk_genkey(&keys[i], parms), 0);
+    gcry_sexp_release(parms);
+  }
+
+  for (i = 0; i < NSIGS; i++) {
+    bool ecdsa = i == NSIGS - 1;
+
+    memset(digest, 'a' + i, sizeof digest);
+    if (ecdsa)
+      ASSERT_EQ(gcry_sexp_build(&data[i], NULL,
+                                "(data(flags rfc6979)(hash sha256 %b))",
+                                (int)sizeof digest, digest),
+                0);
+    else
+      ASSERT_EQ(gcry_sexp_build(&data[i], NULL,
+                                "(data(flags eddsa)(hash-algo sha512)"
+                                "(value %b))",
+                                (int)sizeof digest, digest),
+                0);
+    tmp = keys[ecdsa ? NKEYS : i % NKEYS];
+    skey = gcry_sexp_find_token(tmp, "private-key", 0);
+    pkeys[i] = gcry_sexp_find_token(tmp, "public-key", 0);
+    ASSERT_EQ(gcry_pk_sign(&sigs[i], data[i], skey), 0);
+    gcry_sexp_release(skey);
+  }
+
+  ASSERT_EQ(gcry_pk_verify_batch(sigs, data, pkeys, NSIGS, results), 0);
+  for (i = 0; i < NSIGS; i++) EXPECT_EQ(results[i], 0) << i;
+
+  /* Swap the data of two Ed25519 signatures.  */
+  tmp = data[1];
+  data[1] = data[4];
+  data[4] = tmp;
+  EXPECT_EQ(gcry_pk_verify_batch(sigs, data, pkeys, NSIGS, results),
+            GPG_ERR_BAD_SIGNATURE);
+  for (i = 0; i < NSIGS; i++) {
+    if (i == 1 || i == 4)
+      EXPECT_EQ(results[i], GPG_ERR_BAD_SIGNATURE) << i;
+    else
+      EXPECT_EQ(results[i], 0) << i;
+  }
+
+  for (i = 0; i < NSIGS; i++) {
+    gcry_sexp_release(pkeys[i]);
+    gcry_sexp_release(data[i]);
+    gcry_sexp_release(sigs[i]);
+  }
+  for (i = 0; i <= NKEYS; i++) gcry_sexp_release(keys[i]);
+}
+
+/* A curve is found by its name, an alias or its OID, and always
+   yields the same handle.  */
+TEST_F(GcryptInitTest, ecc_lookup_curve) {
+  gcry_ecc_curve_t curve;
+
+  curve = gcry_ecc_lookup_curve("Ed25519");
+  ASSERT_NE(curve, nullptr);
+  EXPECT_EQ(gcry_ecc_lookup_curve("Ed25519"), curve);
+  EXPECT_EQ(gcry_ecc_lookup_curve("1.3.6.1.4.1.11591.15.1"), curve);
+
+  curve = gcry_ecc_lookup_curve("NIST P-256");
+  ASSERT_NE(curve, nullptr);
+  EXPECT_EQ(gcry_ecc_lookup_curve("prime256v1"), curve);
+  EXPECT_EQ(gcry_ecc_lookup_curve("1.2.840.10045.3.1.7"), curve);
+
+  EXPECT_EQ(gcry_ecc_lookup_curve("no such curve"), nullptr);
+  EXPECT_EQ(gcry_ecc_lookup_curve(NULL), nullptr);
+}
+
+/* Extract the one or two parameters ELEMS of SEXP into MPIS.
+   gcry_sexp_extract_param wants exactly one pointer per parameter.  */
+static gpg_error_t extract_mpis(gcry_sexp_t sexp, const char *elems,
+                                gcry_mpi_t *mpis) {
+  if (strlen(elems) - (elems[0] == '/') == 1)
+    return gcry_sexp_extract_param(sexp, NULL, elems, &mpis[0], NULL);
+  return gcry_sexp_extract_param(sexp, NULL, elems, &mpis[0], &mpis[1], NULL);
+}
+
+/* Verify signatures made with the S-expression interface with the
+   MPIs extracted from them, and with a different value.  */
+TEST_F(GcryptInitTest, pk_verify_mpi) {
+  static const struct {
+    int algo;
+    const char *curve, *genkey, *pkey_elems, *sig_elems;
+  } cases[] = {
+      {GCRY_PK_RSA, NULL, "(genkey(rsa(nbits 4:1024)))", "ne", "s"},
+      {GCRY_PK_ECDSA, "NIST P-256", "(genkey(ecc(curve \"NIST P-256\")))",
+       "q", "rs"},
+      {GCRY_PK_EDDSA, "Ed25519", "(genkey(ecc(curve Ed25519)(flags eddsa)))",
+       "/q", "/rs"}};
+  unsigned char digest[32];
+
+  memset(digest, 0x5a, sizeof digest);
+  for (size_t i = 0; i < sizeof cases / sizeof cases[0]; i++) {
+    bool eddsa = cases[i].algo == GCRY_PK_EDDSA;
+    gcry_ecc_curve_t curve = gcry_ecc_lookup_curve(cases[i].curve);
+    gcry_sexp_t parms, key, skey, pkey, data, sig;
+    gcry_mpi_t value, pkey_mpis[2] = {NULL, NULL}, sig_mpis[2] = {NULL, NULL};
+
+    if (cases[i].curve) ASSERT_NE(curve, nullptr) << i;
+    ASSERT_EQ(gcry_sexp_build(&parms, NULL, cases[i].genkey), 0);
+    ASSERT_EQ(gcry_pk_genkey(&key, parms), 0);
+    skey = gcry_sexp_find_token(key, "private-key", 0);
+    pkey = gcry_sexp_find_token(key, "public-key", 0);
+    if (eddsa) {
+      value = gcry_mpi_set_opaque_copy(NULL, digest, 8 * sizeof digest);
+      ASSERT_EQ(gcry_sexp_build(&data, NULL,
+                                "(data(flags eddsa)(hash-algo sha512)"
+                                "(value %b))",
+                                (int)sizeof digest, digest),
+                0);
+    } else {
+      ASSERT_EQ(gcry_mpi_scan(&value, GCRYMPI_FMT_USG, digest, sizeof digest,
+                              NULL),
+                0);
+      ASSERT_EQ(gcry_sexp_build(&data, NULL, "(data(flags raw)(value %m))",
+                                value),
+                0);
+    }
+    ASSERT_EQ(gcry_pk_sign(&sig, data, skey), 0);
+    ASSERT_EQ(extract_mpis(pkey, cases[i].pkey_elems, pkey_mpis), 0) << i;
+    ASSERT_EQ(extract_mpis(sig, cases[i].sig_elems, sig_mpis), 0) << i;
+
+    EXPECT_EQ(gcry_pk_verify_mpi(cases[i].algo, curve, value, sig_mpis,
+                                 pkey_mpis),
+              0)
+        << i;
+
+    /* Verify the signature over a different value.  */
+    digest[0] ^= 1;
+    gcry_mpi_release(value);
+    if (eddsa)
+      value = gcry_mpi_set_opaque_copy(NULL, digest, 8 * sizeof digest);
+    else
+      gcry_mpi_scan(&value, GCRYMPI_FMT_USG, digest, sizeof digest, NULL);
+    digest[0] ^= 1;
+    EXPECT_EQ(gcry_pk_verify_mpi(cases[i].algo, curve, value, sig_mpis,
+                                 pkey_mpis),
+              GPG_ERR_BAD_SIGNATURE)
+        << i;
+
+    gcry_mpi_release(value);
+    gcry_mpi_release(pkey_mpis[0]);
+    gcry_mpi_release(pkey_mpis[1]);
+    gcry_mpi_release(sig_mpis[0]);
+    gcry_mpi_release(sig_mpis[1]);
+    gcry_sexp_release(sig);
+    gcry_sexp_release(data);
+    gcry_sexp_release(pkey);
+    gcry_sexp_release(skey);
+    gcry_sexp_release(key);
+    gcry_sexp_release(parms);
+  }
+}
+
+/* The test vectors of the SHA self-tests.  A NULL message stands for
+   one million times "a".  */
+static const struct {
+  int algo;
+  const char *msg;
+  const char *digest;
+} md_vectors[] = {
+    {GCRY_MD_SHA1, "abc",
+     "\xa9\x99\x3e\x36\x47\x06\x81\x6a\xba\x3e\x25\x71\x78\x50\xc2\x6c"
+     "\x9c\xd0\xd8\x9d"},
+    {GCRY_MD_SHA1,
+     "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+     "\x84\x98\x3e\x44\x1c\x3b\xd2\x6e\xba\xae\x4a\xa1\xf9\x51\x29\xe5"
+     "\xe5\x46\x70\xf1"},
+    {GCRY_MD_SHA1, NULL,
+     "\x34\xaa\x97\x3c\xd4\xc4\xda\xa4\xf6\x1e\xeb\x2b\xdb\xad\x27\x31"
+     "\x65\x34\x01\x6f"},
+    {GCRY_MD_SHA256, "abc",
+     "\xba\x78\x16\xbf\x8f\x01\xcf\xea\x41\x41\x40\xde\x5d\xae\x22\x23"
+     "\xb0\x03\x61\xa3\x96\x17\x7a\x9c\xb4\x10\xff\x61\xf2\x00\x15\xad"},
+    {GCRY_MD_SHA256,
+     "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+     "\x24\x8d\x6a\x61\xd2\x06\x38\xb8\xe5\xc0\x26\x93\x0c\x3e\x60\x39"
+     "\xa3\x3c\xe4\x59\x64\xff\x21\x67\xf6\xec\xed\xd4\x19\xdb\x06\xc1"},
+    {GCRY_MD_SHA256, NULL,
+     "\xcd\xc7\x6e\x5c\x99\x14\xfb\x92\x81\xa1\xc7\xe2\x84\xd7\x3e\x67"
+     "\xf1\x80\x9a\x48\xa4\x97\x20\x0e\x04\x6d\x39\xcc\xc7\x11\x2c\xd0"},
+    {GCRY_MD_SHA512, "abc",
+     "\xdd\xaf\x35\xa1\x93\x61\x7a\xba\xcc\x41\x73\x49\xae\x20\x41\x31"
+     "\x12\xe6\xfa\x4e\x89\xa9\x7e\xa2\x0a\x9e\xee\xe6\x4b\x55\xd3\x9a"
+     "\x21\x92\x99\x2a\x27\x4f\xc1\xa8\x36\xba\x3c\x23\xa3\xfe\xeb\xbd"
+     "\x45\x4d\x44\x23\x64\x3c\xe8\x0e\x2a\x9a\xc9\x4f\xa5\x4c\xa4\x9f"},
+    {GCRY_MD_SHA512,
+     "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmn"
+     "hijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+     "\x8e\x95\x9b\x75\xda\xe3\x13\xda\x8c\xf4\xf7\x28\x14\xfc\x14\x3f"
+     "\x8f\x77\x79\xc6\xeb\x9f\x7f\xa1\x72\x99\xae\xad\xb6\x88\x90\x18"
+     "\x50\x1d\x28\x9e\x49\x00\xf7\xe4\x33\x1b\x99\xde\xc4\xb5\x43\x3a"
+     "\xc7\xd3\x29\xee\xb6\xdd\x26\x54\x5e\x96\xe5\x5b\x87\x4b\xe9\x09"},
+    {GCRY_MD_SHA512, NULL,
+     "\xe7\x18\x48\x3d\x0c\xe7\x69\x64\x4e\x2e\x42\xc7\xbc\x15\xb4\x63"
+     "\x8e\x1f\x98\xb1\x3b\x20\x44\x28\x56\x32\xa8\x03\xaf\xa9\x73\xeb"
+     "\xde\x0f\xf2\x44\x87\x7e\xa6\x0a\x4c\xb0\x43\x2c\xe5\x77\xc3\x1b"
+     "\xeb\x00\x9c\x5c\x2c\x49\xaa\x2e\x4e\xad\xb2\x17\xad\x8c\xc0\x9b"}};
+
+/* Check all vectors in MD_VECTORS.  */
+static void check_md_vectors(void) {
+  for (size_t i = 0; i < sizeof md_vectors / sizeof md_vectors[0]; i++) {
+    int algo = md_vectors[i].algo;
+    unsigned int dlen = gcry_md_get_algo_dlen(algo);
+    gcry_md_hd_t hd;
+
+    ASSERT_EQ(gcry_md_open(&hd, algo, 0), 0);
+    if (md_vectors[i].msg)
+      gcry_md_write(hd, md_vectors[i].msg, strlen(md_vectors[i].msg));
+    else {
+      char aaa[1000];
+
+      memset(aaa, 'a', sizeof aaa);
+      for (int j = 0; j < 1000; j++) gcry_md_write(hd, aaa, sizeof aaa);
+    }
+    EXPECT_EQ(memcmp(gcry_md_read(hd, algo), md_vectors[i].digest, dlen), 0)
+        << gcry_md_algo_name(algo) << " vector " << i;
+    gcry_md_close(hd);
+  }
+}
+
+/* Compute the OpenPGP CRC-24 of LEN bytes at BUF bit by bit.  */
+static unsigned int crc24_ref(unsigned int crc, const unsigned char *buf,
+                              size_t len) {
+  while (len--) {
+    crc ^= *buf++ << 16;
+    for (int i = 0; i < 8; i++) {
+      crc <<= 1;
+      if (crc & 0x1000000) crc ^= 0x1864cfb;
+    }
+  }
+  return crc;
+}
+
+/* Check gcry_crc24_update for all lengths and alignments the kernels
+   treat differently, fed in two pieces like the armor filters do.  */
+static void check_crc24(void) {
+  unsigned char buf[300];
+
+  for (size_t i = 0; i < sizeof buf; i++) buf[i] = i * 29 + 3;
+  EXPECT_EQ(gcry_crc24_update(GCRY_CRC24_INIT, "123456789", 9), 0x21cf02u);
+  for (size_t off = 0; off < 4; off++)
+    for (size_t len = 0; len + off <= sizeof buf; len++) {
+      unsigned int crc;
+
+      crc = gcry_crc24_update(GCRY_CRC24_INIT, buf + off, len / 3);
+      crc = gcry_crc24_update(crc, buf + off + len / 3, len - len / 3);
+      ASSERT_EQ(crc, crc24_ref(GCRY_CRC24_INIT, buf + off, len))
+          << "offset " << off << " length " << len;
+    }
+}
+
+/* The tests below disable hardware features for the rest of the
+   process, so they must stay at the end.  */
+
+TEST(GcryptTest, md_vectors_hwf) {
+  check_md_vectors();
+  ASSERT_EQ(gcry_control(GCRYCTL_DISABLE_HWF, "intel-shaext:intel-avx2", NULL),
+            0);
+  check_md_vectors();
+}
+
+/* Decrypt a buffer spanning several bulk strides with each AES
+   bulk mode, once with and once without the AES-NI code, and compare
+   the results.  */
+static void aes_decrypt_all(unsigned char *out, size_t len) {
+  static const int modes[] = {GCRY_CIPHER_MODE_CFB, GCRY_CIPHER_MODE_CBC,
+                              GCRY_CIPHER_MODE_CTR};
+  unsigned char key[32];
+  unsigned char iv[16];
+  gcry_cipher_hd_t hd;
+
+  for (size_t i = 0; i < sizeof key; i++) key[i] = i;
+  for (size_t i = 0; i < sizeof iv; i++) iv[i] = 0xf0 | i;
+  for (size_t m = 0; m < sizeof modes / sizeof modes[0]; m++) {
+    unsigned char *buf = out + m * len;
+
+    for (size_t i = 0; i < len; i++) buf[i] = i * 13;
+    ASSERT_EQ(gcry_cipher_open(&hd, GCRY_CIPHER_AES256, modes[m], 0), 0);
+    ASSERT_EQ(gcry_cipher_setkey(hd, key, sizeof key), 0);
+    if (modes[m] == GCRY_CIPHER_MODE_CTR)
+      ASSERT_EQ(gcry_cipher_setctr(hd, iv, sizeof iv), 0);
+    else
+      ASSERT_EQ(gcry_cipher_setiv(hd, iv, sizeof iv), 0);
+    ASSERT_EQ(gcry_cipher_decrypt(hd, buf, len, NULL, 0), 0);
+    gcry_cipher_close(hd);
+  }
+}
+
+TEST(GcryptTest, aes_bulk_hwf) {
+  const size_t len = 16 * 37;
+  unsigned char hw[3 * len];
+  unsigned char sw[3 * len];
+
+  aes_decrypt_all(hw, len);
+  ASSERT_EQ(gcry_control(GCRYCTL_DISABLE_HWF, "intel-aesni", NULL), 0);
+  aes_decrypt_all(sw, len);
+  ASSERT_EQ(memcmp(hw, sw, sizeof hw), 0);
+}
+
+TEST(GcryptTest, crc24_hwf) {
+  check_crc24();
+  ASSERT_EQ(gcry_control(GCRYCTL_DISABLE_HWF, "intel-pclmul", NULL), 0);
+  check_crc24();
+}
@@ -0,0 +1,88 @@
+/* md-bench.cpp - Benchmark message digest throughput
+   Copyright 2017 The NeoPG developers
+
+   NeoPG is released under the Simplified BSD License (see license.txt)
+*/
+
+/* Usage: md-bench [--disable-hwf NAME] [MBYTES]
+
+   Hashes MBYTES (default 1024) of data with each of the SHA-1 and
+   SHA-2 digests and reports the throughput.  The data is fed in 64
+   KiB chunks, like the hashing of a large file does.  With
+   "--disable-hwf intel-shaext:intel-avx2" the generic transforms are
+   measured instead.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "gcrypt.h"
+
+#define CHUNKSIZE 65536
+
+static double elapsed(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+static int bench(int algo, unsigned long mbytes) {
+  std::vector<unsigned char> buf(CHUNKSIZE);
+  unsigned long nchunks = mbytes * (1024 * 1024 / CHUNKSIZE);
+  gcry_md_hd_t hd;
+  gpg_error_t err;
+  double secs;
+
+  for (size_t i = 0; i < buf.size(); i++) buf[i] = i * 7;
+
+  err = gcry_md_open(&hd, algo, 0);
+  if (err) {
+    fprintf(stderr, "md-bench: digest setup failed: %s\n", gpg_strerror(err));
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < nchunks; i++)
+    gcry_md_write(hd, buf.data(), buf.size());
+  gcry_md_final(hd);
+  secs = elapsed(start);
+  gcry_md_close(hd);
+
+  printf("%-7s: %lu MiB in %.3f s, %.1f MiB/s\n", gcry_md_algo_name(algo),
+         mbytes, secs, mbytes / secs);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  static const int algos[] = {GCRY_MD_SHA1, GCRY_MD_SHA224, GCRY_MD_SHA256,
+                              GCRY_MD_SHA384, GCRY_MD_SHA512};
+  unsigned long mbytes = 1024;
+  int rc = 0;
+
+  if (argc > 2 && !strcmp(argv[1], "--disable-hwf")) {
+    if (gcry_control(GCRYCTL_DISABLE_HWF, argv[2], NULL)) {
+      fprintf(stderr, "md-bench: unknown hardware feature '%s'\n", argv[2]);
+      return 1;
+    }
+    argc -= 2;
+    argv += 2;
+  }
+  if (argc > 1) mbytes = strtoul(argv[1], NULL, 10);
+  if (!mbytes || argc > 2) {
+    fprintf(stderr, "usage: md-bench [--disable-hwf NAME] [MBYTES]\n");
+    return 1;
+  }
+
+  gcry_control(GCRYCTL_INITIALIZATION_FINISHED, 0);
+
+  for (size_t i = 0; i < sizeof algos / sizeof algos[0]; i++)
+    rc |= bench(algos[i], mbytes);
+
+  return rc;
+}
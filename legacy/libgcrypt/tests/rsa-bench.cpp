@@ -0,0 +1,116 @@
+/* rsa-bench.cpp - Benchmark RSA signing and verification
+   Copyright 2017 The NeoPG developers
+
+   NeoPG is released under the Simplified BSD License (see license.txt)
+*/
+
+/* Usage: rsa-bench [--disable-hwf NAME] [ITERATIONS]
+
+   Generates an RSA-2048 and an RSA-4096 key and reports the time for
+   ITERATIONS (default 100) PKCS#1 signatures and verifications of a
+   SHA-256 digest with each.  With "--disable-hwf intel-bmi2" the
+   generic MPI multiplication loops are measured instead.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+#include "gcrypt.h"
+
+static double elapsed(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+static int bench(unsigned int nbits, unsigned long iterations) {
+  gcry_sexp_t parms = NULL, key = NULL, skey = NULL, pkey = NULL;
+  gcry_sexp_t data = NULL, sig = NULL;
+  unsigned char digest[32];
+  std::chrono::steady_clock::time_point start;
+  gpg_error_t err;
+  double secs;
+
+  memset(digest, 0x5a, sizeof digest);
+
+  err = gcry_sexp_build(&parms, NULL, "(genkey(rsa(nbits %u)))", nbits);
+  if (!err) err = gcry_pk_genkey(&key, parms);
+  if (!err) {
+    skey = gcry_sexp_find_token(key, "private-key", 0);
+    pkey = gcry_sexp_find_token(key, "public-key", 0);
+    if (!skey || !pkey) err = GPG_ERR_NO_OBJ;
+  }
+  if (!err)
+    err = gcry_sexp_build(&data, NULL, "(data(flags pkcs1)(hash sha256 %b))",
+                          (int)sizeof digest, digest);
+  if (err) {
+    fprintf(stderr, "rsa-bench: key setup failed: %s\n", gpg_strerror(err));
+    goto leave;
+  }
+
+  start = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < iterations && !err; i++) {
+    gcry_sexp_release(sig);
+    err = gcry_pk_sign(&sig, data, skey);
+  }
+  secs = elapsed(start);
+  if (err) {
+    fprintf(stderr, "rsa-bench: signing failed: %s\n", gpg_strerror(err));
+    goto leave;
+  }
+  printf("RSA-%u sign:   %lu in %.3f s, %.3f ms each\n", nbits, iterations,
+         secs, secs * 1000 / iterations);
+
+  start = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < iterations && !err; i++)
+    err = gcry_pk_verify(sig, data, pkey);
+  secs = elapsed(start);
+  if (err) {
+    fprintf(stderr, "rsa-bench: verification failed: %s\n",
+            gpg_strerror(err));
+    goto leave;
+  }
+  printf("RSA-%u verify: %lu in %.3f s, %.3f ms each\n", nbits, iterations,
+         secs, secs * 1000 / iterations);
+
+leave:
+  gcry_sexp_release(sig);
+  gcry_sexp_release(data);
+  gcry_sexp_release(pkey);
+  gcry_sexp_release(skey);
+  gcry_sexp_release(key);
+  gcry_sexp_release(parms);
+  return err ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+  static const unsigned int sizes[] = {2048, 4096};
+  unsigned long iterations = 100;
+  int rc = 0;
+
+  if (argc > 2 && !strcmp(argv[1], "--disable-hwf")) {
+    if (gcry_control(GCRYCTL_DISABLE_HWF, argv[2], NULL)) {
+      fprintf(stderr, "rsa-bench: unknown hardware feature '%s'\n", argv[2]);
+      return 1;
+    }
+    argc -= 2;
+    argv += 2;
+  }
+  if (argc > 1) iterations = strtoul(argv[1], NULL, 10);
+  if (!iterations || argc > 2) {
+    fprintf(stderr, "usage: rsa-bench [--disable-hwf NAME] [ITERATIONS]\n");
+    return 1;
+  }
+
+  gcry_control(GCRYCTL_INITIALIZATION_FINISHED, 0);
+
+  for (size_t i = 0; i < sizeof sizes / sizeof sizes[0]; i++)
+    rc |= bench(sizes[i], iterations);
+
+  return rc;
+}
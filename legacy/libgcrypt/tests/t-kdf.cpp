@@ -493,8 +493,6 @@ static void check_openpgp(void) {
 
   for (tvidx = 0; tvidx < DIM(tv); tvidx++) {
     if (tv[tvidx].disabled) continue;
-    /* MD5 isn't supported in fips mode */
-    if (gcry_fips_mode_active() && tv[tvidx].hashalgo == GCRY_MD_MD5) continue;
     if (verbose) fprintf(stderr, "checking S2K test vector %d\n", tvidx);
     assert(tv[tvidx].dklen <= sizeof outbuf);
     err = gcry_kdf_derive(tv[tvidx].p, tv[tvidx].plen, tv[tvidx].algo,
@@ -624,6 +622,8 @@ static void check_pbkdf2(void) {
 
   for (tvidx = 0; tvidx < DIM(tv); tvidx++) {
     if (tv[tvidx].disabled) continue;
+    /* The GOST digests are not part of this build.  */
+    if (gcry_md_test_algo(tv[tvidx].hashalgo)) continue;
     if (verbose)
       fprintf(stderr, "checking PBKDF2 test vector %d algo %d\n", tvidx,
               tv[tvidx].hashalgo);
@@ -703,7 +703,7 @@ static void check_scrypt(void) {
   }
 }
 
-int main(int argc, char **argv) {
+int kdf_main(int argc, char **argv) {
   int last_argc = -1;
   unsigned long s2kcount = 0;
 
@@ -750,8 +750,6 @@ int main(int argc, char **argv) {
     if (!s2kcount) die("t-kdf: S2KCOUNT must be positive\n");
   }
 
-  if (!gcry_check_version(GCRYPT_VERSION)) die("version mismatch\n");
-
   xgcry_control(GCRYCTL_DISABLE_SECMEM, 0);
   xgcry_control(GCRYCTL_INITIALIZATION_FINISHED, 0);
   if (debug) xgcry_control(GCRYCTL_SET_DEBUG_FLAGS, 1u, 0);
@@ -0,0 +1,199 @@
+/* verify-bench.cpp - Benchmark signature verification with MPIs
+   Copyright 2017 The NeoPG developers
+
+   NeoPG is released under the Simplified BSD License (see license.txt)
+*/
+
+/* Usage: verify-bench [--disable-hwf NAME] [ITERATIONS]
+
+   Generates an RSA-2048, a NIST P-256 and an Ed25519 key and reports
+   the verifications per second of ITERATIONS (default 1000)
+   signatures, once with S-expressions built for each call like gpg
+   did and once with gcry_pk_verify_mpi.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+#include "gcrypt.h"
+
+struct bench_case {
+  const char *name;
+  int algo;
+  const char *curve;
+  const char *genkey;
+  /* The formats of the S-expressions as gpg built them and the names
+     of the elements passed to gcry_pk_verify_mpi.  */
+  const char *pkey_fmt;
+  const char *data_fmt;
+  const char *sig_fmt;
+  const char *pkey_elems;
+  const char *sig_elems;
+};
+
+static const struct bench_case cases[] = {
+    {"RSA-2048", GCRY_PK_RSA, NULL, "(genkey(rsa(nbits 4:2048)))",
+     "(public-key(rsa(n%m)(e%m)))", "%m", "(sig-val(rsa(s%m)))", "ne", "s"},
+    {"NIST P-256", GCRY_PK_ECDSA, "NIST P-256",
+     "(genkey(ecc(curve \"NIST P-256\")))",
+     "(public-key(ecdsa(curve %s)(q%m)))", "%m", "(sig-val(ecdsa(r%m)(s%m)))",
+     "q", "rs"},
+    {"Ed25519", GCRY_PK_EDDSA, "Ed25519",
+     "(genkey(ecc(curve Ed25519)(flags eddsa)))",
+     "(public-key(ecc(curve %s)(flags eddsa)(q%m)))",
+     "(data(flags eddsa)(hash-algo sha512)(value %m))",
+     "(sig-val(eddsa(r%M)(s%M)))", "q", "rs"}};
+
+static double elapsed(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+/* Store the elements ELEMS of the S-expression SEXP at MPIS.  */
+static int get_mpis(gcry_sexp_t sexp, const char *elems, gcry_mpi_t *mpis,
+                    int opaque) {
+  char name[2] = {0, 0};
+
+  for (int i = 0; elems[i]; i++) {
+    gcry_sexp_t l;
+
+    name[0] = elems[i];
+    l = gcry_sexp_find_token(sexp, name, 1);
+    mpis[i] = l ? gcry_sexp_nth_mpi(l, 1, opaque ? GCRYMPI_FMT_OPAQUE
+                                                 : GCRYMPI_FMT_USG)
+                : NULL;
+    gcry_sexp_release(l);
+    if (!mpis[i]) return 1;
+  }
+  return 0;
+}
+
+/* Verify the signature SIG over DATA with the key PKEY like gpg did:
+   build the S-expressions and pass them to gcry_pk_verify.  */
+static gpg_error_t verify_sexp(const struct bench_case *bc, gcry_mpi_t data,
+                               gcry_mpi_t *sig, gcry_mpi_t *pkey) {
+  gcry_sexp_t s_pkey = NULL, s_data = NULL, s_sig = NULL;
+  gpg_error_t err;
+
+  if (bc->curve)
+    err = gcry_sexp_build(&s_pkey, NULL, bc->pkey_fmt, bc->curve, pkey[0]);
+  else
+    err = gcry_sexp_build(&s_pkey, NULL, bc->pkey_fmt, pkey[0], pkey[1]);
+  if (!err) err = gcry_sexp_build(&s_data, NULL, bc->data_fmt, data);
+  if (!err) err = gcry_sexp_build(&s_sig, NULL, bc->sig_fmt, sig[0], sig[1]);
+  if (!err) err = gcry_pk_verify(s_sig, s_data, s_pkey);
+
+  gcry_sexp_release(s_sig);
+  gcry_sexp_release(s_data);
+  gcry_sexp_release(s_pkey);
+  return err;
+}
+
+static int bench(const struct bench_case *bc, unsigned long iterations) {
+  gcry_sexp_t parms = NULL, key = NULL, skey = NULL, pkey = NULL;
+  gcry_sexp_t s_data = NULL, s_sig = NULL;
+  gcry_mpi_t data = NULL, sig_mpis[2] = {NULL, NULL};
+  gcry_mpi_t pkey_mpis[2] = {NULL, NULL};
+  gcry_ecc_curve_t curve = gcry_ecc_lookup_curve(bc->curve);
+  int eddsa = bc->algo == GCRY_PK_EDDSA;
+  unsigned char digest[32];
+  std::chrono::steady_clock::time_point start;
+  gpg_error_t err;
+  double secs[2];
+
+  /* A value below the RSA modulus and the group orders.  */
+  memset(digest, 0x5a, sizeof digest);
+  if (eddsa)
+    data = gcry_mpi_set_opaque_copy(NULL, digest, 8 * sizeof digest);
+  else
+    gcry_mpi_scan(&data, GCRYMPI_FMT_USG, digest, sizeof digest, NULL);
+
+  err = gcry_sexp_build(&parms, NULL, bc->genkey);
+  if (!err) err = gcry_pk_genkey(&key, parms);
+  if (!err) {
+    skey = gcry_sexp_find_token(key, "private-key", 0);
+    pkey = gcry_sexp_find_token(key, "public-key", 0);
+    if (!skey || !pkey) err = GPG_ERR_NO_OBJ;
+  }
+  if (!err && eddsa)
+    err = gcry_sexp_build(&s_data, NULL,
+                          "(data(flags eddsa)(hash-algo sha512)(value %b))",
+                          (int)sizeof digest, digest);
+  else if (!err)
+    err = gcry_sexp_build(&s_data, NULL, "(data(flags raw)(value %m))", data);
+  if (!err) err = gcry_pk_sign(&s_sig, s_data, skey);
+  if (!err &&
+      (get_mpis(pkey, bc->pkey_elems, pkey_mpis, !!bc->curve) ||
+       get_mpis(s_sig, bc->sig_elems, sig_mpis, eddsa)))
+    err = GPG_ERR_NO_OBJ;
+  if (err) {
+    fprintf(stderr, "verify-bench: %s setup failed: %s\n", bc->name,
+            gpg_strerror(err));
+    goto leave;
+  }
+
+  start = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < iterations && !err; i++)
+    err = verify_sexp(bc, data, sig_mpis, pkey_mpis);
+  secs[0] = elapsed(start);
+
+  start = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < iterations && !err; i++)
+    err = gcry_pk_verify_mpi(bc->algo, curve, data, sig_mpis, pkey_mpis);
+  secs[1] = elapsed(start);
+
+  if (err) {
+    fprintf(stderr, "verify-bench: %s verification failed: %s\n", bc->name,
+            gpg_strerror(err));
+    goto leave;
+  }
+  printf("%-10s verify: %.0f/s with S-expressions, %.0f/s with MPIs\n",
+         bc->name, iterations / secs[0], iterations / secs[1]);
+
+leave:
+  gcry_mpi_release(data);
+  gcry_mpi_release(sig_mpis[0]);
+  gcry_mpi_release(sig_mpis[1]);
+  gcry_mpi_release(pkey_mpis[0]);
+  gcry_mpi_release(pkey_mpis[1]);
+  gcry_sexp_release(s_sig);
+  gcry_sexp_release(s_data);
+  gcry_sexp_release(pkey);
+  gcry_sexp_release(skey);
+  gcry_sexp_release(key);
+  gcry_sexp_release(parms);
+  return err ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+  unsigned long iterations = 1000;
+  int rc = 0;
+
+  if (argc > 2 && !strcmp(argv[1], "--disable-hwf")) {
+    if (gcry_control(GCRYCTL_DISABLE_HWF, argv[2], NULL)) {
+      fprintf(stderr, "verify-bench: unknown hardware feature '%s'\n",
+              argv[2]);
+      return 1;
+    }
+    argc -= 2;
+    argv += 2;
+  }
+  if (argc > 1) iterations = strtoul(argv[1], NULL, 10);
+  if (!iterations || argc > 2) {
+    fprintf(stderr, "usage: verify-bench [--disable-hwf NAME] [ITERATIONS]\n");
+    return 1;
+  }
+
+  gcry_control(GCRYCTL_INITIALIZATION_FINISHED, 0);
+
+  for (size_t i = 0; i < sizeof cases / sizeof cases[0]; i++)
+    rc |= bench(&cases[i], iterations);
+
+  return rc;
+}
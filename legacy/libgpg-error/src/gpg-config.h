@@ -34,6 +34,21 @@
 /* Defined if this module should be included */
 #define USE_AES 1
 
+/* Enable support for Intel AES-NI instructions. */
+#define ENABLE_AESNI_SUPPORT 1
+
+/* Enable support for Intel PCLMUL instructions. */
+#define ENABLE_PCLMUL_SUPPORT 1
+
+/* Enable support for Intel SSE4.1 instructions. */
+#define ENABLE_SSE41_SUPPORT 1
+
+/* Enable support for Intel SHA Extensions instructions. */
+#define ENABLE_SHAEXT_SUPPORT 1
+
+/* Enable support for Intel AVX2 instructions. */
+#define ENABLE_AVX2_SUPPORT 1
+
 #define USE_DES 1
 
 /* Defined if this module should be included */
@@ -224,6 +239,7 @@
 #define GPGSM_NAME "neopgsm"
 #define GPGTAR_NAME "neopgtar"
 #define GPG_AGENT_NAME "neopg-agent"
+#define GPG_AGENT_SOCK_NAME "S.gpg-agent"
 #define GPG_DISP_NAME "NeoPG"
 #define GPG_NAME "neopg"
 #define GPG_USE_AES128 1
@@ -6,7 +6,24 @@
 
 #include <neopg/http.h>
 
+#include <botan/hash.h>
+#include <botan/hex.h>
+
+#include <dirent.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <exception>
+#include <fstream>
 #include <iostream>
+#include <utility>
+#include <vector>
 
 namespace NeoPG {
 
@@ -33,7 +50,8 @@ Http& Http::set_url(const std::string& url) {
   }
 
   /* Would be nice to have a URI check.  */
-  return set_opt_ptr(CURLOPT_URL, (void*)url.c_str());
+  m_url = url;
+  return set_opt_ptr(CURLOPT_URL, (void*)m_url.c_str());
 }
 
 Http& Http::set_proxy(const std::string& proxy) {
@@ -111,37 +129,266 @@ Http& Http::set_maxfilesize(long maxfilesize) {
   return set_opt_long(CURLOPT_MAXFILESIZE, maxfilesize);
 }
 
+Http& Http::set_cache_dir(const std::string& directory) {
+  m_cache_dir = directory;
+  return *this;
+}
+
+Http& Http::set_cache_limits(size_t max_entries, long max_age) {
+  m_cache_max_entries = max_entries;
+  m_cache_max_age = max_age;
+  return *this;
+}
+
+/* A cache file starts with a few header lines describing the stored
+   response, followed by an empty line and the body.  */
+static const char CACHE_MAGIC[] = "NeoPG-Http-Cache 1";
+
+/* The validators of a response, as stored in the cache.  */
+struct CacheEntry {
+  std::string url;
+  std::string etag;
+  std::string last_modified;
+
+  bool cacheable() const { return !etag.empty() || !last_modified.empty(); }
+};
+
+static std::string cache_filename(const std::string& directory,
+                                  const std::string& url) {
+  auto hash = Botan::HashFunction::create_or_throw("SHA-256");
+  hash->update(url);
+  auto digest = hash->final();
+  return directory + "/" +
+         Botan::hex_encode(digest.data(), digest.size(), false);
+}
+
+/* Read the header of the cache file FILENAME into ENTRY and leave IN
+   positioned at the start of the body.  Returns false if there is no
+   usable entry for URL.  */
+static bool cache_lookup(const std::string& filename, const std::string& url,
+                         std::ifstream& in, CacheEntry& entry) {
+  std::string line;
+
+  in.open(filename, std::ios::binary);
+  if (!in || !std::getline(in, line) || line != CACHE_MAGIC) return false;
+  while (std::getline(in, line) && !line.empty()) {
+    size_t colon = line.find(": ");
+    if (colon == std::string::npos) return false;
+    std::string name = line.substr(0, colon);
+    std::string value = line.substr(colon + 2);
+    if (name == "URL")
+      entry.url = value;
+    else if (name == "ETag")
+      entry.etag = value;
+    else if (name == "Last-Modified")
+      entry.last_modified = value;
+  }
+  /* The file name is a hash, so check for a collision.  */
+  return in && entry.url == url && entry.cacheable();
+}
+
+/* Remove the entries of the cache DIRECTORY which have not been used
+   for MAX_AGE seconds, and then the least recently used ones until at
+   most MAX_ENTRIES are left.  The modification time of a cache file
+   is the time of its last use.  */
+static void cache_evict(const std::string& directory, size_t max_entries,
+                        long max_age) {
+  std::vector<std::pair<time_t, std::string>> entries;
+  time_t now = time(nullptr);
+  struct dirent* de;
+  DIR* dp;
+
+  dp = opendir(directory.c_str());
+  if (!dp) return;
+  while ((de = readdir(dp))) {
+    std::string name = de->d_name;
+    struct stat st;
+
+    /* Skip the temporary files of transfers in progress.  */
+    if (name.size() != 64 ||
+        name.find_first_not_of("0123456789abcdef") != std::string::npos)
+      continue;
+    std::string filename = directory + "/" + name;
+    if (stat(filename.c_str(), &st) != 0) continue;
+    if (now - st.st_mtime > max_age)
+      std::remove(filename.c_str());
+    else
+      entries.emplace_back(st.st_mtime, filename);
+  }
+  closedir(dp);
+
+  if (entries.size() <= max_entries) return;
+  std::sort(entries.begin(), entries.end());
+  for (size_t i = 0; i < entries.size() - max_entries; i++)
+    std::remove(entries[i].second.c_str());
+}
+
+/* State of a streaming transfer, passed to write_fnc and header_fnc.  */
+struct WriteState {
+  CURL* handle;
+  const Http::Sink* sink;
+  std::exception_ptr error;
+
+  /* The validators of the current response.  */
+  CacheEntry response;
+  /* If not empty, the body of a cacheable response is copied to this
+     file.  */
+  std::string cache_tmp;
+  std::ofstream cache_out;
+};
+
+/* Start writing the cache file for the current response, if it can be
+   cached.  On failure, the response is just not cached.  */
+static void cache_open(WriteState* state) {
+  if (state->cache_tmp.empty() || state->cache_out.is_open()) return;
+  if (!state->response.cacheable()) {
+    state->cache_tmp.clear();
+    return;
+  }
+
+  state->cache_out.open(state->cache_tmp, std::ios::binary | std::ios::trunc);
+  state->cache_out << CACHE_MAGIC << "\n"
+                   << "URL: " << state->response.url << "\n";
+  if (!state->response.etag.empty())
+    state->cache_out << "ETag: " << state->response.etag << "\n";
+  if (!state->response.last_modified.empty())
+    state->cache_out << "Last-Modified: " << state->response.last_modified
+                     << "\n";
+  state->cache_out << "\n";
+  if (!state->cache_out) {
+    state->cache_out.close();
+    std::remove(state->cache_tmp.c_str());
+    state->cache_tmp.clear();
+  }
+}
+
+/* Must be an unbound function, because it is used as C callback.  */
+static size_t header_fnc(char* buffer, size_t size, size_t nitems,
+                         void* userp) {
+  WriteState* state = (WriteState*)userp;
+  size_t amount = size * nitems;
+  std::string line(buffer, amount);
+
+  while (!line.empty() && (line.back() == '\r' || line.back() == '\n'))
+    line.pop_back();
+
+  /* A new status line starts the headers of the next response, for
+     example after a redirect.  */
+  if (line.compare(0, 5, "HTTP/") == 0) {
+    state->response.etag.clear();
+    state->response.last_modified.clear();
+    return amount;
+  }
+
+  size_t colon = line.find(':');
+  if (colon == std::string::npos) return amount;
+  std::string name = line.substr(0, colon);
+  size_t start = line.find_first_not_of(" \t", colon + 1);
+  std::string value = start == std::string::npos ? "" : line.substr(start);
+  /* Values end up in the cache file as single lines.  */
+  if (value.find_first_of("\r\n") != std::string::npos) return amount;
+
+  if (strcasecmp(name.c_str(), "ETag") == 0)
+    state->response.etag = value;
+  else if (strcasecmp(name.c_str(), "Last-Modified") == 0)
+    state->response.last_modified = value;
+  return amount;
+}
+
 /* Must be an unbound function, because it is used as C callback.  */
 static size_t write_fnc(void* buffer, size_t size, size_t nmemb, void* userp) {
-  std::string* response = (std::string*)userp;
+  WriteState* state = (WriteState*)userp;
   size_t amount = size * nmemb;  // Overflow?
-  response->append((char*)buffer, amount);
+  long http_code = 0;
+
+  /* Do not pass error documents on to the sink.  */
+  curl_easy_getinfo(state->handle, CURLINFO_RESPONSE_CODE, &http_code);
+  if (http_code != 200) return amount;
+
+  /* Exceptions must not unwind through libcurl.  Returning a short
+     count aborts the transfer with CURLE_WRITE_ERROR.  */
+  try {
+    (*state->sink)((const uint8_t*)buffer, amount);
+  } catch (...) {
+    state->error = std::current_exception();
+    return 0;
+  }
+
+  cache_open(state);
+  if (state->cache_out.is_open() &&
+      !state->cache_out.write((const char*)buffer, amount)) {
+    /* Running out of disk space must not fail the transfer.  */
+    state->cache_out.close();
+    std::remove(state->cache_tmp.c_str());
+    state->cache_tmp.clear();
+  }
   return amount;
 }
 
 static int progress_fnc(void* userp, curl_off_t dltotal, curl_off_t dlnow,
                         curl_off_t ultotal, curl_off_t ulnow) {
   long* maxfilesize = (long*)userp;
-  if (dlnow >
-      (curl_off_t)maxfilesize) /* Aborts with CURLE_ABORTED_BY_CALLBACK.  */
+  if (*maxfilesize > 0 &&
+      dlnow > (curl_off_t)*maxfilesize) /* Aborts with
+                                           CURLE_ABORTED_BY_CALLBACK.  */
     return 1;
   return 0;
 }
 
 std::string Http::fetch() {
   std::string response;
+
+  fetch([&response](const uint8_t* data, size_t len) {
+    response.append((const char*)data, len);
+  });
+  return response;
+}
+
+void Http::fetch(Botan::DataSink& sink) {
+  fetch([&sink](const uint8_t* data, size_t len) { sink.write(data, len); });
+}
+
+void Http::fetch(const Sink& sink) {
+  WriteState state;
+  std::string cache_file;
+  std::ifstream cached_body;
+  CacheEntry cached;
+  bool have_cached = false;
+  auto header_list = m_header;
   char last_error[CURL_ERROR_SIZE] = {'\0'};
   std::unique_ptr<struct curl_slist, void (*)(struct curl_slist*)> headers{
       nullptr, curl_slist_free_all};
   std::unique_ptr<struct curl_slist, void (*)(struct curl_slist*)> connect_to{
       nullptr, curl_slist_free_all};
 
+  state.handle = m_handle.get();
+  state.sink = &sink;
+  state.response.url = m_url;
+  m_not_modified = false;
+
+  /* Only plain GET requests are cached.  */
+  if (!m_cache_dir.empty() && !m_post_data) {
+    cache_file = cache_filename(m_cache_dir, m_url);
+    have_cached = cache_lookup(cache_file, m_url, cached_body, cached);
+    if (have_cached) {
+      if (!cached.etag.empty()) header_list["If-None-Match"] = cached.etag;
+      if (!cached.last_modified.empty())
+        header_list["If-Modified-Since"] = cached.last_modified;
+    }
+
+    mkdir(m_cache_dir.c_str(), 0700);
+    state.cache_tmp = cache_file + "." + std::to_string(getpid()) + "." +
+                      std::to_string((uintptr_t)this) + ".tmp";
+  }
+
   set_opt_ptr(CURLOPT_WRITEFUNCTION, (void*)write_fnc);
-  set_opt_ptr(CURLOPT_WRITEDATA, (void*)&response);
+  set_opt_ptr(CURLOPT_WRITEDATA, (void*)&state);
+  set_opt_ptr(CURLOPT_HEADERFUNCTION, (void*)header_fnc);
+  set_opt_ptr(CURLOPT_HEADERDATA, (void*)&state);
   // FIXME: Proxy, IP resolve, header, post, cainfo, http_code?
   set_opt_ptr(CURLOPT_ERRORBUFFER, last_error);
 
-  for (auto& item : m_header) {
+  for (auto& item : header_list) {
     std::string header = item.first;
     header += ": " + item.second;
     /* A bit odd: curl_slist_append also does initialization.  The return
@@ -171,22 +418,51 @@ std::string Http::fetch() {
   set_opt_long(CURLOPT_NOPROGRESS, 0);
 
   CURLcode result = curl_easy_perform(m_handle.get());
+  long http_code = 0;
+  curl_easy_getinfo(m_handle.get(), CURLINFO_RESPONSE_CODE, &http_code);
+
+  /* Keep the body for the next request, but only if it is complete.  */
+  if (!state.cache_tmp.empty()) {
+    bool complete = (result == CURLE_OK && http_code == 200);
+    if (complete) cache_open(&state);
+    if (state.cache_out.is_open()) {
+      state.cache_out.close();
+      if (!complete || !state.cache_out ||
+          std::rename(state.cache_tmp.c_str(), cache_file.c_str()) != 0)
+        std::remove(state.cache_tmp.c_str());
+      else
+        cache_evict(m_cache_dir, m_cache_max_entries, m_cache_max_age);
+    }
+  }
+  /* A response without validators replaces an outdated entry.  */
+  if (have_cached && result == CURLE_OK && http_code == 200 &&
+      !state.response.cacheable())
+    std::remove(cache_file.c_str());
+
+  if (state.error) std::rethrow_exception(state.error);
   if (result != CURLE_OK) throw std::runtime_error(last_error);
 
   m_last_error = last_error;
 
-  long http_code;
-  curl_easy_getinfo(m_handle.get(), CURLINFO_RESPONSE_CODE, &http_code);
   std::string reason;
   reason += "HTTP " + std::to_string(http_code);
-  if (http_code != 200) throw std::runtime_error(reason);
+  if (http_code == 304 && have_cached) {
+    char buffer[16384];
+    m_not_modified = true;
+    /* Mark the entry as used for cache_evict.  */
+    utimes(cache_file.c_str(), nullptr);
+    while (cached_body.read(buffer, sizeof(buffer)) ||
+           cached_body.gcount() > 0)
+      sink((const uint8_t*)buffer, cached_body.gcount());
+    if (cached_body.bad()) throw std::runtime_error("error reading cache");
+  } else if (http_code != 200)
+    throw std::runtime_error(reason);
 
   // Clear post data so it is never reused accidentially.
   set_post();
   m_connect_to = "";
   /* This is probably too simplicistic.  */
   m_header.clear();
-  return response;
 }
 
 }  // Namespace NeoPG
@@ -6,8 +6,10 @@
 
 #pragma once
 
+#include <botan/data_snk.h>
 #include <curl/curl.h>
 #include <tao/json/external/optional.hpp>
+#include <functional>
 #include <map>
 #include <regex>
 
@@ -18,6 +20,8 @@ namespace NeoPG {
 class NEOPG_UNSTABLE_API Http {
   const long MAX_REDIRECTS_DEFAULT = 2;
   const long MAX_FILESIZE_DEFAULT = 2 * 1024 * 1024;
+  const size_t CACHE_MAX_ENTRIES_DEFAULT = 1000;
+  const long CACHE_MAX_AGE_DEFAULT = 30 * 24 * 60 * 60;
 
  public:
   Http();
@@ -35,6 +39,19 @@ class NEOPG_UNSTABLE_API Http {
   Http& set_connect_to(const std::string& host);
   Http& set_maxfilesize(long size);
 
+  /* Keep successful GET responses that carry an ETag or Last-Modified
+     header in DIRECTORY, one file per URL.  Later requests for the
+     same URL are made conditional, and if the server answers with 304
+     Not Modified, the stored body is delivered instead.  An empty
+     DIRECTORY disables the cache.  */
+  Http& set_cache_dir(const std::string& directory);
+
+  /* Limit the cache directory to MAX_ENTRIES responses which have been
+     used within the last MAX_AGE seconds.  The limits are enforced
+     whenever a response is stored; the entries used least recently
+     are removed first.  */
+  Http& set_cache_limits(size_t max_entries, long max_age);
+
   enum class Resolve : long {
     Any = CURL_IPRESOLVE_WHATEVER,
     IPv4 = CURL_IPRESOLVE_V4,
@@ -42,16 +59,37 @@ class NEOPG_UNSTABLE_API Http {
   };
   Http& set_ipresolve(Resolve which = Resolve::Any);
 
+  /* A sink receives the body of a response in chunks as they arrive.
+     Exceptions thrown by the sink abort the transfer and are rethrown
+     by fetch.  */
+  using Sink = std::function<void(const uint8_t* data, size_t len)>;
+
+  /* Perform the request and return the response body.  */
   std::string fetch();
 
+  /* Perform the request and pass the response body to SINK.  Only the
+     body of a successful response is delivered; on errors fetch throws
+     before or while writing to the sink.  */
+  void fetch(const Sink& sink);
+  void fetch(Botan::DataSink& sink);
+
   std::string get_last_error() { return m_last_error; }
 
+  /* True if the last fetch was answered with 304 Not Modified and the
+     body was taken from the cache directory.  */
+  bool not_modified() const { return m_not_modified; }
+
   /* Add header here.  */
   std::map<std::string, std::string> m_header;
 
  private:
   std::unique_ptr<CURL, void (*)(CURL*)> m_handle;
   std::string m_last_error;
+  std::string m_url;
+  std::string m_cache_dir;
+  size_t m_cache_max_entries{CACHE_MAX_ENTRIES_DEFAULT};
+  long m_cache_max_age{CACHE_MAX_AGE_DEFAULT};
+  bool m_not_modified{false};
   tao::optional<std::string> m_post_data;
   std::string m_connect_to;
   long m_maxfilesize;
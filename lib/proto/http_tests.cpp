@@ -6,10 +6,159 @@
 
 #include <neopg/http.h>
 
+#include <botan/data_snk.h>
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 using namespace NeoPG;
 
+namespace {
+
+/* A minimal HTTP server on the loopback interface, which answers one
+   request per connection with a canned response, in order.  */
+class StubServer {
+ public:
+  explicit StubServer(const std::string& response)
+      : StubServer(std::vector<std::string>{response}) {}
+
+  explicit StubServer(const std::vector<std::string>& responses)
+      : m_responses(responses) {
+    struct sockaddr_in addr = {};
+    socklen_t addrlen = sizeof(addr);
+
+    m_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (m_fd < 0) throw std::runtime_error("socket failed");
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(m_fd, (struct sockaddr*)&addr, sizeof(addr)) ||
+        listen(m_fd, 1) ||
+        getsockname(m_fd, (struct sockaddr*)&addr, &addrlen))
+      throw std::runtime_error("bind failed");
+    m_port = ntohs(addr.sin_port);
+    m_thread = std::thread([this]() { serve(); });
+  }
+
+  ~StubServer() {
+    /* Wake up an accept for a client that never came, for example
+       after a failed assertion.  */
+    shutdown(m_fd, SHUT_RDWR);
+    wait();
+    close(m_fd);
+  }
+
+  /* Wait until all responses have been sent.  */
+  void wait() {
+    if (m_thread.joinable()) m_thread.join();
+  }
+
+  std::string url(const std::string& path = "/") {
+    return "http://127.0.0.1:" + std::to_string(m_port) + path;
+  }
+
+  /* The requests as received by the server.  Only valid after
+     wait.  */
+  std::vector<std::string> m_requests;
+
+ private:
+  void serve() {
+    for (auto& response : m_responses) {
+      int fd = accept(m_fd, nullptr, nullptr);
+      if (fd < 0) return;
+
+      std::string request;
+      char buf[1024];
+      ssize_t n;
+      while (request.find("\r\n\r\n") == std::string::npos &&
+             (n = read(fd, buf, sizeof(buf))) > 0)
+        request.append(buf, n);
+      m_requests.push_back(request);
+
+      size_t off = 0;
+      while (off < response.size() &&
+             (n = send(fd, response.data() + off, response.size() - off,
+                       MSG_NOSIGNAL)) > 0)
+        off += n;
+      close(fd);
+    }
+  }
+
+  std::vector<std::string> m_responses;
+  int m_fd;
+  int m_port;
+  std::thread m_thread;
+};
+
+std::string http_response(const std::string& status, const std::string& body,
+                          const std::string& headers = "") {
+  return "HTTP/1.1 " + status + "\r\nContent-Length: " +
+         std::to_string(body.size()) + "\r\n" + headers +
+         "Connection: close\r\n\r\n" + body;
+}
+
+/* A fresh, empty directory for cache files.  */
+std::string make_cache_dir() {
+  char dir[] = "/tmp/neopg-http-XXXXXX";
+  if (!mkdtemp(dir)) throw std::runtime_error("mkdtemp failed");
+  return dir;
+}
+
+void remove_cache_dir(const std::string& dir) {
+  DIR* dp = opendir(dir.c_str());
+  if (dp) {
+    struct dirent* de;
+    while ((de = readdir(dp)))
+      if (de->d_name[0] != '.') unlink((dir + "/" + de->d_name).c_str());
+    closedir(dp);
+  }
+  rmdir(dir.c_str());
+}
+
+/* The number of files in the cache directory DIR.  */
+size_t count_cache_files(const std::string& dir) {
+  size_t count = 0;
+  DIR* dp = opendir(dir.c_str());
+  if (dp) {
+    struct dirent* de;
+    while ((de = readdir(dp)))
+      if (de->d_name[0] != '.') count++;
+    closedir(dp);
+  }
+  return count;
+}
+
+/* Pretend that the files in the cache directory DIR were last used
+   SECONDS earlier than they were.  */
+void age_cache_files(const std::string& dir, long seconds) {
+  DIR* dp = opendir(dir.c_str());
+  if (dp) {
+    struct dirent* de;
+    while ((de = readdir(dp))) {
+      std::string filename = dir + "/" + de->d_name;
+      struct stat st;
+      struct timeval times[2] = {};
+      if (de->d_name[0] == '.' || stat(filename.c_str(), &st)) continue;
+      times[0].tv_sec = times[1].tv_sec = st.st_mtime - seconds;
+      utimes(filename.c_str(), times);
+    }
+    closedir(dp);
+  }
+}
+
+}  // namespace
+
 namespace NeoPG {
 
 TEST(NeopgTest, proto_http_test) {
@@ -21,4 +170,182 @@ TEST(NeopgTest, proto_http_test) {
     // request.fetch();
   }
 }
+
+TEST(NeopgTest, proto_http_fetch_sink_test) {
+  std::string body(1024 * 1024, 'x');
+  for (size_t i = 0; i < body.size(); i += 997) body[i] = 'a' + (i % 26);
+  StubServer server(http_response("200 OK", body));
+
+  Http request;
+  request.set_url(server.url()).default_proxy(false);
+  std::string received;
+  size_t chunks = 0;
+  request.fetch([&](const uint8_t* data, size_t len) {
+    received.append((const char*)data, len);
+    chunks++;
+  });
+  ASSERT_EQ(received, body);
+  ASSERT_GT(chunks, 1u);
+}
+
+TEST(NeopgTest, proto_http_fetch_datasink_test) {
+  StubServer server(http_response("200 OK", "Hello, World!"));
+
+  Http request;
+  request.set_url(server.url()).default_proxy(false);
+  std::stringstream out;
+  Botan::DataSink_Stream sink(out);
+  request.fetch(sink);
+  ASSERT_EQ(out.str(), "Hello, World!");
+}
+
+TEST(NeopgTest, proto_http_fetch_error_test) {
+  StubServer server(http_response("404 Not Found", "Error document"));
+
+  Http request;
+  request.set_url(server.url()).default_proxy(false);
+  std::string received;
+  ASSERT_THROW(request.fetch([&](const uint8_t* data, size_t len) {
+    received.append((const char*)data, len);
+  }),
+               std::runtime_error);
+  ASSERT_EQ(received, "");
+}
+
+TEST(NeopgTest, proto_http_fetch_sink_exception_test) {
+  StubServer server(http_response("200 OK", "Hello, World!"));
+
+  Http request;
+  request.set_url(server.url()).default_proxy(false);
+  ASSERT_THROW(request.fetch([](const uint8_t* data, size_t len) {
+    throw std::length_error("sink full");
+  }),
+               std::length_error);
+}
+
+TEST(NeopgTest, proto_http_cache_test) {
+  std::string dir = make_cache_dir();
+  StubServer server(std::vector<std::string>{
+      http_response("200 OK", "Hello, World!",
+                    "ETag: \"v1\"\r\n"
+                    "Last-Modified: Mon, 02 Oct 2017 10:00:00 GMT\r\n"),
+      "HTTP/1.1 304 Not Modified\r\nConnection: close\r\n\r\n",
+      http_response("200 OK", "Goodbye!", "ETag: \"v2\"\r\n"),
+      "HTTP/1.1 304 Not Modified\r\nConnection: close\r\n\r\n"});
+
+  Http request;
+  request.set_url(server.url()).default_proxy(false).set_cache_dir(dir);
+  ASSERT_EQ(request.fetch(), "Hello, World!");
+  ASSERT_FALSE(request.not_modified());
+  ASSERT_EQ(request.fetch(), "Hello, World!");
+  ASSERT_TRUE(request.not_modified());
+  ASSERT_EQ(request.fetch(), "Goodbye!");
+  ASSERT_FALSE(request.not_modified());
+  ASSERT_EQ(request.fetch(), "Goodbye!");
+  ASSERT_TRUE(request.not_modified());
+  remove_cache_dir(dir);
+
+  server.wait();
+  ASSERT_EQ(server.m_requests.size(), 4u);
+  ASSERT_EQ(server.m_requests[0].find("If-None-Match"), std::string::npos);
+  ASSERT_NE(server.m_requests[1].find("If-None-Match: \"v1\"\r\n"),
+            std::string::npos);
+  ASSERT_NE(server.m_requests[1].find(
+                "If-Modified-Since: Mon, 02 Oct 2017 10:00:00 GMT\r\n"),
+            std::string::npos);
+  ASSERT_NE(server.m_requests[2].find("If-None-Match: \"v1\"\r\n"),
+            std::string::npos);
+  ASSERT_NE(server.m_requests[3].find("If-None-Match: \"v2\"\r\n"),
+            std::string::npos);
+  ASSERT_EQ(server.m_requests[3].find("If-Modified-Since"), std::string::npos);
+}
+
+TEST(NeopgTest, proto_http_cache_uncacheable_test) {
+  std::string dir = make_cache_dir();
+  StubServer server(std::vector<std::string>{
+      http_response("200 OK", "Hello, World!"),
+      http_response("200 OK", "Hello, World!")});
+
+  Http request;
+  request.set_url(server.url()).default_proxy(false).set_cache_dir(dir);
+  ASSERT_EQ(request.fetch(), "Hello, World!");
+  ASSERT_EQ(request.fetch(), "Hello, World!");
+  ASSERT_FALSE(request.not_modified());
+  remove_cache_dir(dir);
+
+  server.wait();
+  ASSERT_EQ(server.m_requests.size(), 2u);
+  ASSERT_EQ(server.m_requests[1].find("If-"), std::string::npos);
+}
+
+TEST(NeopgTest, proto_http_cache_error_test) {
+  std::string dir = make_cache_dir();
+  StubServer server(std::vector<std::string>{
+      http_response("404 Not Found", "Error document", "ETag: \"e\"\r\n"),
+      http_response("200 OK", "Hello, World!")});
+
+  Http request;
+  request.set_url(server.url()).default_proxy(false).set_cache_dir(dir);
+  ASSERT_THROW(request.fetch(), std::runtime_error);
+  ASSERT_EQ(request.fetch(), "Hello, World!");
+  remove_cache_dir(dir);
+
+  /* Error documents are never cached.  */
+  server.wait();
+  ASSERT_EQ(server.m_requests[1].find("If-None-Match"), std::string::npos);
+}
+
+TEST(NeopgTest, proto_http_cache_evict_lru_test) {
+  std::string dir = make_cache_dir();
+  StubServer server(std::vector<std::string>{
+      http_response("200 OK", "a", "ETag: \"a\"\r\n"),
+      http_response("200 OK", "b", "ETag: \"b\"\r\n"),
+      "HTTP/1.1 304 Not Modified\r\nConnection: close\r\n\r\n",
+      http_response("200 OK", "c", "ETag: \"c\"\r\n"),
+      "HTTP/1.1 304 Not Modified\r\nConnection: close\r\n\r\n",
+      http_response("200 OK", "b")});
+
+  Http request;
+  request.default_proxy(false).set_cache_dir(dir).set_cache_limits(2, 3600);
+  ASSERT_EQ(request.set_url(server.url("/a")).fetch(), "a");
+  age_cache_files(dir, 200);
+  ASSERT_EQ(request.set_url(server.url("/b")).fetch(), "b");
+  age_cache_files(dir, 100);
+  /* Using /a makes /b the least recently used entry.  */
+  ASSERT_EQ(request.set_url(server.url("/a")).fetch(), "a");
+  ASSERT_TRUE(request.not_modified());
+  ASSERT_EQ(request.set_url(server.url("/c")).fetch(), "c");
+  ASSERT_EQ(count_cache_files(dir), 2u);
+  ASSERT_EQ(request.set_url(server.url("/a")).fetch(), "a");
+  ASSERT_TRUE(request.not_modified());
+  ASSERT_EQ(request.set_url(server.url("/b")).fetch(), "b");
+  remove_cache_dir(dir);
+
+  server.wait();
+  ASSERT_EQ(server.m_requests.size(), 6u);
+  ASSERT_NE(server.m_requests[4].find("If-None-Match: \"a\"\r\n"),
+            std::string::npos);
+  ASSERT_EQ(server.m_requests[5].find("If-None-Match"), std::string::npos);
+}
+
+TEST(NeopgTest, proto_http_cache_evict_age_test) {
+  std::string dir = make_cache_dir();
+  StubServer server(std::vector<std::string>{
+      http_response("200 OK", "a", "ETag: \"a\"\r\n"),
+      http_response("200 OK", "b", "ETag: \"b\"\r\n"),
+      http_response("200 OK", "a")});
+
+  Http request;
+  request.default_proxy(false).set_cache_dir(dir).set_cache_limits(10, 3600);
+  ASSERT_EQ(request.set_url(server.url("/a")).fetch(), "a");
+  age_cache_files(dir, 7200);
+  ASSERT_EQ(request.set_url(server.url("/b")).fetch(), "b");
+  ASSERT_EQ(count_cache_files(dir), 1u);
+  ASSERT_EQ(request.set_url(server.url("/a")).fetch(), "a");
+  remove_cache_dir(dir);
+
+  server.wait();
+  ASSERT_EQ(server.m_requests.size(), 3u);
+  ASSERT_EQ(server.m_requests[2].find("If-None-Match"), std::string::npos);
+}
 }  // namespace NeoPG
@@ -4,3 +4,6 @@ bench 'dd if=/dev/urandom bs=4M count=50 | gpg2 --print-md SHA1' 'dd if=/dev/ura
 dd if=/dev/urandom bs=4M count=10 | src/neopg gpg2 --compress-algo zip --encrypt -r obama  | src/neopg gpg2 --decrypt > /dev/null
 dd if=/dev/urandom bs=4M count=10 | src/neopg gpg2 --compress-algo zlib --encrypt -r obama  | src/neopg gpg2 --decrypt > /dev/null
 dd if=/dev/urandom bs=4M count=10 | src/neopg gpg2 --compress-algo bzip2 --encrypt -r obama  | src/neopg gpg2 --decrypt > /dev/null
+
+# CRL cache lookups of serial numbers on a million-entry CRL.
+src/cdb-bench 1000000